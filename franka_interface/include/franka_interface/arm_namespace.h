@@ -0,0 +1,60 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <string>
+
+#include <ros/names.h>
+#include <ros/node_handle.h>
+
+namespace franka_interface {
+
+/**
+ * Returns a node handle in the namespace of the arm that node_handle belongs to.
+ *
+ * The arm namespace is the closest namespace at or above node_handle that holds a robot_config
+ * parameter: "/" when the control node drives a single arm (the configuration in
+ * robot_config.yaml is loaded globally), or e.g. "/left" when it drives several arms and the
+ * configuration of each is loaded into its own namespace. The topics, services and parameters
+ * of the interface (robot_config, controllers_config, franka_ros_interface/...) are resolved
+ * relative to it, so that a single arm keeps the global names. Its callbacks go to the callback
+ * queue of node_handle.
+ *
+ * @param[in] node_handle e.g. the node handle of a controller.
+ * @return node handle in the arm namespace.
+ */
+inline ros::NodeHandle armNodeHandle(const ros::NodeHandle& node_handle) {
+  std::string robot_config;
+  ros::NodeHandle arm_node_handle(node_handle.searchParam("robot_config", robot_config)
+                                      ? ros::names::parentNamespace(robot_config)
+                                      : std::string("/"));
+  // like a child node handle, it delivers its callbacks to the queue of node_handle
+  arm_node_handle.setCallbackQueue(node_handle.getCallbackQueue());
+  return arm_node_handle;
+}
+
+}  // namespace franka_interface
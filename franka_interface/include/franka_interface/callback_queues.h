@@ -0,0 +1,137 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <franka_core_msgs/CallbackQueueTiming.h>
+#include <franka_interface/histogram.h>
+#include <ros/callback_queue.h>
+#include <ros/node_handle.h>
+#include <ros/publisher.h>
+#include <ros/timer.h>
+
+namespace franka_interface {
+
+/**
+ * ros::CallbackQueue that keeps statistics of the callbacks going through it: how many are
+ * waiting, how long they wait before they are called and how long they run. Each callback is
+ * wrapped when it is added; the statistics can be read from any thread.
+ */
+class MonitoredCallbackQueue : public ros::CallbackQueue {
+ public:
+  /**
+   * @param[in] name name of the queue in the statistics.
+   */
+  explicit MonitoredCallbackQueue(std::string name) : name_(std::move(name)) {}
+  ~MonitoredCallbackQueue() override;
+
+  void addCallback(const ros::CallbackInterfacePtr& callback, uint64_t removal_id = 0) override;
+
+  const std::string& name() const { return name_; }
+
+  /**
+   * Fills everything but the number of threads.
+   */
+  void fillTiming(franka_core_msgs::CallbackQueueTiming& msg) const;
+
+ private:
+  class TimedCallback;
+
+  void callbackFinished(double wait, double run);
+  void callbackReleased() { depth_.fetch_sub(1, std::memory_order_relaxed); }
+
+  const std::string name_;
+  std::atomic<uint32_t> depth_{0};
+  std::atomic<uint32_t> max_depth_{0};
+  // the histograms have a single writer, but the queue may be served by several threads
+  std::mutex histogram_mutex_;
+  Histogram<LogBins> wait_;
+  Histogram<LogBins> run_;
+};
+
+/**
+ * Registers the queue for the joint command subscriptions of the controllers of an arm. The
+ * control node registers a queue per arm before loading the controllers and serves it from a
+ * thread of its own, so that commands are neither delayed by services, actions and
+ * dynamic_reconfigure nor by the commands of another arm.
+ *
+ * @param[in] arm_node_handle node handle in the arm namespace.
+ * @param[in] queue the queue, nullptr to remove it. Must outlive the controllers.
+ */
+void setCommandCallbackQueue(const ros::NodeHandle& arm_node_handle,
+                             ros::CallbackQueueInterface* queue);
+
+/**
+ * Returns the node handle for the command subscriptions of a controller: a node handle in the
+ * arm namespace (see armNodeHandle()) whose callbacks go to the command queue registered for the
+ * arm, or to the queue of node_handle if the control node did not register one.
+ *
+ * @param[in] node_handle node handle of the controller.
+ */
+ros::NodeHandle commandNodeHandle(const ros::NodeHandle& node_handle);
+
+/**
+ * Publishes the statistics of the callback queues of the control node at a low rate on
+ * franka_ros_interface/franka_control/callback_queue_statistics.
+ */
+class CallbackQueueMonitor {
+ public:
+  /**
+   * Adds a queue to the statistics. Call before init().
+   *
+   * @param[in] queue the queue, must outlive the monitor.
+   * @param[in] threads number of threads serving the queue.
+   */
+  void addQueue(const MonitoredCallbackQueue& queue, uint32_t threads);
+
+  /**
+   * Reads control_node_config/callback_queues/publish_rate and starts the publishing timer.
+   *
+   * @param[in] nh node handle in the (first) arm namespace.
+   */
+  void init(ros::NodeHandle& nh);
+
+ private:
+  struct Entry {
+    const MonitoredCallbackQueue* queue;
+    uint32_t threads;
+  };
+
+  void publishStatistics(const ros::TimerEvent& e);
+
+  std::vector<Entry> queues_;
+  ros::Publisher statistics_publisher_;
+  ros::Timer publish_timer_;
+};
+
+}  // namespace franka_interface
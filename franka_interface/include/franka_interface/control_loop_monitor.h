@@ -0,0 +1,121 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <controller_manager/controller_manager.h>
+#include <franka_core_msgs/ControlLoopTiming.h>
+#include <franka_interface/histogram.h>
+#include <ros/ros.h>
+
+namespace franka_interface {
+
+/**
+ * Records the timing of every cycle of the franka_hw control loop and publishes a summary at a
+ * low rate.
+ *
+ * cycleStarted() and cycleFinished() are called from the control loop and only touch
+ * preallocated atomics. Everything else (finding out which controllers are running, computing
+ * percentiles, publishing) happens in ros::Timer callbacks on the spinner threads.
+ *
+ * The controller manager does not expose the duration of individual controllers, so the
+ * breakdown is done per set of running controllers: samples are accumulated separately for
+ * every combination of controllers seen so far. Since only one motion controller is normally
+ * running at a time, this points directly at the controller that used up the budget. The
+ * running set is polled, so cycles right after a switch may be counted for the previous set.
+ */
+class ControlLoopMonitor {
+ public:
+  /**
+   * Reads the configuration and starts the publishing timers.
+   *
+   * @param[in] nh Node handle in the arm namespace, used for parameters, timers and the
+   * statistics topic.
+   * @param[in] controller_manager the controller manager instance driven by the control loop.
+   */
+  void init(ros::NodeHandle& nh,
+            boost::shared_ptr<controller_manager::ControllerManager> controller_manager);
+
+  /**
+   * Marks the start of a control cycle. Realtime safe.
+   *
+   * @param[in] period period passed to the control loop callback; zero at the start of a motion.
+   */
+  void cycleStarted(const ros::Duration& period);
+
+  /**
+   * Marks the end of the control cycle started by the last cycleStarted(). Realtime safe.
+   */
+  void cycleFinished();
+
+ private:
+  static constexpr size_t kMaxControllerSets{16};
+  static constexpr double kNominalPeriod{0.001};  // [s]
+
+  struct TimingSlot {
+    Histogram<LinearBins> update_duration;
+    Histogram<LinearBins> jitter;
+    std::atomic<uint64_t> deadline_misses{0};
+    std::atomic<uint64_t> lost_robot_packets{0};
+  };
+
+  void checkRunningControllers(const ros::TimerEvent& e);
+  void publishStatistics(const ros::TimerEvent& e);
+  void fillTiming(const TimingSlot& slot, franka_core_msgs::ControlLoopTiming& msg) const;
+
+  boost::shared_ptr<controller_manager::ControllerManager> controller_manager_;
+
+  // slot 0 collects cycles that could not be attributed (before the first check or when
+  // more than kMaxControllerSets different sets were seen)
+  TimingSlot total_;
+  std::array<TimingSlot, kMaxControllerSets> controller_sets_;
+  std::atomic<size_t> active_set_{0};
+
+  // owned by the timer callbacks
+  std::mutex controller_set_names_mutex_;
+  std::vector<std::vector<std::string>> controller_set_names_;
+
+  // owned by the control loop
+  double deadline_{0.0005};
+  size_t cycle_set_{0};
+  bool has_last_cycle_{false};
+  std::chrono::steady_clock::time_point cycle_start_;
+  std::chrono::steady_clock::time_point last_cycle_start_;
+
+  ros::Publisher statistics_publisher_;
+  ros::Timer check_timer_;
+  ros::Timer publish_timer_;
+};
+
+}  // namespace franka_interface
@@ -0,0 +1,255 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <franka/model.h>
+#include <franka_hw/franka_model_interface.h>
+#include <hardware_interface/internal/hardware_resource_manager.h>
+#include <hardware_interface/robot_hw.h>
+
+namespace franka_interface {
+
+/**
+ * Provides the model quantities cached by FrankaModelCache, evaluated at the current robot
+ * state. Hardware with a libfranka model uses FrankaModelHandleSource; hardware without one
+ * (simulation, benchmarks) implements its own source.
+ */
+class FrankaModelSource {
+ public:
+  virtual ~FrankaModelSource() = default;
+
+  virtual std::array<double, 7> getCoriolis() const = 0;
+  virtual std::array<double, 7> getGravity() const = 0;
+  virtual std::array<double, 49> getMass() const = 0;
+  virtual std::array<double, 42> getZeroJacobian(const franka::Frame& frame) const = 0;
+};
+
+/**
+ * FrankaModelSource evaluating libfranka's model through a franka_hw::FrankaModelHandle.
+ */
+class FrankaModelHandleSource : public FrankaModelSource {
+ public:
+  explicit FrankaModelHandleSource(const franka_hw::FrankaModelHandle& model_handle)
+      : model_handle_(model_handle) {}
+
+  std::array<double, 7> getCoriolis() const override { return model_handle_.getCoriolis(); }
+  std::array<double, 7> getGravity() const override { return model_handle_.getGravity(); }
+  std::array<double, 49> getMass() const override { return model_handle_.getMass(); }
+  std::array<double, 42> getZeroJacobian(const franka::Frame& frame) const override {
+    return model_handle_.getZeroJacobian(frame);
+  }
+
+ private:
+  franka_hw::FrankaModelHandle model_handle_;
+};
+
+/**
+ * Computes the dynamics and kinematics quantities of franka_hw::FrankaModelHandle at most once
+ * per control cycle.
+ *
+ * Every quantity is computed on the first request after invalidate() and served from the cache
+ * for the rest of the cycle, so quantities nobody asks for are never computed. The owner of the
+ * robot state (the control node) must call invalidate() every time the state is updated. Not
+ * thread safe; it is meant to be used from the control loop only.
+ */
+class FrankaModelCache {
+ public:
+  FrankaModelCache() = delete;
+
+  /**
+   * @param[in] model_handle Handle providing the model and the robot state it is evaluated at.
+   * @param[in] cache_per_tick If false, every request is recomputed. Used when the hardware
+   * does not provide a shared cache to keep the controller code independent of it.
+   */
+  explicit FrankaModelCache(const franka_hw::FrankaModelHandle& model_handle,
+                            bool cache_per_tick = true)
+      : FrankaModelCache(std::make_unique<FrankaModelHandleSource>(model_handle), cache_per_tick) {}
+
+  /**
+   * @param[in] source Source of the model quantities.
+   * @param[in] cache_per_tick If false, every request is recomputed.
+   */
+  explicit FrankaModelCache(std::unique_ptr<FrankaModelSource> source, bool cache_per_tick = true)
+      : source_(std::move(source)), cache_per_tick_(cache_per_tick) {}
+
+  /**
+   * Marks all cached quantities as outdated. Call once per control cycle after the robot state
+   * was updated.
+   */
+  void invalidate() { valid_ = 0; }
+
+  /**
+   * @return the Coriolis force vector at the current robot state.
+   */
+  const std::array<double, 7>& getCoriolis() {
+    if (!isValid(kCoriolis)) {
+      coriolis_ = source_->getCoriolis();
+    }
+    return coriolis_;
+  }
+
+  /**
+   * @return the gravity vector at the current robot state, with the default gravity vector and
+   * the payload configured in the robot state.
+   */
+  const std::array<double, 7>& getGravity() {
+    if (!isValid(kGravity)) {
+      gravity_ = source_->getGravity();
+    }
+    return gravity_;
+  }
+
+  /**
+   * @return the 7x7 mass matrix (column-major) at the current robot state.
+   */
+  const std::array<double, 49>& getMass() {
+    if (!isValid(kMass)) {
+      mass_ = source_->getMass();
+    }
+    return mass_;
+  }
+
+  /**
+   * @param[in] frame The desired frame.
+   * @return the 6x7 zero Jacobian (column-major) of the given frame at the current robot state.
+   */
+  const std::array<double, 42>& getZeroJacobian(const franka::Frame& frame) {
+    size_t index = static_cast<size_t>(frame);
+    if (!isValid(kZeroJacobian << index)) {
+      zero_jacobian_[index] = source_->getZeroJacobian(frame);
+    }
+    return zero_jacobian_[index];
+  }
+
+ private:
+  static constexpr size_t kNumFrames{static_cast<size_t>(franka::Frame::kStiffness) + 1};
+  static constexpr uint32_t kCoriolis{1u << 0};
+  static constexpr uint32_t kGravity{1u << 1};
+  static constexpr uint32_t kMass{1u << 2};
+  static constexpr uint32_t kZeroJacobian{1u << 3};  // one bit per frame from here on
+
+  // returns whether the quantity is cached and marks it as cached from now on
+  bool isValid(uint32_t bit) {
+    bool valid = cache_per_tick_ && (valid_ & bit);
+    valid_ |= bit;
+    return valid;
+  }
+
+  std::unique_ptr<FrankaModelSource> source_;
+  bool cache_per_tick_;
+  uint32_t valid_{0};
+
+  std::array<double, 7> coriolis_{};
+  std::array<double, 7> gravity_{};
+  std::array<double, 49> mass_{};
+  std::array<std::array<double, 42>, kNumFrames> zero_jacobian_{};
+};
+
+/**
+ * Handle to read the per-cycle cached model quantities of a Franka robot, with the same getters
+ * as franka_hw::FrankaModelHandle but returning references.
+ */
+class FrankaModelCacheHandle {
+ public:
+  FrankaModelCacheHandle() = delete;
+
+  /**
+   * Creates an instance of a FrankaModelCacheHandle sharing the given cache.
+   *
+   * @param[in] name The name of the handle, normally arm_id + "_model".
+   * @param[in] cache The cache owned by the hardware.
+   */
+  FrankaModelCacheHandle(const std::string& name, std::shared_ptr<FrankaModelCache> cache)
+      : name_(name), cache_(std::move(cache)) {}
+
+  /**
+   * Creates a handle with a private, non-caching model for hardware that does not provide a
+   * FrankaModelCacheInterface.
+   *
+   * @param[in] model_handle The model handle to forward all requests to.
+   */
+  explicit FrankaModelCacheHandle(const franka_hw::FrankaModelHandle& model_handle)
+      : name_(model_handle.getName()),
+        cache_(std::make_shared<FrankaModelCache>(model_handle, false)) {}
+
+  /**
+   * Gets the name of the model handle.
+   *
+   * @return Name of the model handle.
+   */
+  const std::string& getName() const noexcept { return name_; }
+
+  const std::array<double, 7>& getCoriolis() { return cache_->getCoriolis(); }
+  const std::array<double, 7>& getGravity() { return cache_->getGravity(); }
+  const std::array<double, 49>& getMass() { return cache_->getMass(); }
+  const std::array<double, 42>& getZeroJacobian(const franka::Frame& frame) {
+    return cache_->getZeroJacobian(frame);
+  }
+
+ private:
+  std::string name_;
+  std::shared_ptr<FrankaModelCache> cache_;
+};
+
+/**
+ * Hardware interface to share one FrankaModelCache between all controllers of a control loop.
+ */
+class FrankaModelCacheInterface
+    : public hardware_interface::HardwareResourceManager<FrankaModelCacheHandle> {};
+
+/**
+ * Gets the cached model handle of the given arm, falling back to a non-caching handle wrapping
+ * the plain model interface when the hardware does not provide a FrankaModelCacheInterface.
+ * Controllers should list FrankaModelCacheInterface as an optional interface.
+ *
+ * @param[in] robot_hw The robot hardware passed to the controller's init().
+ * @param[in] arm_id The arm_id of the robot.
+ * @return the handle, or nullptr if neither interface provides it.
+ * @throw hardware_interface::HardwareInterfaceException if the handle does not exist.
+ */
+inline std::unique_ptr<FrankaModelCacheHandle> getModelCacheHandle(
+    hardware_interface::RobotHW* robot_hw, const std::string& arm_id) {
+  auto* model_cache_interface = robot_hw->get<FrankaModelCacheInterface>();
+  if (model_cache_interface != nullptr) {
+    return std::make_unique<FrankaModelCacheHandle>(
+        model_cache_interface->getHandle(arm_id + "_model"));
+  }
+  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
+  if (model_interface != nullptr) {
+    return std::make_unique<FrankaModelCacheHandle>(
+        model_interface->getHandle(arm_id + "_model"));
+  }
+  return nullptr;
+}
+
+}  // namespace franka_interface
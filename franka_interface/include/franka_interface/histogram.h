@@ -0,0 +1,165 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <franka_core_msgs/LatencyPercentiles.h>
+
+namespace franka_interface {
+
+/**
+ * Bins of 20 us covering 0 - 2 ms, for the durations of the control loop.
+ */
+struct LinearBins {
+  static constexpr size_t kNumBins{100};
+  static constexpr double kBinWidth{20e-6};  // [s]
+
+  static size_t bin(double seconds) {
+    return static_cast<size_t>(std::min<double>(kNumBins - 1, seconds / kBinWidth));
+  }
+  static double upperEdge(size_t bin) { return (bin + 1) * kBinWidth; }
+};
+
+/**
+ * Logarithmically spaced bins, 16 per octave from 1 us to 16 s, for latencies, so that the
+ * sub-millisecond wait for the control loop and network delays of tens of milliseconds are
+ * resolved alike.
+ */
+struct LogBins {
+  static constexpr size_t kBinsPerOctave{16};
+  static constexpr size_t kNumBins{24 * kBinsPerOctave};
+  static constexpr double kMinValue{1e-6};  // [s], upper edge of the first bin
+
+  static size_t bin(double seconds) {
+    if (seconds <= kMinValue) {
+      return 0;
+    }
+    return static_cast<size_t>(
+        std::min<double>(kNumBins - 1, kBinsPerOctave * std::log2(seconds / kMinValue) + 1));
+  }
+  static double upperEdge(size_t bin) {
+    return kMinValue * std::exp2(static_cast<double>(bin) / kBinsPerOctave);
+  }
+};
+
+/**
+ * Histogram of durations [s], binned by Bins (LinearBins or LogBins), which provides kNumBins,
+ * bin() mapping a non-negative sample to its bin and upperEdge() of a bin; the last bin takes
+ * everything beyond. Samples are added by a single (realtime) thread without locks or
+ * allocation; the statistics can be read concurrently from any other thread.
+ */
+template <typename Bins>
+class Histogram {
+ public:
+  static constexpr size_t kNumBins{Bins::kNumBins};
+
+  /**
+   * Adds one sample. Must only be called from the single writer thread.
+   *
+   * @param[in] seconds duration of the sample; negative values count as zero.
+   */
+  void add(double seconds) {
+    seconds = std::max(0.0, seconds);
+    increment(bins_[Bins::bin(seconds)]);
+    increment(count_);
+    sum_.store(sum_.load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+    if (seconds > max_.load(std::memory_order_relaxed)) {
+      max_.store(seconds, std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  double max() const { return max_.load(std::memory_order_relaxed); }
+  double mean() const {
+    uint64_t n = count();
+    return n > 0 ? sum_.load(std::memory_order_relaxed) / n : 0.0;
+  }
+
+  /**
+   * @param[in] fraction requested percentile in [0, 1].
+   * @return upper edge of the bin containing the requested percentile, at most max() [s].
+   */
+  double percentile(double fraction) const {
+    uint64_t n = count();
+    if (n == 0) {
+      return 0.0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * n)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBins - 1; ++i) {
+      seen += bins_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return std::min(max(), Bins::upperEdge(i));
+      }
+    }
+    // the overflow bin has no upper edge
+    return max();
+  }
+
+  /**
+   * Copies the current bin counts.
+   */
+  void copyBins(std::vector<uint64_t>& bins) const {
+    bins.resize(kNumBins);
+    for (size_t i = 0; i < kNumBins; ++i) {
+      bins[i] = bins_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  void fill(franka_core_msgs::LatencyPercentiles& msg) const {
+    msg.samples = count();
+    msg.mean = mean();
+    msg.p50 = percentile(0.5);
+    msg.p90 = percentile(0.9);
+    msg.p99 = percentile(0.99);
+    msg.max = max();
+  }
+
+ private:
+  static void increment(std::atomic<uint64_t>& counter) {
+    // single writer: a plain load/store pair is enough and avoids a locked instruction
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint64_t>, kNumBins> bins_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<double> sum_{0.0};
+  std::atomic<double> max_{0.0};
+};
+
+template <typename Bins>
+constexpr size_t Histogram<Bins>::kNumBins;
+
+}  // namespace franka_interface
@@ -0,0 +1,85 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <ros/time.h>
+
+namespace franka_interface {
+
+/**
+ * End-of-motion check of a motion primitive (see MotionPrimitiveServer).
+ *
+ * The arm counts as arrived once it is within the position tolerance of the last waypoint, but
+ * only after the trajectory towards it was executed: its last time_from_start has passed, or the
+ * trajectory controller reported the trajectory as succeeded, whichever comes first. Before
+ * that, a path that returns to its start (or passes the last waypoint on the way) would be
+ * within the tolerance while it is still running.
+ */
+class MotionCompletion {
+ public:
+  /**
+   * @param[in] target positions of the last waypoint.
+   * @param[in] tolerance [rad] largest joint position error at the end.
+   * @param[in] trajectory_end time at which the trajectory reaches its last point.
+   */
+  MotionCompletion(const std::array<double, 7>& target, double tolerance,
+                   const ros::Time& trajectory_end)
+      : target_(target), tolerance_(tolerance), trajectory_end_(trajectory_end) {}
+
+  /**
+   * @param[in] now current time.
+   * @param[in] q current joint positions.
+   * @param[in] trajectory_succeeded the trajectory controller finished the trajectory.
+   * @return true if the motion reached its end.
+   */
+  bool reached(const ros::Time& now, const std::array<double, 7>& q, bool trajectory_succeeded) {
+    position_error_ = 0.0;
+    for (size_t j = 0; j < 7; ++j) {
+      position_error_ = std::max(position_error_, std::abs(q[j] - target_[j]));
+    }
+    const bool executed = trajectory_succeeded || now >= trajectory_end_;
+    return executed && position_error_ < tolerance_;
+  }
+
+  /**
+   * @return [rad] largest joint position error to the last waypoint in the last check.
+   */
+  double positionError() const { return position_error_; }
+
+ private:
+  std::array<double, 7> target_;
+  double tolerance_;
+  ros::Time trajectory_end_;
+  double position_error_{0.0};
+};
+
+}  // namespace franka_interface
@@ -28,14 +28,21 @@
 #ifndef _FRANKA_INTERFACE____MOTION_CONTROLLER_INTERFACE_H_
 #define _FRANKA_INTERFACE____MOTION_CONTROLLER_INTERFACE_H_
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include <ros/ros.h>
 #include <controller_manager/controller_manager.h>
 
-#include <std_msgs/Float64.h>
-#include <realtime_tools/realtime_box.h>
+#include <franka_core_msgs/ControllerManagerState.h>
 #include <franka_core_msgs/JointCommand.h>
+#include <franka_core_msgs/SwitchToController.h>
+#include <franka_interface/startup_timer.h>
 
 
 namespace franka_interface {
@@ -45,24 +52,87 @@ namespace franka_interface {
     /**
    * Initializes the controller manager.
    *
-   * @param[in] root_node_handle Node handle in the controller_manager namespace.
+   * @param[in] nh Node handle in the arm namespace (that of the controller_manager). Also
+   * advertises franka_ros_interface/motion_controller/arm/switch_to and the latched
+   * franka_ros_interface/motion_controller/arm/controller_manager_state in it.
    * @param[in] controller_manager the controller manager instance.
    */
     void init(ros::NodeHandle& nh,
          boost::shared_ptr<controller_manager::ControllerManager> controller_manager);
 
+  /**
+   * Loads the configured motion controllers that are not loaded yet, so that switching to them
+   * does not have to wait for their init(). The default and the trajectory controller are left
+   * to the spawner of the launch files, controllers without a configuration (no <name>/type
+   * parameter) are skipped. Does nothing if controllers_config/preload is false. Call after
+   * init(), before the spinner threads start.
+   *
+   * @param[in,out] timer records the loading time of every controller.
+   */
+    void preloadControllers(StartupTimer& timer);
+
+  /**
+   * Marks the end of a control cycle, i.e. of an update of the controller manager; a switch
+   * requested through switch_to returns after the next cycle that has started after the switch.
+   * Realtime safe.
+   */
+    void cycleFinished() {
+      update_cycles_.store(update_cycles_.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_release);
+    }
+
+  /**
+   * Starts the joint trajectory controller, loading it if needed, and stops the other motion
+   * controllers. Does nothing if it is running already. Thread safe.
+   *
+   * @return false if the controller could not be started.
+   */
+    bool startTrajectoryController();
+
+    const std::string& trajectoryControllerName() const { return trajectory_controller_name_; }
+
+  /**
+   * Stops the running motion controllers, calls apply and restarts the stopped controllers, also
+   * if apply failed. Mode switches requested meanwhile wait until the controllers are restarted.
+   * Thread safe.
+   *
+   * @param[in] apply called with no motion controller running; returns false and describes the
+   * failure in its argument if it failed.
+   * @param[out] error description of the failure.
+   * @return false if the controllers could not be stopped or restarted, or if apply failed.
+   */
+    bool pauseMotionControllersAndDo(const std::function<bool(std::string&)>& apply,
+                                     std::string& error);
+
   private:
+    // start and stop lists for switching between two of all_controllers_, built once in init()
+    struct SwitchPlan {
+      std::vector<std::string> start_controllers;
+      std::vector<std::string> stop_controllers;
+    };
+
     // mutex for re-entrant calls to modeCommandCallback
     std::mutex mtx_;
-    int current_mode_;
-
-    realtime_tools::RealtimeBox< std::shared_ptr<const ros::Duration > > box_timeout_length_;
-    realtime_tools::RealtimeBox< std::shared_ptr<const ros::Time > > box_cmd_timeout_;
+    // written under mtx_, read without it to skip commands that do not need a switch
+    std::atomic<int> current_mode_{-1};
 
-    ros::Timer cmd_timeout_timer_;
+    static constexpr double kDefaultSwitchTimeout{1.0};  // [s]
 
-    ros::Subscriber joint_command_timeout_sub_;
+    // the controller manager looks up the configuration of the controllers in this namespace
+    ros::NodeHandle nh_;
     ros::Subscriber joint_command_sub_;
+    ros::ServiceServer switch_to_service_;
+    ros::Publisher controller_state_pub_;
+    // catches changes made through the controller manager services
+    ros::Timer controller_state_timer_;
+    // guards the members below, which are used by publishControllerState() only
+    std::mutex state_mtx_;
+    std::vector<std::string> controller_names_;
+    std::map<std::string, std::string> controller_types_;
+    franka_core_msgs::ControllerManagerState controller_state_msg_;
+    // written by the control loop only
+    std::atomic<uint64_t> update_cycles_{0};
+    bool preload_{true};
     boost::shared_ptr<controller_manager::ControllerManager> controller_manager_;
 
     std::string position_controller_name_;
@@ -80,16 +150,15 @@ namespace franka_interface {
     std::vector<std::string> all_controllers_;
 
     std::map<std::string,int> controller_name_to_mode_map_;
-  protected:
-  /**
-   * Callback function to set time out to switch back to position mode. When using torque
-   * mode controllers, consecutive torque commands should be sent in smaller intervals than
-   * this timeout value
-   *
-   * @param[in] msg Float64 instance containing the desired timeout.
-   */
-    void jointCommandTimeoutCallback(const std_msgs::Float64 msg);
 
+    // switch_plans_[from][to], indexed like all_controllers_
+    std::vector<std::vector<SwitchPlan> > switch_plans_;
+    std::map<int, size_t> mode_to_controller_index_;
+    size_t default_controller_index_{0};
+    size_t trajectory_controller_index_{0};
+    size_t current_controller_index_{0};
+    std::vector<std::string> running_controllers_;
+  protected:
   /**
    * Callback function to choose the appropriate controller. This function checks the type
    * of controller requested by the client through the type field in the message, and 
@@ -111,13 +180,33 @@ namespace franka_interface {
    */
     bool switchToDefaultController();
 
-   /**
-   * Check if the command timeout has been violated.
+  /**
+   * Switch from the current controller to the one at the given index of all_controllers_,
+   * using the precomputed plan when the current controller is the only one running, and
+   * stopping whichever of all_controllers_ are running otherwise. Logs the time taken.
    *
-   * @param[in] control_mode integer value representing the type of controller to use
+   * @param[in] controller_index index of the controller to start in all_controllers_
+   */
+    bool switchToController(size_t controller_index);
+
+    bool isRunning(const std::string& controller_name) const;
+
+  /**
+   * Publishes the loaded controllers and their states on controller_manager_state if they
+   * changed since they were last published, or if force is set. Thread safe.
    */
-    void commandTimeoutCheck(const ros::TimerEvent& e);
+    void publishControllerState(bool force);
+
+    void controllerStateTimerCallback(const ros::TimerEvent& /*event*/) {
+      publishControllerState(false);
+    }
 
+  /**
+   * Service callback of switch_to: switches to the requested controller and waits until the
+   * control loop has updated it.
+   */
+    bool switchToCallback(franka_core_msgs::SwitchToController::Request& request,
+                          franka_core_msgs::SwitchToController::Response& response);
 
   };
 }
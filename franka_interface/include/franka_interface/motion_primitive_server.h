@@ -0,0 +1,135 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <actionlib/client/simple_action_client.h>
+#include <actionlib/server/simple_action_server.h>
+#include <control_msgs/FollowJointTrajectoryAction.h>
+#include <franka_core_msgs/JointMotionAction.h>
+#include <franka_core_msgs/TimeParameterizePath.h>
+#include <ros/ros.h>
+
+#include <franka_interface/motion_completion.h>
+#include <franka_interface/motion_controller_interface.h>
+#include <franka_interface/multi_arm_state.h>
+#include <franka_interface/trajectory_timing.h>
+
+namespace franka_interface {
+
+/**
+ * Runs joint space motion primitives (move to positions, along a path, to or from a touch) as a
+ * single franka_core_msgs::JointMotionAction goal, on
+ * franka_ros_interface/motion_primitives/joint_motion.
+ *
+ * A goal switches to the joint trajectory controller through the MotionControllerInterface,
+ * sends it the waypoints and then checks the latest robot state of the arm (MultiArmState, the
+ * state CustomFrankaStateController publishes) at the rate of the control loop, for
+ * convergence (see MotionCompletion), contacts, reflexes and the timeout. The goal finishes in the first check that
+ * meets its stop condition; on a collision or preemption the trajectory is cancelled, which
+ * makes the trajectory controller hold the current position.
+ *
+ * Untimed waypoints are turned into the minimum-time trajectory within the joint velocity and
+ * acceleration limits (JointTrajectoryTiming), which is also offered without executing it by
+ * the franka_ros_interface/motion_primitives/time_parameterize_path service.
+ */
+class MotionPrimitiveServer {
+ public:
+  // recovers the robot from a reflex, returns false and a description on failure
+  using ErrorRecovery = std::function<bool(std::string& error)>;
+
+  /**
+   * Reads the joint limits and starts the action server.
+   *
+   * @param[in] nh Node handle in the arm namespace.
+   * @param[in] motion_controller_interface switches to the trajectory controller; must outlive
+   * the server.
+   * @param[in] multi_arm_state states of the arms of the control node.
+   * @param[in] arm_index index of the arm in multi_arm_state.
+   * @param[in] error_recovery used for goals with recover_from_reflex.
+   * @return false if the configuration is invalid.
+   */
+  bool init(ros::NodeHandle& nh, MotionControllerInterface& motion_controller_interface,
+            std::shared_ptr<const MultiArmState> multi_arm_state, size_t arm_index,
+            ErrorRecovery error_recovery);
+
+ private:
+  using Goal = franka_core_msgs::JointMotionGoal;
+  using Result = franka_core_msgs::JointMotionResult;
+  using TrajectoryClient = actionlib::SimpleActionClient<control_msgs::FollowJointTrajectoryAction>;
+
+  static constexpr double kDefaultPositionTolerance{0.00085};  // [rad]
+  static constexpr double kDefaultTimeout{10.0};               // [s]
+  static constexpr double kSettleTime{0.5};  // [s] after the end of the trajectory
+  void execute(const franka_core_msgs::JointMotionGoalConstPtr& goal);
+  bool timeParameterizePath(franka_core_msgs::TimeParameterizePath::Request& request,
+                            franka_core_msgs::TimeParameterizePath::Response& response);
+
+  /**
+   * Computes the minimum-time trajectory along path, which starts at its first point.
+   *
+   * @return false if the path or speed_ratio are invalid, with the reason in error.
+   */
+  bool timePath(const std::vector<std::array<double, 7>>& path, double speed_ratio,
+                double sample_period, trajectory_msgs::JointTrajectory& trajectory,
+                std::string& error) const;
+
+  /**
+   * Builds the trajectory from the waypoints of the goal, timing it if needed.
+   *
+   * @return false if the goal is invalid, with the reason in error.
+   */
+  bool makeTrajectory(const Goal& goal, const std::array<double, 7>& start,
+                      control_msgs::FollowJointTrajectoryGoal& trajectory,
+                      std::string& error) const;
+
+  void finish(int32_t error_code, const std::string& error_string, const SharedRobotState& state,
+              const ros::Time& start);
+
+  std::unique_ptr<actionlib::SimpleActionServer<franka_core_msgs::JointMotionAction>> server_;
+  std::unique_ptr<TrajectoryClient> trajectory_client_;
+  ros::ServiceServer time_parameterize_service_;
+  MotionControllerInterface* motion_controller_interface_{nullptr};
+  std::shared_ptr<const MultiArmState> multi_arm_state_;
+  size_t arm_index_{0};
+  ErrorRecovery error_recovery_;
+
+  std::vector<std::string> joint_names_;
+  std::array<double, 7> velocity_limits_{};
+  std::array<double, 7> acceleration_limits_{};
+  int grid_points_per_segment_{100};
+  double sample_period_{0.01};    // [s] between the points of timed trajectories
+  double check_rate_{1000.0};     // [Hz]
+  double feedback_rate_{20.0};    // [Hz]
+};
+
+}  // namespace franka_interface
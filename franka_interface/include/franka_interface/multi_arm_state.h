@@ -0,0 +1,181 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <franka_interface/shared_memory_transport.h>
+#include <hardware_interface/internal/hardware_resource_manager.h>
+
+namespace franka_interface {
+
+/**
+ * Latest robot states of all arms driven by one control node, for controllers that coordinate
+ * several arms.
+ *
+ * Every arm runs its own control loop, paced by its own robot, so the arms are not updated in
+ * lockstep. Each loop writes the state of every cycle, stamped with the ROS time of the cycle,
+ * into a short per-arm history; alignedSnapshot() picks one state per arm such that all of them
+ * were measured no later than the most recent cycle of the slowest arm, which keeps the states
+ * within one control period of each other.
+ *
+ * write() is realtime safe and must only be called by the loop of the arm; the readers are
+ * lock-free and may run in any thread, including the control loops of the other arms.
+ */
+class MultiArmState {
+ public:
+  static constexpr size_t kMaxArms{4};
+  static constexpr size_t kHistory{8};  // cycles kept per arm
+
+  using Snapshot = std::array<SharedRobotState, kMaxArms>;
+
+  /**
+   * @param[in] arm_ids arm_id of every arm, at most kMaxArms.
+   */
+  explicit MultiArmState(std::vector<std::string> arm_ids) : arm_ids_(std::move(arm_ids)) {
+    if (arm_ids_.size() > kMaxArms) {
+      arm_ids_.resize(kMaxArms);
+    }
+  }
+
+  size_t size() const { return arm_ids_.size(); }
+  const std::string& armId(size_t arm) const { return arm_ids_.at(arm); }
+
+  /**
+   * @return index of the arm with the given arm_id, size() if there is none.
+   */
+  size_t index(const std::string& arm_id) const {
+    return std::find(arm_ids_.cbegin(), arm_ids_.cend(), arm_id) - arm_ids_.cbegin();
+  }
+
+  /**
+   * Adds the state of the current cycle of an arm. Realtime safe; single writer per arm.
+   */
+  void write(size_t arm, const SharedRobotState& state) {
+    ArmHistory& history = arms_[arm];
+    uint64_t next = history.written.load(std::memory_order_relaxed);
+    history.slots[next % kHistory].write(state);
+    history.written.store(next + 1, std::memory_order_release);
+  }
+
+  /**
+   * @param[out] state most recent state of the arm.
+   * @return false if the arm has not been written yet or the read raced with the writer.
+   */
+  bool latest(size_t arm, SharedRobotState& state) const {
+    const ArmHistory& history = arms_[arm];
+    uint64_t written = history.written.load(std::memory_order_acquire);
+    return written > 0 && history.slots[(written - 1) % kHistory].read(state);
+  }
+
+  /**
+   * Reads one state per arm, all measured at or before the time of the latest cycle of the arm
+   * that was updated last, and as close to it as the history allows.
+   *
+   * @param[out] snapshot the first size() entries are filled, in arm order.
+   * @param[out] time the common time the states are aligned to [s].
+   * @return false if an arm has not been written yet or a read failed.
+   */
+  bool alignedSnapshot(Snapshot& snapshot, double& time) const {
+    time = std::numeric_limits<double>::infinity();
+    for (size_t arm = 0; arm < size(); ++arm) {
+      if (!latest(arm, snapshot[arm])) {
+        return false;
+      }
+      time = std::min(time, snapshot[arm].time);
+    }
+    for (size_t arm = 0; arm < size(); ++arm) {
+      if (snapshot[arm].time > time && !stateAt(arm, time, snapshot[arm])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  struct ArmHistory {
+    std::atomic<uint64_t> written{0};
+    std::array<SeqLocked<SharedRobotState>, kHistory> slots;
+  };
+
+  // newest state of the arm measured at or before time
+  bool stateAt(size_t arm, double time, SharedRobotState& state) const {
+    const ArmHistory& history = arms_[arm];
+    const uint64_t written = history.written.load(std::memory_order_acquire);
+    // the oldest slot may be overwritten while it is read, so it is left out
+    const uint64_t available = std::min<uint64_t>(written, kHistory - 1);
+    for (uint64_t age = 0; age < available; ++age) {
+      if (history.slots[(written - 1 - age) % kHistory].read(state) && state.time <= time) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<std::string> arm_ids_;
+  std::array<ArmHistory, kMaxArms> arms_;
+};
+
+/**
+ * Handle to the MultiArmState of the control node.
+ */
+class MultiArmStateHandle {
+ public:
+  MultiArmStateHandle() = delete;
+
+  /**
+   * @param[in] name name of the handle.
+   * @param[in] state states of all arms of the control node.
+   */
+  MultiArmStateHandle(const std::string& name, std::shared_ptr<MultiArmState> state)
+      : name_(name), state_(std::move(state)) {}
+
+  std::string getName() const { return name_; }
+  MultiArmState& getState() const { return *state_; }
+
+ private:
+  std::string name_;
+  std::shared_ptr<MultiArmState> state_;
+};
+
+/**
+ * Hardware interface giving controllers read access to the states of all arms of the control
+ * node. Registered with the hardware of every arm, with a single handle named
+ * "multi_arm_state".
+ */
+class MultiArmStateInterface
+    : public hardware_interface::HardwareResourceManager<MultiArmStateHandle> {};
+
+}  // namespace franka_interface
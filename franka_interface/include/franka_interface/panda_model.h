@@ -0,0 +1,146 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <franka/robot_state.h>
+#include <franka/model.h>
+
+#include <franka_interface/franka_model_cache_interface.h>
+
+namespace franka_interface {
+
+/**
+ * Rigid-body model of the Panda arm, for simulating it without libfranka's model library.
+ *
+ * The kinematics use the (modified) Denavit-Hartenberg parameters of the Franka Control
+ * Interface documentation, the dynamics the link inertial parameters identified by Gaz et al.,
+ * "Dynamic Identification of the Franka Emika Panda Robot With Retrieval of Feasible
+ * Parameters Using Penalty-Based Optimization" (RA-L, 2019). The load at the flange (hand and
+ * payload) is lumped into link 7. Like libfranka, no friction or motor inertia is modelled.
+ */
+class PandaModel {
+ public:
+  using Vector7d = Eigen::Matrix<double, 7, 1>;
+  using Matrix7d = Eigen::Matrix<double, 7, 7>;
+
+  /**
+   * Creates the model of the arm carrying the Franka Hand.
+   */
+  PandaModel();
+
+  /**
+   * Sets the load at the flange, replacing the hand.
+   *
+   * @param[in] mass [kg].
+   * @param[in] F_x_Cload center of mass in the flange frame [m].
+   * @param[in] load_inertia inertia tensor about the center of mass (column-major) [kg m^2].
+   */
+  void setLoad(double mass, const std::array<double, 3>& F_x_Cload,
+               const std::array<double, 9>& load_inertia);
+
+  /**
+   * @return the pose of the frame in the base frame (column-major), as franka::Model::pose.
+   */
+  std::array<double, 16> pose(franka::Frame frame, const Vector7d& q,
+                              const std::array<double, 16>& F_T_EE,
+                              const std::array<double, 16>& EE_T_K) const;
+
+  /**
+   * @return the 6x7 zero Jacobian of the frame (column-major), as franka::Model::zeroJacobian.
+   */
+  std::array<double, 42> zeroJacobian(franka::Frame frame, const Vector7d& q,
+                                      const std::array<double, 16>& F_T_EE,
+                                      const std::array<double, 16>& EE_T_K) const;
+
+  /**
+   * @return the joint torques compensating gravity.
+   */
+  Vector7d gravity(const Vector7d& q) const;
+
+  /**
+   * @return the Coriolis and centrifugal torques C(q, dq) dq.
+   */
+  Vector7d coriolis(const Vector7d& q, const Vector7d& dq) const;
+
+  /**
+   * @return the joint space mass matrix.
+   */
+  Matrix7d mass(const Vector7d& q) const;
+
+  /**
+   * Recursive Newton-Euler inverse dynamics: M(q) ddq + C(q, dq) dq (+ g(q)).
+   */
+  Vector7d inverseDynamics(const Vector7d& q, const Vector7d& dq, const Vector7d& ddq,
+                           bool with_gravity) const;
+
+ private:
+  struct Link {
+    double a;      // [m] modified DH parameters of the joint preceding the link
+    double d;      // [m]
+    double alpha;  // [rad]
+    double mass;
+    Eigen::Vector3d com;      // in the link frame
+    Eigen::Matrix3d inertia;  // about the center of mass, in the link frame
+  };
+
+  // T_0_i[i] is the pose of the frame of link i + 1 in the base frame
+  void linkPoses(const Vector7d& q, std::array<Eigen::Isometry3d, 7>& T_0_i) const;
+  Eigen::Isometry3d framePose(franka::Frame frame, const std::array<Eigen::Isometry3d, 7>& T_0_i,
+                              const std::array<double, 16>& F_T_EE,
+                              const std::array<double, 16>& EE_T_K) const;
+
+  std::array<Link, 7> arm_;    // without load
+  std::array<Link, 7> links_;  // load lumped into link 7
+};
+
+/**
+ * FrankaModelSource evaluating a PandaModel at a robot state, for simulated hardware.
+ */
+class PandaModelSource : public FrankaModelSource {
+ public:
+  /**
+   * @param[in] model model to evaluate; must outlive the source.
+   * @param[in] robot_state state to evaluate the model at; must outlive the source.
+   */
+  PandaModelSource(const PandaModel& model, const franka::RobotState& robot_state)
+      : model_(model), robot_state_(robot_state) {}
+
+  std::array<double, 7> getCoriolis() const override;
+  std::array<double, 7> getGravity() const override;
+  std::array<double, 49> getMass() const override;
+  std::array<double, 42> getZeroJacobian(const franka::Frame& frame) const override;
+
+ private:
+  const PandaModel& model_;
+  const franka::RobotState& robot_state_;
+};
+
+}  // namespace franka_interface
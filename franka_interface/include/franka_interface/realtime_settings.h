@@ -0,0 +1,99 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <ros/node_handle.h>
+
+namespace franka_interface {
+
+/**
+ * Scheduling and memory settings of the control node (control_node_config/realtime).
+ */
+struct RealtimeSettings {
+  // SCHED_FIFO priority (1-99) of the control loops. 0 leaves the priority to libfranka, which
+  // raises the control loop to the highest SCHED_FIFO priority when a motion starts.
+  int control_priority{0};
+  std::vector<int> control_cpus;  // cores the control loops may run on, empty: any
+  std::vector<int> spinner_cpus;  // cores of the background callback threads, empty: any
+  // SCHED_FIFO priority (1-99) of the thread delivering the joint commands of an arm to its
+  // controllers, 0: not realtime
+  int command_priority{0};
+  std::vector<int> command_cpus;  // cores of the command thread, empty: those of the node
+  // threads serving services, actions, dynamic_reconfigure and parameter topics, 0: 4 per arm
+  size_t background_threads{0};
+  bool lock_memory{true};         // mlockall() at startup
+  size_t prefault_stack{512 * 1024};  // [bytes] of the control thread stack touched at startup
+  size_t prefault_heap{0};  // [bytes] of heap touched at startup and kept by malloc afterwards
+
+  /**
+   * Reads the settings from control_node_config/realtime; missing entries keep their defaults.
+   *
+   * @param[in] node_handle node handle in the arm namespace.
+   * @param[out] error description of an invalid entry.
+   * @return false if an entry is invalid.
+   */
+  bool read(const ros::NodeHandle& node_handle, std::string& error);
+};
+
+/**
+ * Pre-faults prefault_heap bytes of heap, which malloc is told to keep instead of returning
+ * them to the system, and then locks the pages of the process in memory, the pre-faulted heap
+ * included. Call once at startup, before the control loops start. Memory allocated later is only
+ * locked as well if RLIMIT_MEMLOCK is unlimited; with a finite limit the process could otherwise
+ * run out of memory, and realtime allocations should be served from the pre-faulted heap.
+ *
+ * @param[in] settings realtime settings.
+ * @param[out] report description of what was applied, or of the failure.
+ * @return false if the memory could not be locked.
+ */
+bool lockProcessMemory(const RealtimeSettings& settings, std::string& report);
+
+/**
+ * Restricts the calling thread to cpus (unless empty) and, if priority is positive, switches it
+ * to SCHED_FIFO with that priority.
+ *
+ * @param[out] error description of the failure.
+ * @return false if a setting could not be applied.
+ */
+bool configureCurrentThread(int priority, const std::vector<int>& cpus, std::string& error);
+
+/**
+ * Touches bytes of the stack of the calling thread, so that the control loop does not page
+ * fault when it first reaches that depth.
+ */
+void prefaultStack(size_t bytes);
+
+/**
+ * @return scheduling policy, priority and allowed cores of the calling thread, as applied.
+ */
+std::string describeCurrentThread();
+
+}  // namespace franka_interface
@@ -29,20 +29,28 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <controller_interface/multi_interface_controller.h>
 #include <franka_hw/franka_state_interface.h>
 #include <franka_hw/franka_model_interface.h>
 #include <franka_hw/trigger_rate.h>
+#include <franka_interface/franka_model_cache_interface.h>
+#include <franka_interface/shared_memory_transport.h>
+#include <franka_interface/spsc_ring_buffer.h>
+#include <franka_interface/state_recording.h>
+#include <franka_core_msgs/RecordState.h>
+#include <franka_core_msgs/RobotErrors.h>
 #include <franka_core_msgs/RobotState.h>
 #include <franka_core_msgs/EndPointState.h>
 #include <geometry_msgs/WrenchStamped.h>
 #include <realtime_tools/realtime_publisher.h>
 #include <sensor_msgs/JointState.h>
-#include <tf2_msgs/TFMessage.h>
 #include <controller_manager/controller_manager.h>
 #include <Eigen/Dense>
 
@@ -53,12 +61,14 @@ namespace franka_interface {
  */
 class CustomFrankaStateController
     : public controller_interface::MultiInterfaceController<franka_hw::FrankaStateInterface,
-                                                            franka_hw::FrankaModelInterface> {
+                                                            franka_hw::FrankaModelInterface,
+                                                            FrankaModelCacheInterface> {
  public:
   /**
-   * Creates an instance of a CustomFrankaStateController.
+   * Creates an instance of a CustomFrankaStateController. The FrankaModelCacheInterface is
+   * optional, so all interfaces are checked in init().
    */
-  CustomFrankaStateController() = default;
+  CustomFrankaStateController() : MultiInterfaceController(true) {}
 
   /**
    * Initializes the controller with interfaces and publishers.
@@ -73,6 +83,13 @@ class CustomFrankaStateController
 
   /**
    * Reads the current robot state from the franka_hw::FrankaStateInterface and publishes it.
+   * Every topic is published at its own rate (publish_rates/<topic>, defaulting to
+   * publish_rate); the groups of robot_state fields that are not listed in robot_state_fields
+   * are neither computed nor sent. The errors are published on errors whenever they change.
+   * F_T_EE and EE_T_K are checked at the tf rate and published
+   * on /tf_static when they change. If /robot_config/shared_memory/enabled is set, a snapshot of
+   * the state is also written to shared memory on every call, and while a recording is started
+   * with the record_state service, the state of every call is recorded to file.
    *
    * @param[in] time Current ROS time.
    * @param[in] period Time since the last update.
@@ -82,24 +99,72 @@ class CustomFrankaStateController
  private:
   void publishFrankaState(const ros::Time& time);
   void publishJointStates(const ros::Time& time);
-  void publishTransforms(const ros::Time& time);
+  void checkStaticTransforms(const ros::Time& time);
+  void publishStaticTransforms(const ros::WallTimerEvent& event);
   void publishEndPointState(const ros::Time& time);
+  void publishErrors(const ros::Time& time);
+  void writeSharedState(const ros::Time& time);
+  void recordState(const ros::Time& time);
+  bool recordStateCallback(franka_core_msgs::RecordState::Request& request,
+                           franka_core_msgs::RecordState::Response& response);
+
+  // groups of franka_core_msgs::RobotState fields that can be left out
+  enum RobotStateField : uint32_t {
+    kDynamics = 1u << 0,    // gravity, coriolis
+    kMassMatrix = 1u << 1,  // mass_matrix
+    kJacobian = 1u << 2,    // O_Jac_EE
+    kEEVelocity = 1u << 3,  // O_dP_EE
+    kErrors = 1u << 4,      // current_errors, last_motion_errors
+  };
 
   std::string arm_id_;
 
   franka_hw::FrankaStateInterface* franka_state_interface_{};
   std::unique_ptr<franka_hw::FrankaStateHandle> franka_state_handle_{};
-  std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
+  std::unique_ptr<franka_interface::FrankaModelCacheHandle> model_handle_;
 
-  realtime_tools::RealtimePublisher<tf2_msgs::TFMessage> publisher_transforms_;
   realtime_tools::RealtimePublisher<franka_core_msgs::RobotState> publisher_franka_state_;
   realtime_tools::RealtimePublisher<sensor_msgs::JointState> publisher_joint_states_;
   realtime_tools::RealtimePublisher<sensor_msgs::JointState> publisher_joint_states_desired_;
   realtime_tools::RealtimePublisher<franka_core_msgs::EndPointState> publisher_tip_state_;
-  franka_hw::TriggerRate trigger_publish_;
+  realtime_tools::RealtimePublisher<franka_core_msgs::RobotErrors> publisher_errors_;
+  franka_hw::TriggerRate trigger_franka_state_;
+  franka_hw::TriggerRate trigger_joint_states_;
+  franka_hw::TriggerRate trigger_transforms_;
+  franka_hw::TriggerRate trigger_tip_state_;
+  uint32_t robot_state_fields_{0};
   franka::RobotState robot_state_;
+  // of robot_state_, see franka_core_msgs/RobotErrors
+  uint64_t current_errors_mask_{0};
+  uint64_t last_motion_errors_mask_{0};
+  bool errors_published_{false};
   uint64_t sequence_number_ = 0;
+  SharedMemoryTransport shared_memory_;
+  SharedRobotState shared_state_;
+  StateRecorder recorder_;
+  StateRecord record_;
+  std::string recording_directory_;
+  std::mutex recording_mutex_;  // serialises record_state requests
+  ros::ServiceServer record_state_service_;
   std::vector<std::string> joint_names_;
+
+  // frame names, built once in init() so that the publishers do not allocate
+  std::string link0_frame_;
+  std::string link8_frame_;
+  std::string ee_frame_;
+  std::string k_frame_;
+
+  // F_T_EE and EE_T_K, handed from update() to the (non-realtime) /tf_static timer when they
+  // change, e.g. through set_EE_frame or set_K_frame
+  struct StaticFrames {
+    ros::Time stamp;
+    std::array<double, 16> F_T_EE{};
+    std::array<double, 16> EE_T_K{};
+  };
+  SpscRingBuffer<StaticFrames, 4> static_frames_;
+  StaticFrames sent_static_frames_;  // control loop only
+  bool static_frames_sent_{false};   // control loop only
+  ros::WallTimer static_frames_timer_;
 };
 
 }  // namespace franka_interface
@@ -0,0 +1,277 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <franka/robot_state.h>
+
+namespace franka_interface {
+
+/**
+ * Robot state snapshot written to shared memory by CustomFrankaStateController every tick.
+ * Field meanings are those of franka::RobotState.
+ */
+struct SharedRobotState {
+  uint64_t sequence{0};  // control tick counter
+  double time{0.0};      // [s], ROS time of the tick
+  std::array<double, 7> q{};
+  std::array<double, 7> dq{};
+  std::array<double, 7> tau_J{};
+  std::array<double, 7> q_d{};
+  std::array<double, 7> dq_d{};
+  std::array<double, 7> tau_J_d{};
+  std::array<double, 7> tau_ext_hat_filtered{};
+  std::array<double, 16> O_T_EE{};  // column-major
+  std::array<double, 6> O_F_ext_hat_K{};
+  // zero Jacobian of the end effector and mass matrix (column-major), from franka::Model; zero
+  // unless the state controller is configured to compute them (robot_state_fields)
+  std::array<double, 42> O_Jac_EE{};
+  std::array<double, 49> mass_matrix{};
+  uint32_t robot_mode{0};  // franka_core_msgs::RobotState::ROBOT_MODE_*
+  // contact and collision flags, one bit per joint or Cartesian axis (see the masks below)
+  uint32_t contact_flags{0};
+
+  static constexpr uint32_t kJointContact{0x7fu};               // bits 0-6
+  static constexpr uint32_t kCartesianContact{0x3fu << 8};      // bits 8-13
+  static constexpr uint32_t kJointCollision{0x7fu << 16};       // bits 16-22
+  static constexpr uint32_t kCartesianCollision{0x3fu << 24};   // bits 24-29
+  static constexpr uint32_t kContact{kJointContact | kCartesianContact};
+  static constexpr uint32_t kCollision{kJointCollision | kCartesianCollision};
+};
+
+template <size_t N>
+inline uint32_t packFlags(const std::array<double, N>& flags, unsigned shift) {
+  uint32_t bits = 0;
+  for (size_t i = 0; i < N; ++i) {
+    if (flags[i] != 0.0) {
+      bits |= 1u << (shift + i);
+    }
+  }
+  return bits;
+}
+
+/**
+ * Copies the fields of SharedRobotState from a franka::RobotState, except for the model
+ * quantities.
+ */
+inline void toSharedRobotState(const franka::RobotState& robot_state,
+                               double time,
+                               SharedRobotState& state) {
+  state.sequence++;
+  state.time = time;
+  state.q = robot_state.q;
+  state.dq = robot_state.dq;
+  state.tau_J = robot_state.tau_J;
+  state.q_d = robot_state.q_d;
+  state.dq_d = robot_state.dq_d;
+  state.tau_J_d = robot_state.tau_J_d;
+  state.tau_ext_hat_filtered = robot_state.tau_ext_hat_filtered;
+  state.O_T_EE = robot_state.O_T_EE;
+  state.O_F_ext_hat_K = robot_state.O_F_ext_hat_K;
+  state.robot_mode = static_cast<uint32_t>(robot_state.robot_mode);
+  state.contact_flags = packFlags(robot_state.joint_contact, 0) |
+                        packFlags(robot_state.cartesian_contact, 8) |
+                        packFlags(robot_state.joint_collision, 16) |
+                        packFlags(robot_state.cartesian_collision, 24);
+}
+
+/**
+ * Joint command written to shared memory by a local client. It is applied by the running joint
+ * controller whose mode (franka_core_msgs::JointCommand::*_MODE) matches, like a JointCommand
+ * message on motion_controller/arm/joint_commands.
+ */
+struct SharedJointCommand {
+  uint64_t sequence{0};  // must change for every new command
+  double time{0.0};      // [s], informational
+  int32_t mode{0};
+  uint32_t reserved{0};
+  std::array<double, 7> position{};
+  std::array<double, 7> velocity{};
+  std::array<double, 7> effort{};
+};
+
+/**
+ * Single-writer sequence lock around a trivially copyable value. The counter is odd while a
+ * write is in progress; readers retry (a bounded number of times) when it is odd or changes
+ * while they copy. Neither side blocks, so both may be used in the control loop.
+ */
+template <typename T>
+struct alignas(64) SeqLocked {
+  std::atomic<uint64_t> counter{0};
+  T value;
+
+  void write(const T& new_value) {
+    uint64_t start = counter.load(std::memory_order_relaxed);
+    counter.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&value, &new_value, sizeof(T));
+    counter.store(start + 2, std::memory_order_release);
+  }
+
+  bool read(T& result, int max_attempts = 4) const {
+    for (int attempt = 0; attempt < max_attempts; ++attempt) {
+      uint64_t start = counter.load(std::memory_order_acquire);
+      if (start & 1u) {
+        continue;
+      }
+      std::memcpy(&result, &value, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (counter.load(std::memory_order_relaxed) == start) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/**
+ * Memory layout of the shared memory segment. The Python client
+ * (franka_interface.SharedMemoryClient) relies on these exact offsets, so bump kVersion whenever
+ * it changes.
+ */
+struct SharedMemoryLayout {
+  static constexpr uint32_t kMagic{0x464b5348};
+  static constexpr uint32_t kVersion{2};
+
+  uint32_t magic;
+  uint32_t version;
+  SeqLocked<SharedRobotState> state;
+  SeqLocked<SharedJointCommand> command;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "SharedMemoryTransport needs lock-free 64 bit atomics");
+static_assert(offsetof(SharedMemoryLayout, state) == 64 &&
+                  offsetof(SharedMemoryLayout, command) == 1408 &&
+                  sizeof(SharedRobotState) == 1320 && sizeof(SharedJointCommand) == 192 &&
+                  sizeof(SharedMemoryLayout) == 1664,
+              "Shared memory layout changed, update kVersion and the Python client");
+
+/**
+ * Exchanges the robot state and joint commands with processes on the same machine through a
+ * POSIX shared memory segment, bypassing ROS serialisation.
+ *
+ * Every participant simply opens the segment by name; the first one creates it. The robot state
+ * has a single writer (CustomFrankaStateController) and the command slot must have a single
+ * writer (one client) at a time. All accessors are lock-free and allocation-free.
+ */
+class SharedMemoryTransport {
+ public:
+  SharedMemoryTransport() = default;
+  SharedMemoryTransport(const SharedMemoryTransport&) = delete;
+  SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;
+  ~SharedMemoryTransport() { close(); }
+
+  /**
+   * Maps the segment, creating it if it does not exist yet. Not realtime safe.
+   *
+   * @param[in] name shared memory object name, e.g. "/franka_ros_interface_panda".
+   * @param[out] error description of the failure.
+   * @return false if the segment could not be mapped or has an incompatible layout.
+   */
+  bool open(const std::string& name, std::string& error) {
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0660);
+    if (fd < 0) {
+      error = "shm_open(" + name + ") failed: " + std::strerror(errno);
+      return false;
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 ||
+        (static_cast<size_t>(info.st_size) < sizeof(SharedMemoryLayout) &&
+         ftruncate(fd, sizeof(SharedMemoryLayout)) != 0)) {
+      error = "could not size shared memory object " + name + ": " + std::strerror(errno);
+      ::close(fd);
+      return false;
+    }
+    void* memory =
+        mmap(nullptr, sizeof(SharedMemoryLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+      error = "mmap of " + name + " failed: " + std::strerror(errno);
+      return false;
+    }
+    layout_ = static_cast<SharedMemoryLayout*>(memory);
+    // a fresh segment is zero-filled, which is a valid empty state and command
+    if (layout_->magic == 0) {
+      layout_->version = SharedMemoryLayout::kVersion;
+      layout_->magic = SharedMemoryLayout::kMagic;
+    }
+    if (layout_->magic != SharedMemoryLayout::kMagic ||
+        layout_->version != SharedMemoryLayout::kVersion) {
+      error = "shared memory object " + name + " has an incompatible layout";
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (layout_ != nullptr) {
+      munmap(layout_, sizeof(SharedMemoryLayout));
+      layout_ = nullptr;
+    }
+  }
+
+  bool isOpen() const { return layout_ != nullptr; }
+
+  /**
+   * Publishes a new robot state snapshot. Only CustomFrankaStateController may call this.
+   */
+  void writeState(const SharedRobotState& state) { layout_->state.write(state); }
+
+  /**
+   * @return false if no consistent snapshot could be read (retry on the next cycle).
+   */
+  bool readState(SharedRobotState& state) const { return layout_->state.read(state); }
+
+  /**
+   * Publishes a new joint command. Only one client may write commands at a time.
+   */
+  void writeCommand(const SharedJointCommand& command) { layout_->command.write(command); }
+
+  /**
+   * @return false if no consistent command could be read (retry on the next cycle).
+   */
+  bool readCommand(SharedJointCommand& command) const { return layout_->command.read(command); }
+
+ private:
+  SharedMemoryLayout* layout_{nullptr};
+};
+
+}  // namespace franka_interface
@@ -0,0 +1,232 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <franka/robot_state.h>
+#include <franka_hw/franka_state_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
+#include <franka_interface/panda_model.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <ros/time.h>
+
+namespace franka_interface {
+
+/**
+ * RobotHW simulating a Panda arm with a PandaModel, in place of franka_hw::FrankaHW and a
+ * franka::Robot.
+ *
+ * Exposes the JointStateInterface, PositionJointInterface, VelocityJointInterface,
+ * EffortJointInterface and franka_hw::FrankaStateInterface handles of franka_hw::FrankaHW,
+ * and a FrankaModelCacheInterface (<arm_id>_model) evaluating the PandaModel.
+ * franka_hw::FrankaModelInterface is not available, since its handles need a franka::Model,
+ * which only a connected franka::Robot can create; all controllers of franka_ros_interface
+ * use the FrankaModelCacheInterface instead.
+ *
+ * The command mode follows the interfaces claimed by the running controllers:
+ *  - effort: the torques are applied on top of gravity compensation, like libfranka's torque
+ *    control, and the joint accelerations follow from the rigid-body dynamics, integrated with
+ *    semi-implicit Euler steps,
+ *  - position and velocity: the joints follow the command exactly,
+ *  - no command interface claimed: the arm holds its position, like the robot with its brakes
+ *    released but no motion running.
+ * Joints stop at their position limits. Nothing depends on the wall clock, so the simulation
+ * runs as fast as the caller steps it and is deterministic.
+ *
+ * read(), write() and doSwitch() are called from the control loop. The setters (reset(),
+ * setExternalWrench(), setEEFrame(), setKFrame(), setLoad(), setFrames()) may be called from any
+ * thread; they take effect at the following read().
+ */
+class SimulatedFrankaHW : public hardware_interface::RobotHW {
+ public:
+  struct Parameters {
+    size_t substeps{2};  // integration steps per control cycle (effort mode)
+    // reflected rotor inertia added to the diagonal of the mass matrix [kg m^2]. libfranka's
+    // model leaves it out, but it dominates the inertia of the wrist joints of the real arm.
+    std::array<double, 7> armature{{0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.1}};
+    std::array<double, 7> damping{};  // viscous joint friction [Nm s / rad]
+  };
+
+  // changes of setFrames(); those not flagged keep their current values
+  struct FrameChanges {
+    bool set_EE_frame{false};
+    std::array<double, 16> F_T_EE{};
+    bool set_K_frame{false};
+    std::array<double, 16> EE_T_K{};
+    bool set_load{false};
+    double load_mass{0.0};
+    std::array<double, 3> F_x_Cload{};
+    std::array<double, 9> load_inertia{};
+  };
+
+  static constexpr std::array<double, 7> kLowerLimits{
+      {-2.8973, -1.7628, -2.8973, -3.0718, -2.8973, -0.0175, -2.8973}};
+  static constexpr std::array<double, 7> kUpperLimits{
+      {2.8973, 1.7628, 2.8973, -0.0698, 2.8973, 3.7525, 2.8973}};
+
+  /**
+   * @param[in] joint_names names of the 7 joints.
+   * @param[in] arm_id prefix of the franka_hw::FrankaStateHandle (<arm_id>_robot) and the
+   * FrankaModelCacheHandle (<arm_id>_model).
+   * @param[in] q initial joint positions.
+   * @param[in] parameters simulation parameters.
+   */
+  SimulatedFrankaHW(const std::array<std::string, 7>& joint_names,
+                    const std::string& arm_id,
+                    const std::array<double, 7>& q,
+                    const Parameters& parameters);
+
+  /**
+   * Rejects switches that would leave controllers with different command modes running.
+   */
+  bool prepareSwitch(const std::list<hardware_interface::ControllerInfo>& start_list,
+                     const std::list<hardware_interface::ControllerInfo>& stop_list) override;
+
+  void doSwitch(const std::list<hardware_interface::ControllerInfo>& start_list,
+                const std::list<hardware_interface::ControllerInfo>& stop_list) override;
+
+  /**
+   * Applies pending setter calls and updates the robot state and joint handles to the
+   * simulated state; invalidates the model cache.
+   */
+  void read(const ros::Time& time, const ros::Duration& period) override;
+
+  /**
+   * Advances the simulation by period under the current commands.
+   */
+  void write(const ros::Time& time, const ros::Duration& period) override;
+
+  /**
+   * Moves the arm to q at rest, clamped to the joint limits.
+   */
+  void reset(const std::array<double, 7>& q);
+
+  /**
+   * Sets the wrench [N, Nm] exerted on the arm at the stiffness frame, in base frame
+   * coordinates. It stays applied until changed.
+   */
+  void setExternalWrench(const std::array<double, 6>& O_F_ext);
+
+  /**
+   * Sets the end effector frame in the flange frame (column-major), as franka::Robot::setEE.
+   */
+  void setEEFrame(const std::array<double, 16>& F_T_EE);
+
+  /**
+   * Sets the stiffness frame in the end effector frame (column-major), as franka::Robot::setK.
+   */
+  void setKFrame(const std::array<double, 16>& EE_T_K);
+
+  /**
+   * Sets the payload in addition to the hand, as franka::Robot::setLoad.
+   */
+  void setLoad(double mass, const std::array<double, 3>& F_x_Cload,
+               const std::array<double, 9>& load_inertia);
+
+  /**
+   * Sets any of the end effector frame, the stiffness frame and the payload; they take effect
+   * together, at the same read().
+   */
+  void setFrames(const FrameChanges& changes);
+
+  /**
+   * @return true while a controller claiming a command interface is running.
+   */
+  bool controllerActive() const;
+
+  /**
+   * @return the simulated robot state, as of the last read(). Only valid in the control loop.
+   */
+  const franka::RobotState& robotState() const { return robot_state_; }
+
+ private:
+  enum class CommandMode { kNone, kPosition, kVelocity, kEffort };
+
+  struct PendingChanges {
+    bool reset{false};
+    std::array<double, 7> q{};
+    std::array<double, 6> O_F_ext{};
+    std::array<double, 16> F_T_EE{};
+    std::array<double, 16> EE_T_K{};
+    bool load{false};
+    double load_mass{0.0};
+    std::array<double, 3> F_x_Cload{};
+    std::array<double, 9> load_inertia{};
+  };
+
+  static CommandMode commandMode(const hardware_interface::ControllerInfo& info);
+  bool switchModes(const std::list<hardware_interface::ControllerInfo>& start_list,
+                   const std::list<hardware_interface::ControllerInfo>& stop_list,
+                   std::map<std::string, CommandMode>& modes) const;
+  CommandMode activeMode() const;
+  void holdCommands();
+  void applyPendingChanges();  // with pending_mutex_ held
+  void stepDynamics(double dt);
+  void clampToLimits();
+  void updateRobotState(const ros::Duration& period);
+
+  Parameters parameters_;
+  PandaModel model_;
+  franka::RobotState robot_state_;
+  std::shared_ptr<FrankaModelCache> model_cache_;
+
+  // simulated state; robot_state_ is updated from it in read()
+  PandaModel::Vector7d q_;
+  PandaModel::Vector7d dq_;
+  PandaModel::Vector7d ddq_;
+  PandaModel::Vector7d tau_;  // torques commanded in the last cycle, without gravity
+  Eigen::Matrix<double, 6, 1> O_F_ext_;
+
+  std::array<double, 7> position_command_{};
+  std::array<double, 7> velocity_command_{};
+  std::array<double, 7> effort_command_{};
+
+  // command modes of the running controllers that claim a command interface
+  std::map<std::string, CommandMode> controller_modes_;
+  CommandMode mode_{CommandMode::kNone};
+
+  std::mutex pending_mutex_;
+  PendingChanges pending_;
+  bool has_pending_{false};
+
+  hardware_interface::JointStateInterface joint_state_interface_;
+  hardware_interface::PositionJointInterface position_joint_interface_;
+  hardware_interface::VelocityJointInterface velocity_joint_interface_;
+  hardware_interface::EffortJointInterface effort_joint_interface_;
+  franka_hw::FrankaStateInterface franka_state_interface_;
+  FrankaModelCacheInterface model_cache_interface_;
+};
+
+}  // namespace franka_interface
@@ -0,0 +1,132 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace franka_interface {
+
+/**
+ * Preallocated, lock-free single-producer single-consumer FIFO.
+ *
+ * Unlike franka_ros_controllers::CommandMailbox, which only keeps the latest value, every pushed
+ * element is delivered in order. Neither side ever blocks or allocates; push() fails when the
+ * buffer is full. Exactly one thread may push and exactly one (other) thread may pop.
+ */
+template <typename T, size_t Capacity>
+class SpscRingBuffer {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SpscRingBuffer capacity must be a power of two");
+
+ public:
+  SpscRingBuffer() = default;
+  SpscRingBuffer(const SpscRingBuffer&) = delete;
+  SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+  static constexpr size_t capacity() { return Capacity; }
+
+  /**
+   * Appends an element. Producer side only.
+   *
+   * @return false if the buffer is full; the element is dropped in that case.
+   */
+  bool push(const T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= Capacity) {
+      return false;
+    }
+    buffer_[head & kMask] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @return number of elements that can currently be pushed. Producer side only.
+   */
+  size_t freeSpace() const {
+    return Capacity - (head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_acquire));
+  }
+
+  /**
+   * @return pointer to the oldest element, or nullptr if empty. Consumer side only; the element
+   * stays valid until the next pop().
+   */
+  const T* front() const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) {
+      return nullptr;
+    }
+    return &buffer_[tail & kMask];
+  }
+
+  /**
+   * Removes the oldest element. Consumer side only.
+   *
+   * @return false if the buffer was empty.
+   */
+  bool pop() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) {
+      return false;
+    }
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Moves the oldest element into item and removes it. Consumer side only.
+   *
+   * @return false if the buffer was empty; item is untouched in that case.
+   */
+  bool pop(T& item) {
+    const T* oldest = front();
+    if (oldest == nullptr) {
+      return false;
+    }
+    item = *oldest;
+    return pop();
+  }
+
+  /**
+   * Drops all elements currently in the buffer. Consumer side only.
+   */
+  void clear() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+ private:
+  static constexpr size_t kMask{Capacity - 1};
+  static constexpr size_t kCacheLine{64};
+
+  std::array<T, Capacity> buffer_{};
+  // head_ and tail_ are written by different threads; keep them on separate cache lines
+  std::atomic<size_t> head_{0};
+  char padding_[kCacheLine - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_{0};
+};
+
+}  // namespace franka_interface
@@ -0,0 +1,90 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace franka_interface {
+
+/**
+ * Durations of the phases of the startup of the control node, for a single report. Not thread
+ * safe; phases are recorded by the thread doing the startup.
+ */
+class StartupTimer {
+ public:
+  StartupTimer() : start_(std::chrono::steady_clock::now()), last_(start_) {}
+
+  /**
+   * Records the time since the previous phase finished (or since the construction) as the
+   * duration of phase.
+   */
+  void phaseFinished(const std::string& phase) {
+    auto now = std::chrono::steady_clock::now();
+    phases_.emplace_back(phase, std::chrono::duration<double>(now - last_).count());
+    last_ = now;
+  }
+
+  /**
+   * @return [s] since the construction.
+   */
+  double total() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  }
+
+  /**
+   * @return the phases in the order they finished and their durations, longest marked, e.g.
+   * "connection 35.2 ms, model 512.0 ms (longest), ... total 820.4 ms".
+   */
+  std::string report() const {
+    size_t longest = 0;
+    for (size_t i = 1; i < phases_.size(); ++i) {
+      if (phases_[i].second > phases_[longest].second) {
+        longest = i;
+      }
+    }
+    std::ostringstream stream;
+    stream.setf(std::ios::fixed);
+    stream.precision(1);
+    for (size_t i = 0; i < phases_.size(); ++i) {
+      stream << phases_[i].first << " " << phases_[i].second * 1e3 << " ms"
+             << (i == longest && phases_.size() > 1 ? " (longest)" : "") << ", ";
+    }
+    stream << "total " << total() * 1e3 << " ms";
+    return stream.str();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_;
+  std::vector<std::pair<std::string, double>> phases_;
+};
+
+}  // namespace franka_interface
@@ -0,0 +1,244 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <franka_interface/spsc_ring_buffer.h>
+
+namespace franka_interface {
+
+/**
+ * Robot state of one control cycle as stored in a state recording. Field meanings are those of
+ * franka::RobotState; all fields are doubles so that every column of the file is float64.
+ */
+struct StateRecord {
+  double time{0.0};  // [s], ROS time of the cycle
+  std::array<double, 7> q{};
+  std::array<double, 7> dq{};
+  std::array<double, 7> q_d{};
+  std::array<double, 7> dq_d{};
+  std::array<double, 7> tau_J{};
+  std::array<double, 7> dtau_J{};
+  std::array<double, 7> tau_J_d{};  // commanded torques
+  std::array<double, 7> tau_ext_hat_filtered{};
+  std::array<double, 16> O_T_EE{};    // column-major
+  std::array<double, 16> O_T_EE_d{};  // column-major
+  std::array<double, 6> O_F_ext_hat_K{};
+  std::array<double, 6> K_F_ext_hat_K{};
+  double robot_mode{0.0};  // franka::RobotMode
+  double control_command_success_rate{0.0};
+};
+
+/**
+ * One column of a state recording: a StateRecord field.
+ */
+struct StateRecordingColumn {
+  std::array<char, 32> name{};  // zero terminated
+  uint32_t width{0};            // doubles per record
+  uint32_t offset{0};           // doubles preceding the column in a record
+};
+
+/**
+ * File header of a state recording.
+ *
+ * Layout of the file (little endian): the header, padded to kHeaderSize bytes, followed by
+ * blocks of block_records records. Within a block the data is stored by column: column c takes
+ * block_records * width doubles starting at double block_records * offset of the block, in
+ * record order. Every block therefore has the same size, and a column of the whole recording
+ * is a strided view of the memory mapped file. The last block is zero padded; num_records
+ * tells how many records are valid, or is 0 if the recorder did not finish the file (then all
+ * complete blocks are valid).
+ */
+struct StateRecordingHeader {
+  static constexpr uint64_t kMagic{0x3143455254535246ull};  // "FRSTREC1" in file byte order
+  static constexpr uint32_t kVersion{1};
+  static constexpr uint32_t kHeaderSize{4096};
+  static constexpr uint32_t kBlockRecords{1024};
+  static constexpr size_t kMaxColumns{64};
+
+  uint64_t magic{kMagic};
+  uint32_t version{kVersion};
+  uint32_t header_size{kHeaderSize};
+  uint32_t block_records{kBlockRecords};
+  uint32_t record_width{0};  // doubles per record
+  uint64_t num_records{0};
+  uint32_t num_columns{0};
+  uint32_t reserved{0};
+  std::array<StateRecordingColumn, kMaxColumns> columns{};
+
+  /**
+   * @return the header describing StateRecord.
+   */
+  static StateRecordingHeader forStateRecord();
+};
+
+static_assert(sizeof(StateRecordingHeader) <= StateRecordingHeader::kHeaderSize,
+              "StateRecordingHeader does not fit into kHeaderSize");
+static_assert(sizeof(StateRecord) % sizeof(double) == 0, "StateRecord must only contain doubles");
+
+/**
+ * Records a StateRecord every control cycle into a file (see StateRecordingHeader).
+ *
+ * record() is realtime safe: it copies the record into a preallocated SpscRingBuffer, and a
+ * writer thread transposes the records into blocks and writes them. start() and stop() must be
+ * called from one non-realtime thread at a time.
+ */
+class StateRecorder {
+ public:
+  StateRecorder() = default;
+  StateRecorder(const StateRecorder&) = delete;
+  StateRecorder& operator=(const StateRecorder&) = delete;
+  ~StateRecorder();
+
+  /**
+   * Creates the file and starts recording. Not realtime safe.
+   *
+   * @param[in] path file to record to; an existing file is overwritten.
+   * @param[out] error description of the failure.
+   * @return false if already recording or the file could not be created.
+   */
+  bool start(const std::string& path, std::string& error);
+
+  /**
+   * Stops recording and completes the file. Not realtime safe; waits for the writer thread.
+   *
+   * @return number of records written, 0 if not recording.
+   */
+  uint64_t stop();
+
+  bool isRecording() const { return recording_.load(std::memory_order_acquire); }
+
+  const std::string& path() const { return path_; }
+
+  /**
+   * Queues the record of this cycle if recording. Realtime safe.
+   */
+  void record(const StateRecord& record) {
+    if (!isRecording()) {
+      return;
+    }
+    if (!buffer_.push(record)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @return records lost in the current (or last) recording because the writer fell behind.
+   */
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  /**
+   * @return true if writing the last recording failed (e.g. the disk is full). Valid after
+   * stop().
+   */
+  bool failed() const { return write_failed_; }
+
+ private:
+  static constexpr size_t kBufferSize{4096};
+
+  void run();
+  bool writeBlock();
+
+  SpscRingBuffer<StateRecord, kBufferSize> buffer_;
+  std::atomic<bool> recording_{false};
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> dropped_{0};
+
+  // owned by the thread calling start() and stop(), and by the writer thread while it runs
+  std::string path_;
+  int fd_{-1};
+  std::thread writer_;
+  std::vector<double> block_;
+  size_t block_fill_{0};
+  uint64_t num_records_{0};
+  bool write_failed_{false};
+};
+
+/**
+ * Memory maps a state recording for offline analysis. Does not depend on ROS.
+ */
+class StateRecordingReader {
+ public:
+  StateRecordingReader() = default;
+  StateRecordingReader(const StateRecordingReader&) = delete;
+  StateRecordingReader& operator=(const StateRecordingReader&) = delete;
+  ~StateRecordingReader() { close(); }
+
+  /**
+   * @param[in] path recording to open.
+   * @param[out] error description of the failure.
+   * @return false if the file could not be mapped or is not a compatible recording.
+   */
+  bool open(const std::string& path, std::string& error);
+  void close();
+
+  const StateRecordingHeader& header() const { return header_; }
+
+  /**
+   * @return number of valid records.
+   */
+  size_t size() const { return num_records_; }
+
+  /**
+   * @return the column with the given name (e.g. "q" or "tau_J_d"), nullptr if there is none.
+   */
+  const StateRecordingColumn* column(const std::string& name) const;
+
+  /**
+   * @return element element of the column in the given record, without bounds checks.
+   */
+  double value(const StateRecordingColumn& column, size_t record, size_t element = 0) const {
+    const size_t block = record / header_.block_records;
+    const size_t index = record % header_.block_records;
+    return data_[block * header_.block_records * header_.record_width +
+                 static_cast<size_t>(column.offset) * header_.block_records +
+                 index * column.width + element];
+  }
+
+  /**
+   * Copies a column of all records into values, record major (size() * column width values).
+   *
+   * @return false if there is no column with the given name.
+   */
+  bool read(const std::string& name, std::vector<double>& values) const;
+
+ private:
+  StateRecordingHeader header_;
+  void* mapping_{nullptr};
+  size_t mapping_size_{0};
+  const double* data_{nullptr};
+  size_t num_records_{0};
+};
+
+}  // namespace franka_interface
@@ -0,0 +1,125 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <trajectory_msgs/JointTrajectory.h>
+
+namespace franka_interface {
+
+/**
+ * Minimum-time trajectory through joint space waypoints, within joint velocity and
+ * acceleration limits.
+ *
+ * The path through the waypoints is a shape-preserving (PCHIP) cubic per joint over the
+ * cumulative distance between the waypoints: it passes through every waypoint without
+ * stopping there and never overshoots the range of two neighbouring waypoints, so a path within
+ * the joint position limits stays within them; two waypoints give a straight line. The motion
+ * along the path is timed by reachability analysis (TOPP-RA, Pham & Pham 2018) on a grid of
+ * the path: a backward pass finds the largest path velocity from which the end can still be
+ * reached at rest, and a forward pass accelerates as hard as the limits allow within it. The
+ * path acceleration is constant between grid points; the joint velocities and accelerations are
+ * bounded over every interval, not only at the grid points. The trajectory starts and ends at
+ * rest.
+ */
+class JointTrajectoryTiming {
+ public:
+  using Positions = std::array<double, 7>;
+
+  /**
+   * @param[in] velocity_limits [rad/s] per joint.
+   * @param[in] acceleration_limits [rad/s^2] per joint.
+   * @param[in] grid_points_per_segment resolution of the path between two waypoints.
+   */
+  JointTrajectoryTiming(const Positions& velocity_limits, const Positions& acceleration_limits,
+                        size_t grid_points_per_segment = 100);
+
+  /**
+   * Computes the trajectory through the waypoints. Consecutive duplicates are skipped.
+   *
+   * @param[in] waypoints path, starting at the current positions.
+   * @param[in] speed_ratio in (0, 1]; scales the velocity limits, and the acceleration limits
+   * with its square, so that the trajectory is the full-speed one slowed down by this factor.
+   * @param[out] error reason of a failure.
+   * @return false if the waypoints or the speed ratio are invalid.
+   */
+  bool compute(const std::vector<Positions>& waypoints, double speed_ratio, std::string& error);
+
+  /**
+   * @return [s] duration of the computed trajectory.
+   */
+  double duration() const { return times_.empty() ? 0.0 : times_.back(); }
+
+  /**
+   * Evaluates the computed trajectory; times outside [0, duration()] are clamped.
+   */
+  void sample(double time, Positions& positions, Positions& velocities,
+              Positions& accelerations) const;
+
+  /**
+   * Samples the computed trajectory every sample_period, and at its end, into points (the
+   * joint names are left to the caller).
+   */
+  void toMessage(double sample_period, trajectory_msgs::JointTrajectory& trajectory) const;
+
+ private:
+  // position, first and second derivative of the path at s, on segment k of the path
+  void evaluatePath(double s, Positions& q, Positions& dq_ds, Positions& ddq_ds) const;
+  void evaluateSegment(size_t k, double s, Positions& q, Positions& dq_ds,
+                       Positions& ddq_ds) const;
+
+  // interval of path accelerations u allowed by the acceleration limits on grid interval i
+  // (at both of its ends) when starting with squared path velocity x; false if there is none
+  bool accelerationBounds(size_t i, double x, double& lower, double& upper) const;
+
+  Positions velocity_limits_;
+  Positions acceleration_limits_;
+  size_t grid_points_per_segment_;
+
+  // path: knots (cumulative distance), positions and tangents at the knots
+  std::vector<double> knots_;
+  std::vector<Positions> positions_;
+  std::vector<Positions> tangents_;
+
+  // grid: path parameter, derivatives of the path at both ends of every interval (on the
+  // segment of the interval, since the curvature jumps at the knots), squared path velocity
+  // and time
+  std::vector<double> s_;
+  std::vector<Positions> dq_ds_;
+  std::vector<Positions> ddq_ds_start_;
+  std::vector<Positions> dq_ds_end_;
+  std::vector<Positions> ddq_ds_end_;
+  std::vector<double> x_;
+  std::vector<double> times_;
+  Positions scaled_velocity_limits_{};
+  Positions scaled_acceleration_limits_{};
+};
+
+}  // namespace franka_interface
@@ -0,0 +1,160 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/callback_queues.h>
+
+#include <chrono>
+#include <map>
+
+#include <boost/make_shared.hpp>
+#include <franka_core_msgs/CallbackQueueStatistics.h>
+#include <franka_interface/arm_namespace.h>
+#include <ros/console.h>
+
+namespace franka_interface {
+
+namespace {
+
+std::mutex command_queues_mutex;
+std::map<std::string, ros::CallbackQueueInterface*> command_queues;
+
+double secondsBetween(std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double>(end - start).count();
+}
+
+}  // anonymous namespace
+
+// Forwards to the wrapped callback and reports how long it waited and ran. The queue counts a
+// callback as pending until its wrapper is released, i.e. after it was called or removed.
+class MonitoredCallbackQueue::TimedCallback : public ros::CallbackInterface {
+ public:
+  TimedCallback(ros::CallbackInterfacePtr callback, MonitoredCallbackQueue& queue)
+      : callback_(std::move(callback)), queue_(queue), queued_(std::chrono::steady_clock::now()) {}
+  ~TimedCallback() override { queue_.callbackReleased(); }
+
+  CallResult call() override {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    CallResult result = callback_->call();
+    // callbacks that are not ready yet are put back into the queue and called again later
+    if (result != TryAgain) {
+      queue_.callbackFinished(secondsBetween(queued_, start),
+                              secondsBetween(start, std::chrono::steady_clock::now()));
+    }
+    return result;
+  }
+
+  bool ready() override { return callback_->ready(); }
+
+ private:
+  ros::CallbackInterfacePtr callback_;
+  MonitoredCallbackQueue& queue_;
+  std::chrono::steady_clock::time_point queued_;
+};
+
+MonitoredCallbackQueue::~MonitoredCallbackQueue() {
+  // release the wrappers while the counters still exist
+  clear();
+}
+
+void MonitoredCallbackQueue::addCallback(const ros::CallbackInterfacePtr& callback,
+                                         uint64_t removal_id) {
+  uint32_t depth = depth_.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint32_t max_depth = max_depth_.load(std::memory_order_relaxed);
+  while (depth > max_depth &&
+         !max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+  }
+  ros::CallbackQueue::addCallback(boost::make_shared<TimedCallback>(callback, *this), removal_id);
+}
+
+void MonitoredCallbackQueue::callbackFinished(double wait, double run) {
+  std::lock_guard<std::mutex> guard(histogram_mutex_);
+  wait_.add(wait);
+  run_.add(run);
+}
+
+void MonitoredCallbackQueue::fillTiming(franka_core_msgs::CallbackQueueTiming& msg) const {
+  msg.name = name_;
+  msg.callbacks = wait_.count();
+  msg.depth = depth_.load(std::memory_order_relaxed);
+  msg.max_depth = max_depth_.load(std::memory_order_relaxed);
+  wait_.fill(msg.wait);
+  run_.fill(msg.run);
+}
+
+void setCommandCallbackQueue(const ros::NodeHandle& arm_node_handle,
+                             ros::CallbackQueueInterface* queue) {
+  std::lock_guard<std::mutex> guard(command_queues_mutex);
+  if (queue != nullptr) {
+    command_queues[arm_node_handle.getNamespace()] = queue;
+  } else {
+    command_queues.erase(arm_node_handle.getNamespace());
+  }
+}
+
+ros::NodeHandle commandNodeHandle(const ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = armNodeHandle(node_handle);
+  std::lock_guard<std::mutex> guard(command_queues_mutex);
+  auto queue = command_queues.find(arm_node_handle.getNamespace());
+  if (queue != command_queues.end()) {
+    arm_node_handle.setCallbackQueue(queue->second);
+  }
+  return arm_node_handle;
+}
+
+void CallbackQueueMonitor::addQueue(const MonitoredCallbackQueue& queue, uint32_t threads) {
+  queues_.push_back({&queue, threads});
+}
+
+void CallbackQueueMonitor::init(ros::NodeHandle& nh) {
+  double publish_rate(1.0);
+  nh.param<double>("control_node_config/callback_queues/publish_rate", publish_rate, 1.0);
+  if (!(publish_rate > 0.0)) {
+    ROS_WARN_STREAM("CallbackQueueMonitor: Invalid publish_rate " << publish_rate
+                    << ", using 1 Hz");
+    publish_rate = 1.0;
+  }
+  statistics_publisher_ = nh.advertise<franka_core_msgs::CallbackQueueStatistics>(
+      "franka_ros_interface/franka_control/callback_queue_statistics", 1);
+  publish_timer_ = nh.createTimer(ros::Duration(1.0 / publish_rate),
+                                  &CallbackQueueMonitor::publishStatistics, this);
+}
+
+void CallbackQueueMonitor::publishStatistics(const ros::TimerEvent& /*e*/) {
+  if (statistics_publisher_.getNumSubscribers() == 0) {
+    return;
+  }
+  franka_core_msgs::CallbackQueueStatistics msg;
+  msg.header.stamp = ros::Time::now();
+  msg.queues.resize(queues_.size());
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    queues_[i].queue->fillTiming(msg.queues[i]);
+    msg.queues[i].threads = queues_[i].threads;
+  }
+  statistics_publisher_.publish(msg);
+}
+
+}  // namespace franka_interface
@@ -0,0 +1,173 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/control_loop_monitor.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <franka_core_msgs/ControlLoopStatistics.h>
+
+namespace franka_interface {
+
+constexpr size_t ControlLoopMonitor::kMaxControllerSets;
+constexpr double ControlLoopMonitor::kNominalPeriod;
+
+void ControlLoopMonitor::init(ros::NodeHandle& nh,
+        boost::shared_ptr<controller_manager::ControllerManager> controller_manager) {
+  controller_manager_ = controller_manager;
+
+  double publish_rate(1.0);
+  nh.param<double>("control_node_config/loop_statistics/publish_rate", publish_rate, 1.0);
+  nh.param<double>("control_node_config/loop_statistics/deadline", deadline_, 0.0005);
+  double check_rate(10.0);
+  nh.param<double>("control_node_config/loop_statistics/controller_check_rate", check_rate, 10.0);
+
+  controller_set_names_.clear();
+  controller_set_names_.emplace_back();  // slot 0: unattributed cycles
+
+  statistics_publisher_ = nh.advertise<franka_core_msgs::ControlLoopStatistics>(
+      "franka_ros_interface/franka_control/control_loop_statistics", 1);
+
+  check_timer_ = nh.createTimer(ros::Duration(1.0 / check_rate),
+                                &ControlLoopMonitor::checkRunningControllers, this);
+  publish_timer_ = nh.createTimer(ros::Duration(1.0 / publish_rate),
+                                  &ControlLoopMonitor::publishStatistics, this);
+
+  ROS_INFO_STREAM("ControlLoopMonitor: Publishing control loop statistics at " << publish_rate
+                  << " Hz (deadline " << deadline_ * 1e6 << " us)");
+}
+
+void ControlLoopMonitor::cycleStarted(const ros::Duration& period) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  cycle_set_ = active_set_.load(std::memory_order_acquire);
+  TimingSlot& slot = controller_sets_[cycle_set_];
+
+  if (period.isZero()) {
+    // first cycle of a new motion; the interval to the last motion is not a jitter sample
+    has_last_cycle_ = false;
+  }
+  if (has_last_cycle_) {
+    double interval = std::chrono::duration<double>(now - last_cycle_start_).count();
+    double jitter = std::abs(interval - kNominalPeriod);
+    total_.jitter.add(jitter);
+    slot.jitter.add(jitter);
+  }
+
+  // the robot reports periods longer than 1 ms when it had to skip cycles
+  uint64_t lost = static_cast<uint64_t>(std::max(0.0, std::round(period.toSec() / kNominalPeriod) - 1.0));
+  if (lost > 0) {
+    total_.lost_robot_packets.store(total_.lost_robot_packets.load(std::memory_order_relaxed) + lost,
+                                    std::memory_order_relaxed);
+    slot.lost_robot_packets.store(slot.lost_robot_packets.load(std::memory_order_relaxed) + lost,
+                                  std::memory_order_relaxed);
+  }
+
+  last_cycle_start_ = now;
+  has_last_cycle_ = true;
+  cycle_start_ = now;
+}
+
+void ControlLoopMonitor::cycleFinished() {
+  double duration =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - cycle_start_).count();
+  TimingSlot& slot = controller_sets_[cycle_set_];
+  total_.update_duration.add(duration);
+  slot.update_duration.add(duration);
+  if (duration > deadline_) {
+    total_.deadline_misses.store(total_.deadline_misses.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+    slot.deadline_misses.store(slot.deadline_misses.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+  }
+}
+
+void ControlLoopMonitor::checkRunningControllers(const ros::TimerEvent& /*e*/) {
+  std::vector<std::string> names;
+  controller_manager_->getControllerNames(names);
+  std::vector<std::string> running;
+  for (const std::string& name : names) {
+    controller_interface::ControllerBase* controller = controller_manager_->getControllerByName(name);
+    if (controller != nullptr && controller->isRunning()) {
+      running.push_back(name);
+    }
+  }
+  std::sort(running.begin(), running.end());
+
+  std::lock_guard<std::mutex> guard(controller_set_names_mutex_);
+  size_t index = 0;
+  auto it = std::find(controller_set_names_.begin() + 1, controller_set_names_.end(), running);
+  if (it != controller_set_names_.end()) {
+    index = it - controller_set_names_.begin();
+  } else if (controller_set_names_.size() < kMaxControllerSets) {
+    index = controller_set_names_.size();
+    controller_set_names_.push_back(running);
+  } else {
+    ROS_WARN_STREAM_ONCE("ControlLoopMonitor: More than " << kMaxControllerSets - 1
+                         << " controller combinations seen; further cycles are not attributed.");
+  }
+  active_set_.store(index, std::memory_order_release);
+}
+
+void ControlLoopMonitor::fillTiming(const TimingSlot& slot,
+                                    franka_core_msgs::ControlLoopTiming& msg) const {
+  msg.cycles = slot.update_duration.count();
+  msg.deadline_misses = slot.deadline_misses.load(std::memory_order_relaxed);
+  msg.lost_robot_packets = slot.lost_robot_packets.load(std::memory_order_relaxed);
+  msg.update_mean = slot.update_duration.mean();
+  msg.update_p50 = slot.update_duration.percentile(0.5);
+  msg.update_p99 = slot.update_duration.percentile(0.99);
+  msg.update_max = slot.update_duration.max();
+  msg.jitter_p50 = slot.jitter.percentile(0.5);
+  msg.jitter_p99 = slot.jitter.percentile(0.99);
+  msg.jitter_max = slot.jitter.max();
+  msg.histogram_bin_width = LinearBins::kBinWidth;
+  slot.update_duration.copyBins(msg.update_histogram);
+}
+
+void ControlLoopMonitor::publishStatistics(const ros::TimerEvent& /*e*/) {
+  if (statistics_publisher_.getNumSubscribers() == 0) {
+    return;
+  }
+  franka_core_msgs::ControlLoopStatistics msg;
+  msg.header.stamp = ros::Time::now();
+  msg.deadline = deadline_;
+  fillTiming(total_, msg.total);
+
+  std::lock_guard<std::mutex> guard(controller_set_names_mutex_);
+  for (size_t i = 0; i < controller_set_names_.size(); ++i) {
+    if (controller_sets_[i].update_duration.count() == 0) {
+      continue;
+    }
+    franka_core_msgs::ControlLoopTiming timing;
+    timing.running_controllers = controller_set_names_[i];
+    fillTiming(controller_sets_[i], timing);
+    msg.controller_sets.push_back(timing);
+  }
+  statistics_publisher_.publish(msg);
+}
+
+}  // namespace franka_interface
@@ -29,20 +29,36 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <actionlib/server/simple_action_server.h>
 #include <controller_manager/controller_manager.h>
 #include <franka/exception.h>
 #include <franka/robot.h>
 #include <franka_hw/franka_hw.h>
+#include <franka_hw/franka_state_interface.h>
 #include <ros/ros.h>
 
+#include <franka_interface/callback_queues.h>
+#include <franka_interface/control_loop_monitor.h>
+#include <franka_interface/franka_model_cache_interface.h>
 #include <franka_interface/motion_controller_interface.h>
+#include <franka_interface/motion_primitive_server.h>
+#include <franka_interface/multi_arm_state.h>
+#include <franka_interface/realtime_settings.h>
+#include <franka_interface/startup_timer.h>
 
 #include <franka_control/ErrorRecoveryAction.h>
 #include <franka_control/services.h>
+#include <franka_core_msgs/SetFrames.h>
 
 class ServiceContainer {
  public:
@@ -57,189 +73,542 @@ class ServiceContainer {
   std::vector<ros::ServiceServer> services_;
 };
 
-int main(int argc, char** argv) {
-  ros::init(argc, argv, "custom_franka_control_node");
-  ros::NodeHandle public_node_handle;
-  ros::NodeHandle node_handle("~");
+template <size_t N, typename T>
+std::array<double, N> toArray(const T& values) {
+  std::array<double, N> array{};
+  std::copy(values.cbegin(), values.cbegin() + std::min(N, values.size()), array.begin());
+  return array;
+}
 
-  std::vector<std::string> joint_names_vector;
-  if (!node_handle.getParam("/robot_config/joint_names", joint_names_vector) || joint_names_vector.size() != 7) {
-    ROS_ERROR("Invalid or no joint_names parameters provided");
-    return 1;
-  }
+// Robot, hardware, controller manager and control loop of one arm. The topics, services and
+// parameters of the arm are resolved in its namespace, "/" when the node drives a single arm.
+class ArmControl {
+ public:
+  /**
+   * @param[in] node_handle node handle in the arm namespace.
+   * @param[in] private_node_handle node handle for the private parameters of the arm.
+   * @param[in] arm_index index of the arm in multi_arm_state.
+   * @param[in] multi_arm_state states of all arms driven by the node.
+   */
+  ArmControl(const ros::NodeHandle& node_handle, const ros::NodeHandle& private_node_handle,
+             size_t arm_index, std::shared_ptr<franka_interface::MultiArmState> multi_arm_state)
+      : node_handle_(node_handle),
+        private_node_handle_(private_node_handle),
+        arm_index_(arm_index),
+        multi_arm_state_(std::move(multi_arm_state)),
+        command_queue_(node_handle.getNamespace() == "/" ? "commands"
+                                                         : node_handle.getNamespace() + "/commands") {}
+
+  ~ArmControl() { franka_interface::setCommandCallbackQueue(node_handle_, nullptr); }
+
+  // Connects to the robot and starts the controller manager of the arm. Logs how long each
+  // step took.
+  bool init() {
+    franka_interface::StartupTimer startup_timer;
+    std::vector<std::string> joint_names_vector;
+    if (!node_handle_.getParam("robot_config/joint_names", joint_names_vector) || joint_names_vector.size() != 7) {
+      ROS_ERROR("Invalid or no joint_names parameters provided");
+      return false;
+    }
 
-  std::array<std::string, 7> joint_names;
-  std::copy(joint_names_vector.cbegin(), joint_names_vector.cend(), joint_names.begin());
+    std::array<std::string, 7> joint_names;
+    std::copy(joint_names_vector.cbegin(), joint_names_vector.cend(), joint_names.begin());
 
-  bool rate_limiting;
-  if (!node_handle.getParamCached("/robot_config/rate_limiting", rate_limiting)) {
-    ROS_ERROR("Invalid or no rate_limiting parameter provided");
-    return 1;
-  }
+    if (!node_handle_.getParamCached("robot_config/rate_limiting", rate_limiting_)) {
+      ROS_ERROR("Invalid or no rate_limiting parameter provided");
+      return false;
+    }
 
-  double cutoff_frequency;
-  if (!node_handle.getParamCached("/robot_config/cutoff_frequency", cutoff_frequency)) {
-    ROS_ERROR("Invalid or no cutoff_frequency parameter provided");
-    return 1;
-  }
+    if (!node_handle_.getParamCached("robot_config/cutoff_frequency", cutoff_frequency_)) {
+      ROS_ERROR("Invalid or no cutoff_frequency parameter provided");
+      return false;
+    }
 
-  std::string internal_controller;
-  if (!node_handle.getParam("/robot_config/internal_controller", internal_controller)) {
-    ROS_ERROR("No internal_controller parameter provided");
-    return 1;
+    if (!node_handle_.getParam("robot_config/internal_controller", internal_controller_)) {
+      ROS_ERROR("No internal_controller parameter provided");
+      return false;
+    }
+
+    if (!urdf_model_.initParamWithNodeHandle("robot_description", node_handle_)) {
+      ROS_ERROR("Could not initialize URDF model from robot_description");
+      return false;
+    }
+
+    std::string robot_ip;
+    if (!private_node_handle_.getParam("robot_ip", robot_ip)) {
+      ROS_ERROR("Invalid or no robot_ip parameter provided");
+      return false;
+    }
+
+    std::string error;
+    if (!realtime_settings_.read(node_handle_, error)) {
+      ROS_ERROR_STREAM("Invalid control_node_config/realtime parameters: " << error);
+      return false;
+    }
+    // a cpu_core of the arm takes precedence over control_cpus
+    int cpu_core(-1);
+    private_node_handle_.param("cpu_core", cpu_core, -1);
+    if (cpu_core >= 0) {
+      realtime_settings_.control_cpus = {cpu_core};
+    }
+
+    std::string arm_id = multi_arm_state_->armId(arm_index_);
+    startup_timer.phaseFinished("parameters");
+    // libfranka would raise the control loop to its highest priority at the start of every
+    // motion, overriding a configured one
+    robot_ = std::make_unique<franka::Robot>(
+        robot_ip, realtime_settings_.control_priority > 0 ? franka::RealtimeConfig::kIgnore
+                                                          : franka::RealtimeConfig::kEnforce);
+    franka::Robot& robot = *robot_;
+
+    // Set default collision behavior
+    robot.setCollisionBehavior(
+        {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}}, {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}},
+        {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}}, {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}},
+        {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}}, {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}},
+        {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}}, {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}});
+    startup_timer.phaseFinished("connection");
+
+    services_
+        .advertiseService<franka_control::SetJointImpedance>(
+            node_handle_, "franka_ros_interface/franka_control/set_joint_impedance",
+            [&robot](auto&& req, auto&& res) {
+              return franka_control::setJointImpedance(robot, req, res);
+            })
+        .advertiseService<franka_control::SetCartesianImpedance>(
+            node_handle_, "franka_ros_interface/franka_control/set_cartesian_impedance",
+            [&robot](auto&& req, auto&& res) {
+              return franka_control::setCartesianImpedance(robot, req, res);
+            })
+        .advertiseService<franka_control::SetEEFrame>(
+            node_handle_, "franka_ros_interface/franka_control/set_EE_frame",
+            [&robot](auto&& req, auto&& res) { return franka_control::setEEFrame(robot, req, res); })
+        .advertiseService<franka_control::SetKFrame>(
+            node_handle_, "franka_ros_interface/franka_control/set_K_frame",
+            [&robot](auto&& req, auto&& res) { return franka_control::setKFrame(robot, req, res); })
+        .advertiseService<franka_control::SetForceTorqueCollisionBehavior>(
+            node_handle_, "franka_ros_interface/franka_control/set_force_torque_collision_behavior",
+            [&robot](auto&& req, auto&& res) {
+              return franka_control::setForceTorqueCollisionBehavior(robot, req, res);
+            })
+        .advertiseService<franka_control::SetFullCollisionBehavior>(
+            node_handle_, "franka_ros_interface/franka_control/set_full_collision_behavior",
+            [&robot](auto&& req, auto&& res) {
+              return franka_control::setFullCollisionBehavior(robot, req, res);
+            })
+        .advertiseService<franka_control::SetLoad>(
+            node_handle_, "franka_ros_interface/franka_control/set_load",
+            [&robot](auto&& req, auto&& res) { return franka_control::setLoad(robot, req, res); });
+
+    recovery_action_server_ =
+        std::make_unique<actionlib::SimpleActionServer<franka_control::ErrorRecoveryAction>>(
+            node_handle_, "franka_ros_interface/franka_control/error_recovery",
+            [this](const franka_control::ErrorRecoveryGoalConstPtr&) {
+              std::string error;
+              if (recoverFromErrors(error)) {
+                recovery_action_server_->setSucceeded();
+              } else {
+                recovery_action_server_->setAborted(franka_control::ErrorRecoveryResult(), error);
+              }
+            },
+            false);
+
+    startup_timer.phaseFinished("services");
+
+    model_ = std::make_unique<franka::Model>(robot.loadModel());
+    startup_timer.phaseFinished("model");
+    auto get_rate_limiting = [this]() {
+      private_node_handle_.getParamCached("rate_limiting", rate_limiting_);
+      return rate_limiting_;
+    };
+    auto get_internal_controller = [this]() {
+      private_node_handle_.getParamCached("internal_controller", internal_controller_);
+
+      franka::ControllerMode controller_mode;
+      if (internal_controller_ == "joint_impedance") {
+        controller_mode = franka::ControllerMode::kJointImpedance;
+      } else if (internal_controller_ == "cartesian_impedance") {
+        controller_mode = franka::ControllerMode::kCartesianImpedance;
+      } else {
+        ROS_WARN("Invalid internal_controller parameter provided, falling back to joint impedance");
+        controller_mode = franka::ControllerMode::kJointImpedance;
+      }
+
+      return controller_mode;
+    };
+    auto get_cutoff_frequency = [this]() {
+      private_node_handle_.getParamCached("cutoff_frequency", cutoff_frequency_);
+      return cutoff_frequency_;
+    };
+    franka_control_ = std::make_unique<franka_hw::FrankaHW>(
+        joint_names, arm_id, urdf_model_, *model_, get_rate_limiting, get_cutoff_frequency,
+        get_internal_controller);
+
+    // Initialize robot state before loading any controller
+    franka_control_->update(robot.readOnce());
+    franka_state_handle_ = std::make_unique<franka_hw::FrankaStateHandle>(
+        franka_control_->get<franka_hw::FrankaStateInterface>()->getHandle(arm_id + "_robot"));
+
+    // Model quantities are computed at most once per control cycle and shared by all controllers
+    model_cache_ = std::make_shared<franka_interface::FrankaModelCache>(
+        franka_control_->get<franka_hw::FrankaModelInterface>()->getHandle(arm_id + "_model"));
+    model_cache_interface_.registerHandle(
+        franka_interface::FrankaModelCacheHandle(arm_id + "_model", model_cache_));
+    franka_control_->registerInterface(&model_cache_interface_);
+
+    multi_arm_state_interface_.registerHandle(
+        franka_interface::MultiArmStateHandle("multi_arm_state", multi_arm_state_));
+    franka_control_->registerInterface(&multi_arm_state_interface_);
+    writeMultiArmState(ros::Time::now());
+    startup_timer.phaseFinished("hardware interface");
+
+    // the controllers subscribe their command topics on the command queue of the arm
+    franka_interface::setCommandCallbackQueue(node_handle_, &command_queue_);
+    control_manager_.reset(new controller_manager::ControllerManager(franka_control_.get(), node_handle_));
+
+    motion_controller_interface_.init(node_handle_, control_manager_);
+
+    control_loop_monitor_.init(node_handle_, control_manager_);
+    startup_timer.phaseFinished("controller manager");
+
+    motion_controller_interface_.preloadControllers(startup_timer);
+
+    // libfranka only changes the frames and the payload outside of motions
+    set_frames_service_ = node_handle_.advertiseService(
+        "franka_ros_interface/franka_control/set_frames", &ArmControl::setFramesCallback, this);
+
+    if (!motion_primitive_server_.init(
+            node_handle_, motion_controller_interface_, multi_arm_state_, arm_index_,
+            [this](std::string& error) { return recoverFromErrors(error); })) {
+      return false;
+    }
+
+    recovery_action_server_->start();
+    startup_timer.phaseFinished("motion primitives");
+    ROS_INFO_STREAM("Startup of " << arm_id << ": " << startup_timer.report());
+    return true;
   }
 
-  urdf::Model urdf_model;
-  if (!urdf_model.initParamWithNodeHandle("robot_description", public_node_handle)) {
-    ROS_ERROR("Could not initialize URDF model from robot_description");
-    return 1;
+  // Runs the control loop of the arm and the delivery of its commands in threads of their own,
+  // configured by the realtime settings.
+  bool start() {
+    std::promise<bool> configured;
+    std::future<bool> result = configured.get_future();
+    thread_ = std::thread(&ArmControl::run, this, std::move(configured));
+    command_thread_ = std::thread(&ArmControl::serveCommands, this);
+    return result.get();
   }
 
-  std::string robot_ip;
-  if (!node_handle.getParam("robot_ip", robot_ip)) {
-    ROS_ERROR("Invalid or no robot_ip parameter provided");
-    return 1;
+  void join() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    if (command_thread_.joinable()) {
+      command_thread_.join();
+    }
   }
 
-  std::string arm_id;
-  if (!node_handle.getParam("/robot_config/arm_id", arm_id)) {
-    ROS_ERROR("Invalid or no arm_id parameter provided");
-    return 1;
+  const franka_interface::MonitoredCallbackQueue& commandQueue() const { return command_queue_; }
+
+ private:
+  bool recoverFromErrors(std::string& error) {
+    try {
+      robot_->automaticErrorRecovery();
+      has_error_ = false;
+      ROS_INFO("Recovered from error");
+      return true;
+    } catch (const franka::Exception& ex) {
+      error = ex.what();
+      return false;
+    }
   }
-  franka::Robot robot(robot_ip);
-
-  // Set default collision behavior
-  robot.setCollisionBehavior(
-      {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}}, {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}},
-      {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}}, {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}},
-      {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}}, {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}},
-      {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}}, {{20.0, 20.0, 20.0, 25.0, 25.0, 25.0}});
-
-  std::atomic_bool has_error(false);
-
-  ServiceContainer services;
-  services
-      .advertiseService<franka_control::SetJointImpedance>(
-          node_handle, "/franka_ros_interface/franka_control/set_joint_impedance",
-          [&robot](auto&& req, auto&& res) {
-            return franka_control::setJointImpedance(robot, req, res);
-          })
-      .advertiseService<franka_control::SetCartesianImpedance>(
-          node_handle, "/franka_ros_interface/franka_control/set_cartesian_impedance",
-          [&robot](auto&& req, auto&& res) {
-            return franka_control::setCartesianImpedance(robot, req, res);
-          })
-      .advertiseService<franka_control::SetEEFrame>(
-          node_handle, "/franka_ros_interface/franka_control/set_EE_frame",
-          [&robot](auto&& req, auto&& res) { return franka_control::setEEFrame(robot, req, res); })
-      .advertiseService<franka_control::SetKFrame>(
-          node_handle, "/franka_ros_interface/franka_control/set_K_frame",
-          [&robot](auto&& req, auto&& res) { return franka_control::setKFrame(robot, req, res); })
-      .advertiseService<franka_control::SetForceTorqueCollisionBehavior>(
-          node_handle, "/franka_ros_interface/franka_control/set_force_torque_collision_behavior",
-          [&robot](auto&& req, auto&& res) {
-            return franka_control::setForceTorqueCollisionBehavior(robot, req, res);
-          })
-      .advertiseService<franka_control::SetFullCollisionBehavior>(
-          node_handle, "/franka_ros_interface/franka_control/set_full_collision_behavior",
-          [&robot](auto&& req, auto&& res) {
-            return franka_control::setFullCollisionBehavior(robot, req, res);
-          })
-      .advertiseService<franka_control::SetLoad>(
-          node_handle, "/franka_ros_interface/franka_control/set_load",
-          [&robot](auto&& req, auto&& res) { return franka_control::setLoad(robot, req, res); });
-
-  actionlib::SimpleActionServer<franka_control::ErrorRecoveryAction> recovery_action_server(
-      node_handle, "/franka_ros_interface/franka_control/error_recovery",
-      [&](const franka_control::ErrorRecoveryGoalConstPtr&) {
-        try {
-          robot.automaticErrorRecovery();
-          has_error = false;
-          recovery_action_server.setSucceeded();
-          ROS_INFO("Recovered from error");
-        } catch (const franka::Exception& ex) {
-          recovery_action_server.setAborted(franka_control::ErrorRecoveryResult(), ex.what());
+
+  void run(std::promise<bool> configured) {
+    std::string error;
+    if (!franka_interface::configureCurrentThread(realtime_settings_.control_priority,
+                                                  realtime_settings_.control_cpus, error)) {
+      ROS_ERROR_STREAM("Control loop of " << multi_arm_state_->armId(arm_index_) << ": " << error);
+      configured.set_value(false);
+      return;
+    }
+    franka_interface::prefaultStack(realtime_settings_.prefault_stack);
+    ROS_INFO_STREAM("Control loop of " << multi_arm_state_->armId(arm_index_) << ": "
+                    << franka_interface::describeCurrentThread()
+                    << (realtime_settings_.control_priority > 0
+                            ? ""
+                            : " (libfranka switches to the highest SCHED_FIFO priority for motions)")
+                    << ", " << realtime_settings_.prefault_stack << " bytes of stack pre-faulted");
+    configured.set_value(true);
+
+    franka::Robot& robot = *robot_;
+    franka_hw::FrankaHW& franka_control = *franka_control_;
+
+    while (ros::ok()) {
+      ros::Time last_time = ros::Time::now();
+
+      // Wait until controller has been activated or error has been recovered
+      while (!franka_control.controllerActive() || has_error_) {
+        franka_control.update(robot.readOnce());
+        model_cache_->invalidate();
+        applyPendingFrames(robot);
+
+        ros::Time now = ros::Time::now();
+        writeMultiArmState(now);
+        control_manager_->update(now, now - last_time);
+        motion_controller_interface_.cycleFinished();
+        last_time = now;
+
+        if (!ros::ok()) {
+          return;
         }
-      },
-      false);
-
-  franka::Model model = robot.loadModel();
-  auto get_rate_limiting = [&]() {
-    node_handle.getParamCached("rate_limiting", rate_limiting);
-    return rate_limiting;
-  };
-  auto get_internal_controller = [&]() {
-    node_handle.getParamCached("internal_controller", internal_controller);
-
-    franka::ControllerMode controller_mode;
-    if (internal_controller == "joint_impedance") {
-      controller_mode = franka::ControllerMode::kJointImpedance;
-    } else if (internal_controller == "cartesian_impedance") {
-      controller_mode = franka::ControllerMode::kCartesianImpedance;
-    } else {
-      ROS_WARN("Invalid internal_controller parameter provided, falling back to joint impedance");
-      controller_mode = franka::ControllerMode::kJointImpedance;
-    }
-
-    return controller_mode;
-  };
-  auto get_cutoff_frequency = [&]() {
-    node_handle.getParamCached("cutoff_frequency", cutoff_frequency);
-    return cutoff_frequency;
-  };
-  franka_hw::FrankaHW franka_control(joint_names, arm_id, urdf_model, model, get_rate_limiting,
-                                     get_cutoff_frequency, get_internal_controller);
-
-  // Initialize robot state before loading any controller
-  franka_control.update(robot.readOnce());
-
-  boost::shared_ptr<controller_manager::ControllerManager> control_manager;
-
-  control_manager.reset(new controller_manager::ControllerManager(&franka_control, public_node_handle)); 
+      }
 
-  franka_interface::MotionControllerInterface motion_controller_interface_;
-  motion_controller_interface_.init(public_node_handle, control_manager);
+      try {
+        // Run control loop. Will exit if the controller is switched.
+        franka_control.control(robot, [&](const ros::Time& now, const ros::Duration& period) {
+          control_loop_monitor_.cycleStarted(period);
+          model_cache_->invalidate();
+          writeMultiArmState(now);
+          if (period.toSec() == 0.0) {
+            // Reset controllers before starting a motion
+            control_manager_->update(now, period, true);
+            franka_control.reset();
+          } else {
+            control_manager_->update(now, period);
+            franka_control.enforceLimits(period);
+          }
+          motion_controller_interface_.cycleFinished();
+          control_loop_monitor_.cycleFinished();
+          return ros::ok();
+        });
+      } catch (const franka::ControlException& e) {
+        ROS_ERROR("%s", e.what());
+        has_error_ = true;
+      }
+    }
+  }
 
-  recovery_action_server.start();
+  // Pauses the motion controllers and has the control loop apply the requested frames and
+  // payload between two of its cycles, so that no motion starts before all of them are set.
+  bool setFramesCallback(franka_core_msgs::SetFrames::Request& request,
+                         franka_core_msgs::SetFrames::Response& response) {
+    auto apply = [this, &request](std::string& error) {
+      std::unique_lock<std::mutex> lock(frames_mutex_);
+      pending_frames_ = &request;
+      frames_error_.clear();
+      if (!frames_applied_.wait_for(lock, std::chrono::seconds(1),
+                                    [this]() { return pending_frames_ == nullptr; })) {
+        pending_frames_ = nullptr;
+        error = "the control loop did not apply the frames within 1 s";
+        return false;
+      }
+      error = frames_error_;
+      return error.empty();
+    };
+    std::string error;
+    response.success = motion_controller_interface_.pauseMotionControllersAndDo(apply, error);
+    response.message = response.success ? "frames set" : error;
+    return true;
+  }
 
-  // Start background threads for message handling
-  ros::AsyncSpinner spinner(4);
-  spinner.start();
+  // Applies the set_frames request waiting in pending_frames_, if any. Called by the control
+  // loop between motions only; does not wait for a request being handed over.
+  void applyPendingFrames(franka::Robot& robot) {
+    std::unique_lock<std::mutex> lock(frames_mutex_, std::try_to_lock);
+    if (!lock.owns_lock() || pending_frames_ == nullptr) {
+      return;
+    }
+    const franka_core_msgs::SetFrames::Request& frames = *pending_frames_;
+    const char* step = "end effector frame";
+    try {
+      if (frames.set_EE_frame) {
+        robot.setEE(toArray<16>(frames.F_T_EE));
+      }
+      step = "stiffness frame";
+      if (frames.set_K_frame) {
+        robot.setK(toArray<16>(frames.EE_T_K));
+      }
+      step = "payload";
+      if (frames.set_load) {
+        robot.setLoad(frames.mass, toArray<3>(frames.F_x_center_load),
+                      toArray<9>(frames.load_inertia));
+      }
+    } catch (const franka::Exception& ex) {
+      frames_error_ = std::string("failed to set the ") + step + ": " + ex.what();
+      ROS_ERROR_STREAM("set_frames of " << multi_arm_state_->armId(arm_index_) << ": "
+                       << frames_error_);
+    }
+    pending_frames_ = nullptr;
+    frames_applied_.notify_all();
+  }
 
-  while (ros::ok()) {
-    ros::Time last_time = ros::Time::now();
+  // Calls the command callbacks of the controllers of the arm, one at a time and in order.
+  void serveCommands() {
+    std::string error;
+    if (!franka_interface::configureCurrentThread(realtime_settings_.command_priority,
+                                                  realtime_settings_.command_cpus, error)) {
+      ROS_WARN_STREAM("Command callbacks of " << multi_arm_state_->armId(arm_index_) << ": "
+                      << error);
+    }
+    ROS_INFO_STREAM("Command callbacks of " << multi_arm_state_->armId(arm_index_) << ": "
+                    << franka_interface::describeCurrentThread());
+    while (ros::ok()) {
+      command_queue_.callAvailable(ros::WallDuration(0.1));
+    }
+  }
 
-    // Wait until controller has been activated or error has been recovered
-    while (!franka_control.controllerActive() || has_error) {
-      franka_control.update(robot.readOnce());
+  void writeMultiArmState(const ros::Time& now) {
+    franka_interface::toSharedRobotState(franka_state_handle_->getRobotState(), now.toSec(),
+                                         shared_state_);
+    multi_arm_state_->write(arm_index_, shared_state_);
+  }
 
-      ros::Time now = ros::Time::now();
-      control_manager->update(now, now - last_time);
-      last_time = now;
+  ros::NodeHandle node_handle_;
+  ros::NodeHandle private_node_handle_;
+  size_t arm_index_;
+  std::shared_ptr<franka_interface::MultiArmState> multi_arm_state_;
+  // declared before everything subscribing to it
+  franka_interface::MonitoredCallbackQueue command_queue_;
+
+  bool rate_limiting_{false};
+  double cutoff_frequency_{0.0};
+  std::string internal_controller_;
+  franka_interface::RealtimeSettings realtime_settings_;
+  std::atomic_bool has_error_{false};
+
+  urdf::Model urdf_model_;
+  std::unique_ptr<franka::Robot> robot_;
+  std::unique_ptr<franka::Model> model_;
+  ServiceContainer services_;
+  ros::ServiceServer set_frames_service_;
+  // request of set_frames handed to the control loop, and its outcome; guarded by frames_mutex_
+  std::mutex frames_mutex_;
+  std::condition_variable frames_applied_;
+  const franka_core_msgs::SetFrames::Request* pending_frames_{nullptr};
+  std::string frames_error_;
+  std::unique_ptr<actionlib::SimpleActionServer<franka_control::ErrorRecoveryAction>>
+      recovery_action_server_;
+  std::unique_ptr<franka_hw::FrankaHW> franka_control_;
+  std::unique_ptr<franka_hw::FrankaStateHandle> franka_state_handle_;
+  std::shared_ptr<franka_interface::FrankaModelCache> model_cache_;
+  franka_interface::FrankaModelCacheInterface model_cache_interface_;
+  franka_interface::MultiArmStateInterface multi_arm_state_interface_;
+  franka_interface::SharedRobotState shared_state_;
+  boost::shared_ptr<controller_manager::ControllerManager> control_manager_;
+  franka_interface::MotionControllerInterface motion_controller_interface_;
+  franka_interface::ControlLoopMonitor control_loop_monitor_;
+  franka_interface::MotionPrimitiveServer motion_primitive_server_;
+  std::thread thread_;
+  std::thread command_thread_;
+};
 
-      if (!ros::ok()) {
-        return 0;
-      }
-    }
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "custom_franka_control_node");
+  franka_interface::StartupTimer startup_timer;
+  // Services, actions, dynamic_reconfigure and parameter topics of all arms (including those of
+  // the controllers) go to the background queue, served by a pool of threads; the command topics
+  // of each arm have a queue and a thread of their own (ArmControl).
+  franka_interface::MonitoredCallbackQueue background_queue("background");
+  ros::NodeHandle public_node_handle;
+  public_node_handle.setCallbackQueue(&background_queue);
+  ros::NodeHandle node_handle("~");
+  node_handle.setCallbackQueue(&background_queue);
+
+  // A single arm uses the global names. Several arms (~arms: [left, right]) each have their
+  // robot_config, controllers and topics in their own namespace (/left, /right) and their
+  // robot_ip and cpu_core in ~left and ~right.
+  std::vector<std::string> arms;
+  node_handle.getParam("arms", arms);
+  if (arms.size() > franka_interface::MultiArmState::kMaxArms) {
+    ROS_ERROR("At most %zu arms are supported", franka_interface::MultiArmState::kMaxArms);
+    return 1;
+  }
+  std::vector<std::pair<ros::NodeHandle, ros::NodeHandle>> arm_node_handles;
+  if (arms.empty()) {
+    arm_node_handles.emplace_back(public_node_handle, node_handle);
+  }
+  for (const std::string& arm : arms) {
+    arm_node_handles.emplace_back(ros::NodeHandle(public_node_handle, arm),
+                                  ros::NodeHandle(node_handle, arm));
+  }
 
-    try {
-      // Run control loop. Will exit if the controller is switched.
-      franka_control.control(robot, [&](const ros::Time& now, const ros::Duration& period) {
-        if (period.toSec() == 0.0) {
-          // Reset controllers before starting a motion
-          control_manager->update(now, period, true);
-          franka_control.reset();
-        } else {
-          control_manager->update(now, period);
-          franka_control.enforceLimits(period);
-        }
-        return ros::ok();
-      });
-    } catch (const franka::ControlException& e) {
-      ROS_ERROR("%s", e.what());
-      has_error = true;
+  std::vector<std::string> arm_ids;
+  for (auto& arm_node_handle : arm_node_handles) {
+    std::string arm_id;
+    if (!arm_node_handle.first.getParam("robot_config/arm_id", arm_id)) {
+      ROS_ERROR("Invalid or no arm_id parameter provided");
+      return 1;
+    }
+    if (std::find(arm_ids.cbegin(), arm_ids.cend(), arm_id) != arm_ids.cend()) {
+      ROS_ERROR("arm_id %s is used by more than one arm", arm_id.c_str());
+      return 1;
     }
+    arm_ids.push_back(arm_id);
+  }
+  auto multi_arm_state = std::make_shared<franka_interface::MultiArmState>(arm_ids);
+
+  std::vector<std::unique_ptr<ArmControl>> arm_controls;
+  for (size_t i = 0; i < arm_node_handles.size(); ++i) {
+    arm_controls.push_back(std::make_unique<ArmControl>(
+        arm_node_handles[i].first, arm_node_handles[i].second, i, multi_arm_state));
+    if (!arm_controls.back()->init()) {
+      return 1;
+    }
+  }
+  startup_timer.phaseFinished(arm_controls.size() > 1 ? "arms" : "arm");
+
+  // The memory and the callback threads are shared by all arms; their settings are those of the
+  // first arm.
+  franka_interface::RealtimeSettings realtime_settings;
+  std::string report;
+  if (!realtime_settings.read(arm_node_handles.front().first, report)) {
+    ROS_ERROR_STREAM("Invalid control_node_config/realtime parameters: " << report);
+    return 1;
+  }
+  if (franka_interface::lockProcessMemory(realtime_settings, report)) {
+    ROS_INFO_STREAM("Control node: " << report);
+  } else {
+    ROS_WARN_STREAM("Control node: " << report);
+  }
+  startup_timer.phaseFinished("memory");
+
+  // libfranka runs a blocking control loop per robot, each paced by its own robot
+  bool started = true;
+  for (auto& arm_control : arm_controls) {
+    started = started && arm_control->start();
+  }
+  if (!started) {
+    ros::shutdown();
+  }
+
+  // Start background threads for message handling. They inherit the affinity of this thread,
+  // the control and command threads have been started before and keep their own.
+  if (!franka_interface::configureCurrentThread(0, realtime_settings.spinner_cpus, report)) {
+    ROS_WARN_STREAM("ROS callback threads: " << report);
+  }
+  const size_t background_threads = realtime_settings.background_threads > 0
+                                        ? realtime_settings.background_threads
+                                        : 4 * arm_controls.size();
+  ROS_INFO_STREAM("ROS callback threads: " << background_threads << " background threads, "
+                  << franka_interface::describeCurrentThread());
+  ros::AsyncSpinner spinner(background_threads, &background_queue);
+  spinner.start();
+  // callbacks of node handles created without one of the above
+  ros::AsyncSpinner global_spinner(1);
+  global_spinner.start();
+
+  franka_interface::CallbackQueueMonitor callback_queue_monitor;
+  callback_queue_monitor.addQueue(background_queue, background_threads);
+  for (auto& arm_control : arm_controls) {
+    callback_queue_monitor.addQueue(arm_control->commandQueue(), 1);
+  }
+  callback_queue_monitor.init(arm_node_handles.front().first);
+  startup_timer.phaseFinished("control loops and spinner");
+  ROS_INFO_STREAM("Control node startup: " << startup_timer.report());
+
+  for (auto& arm_control : arm_controls) {
+    arm_control->join();
   }
 
-  return 0;
+  return started ? 0 : 1;
 }
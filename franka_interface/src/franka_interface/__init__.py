@@ -17,4 +17,6 @@
 from .robot_params import RobotParams
 from .arm import ArmInterface
 from .gripper import GripperInterface
-from .robot_enable import RobotEnable
\ No newline at end of file
+from .robot_enable import RobotEnable
+from .shared_memory import SharedMemoryClient, SharedStateCache
+from .state_recording import StateRecording
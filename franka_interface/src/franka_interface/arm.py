@@ -33,19 +33,23 @@
 
 import enum
 import rospy
+import actionlib
 import warnings
 import quaternion
 import numpy as np
 from copy import deepcopy
-from rospy_message_converter import message_converter
 
-from franka_core_msgs.msg import JointCommand, RobotState, EndPointState, CartImpedanceStiffness, JointImpedanceStiffness, TorqueCmd, JICmd
+from franka_core_msgs.msg import JointCommand, JointCommandChunk, RobotState, EndPointState, CartImpedanceStiffness, JointImpedanceStiffness, TorqueCmd, JICmd
+from franka_core_msgs.msg import JointMotionAction, JointMotionGoal, JointMotionResult
+from franka_msgs.msg import Errors
+from trajectory_msgs.msg import JointTrajectoryPoint
 from sensor_msgs.msg import JointState
 from std_msgs.msg import Float64
 from geometry_msgs.msg import PoseStamped, Wrench
 
 import franka_interface
 import franka_control
+import franka_interface.shared_memory as shared_memory
 import franka_dataflow
 from robot_params import RobotParams
 
@@ -144,12 +148,33 @@ class ArmInterface(object):
         self._cartesian_velocity = dict()
         self._cartesian_effort = dict()
         self._stiffness_frame_effort = dict()
-        self._errors = dict()
+        self._errors_mask = 0
         self._collision_state = False
         self._tip_states = None
         self._jacobian = None
+        self._joint_inertia = None
+        self._gravity = None
+        self._coriolis = None
         self._cartesian_contact = None
 
+        # latest messages; the accessors parse them on first use
+        self._joint_state_msg = None
+        self._parsed_joint_state = None
+        self._robot_state_msg = None
+        self._parsed_robot_state = None
+        self._endpoint_state_msg = None
+        self._parsed_endpoint_state = None
+        self._state_cache_sequence = None
+
+        # with the driver on this machine, joint states and end-effector pose come straight from
+        # its shared memory instead of the topics
+        self._state_cache = None
+        if shared_memory.available():
+            try:
+                self._state_cache = shared_memory.SharedStateCache()
+            except (IOError, OSError, ValueError) as e:
+                rospy.logwarn("ArmInterface: Could not open the shared robot state ({}). Using the state topics.".format(e))
+
         self._robot_mode = False
 
         self._command_msg = JointCommand()
@@ -157,7 +182,7 @@ class ArmInterface(object):
         # neutral pose joint positions
         self._neutral_pose_joints = self._params.get_neutral_pose()
 
-        self._frames_interface = FrankaFramesInterface()
+        self._frames_interface = FrankaFramesInterface(ns = self._ns)
 
         try:
             self._collision_behaviour_interface = CollisionBehaviourInterface()
@@ -168,6 +193,14 @@ class ArmInterface(object):
 
         self._speed_ratio = 0.15
 
+        # joint motions are run and monitored by the driver when it provides the motion primitive
+        # server (not the case e.g. in panda_simulator)
+        self._joint_motion_client = actionlib.SimpleActionClient(
+            self._ns + '/motion_primitives/joint_motion', JointMotionAction)
+        if not self._joint_motion_client.wait_for_server(rospy.Duration(1.0)):
+            rospy.loginfo("ArmInterface: Motion primitive server not found. Joint motions will be monitored by the client.")
+            self._joint_motion_client = None
+
         queue_size = None if synchronous_pub else 1
         with warnings.catch_warnings():
             warnings.simplefilter("ignore")
@@ -176,6 +209,11 @@ class ArmInterface(object):
                 JointCommand,
                 tcp_nodelay=True,
                 queue_size=queue_size)
+            self._joint_command_chunk_publisher = rospy.Publisher(
+                self._ns +'/motion_controller/arm/joint_command_chunks',
+                JointCommandChunk,
+                tcp_nodelay=True,
+                queue_size=10)
 
         self._pub_joint_cmd_timeout = rospy.Publisher(
             self._ns +'/motion_controller/arm/joint_command_timeout',
@@ -191,12 +229,14 @@ class ArmInterface(object):
             tcp_nodelay=True)
 
         joint_state_topic = self._ns + '/custom_franka_state_controller/joint_states'
-        self._joint_state_sub = rospy.Subscriber(
-            joint_state_topic,
-            JointState,
-            self._on_joint_states,
-            queue_size=1,
-            tcp_nodelay=True)
+        self._joint_state_sub = None
+        if self._state_cache is None:
+            self._joint_state_sub = rospy.Subscriber(
+                joint_state_topic,
+                JointState,
+                self._on_joint_states,
+                queue_size=1,
+                tcp_nodelay=True)
 
         self._cartesian_state_sub = rospy.Subscriber(
             self._ns + '/custom_franka_state_controller/tip_state',
@@ -223,17 +263,20 @@ class ArmInterface(object):
 
         err_msg = ("%s arm init failed to get current joint_states "
                    "from %s") % (self.name.capitalize(), joint_state_topic)
-        franka_dataflow.wait_for(lambda: len(self._joint_angle.keys()) > 0,
+        if self._state_cache is not None:
+            err_msg = ("%s arm init failed to get current joint_states "
+                       "from shared memory") % (self.name.capitalize())
+        franka_dataflow.wait_for(lambda: len(self._update_joint_state()[0]) > 0,
                                  timeout_msg=err_msg, timeout=5.0)
 
         err_msg = ("%s arm, init failed to get current tip_state "
                    "from %s") % (self.name.capitalize(), self._ns + 'tip_state')
-        franka_dataflow.wait_for(lambda: len(self._cartesian_pose.keys()) > 0,
+        franka_dataflow.wait_for(lambda: self._endpoint_state_msg is not None,
                                  timeout_msg=err_msg, timeout=5.0)
 
         err_msg = ("%s arm, init failed to get current robot_state "
                    "from %s") % (self.name.capitalize(), self._ns + 'robot_state')
-        franka_dataflow.wait_for(lambda: self._jacobian is not None,
+        franka_dataflow.wait_for(lambda: self._cartesian_contact is not None,
                                  timeout_msg=err_msg, timeout=5.0)
 
         self.set_joint_position_speed(self._speed_ratio)
@@ -252,17 +295,22 @@ class ArmInterface(object):
         return q
 
     def _clean_shutdown(self):
-        self._joint_state_sub.unregister()
+        if self._joint_state_sub is not None:
+            self._joint_state_sub.unregister()
         self._cartesian_state_sub.unregister()
         self._pub_joint_cmd_timeout.unregister()
         self._robot_state_subscriber.unregister()
         self._joint_command_publisher.unregister()
+        self._joint_command_chunk_publisher.unregister()
         self._cartesian_impedance_pose_publisher.unregister()
         self._cartesian_stiffness_publisher.unregister()
         self._force_controller_publisher.unregister()
         self._torque_controller_publisher.unregister()
         self._joint_impedance_publisher.unregister()
         self._joint_stiffness_publisher.unregister()
+        if self._state_cache is not None:
+            self._state_cache.close()
+            self._state_cache = None
 
     def get_robot_params(self):
         """
@@ -289,26 +337,50 @@ class ArmInterface(object):
         """
         return self._joint_names
 
-    def _on_joint_states(self, msg):
+    def state_cache(self):
+        """
+        Return the shared memory state cache, if the driver runs on this machine with shared
+        memory enabled (/robot_config/shared_memory). Its arrays (q, dq, tau, O_T_EE, jacobian,
+        mass_matrix, ...) are views that are refreshed in place by its update() method; the
+        accessors of this class update it as well.
 
-        for idx, name in enumerate(msg.name):
-            if name in self._joint_names:
-                self._joint_angle[name] = msg.position[idx]
-                self._joint_velocity[name] = msg.velocity[idx]
-                self._joint_effort[name] = msg.effort[idx]
+        :rtype: franka_interface.SharedStateCache
+        :return: the cache, or None if the state is received over the state topics
+        """
+        return self._state_cache
+
+    def _on_joint_states(self, msg):
+        self._joint_state_msg = msg
+
+    def _update_joint_state(self):
+        # refreshes the joint state dicts from the state cache or from the latest message
+        if self._state_cache is not None:
+            if self._state_cache.update() and self._state_cache.sequence != self._state_cache_sequence and self._state_cache.sequence > 0:
+                self._state_cache_sequence = self._state_cache.sequence
+                q, dq, tau = self._state_cache.q, self._state_cache.dq, self._state_cache.tau
+                for idx, name in enumerate(self._joint_names):
+                    self._joint_angle[name] = float(q[idx])
+                    self._joint_velocity[name] = float(dq[idx])
+                    self._joint_effort[name] = float(tau[idx])
+        else:
+            msg = self._joint_state_msg
+            if msg is not None and msg is not self._parsed_joint_state:
+                self._parsed_joint_state = msg
+                for idx, name in enumerate(msg.name):
+                    if name in self._joint_names:
+                        self._joint_angle[name] = msg.position[idx]
+                        self._joint_velocity[name] = msg.velocity[idx]
+                        self._joint_effort[name] = msg.effort[idx]
+        return self._joint_angle, self._joint_velocity, self._joint_effort
 
     def _on_robot_state(self, msg):
+        self._robot_state_msg = msg
 
         self._robot_mode = self.RobotMode(msg.robot_mode)
+        self._errors_mask = msg.current_errors_mask
 
         self._robot_mode_ok = (self._robot_mode.value != self.RobotMode.ROBOT_MODE_REFLEX) and (self._robot_mode.value != self.RobotMode.ROBOT_MODE_USER_STOPPED)
 
-        self._jacobian = np.asarray(msg.O_Jac_EE).reshape(6,7,order = 'F')
-
-        self._cartesian_velocity = {
-                'linear': np.asarray([msg.O_dP_EE[0], msg.O_dP_EE[1], msg.O_dP_EE[2]]),
-                'angular': np.asarray([msg.O_dP_EE[3], msg.O_dP_EE[4], msg.O_dP_EE[5]]) }
-
         self._cartesian_contact = msg.cartesian_contact
         self._cartesian_collision = msg.cartesian_collision
 
@@ -317,15 +389,31 @@ class ArmInterface(object):
         if self._frames_interface:
             self._frames_interface._update_frame_data(msg.F_T_EE, msg.EE_T_K)
 
-        self._joint_inertia = np.asarray(msg.mass_matrix).reshape(7,7,order='F')
-
         self.q_d = msg.q_d
         self.dq_d = msg.dq_d
 
-        self._gravity = np.asarray(msg.gravity)
-        self._coriolis = np.asarray(msg.coriolis)
+    def _update_robot_state(self):
+        # parses the latest robot state message, once per message
+        msg = self._robot_state_msg
+        if msg is None or msg is self._parsed_robot_state:
+            return
+        self._parsed_robot_state = msg
 
-        self._errors = message_converter.convert_ros_message_to_dictionary(msg.current_errors)
+        # optional fields are empty when the state controller is configured not to publish them
+        if len(msg.O_Jac_EE) > 0:
+            self._jacobian = np.asarray(msg.O_Jac_EE).reshape(6,7,order = 'F')
+
+        if len(msg.O_dP_EE) > 0:
+            self._cartesian_velocity = {
+                    'linear': np.asarray([msg.O_dP_EE[0], msg.O_dP_EE[1], msg.O_dP_EE[2]]),
+                    'angular': np.asarray([msg.O_dP_EE[3], msg.O_dP_EE[4], msg.O_dP_EE[5]]) }
+
+        if len(msg.mass_matrix) > 0:
+            self._joint_inertia = np.asarray(msg.mass_matrix).reshape(7,7,order='F')
+
+        if len(msg.gravity) > 0:
+            self._gravity = np.asarray(msg.gravity)
+            self._coriolis = np.asarray(msg.coriolis)
 
     def coriolis_comp(self):
         """
@@ -335,6 +423,7 @@ class ArmInterface(object):
         :rtype: np.ndarray
         :return: 7D joint torques compensating for coriolis.
         """
+        self._update_robot_state()
         return self._coriolis
         
     def gravity_comp(self):
@@ -344,6 +433,7 @@ class ArmInterface(object):
         :rtype: np.ndarray
         :return: 7D joint torques compensating for gravity.
         """
+        self._update_robot_state()
         return self._gravity
 
     def get_robot_status(self):
@@ -353,7 +443,9 @@ class ArmInterface(object):
         :rtype: dict
         :return: ['robot_mode' (RobotMode object), 'robot_status' (bool), 'errors' (dict() of errors and their truth value), 'error_in_curr_status' (bool)]
         """
-        return {'robot_mode': self._robot_mode, 'robot_status': self._robot_mode_ok, 'errors': self._errors, 'error_in_current_state' : self.error_in_current_state()}
+        mask = self._errors_mask
+        errors = {name: bool(mask >> bit & 1) for bit, name in enumerate(Errors.__slots__)}
+        return {'robot_mode': self._robot_mode, 'robot_status': self._robot_mode_ok, 'errors': errors, 'error_in_current_state' : mask != 0}
 
     def in_safe_state(self):
         """
@@ -371,7 +463,7 @@ class ArmInterface(object):
         :rtype: bool
         :return: True if the arm has error, False otherwise.
         """
-        return not all([e == False for e in self._errors.values()])
+        return self._errors_mask != 0
 
     def what_errors(self):
         """
@@ -380,26 +472,44 @@ class ArmInterface(object):
         :rtype: [str]
         :return: list of names of current errors in robot state
         """
-        return [e for e in self._errors if self._errors[e] == True] if self.error_in_current_state() else None
+        mask = self._errors_mask
+        if not mask:
+            return None
+        # bit i of the mask is the i-th field of franka_msgs/Errors
+        return [name for bit, name in enumerate(Errors.__slots__) if mask >> bit & 1]
 
 
     def _on_endpoint_state(self, msg):
-
-        cart_pose_trans_mat = np.asarray(msg.O_T_EE).reshape(4,4,order='F')
-
-        self._cartesian_pose = {
-            'position': cart_pose_trans_mat[:3,3],
-            'orientation': quaternion.from_rotation_matrix(cart_pose_trans_mat[:3,:3]) }
-
-        self._cartesian_effort = {
-            'force': np.asarray([ msg.O_F_ext_hat_K.wrench.force.x,
-                                  msg.O_F_ext_hat_K.wrench.force.y,
-                                  msg.O_F_ext_hat_K.wrench.force.z]),
-
-            'torque': np.asarray([ msg.O_F_ext_hat_K.wrench.torque.x,
-                                   msg.O_F_ext_hat_K.wrench.torque.y,
-                                   msg.O_F_ext_hat_K.wrench.torque.z])
-        }
+        self._endpoint_state_msg = msg
+
+    def _update_endpoint_state(self):
+        # parses the latest tip state message once; pose and external wrench are taken from the
+        # state cache instead, when there is one
+        if self._state_cache is not None:
+            self._state_cache.update()
+            self._set_cartesian_pose(self._state_cache.O_T_EE)
+            wrench = self._state_cache.O_F_ext_hat_K
+            self._cartesian_effort = {
+                'force': np.array(wrench[:3]),
+                'torque': np.array(wrench[3:]) }
+
+        msg = self._endpoint_state_msg
+        if msg is None or msg is self._parsed_endpoint_state:
+            return
+        self._parsed_endpoint_state = msg
+
+        if self._state_cache is None:
+            self._set_cartesian_pose(np.asarray(msg.O_T_EE).reshape(4,4,order='F'))
+
+            self._cartesian_effort = {
+                'force': np.asarray([ msg.O_F_ext_hat_K.wrench.force.x,
+                                      msg.O_F_ext_hat_K.wrench.force.y,
+                                      msg.O_F_ext_hat_K.wrench.force.z]),
+
+                'torque': np.asarray([ msg.O_F_ext_hat_K.wrench.torque.x,
+                                       msg.O_F_ext_hat_K.wrench.torque.y,
+                                       msg.O_F_ext_hat_K.wrench.torque.z])
+            }
 
         self._stiffness_frame_effort = {
             'force': np.asarray([ msg.K_F_ext_hat_K.wrench.force.x,
@@ -411,9 +521,12 @@ class ArmInterface(object):
                                    msg.K_F_ext_hat_K.wrench.torque.z])
         }
 
-        self._tip_states = TipState(msg.header.stamp, deepcopy(self._cartesian_pose), deepcopy(self._cartesian_velocity), deepcopy(self._cartesian_effort), deepcopy(self._stiffness_frame_effort))
-
+        self._tip_states = None
 
+    def _set_cartesian_pose(self, cart_pose_trans_mat):
+        self._cartesian_pose = {
+            'position': np.array(cart_pose_trans_mat[:3,3]),
+            'orientation': quaternion.from_rotation_matrix(cart_pose_trans_mat[:3,:3]) }
 
     def joint_angle(self, joint):
         """
@@ -424,7 +537,7 @@ class ArmInterface(object):
         :rtype: float
         :return: angle in radians of individual joint
         """
-        return self._joint_angle[joint]
+        return self._update_joint_state()[0][joint]
 
     def joint_angles(self):
         """
@@ -433,7 +546,7 @@ class ArmInterface(object):
         :rtype: dict({str:float})
         :return: unordered dict of joint name Keys to angle (rad) Values
         """
-        return deepcopy(self._joint_angle)
+        return deepcopy(self._update_joint_state()[0])
 
     def joint_ordered_angles(self):
         """
@@ -442,7 +555,8 @@ class ArmInterface(object):
         :rtype: [float]
         :return: joint angles (rad) orded by joint_names from proximal to distal (i.e. shoulder to wrist).
         """
-        return [self._joint_angle[name] for name in self._joint_names]
+        joint_angle = self._update_joint_state()[0]
+        return [joint_angle[name] for name in self._joint_names]
 
     def joint_velocity(self, joint):
         """
@@ -453,7 +567,7 @@ class ArmInterface(object):
         :rtype: float
         :return: velocity in radians/s of individual joint
         """
-        return self._joint_velocity[joint]
+        return self._update_joint_state()[1][joint]
 
     def joint_velocities(self):
         """
@@ -462,7 +576,7 @@ class ArmInterface(object):
         :rtype: dict({str:float})
         :return: unordered dict of joint name Keys to velocity (rad/s) Values
         """
-        return deepcopy(self._joint_velocity)
+        return deepcopy(self._update_joint_state()[1])
 
     def joint_effort(self, joint):
         """
@@ -473,7 +587,7 @@ class ArmInterface(object):
         :rtype: float
         :return: effort in Nm of individual joint
         """
-        return self._joint_effort[joint]
+        return self._update_joint_state()[2][joint]
 
     def joint_efforts(self):
         """
@@ -482,7 +596,7 @@ class ArmInterface(object):
         :rtype: dict({str:float})
         :return: unordered dict of joint name Keys to effort (Nm) Values
         """
-        return deepcopy(self._joint_effort)
+        return deepcopy(self._update_joint_state()[2])
 
     def endpoint_pose(self):
         """
@@ -495,6 +609,7 @@ class ArmInterface(object):
           - 'orientation': quaternion x,y,z,w in quaternion format
 
         """
+        self._update_endpoint_state()
         return deepcopy(self._cartesian_pose)
 
     def endpoint_velocity(self):
@@ -507,6 +622,7 @@ class ArmInterface(object):
           - 'linear': np.array of x, y, z
           - 'angular': np.array of x, y, z (angular velocity along the axes)
         """
+        self._update_robot_state()
         return deepcopy(self._cartesian_velocity)
 
     def endpoint_effort(self):
@@ -519,14 +635,14 @@ class ArmInterface(object):
           - 'force': Cartesian force on x,y,z axes in np.ndarray format
           - 'torque': Torque around x,y,z axes in np.ndarray format
         """
+        self._update_endpoint_state()
         return deepcopy(self._cartesian_effort)
 
     def exit_control_mode(self, timeout=0.2):
         """
         Clean exit from advanced control modes (joint torque or velocity).
-        Resets control to joint position mode with current positions if the 
-        advanced control commands are not send within the specified timeout
-        interval.
+        Sets the command timeout of the advanced controllers and resets control
+        to joint position mode with the current positions.
 
         :type timeout: float
         :param timeout: control timeout in seconds [default: 0.2]
@@ -541,6 +657,11 @@ class ArmInterface(object):
         :rtype: TipState object
         :return: pose, velocity, effort, effort_in_K_frame
         """
+        self._update_robot_state()
+        self._update_endpoint_state()
+        if self._tip_states is None or self._state_cache is not None:
+            stamp = rospy.Time.from_sec(self._state_cache.time) if self._state_cache is not None else self._endpoint_state_msg.header.stamp
+            self._tip_states = TipState(stamp, deepcopy(self._cartesian_pose), deepcopy(self._cartesian_velocity), deepcopy(self._cartesian_effort), deepcopy(self._stiffness_frame_effort))
         return deepcopy(self._tip_states)
         
     def joint_inertia_matrix(self):
@@ -549,6 +670,10 @@ class ArmInterface(object):
         :return: joint inertia matrix (7,7)
         :rtype: np.ndarray [7x7]
         """
+        self._update_robot_state()
+        if self._state_cache is not None and self._joint_inertia is not None:
+            self._state_cache.update()
+            return self._state_cache.mass_matrix.copy()
         return deepcopy(self._joint_inertia)
 
     def zero_jacobian(self):
@@ -556,14 +681,22 @@ class ArmInterface(object):
         :return: end-effector jacobian (6,7)
         :rtype: np.ndarray [6x7]
         """
-        return deepcopy(self._jacobian)        
+        self._update_robot_state()
+        if self._state_cache is not None and self._jacobian is not None:
+            self._state_cache.update()
+            return self._state_cache.jacobian.copy()
+        return deepcopy(self._jacobian)
 
     def set_command_timeout(self, timeout):
         """
-        Set the timeout in seconds for the joint controller
+        Set the command timeout in seconds for the joint velocity, torque and
+        impedance controllers. If no command arrives within the timeout, the
+        running controller stops the robot (velocity), falls back to gravity
+        compensation (torque) or holds the last target (impedance) within one
+        control cycle. 0 disables the timeout.
 
         :type timeout: float
-        :param timeout: timeout in seconds
+        :param timeout: timeout in seconds (clipped to [0.0-1.0])
         """
         self._pub_joint_cmd_timeout.publish(Float64(timeout))
 
@@ -646,6 +779,41 @@ class ArmInterface(object):
         self._command_msg.header.stamp = rospy.Time.now()
         self._joint_command_publisher.publish(self._command_msg)
 
+    def set_joint_trajectory_chunk(self, positions, times, velocities=None, accelerations=None, quintic=True, start_new=False):
+        """
+        Streams a chunk of joint setpoints to the effort joint impedance or effort joint position 
+        controller, which interpolate between them at control rate. This allows sending 
+        trajectories at a much lower rate than the control loop without losing any setpoints.
+
+        :type positions: [[float]]
+        :param positions: desired joint positions of each point, each an ordered list corresponding to joints given by self.joint_names()
+        :type times: [float]
+        :param times: strictly increasing time (in seconds) at which each point is to be reached, relative to 
+            now if start_new is True, else relative to the last point already queued (or to now if none is queued)
+        :type velocities: [[float]] or None
+        :param velocities: desired joint velocities of each point; estimated by the controller if None
+        :type accelerations: [[float]] or None
+        :param accelerations: desired joint accelerations of each point (quintic only); zero if None
+        :type quintic: bool
+        :param quintic: use quintic instead of cubic interpolation between the points
+        :type start_new: bool
+        :param start_new: drop the points still queued in the controller and start a new trajectory
+        """
+        msg = JointCommandChunk()
+        if start_new:
+            msg.header.stamp = rospy.Time.now()
+        msg.interpolation = JointCommandChunk.QUINTIC if quintic else JointCommandChunk.CUBIC
+        for i in range(len(positions)):
+            point = JointTrajectoryPoint()
+            point.positions = positions[i]
+            if velocities is not None:
+                point.velocities = velocities[i]
+            if accelerations is not None:
+                point.accelerations = accelerations[i]
+            point.time_from_start = rospy.Duration(times[i])
+            msg.points.append(point)
+        self._joint_command_chunk_publisher.publish(msg)
+
 
     def has_collided(self):
         """
@@ -656,6 +824,10 @@ class ArmInterface(object):
         
 
     def switchToController(self, controller_name):
+        if self._ctrl_manager.has_switch_to_service():
+            self._ctrl_manager.switch_to(controller_name)
+            return
+
         active_controllers = self._ctrl_manager.list_active_controllers(only_motion_controllers = True)
         for ctrlr in active_controllers:
             self._ctrl_manager.stop_controller(ctrlr.name)
@@ -682,9 +854,44 @@ class ArmInterface(object):
 
     def genf(self, joint, angle):
         def joint_diff():
-            return abs(angle - self._joint_angle[joint])
+            return abs(angle - self.joint_angle(joint))
         return joint_diff
 
+    def _run_joint_motion(self, waypoints, speed_ratio, threshold, timeout, stop_condition,
+                          recover_from_reflex=False, test=None):
+        """
+        Runs a joint motion on the motion primitive server of the driver and waits for its result.
+
+        :param waypoints: joint_name:angle dicts to move through; the driver computes the
+            minimum-time trajectory through them within speed_ratio of the joint limits
+        :param stop_condition: franka_core_msgs.msg.JointMotionGoal.STOP_ON_COLLISION, STOP_ON_CONTACT or IGNORE_CONTACT
+        :param test: optional function returning True if motion must be aborted
+        :rtype: franka_core_msgs.msg.JointMotionResult
+        :return: the result, None if the motion was aborted by test or ROS shut down
+        """
+        goal = JointMotionGoal()
+        for q in waypoints:
+            point = JointTrajectoryPoint()
+            point.positions = [q[n] for n in self._joint_names]
+            goal.waypoints.append(point)
+        goal.speed_ratio = speed_ratio
+        goal.position_tolerance = threshold
+        goal.timeout = timeout
+        goal.stop_condition = stop_condition
+        goal.recover_from_reflex = recover_from_reflex
+
+        self._joint_motion_client.send_goal(goal)
+        if callable(test):
+            while not self._joint_motion_client.wait_for_result(rospy.Duration(0.01)):
+                if rospy.is_shutdown():
+                    return None
+                if test() == True:
+                    self._joint_motion_client.cancel_goal()
+                    return None
+        elif not self._joint_motion_client.wait_for_result():
+            return None
+        return self._joint_motion_client.get_result()
+
     def move_to_joint_positions(self, positions, timeout=10.0,
                                 threshold=0.00085, test=None):
         """
@@ -704,6 +911,14 @@ class ArmInterface(object):
          move is considered successful [0.00085]
         :param test: optional function returning True if motion must be aborted
         """
+        if self._joint_motion_client is not None:
+            res = self._run_joint_motion([positions], self._speed_ratio, threshold, timeout,
+                                         JointMotionGoal.STOP_ON_COLLISION, test = test)
+            if res is not None and res.error_code != JointMotionResult.SUCCEEDED:
+                rospy.logerr("ArmInterface: {0} limb failed to reach commanded joint positions: {1}".format(
+                             self.name.capitalize(), res.error_string))
+            rospy.loginfo("ArmInterface: Trajectory controlling complete")
+            return
 
         if self._ctrl_manager.current_controller != self._ctrl_manager.joint_trajectory_controller:  
             self.switchToController(self._ctrl_manager.joint_trajectory_controller)
@@ -714,10 +929,10 @@ class ArmInterface(object):
 
         dur = []
         for j in range(len(self._joint_names)):
-            dur.append(max(abs(positions[self._joint_names[j]] - self._joint_angle[self._joint_names[j]]) / self._joint_limits.velocity[j], min_traj_dur))
+            dur.append(max(abs(positions[self._joint_names[j]] - self.joint_angle(self._joint_names[j])) / self._joint_limits.velocity[j], min_traj_dur))
         traj_client.add_point(positions = [positions[n] for n in self._joint_names], time = max(dur)/self._speed_ratio)
 
-        diffs = [self.genf(j, a) for j, a in positions.items() if j in self._joint_angle]
+        diffs = [self.genf(j, a) for j, a in positions.items() if j in self._joint_names]
 
         traj_client.start() # send the trajectory action request
         fail_msg = "ArmInterface: {0} limb failed to reach commanded joint positions.".format(
@@ -767,6 +982,16 @@ class ArmInterface(object):
         if diff_from_start > 0.1:
             raise IOError("Robot not at start of trajectory")
 
+        if self._joint_motion_client is not None:
+            # the robot is already at the first waypoint
+            res = self._run_joint_motion(position_path[1:], self._speed_ratio, threshold, timeout,
+                                         JointMotionGoal.STOP_ON_COLLISION, test = test)
+            if res is not None and res.error_code != JointMotionResult.SUCCEEDED:
+                rospy.logerr("ArmInterface: {0} limb failed to reach commanded joint positions: {1}".format(
+                             self.name.capitalize(), res.error_string))
+            rospy.loginfo("ArmInterface: Trajectory controlling complete")
+            return
+
         if self._ctrl_manager.current_controller != self._ctrl_manager.joint_trajectory_controller: 
             self.switchToController(self._ctrl_manager.joint_trajectory_controller)
         
@@ -780,12 +1005,12 @@ class ArmInterface(object):
             q = position_path[i]
             dur = []
             for j in range(len(self._joint_names)):
-                dur.append(max(abs(q[self._joint_names[j]] - self._joint_angle[self._joint_names[j]]) / self._joint_limits.velocity[j], min_traj_dur))
+                dur.append(max(abs(q[self._joint_names[j]] - self.joint_angle(self._joint_names[j])) / self._joint_limits.velocity[j], min_traj_dur))
 
             time_so_far += max(dur)/self._speed_ratio
             traj_client.add_point(positions = [q[n] for n in self._joint_names], time = time_so_far, velocities=[0.005 for n in self._joint_names])
 
-        diffs = [self.genf(j, a) for j, a in (position_path[-1]).items() if j in self._joint_angle] # Measures diff to last waypoint
+        diffs = [self.genf(j, a) for j, a in (position_path[-1]).items() if j in self._joint_names] # Measures diff to last waypoint
 
         fail_msg = "ArmInterface: {0} limb failed to reach commanded joint positions.".format(
                                                       self.name.capitalize())
@@ -828,6 +1053,21 @@ class ArmInterface(object):
         move is considered successful [0.008726646]
         @param test: optional function returning True if motion must be aborted
         """
+        speed_ratio = 0.05 # Move slower when approaching contact
+
+        if self._joint_motion_client is not None:
+            # the server stops at the first contact and recovers from the reflex it causes
+            res = self._run_joint_motion([positions], speed_ratio, threshold, timeout,
+                                         JointMotionGoal.STOP_ON_CONTACT, recover_from_reflex = True)
+            if res is None or not res.collision:
+                rospy.logerr('Move To Touch did not end in making contact')
+            else:
+                rospy.loginfo('Collision detected!')
+                if res.error_code != JointMotionResult.SUCCEEDED:
+                    rospy.logerr("ArmInterface: {}".format(res.error_string))
+            rospy.loginfo("ArmInterface: Trajectory controlling complete")
+            return
+
         if self._ctrl_manager.current_controller != self._ctrl_manager.joint_trajectory_controller: 
             self.switchToController(self._ctrl_manager.joint_trajectory_controller)
         
@@ -835,13 +1075,12 @@ class ArmInterface(object):
         traj_client = JointTrajectoryActionClient(joint_names = self.joint_names())
         traj_client.clear()
 
-        speed_ratio = 0.05 # Move slower when approaching contact
         dur = []
         for j in range(len(self._joint_names)):
-            dur.append(max(abs(positions[self._joint_names[j]] - self._joint_angle[self._joint_names[j]]) / self._joint_limits.velocity[j], min_traj_dur))
+            dur.append(max(abs(positions[self._joint_names[j]] - self.joint_angle(self._joint_names[j])) / self._joint_limits.velocity[j], min_traj_dur))
         traj_client.add_point(positions = [positions[n] for n in self._joint_names], time = max(dur)/speed_ratio, velocities=[0.002 for n in self._joint_names])
 
-        diffs = [self.genf(j, a) for j, a in positions.items() if j in self._joint_angle]
+        diffs = [self.genf(j, a) for j, a in positions.items() if j in self._joint_names]
         fail_msg = "ArmInterface: {0} limb failed to reach commanded joint positions.".format(
                                                       self.name.capitalize()) 
  
@@ -894,6 +1133,14 @@ class ArmInterface(object):
         move is considered successful [0.008726646]
         @param test: optional function returning True if motion must be aborted
         """
+        if self._joint_motion_client is not None:
+            res = self._run_joint_motion([positions], self._speed_ratio, threshold, timeout,
+                                         JointMotionGoal.IGNORE_CONTACT)
+            if res is not None and res.error_code != JointMotionResult.SUCCEEDED:
+                rospy.logerr("ArmInterface: Unable to complete plan: {}".format(res.error_string))
+            rospy.loginfo("ArmInterface: Trajectory controlling complete")
+            return
+
         if self._ctrl_manager.current_controller != self._ctrl_manager.joint_trajectory_controller: 
             self.switchToController(self._ctrl_manager.joint_trajectory_controller)
         
@@ -903,10 +1150,10 @@ class ArmInterface(object):
 
         dur = []
         for j in range(len(self._joint_names)):
-            dur.append(max(abs(positions[self._joint_names[j]] - self._joint_angle[self._joint_names[j]]) / self._joint_limits.velocity[j], min_traj_dur))
+            dur.append(max(abs(positions[self._joint_names[j]] - self.joint_angle(self._joint_names[j])) / self._joint_limits.velocity[j], min_traj_dur))
         traj_client.add_point(positions = [positions[n] for n in self._joint_names], time = max(dur)/self._speed_ratio)
 
-        diffs = [self.genf(j, a) for j, a in positions.items() if j in self._joint_angle]
+        diffs = [self.genf(j, a) for j, a in positions.items() if j in self._joint_names]
         fail_msg = "ArmInterface: {0} limb failed to reach commanded joint positions.".format(
                                                       self.name.capitalize()) 
  
@@ -1040,6 +1287,37 @@ class ArmInterface(object):
 
         return retval
 
+    def _change_frames(self, func, *args, **kwargs):
+        """
+        Calls func of the frames interface, stopping the motion controllers around it
+        (:py:meth:`pause_controllers_and_do`) unless the control node provides the set_frames
+        service, which pauses them itself.
+        """
+        if self._frames_interface.has_set_frames_service():
+            return func(*args, **kwargs)
+        return self.pause_controllers_and_do(func, *args, **kwargs)
+
+    def set_frames(self, EE_frame = None, K_frame = None, load = None):
+        """
+        Set any of the EE frame, the K frame and the load in one request
+        (see :py:meth:`franka_tools.FrankaFramesInterface.set_frames`).
+        Motion controllers are stopped for switching
+
+        :type EE_frame: [float (16,)] / np.ndarray (4x4)
+        :param EE_frame: transformation matrix of new EE frame wrt flange frame (column major); None to keep the current one
+        :type K_frame: [float (16,)] / np.ndarray (4x4)
+        :param K_frame: transformation matrix of new K frame wrt EE frame (column major); None to keep the current one
+        :type load: (float, [float (3,)], [float (9,)] / np.ndarray (3x3))
+        :param load: mass [kg], center of mass in the flange frame [m] and inertia [kg m^2] of the load; None to keep the current one
+        :rtype: bool
+        :return: success status of service request
+        """
+        if self._frames_interface:
+            return self._change_frames(self._frames_interface.set_frames, EE_frame = EE_frame, K_frame = K_frame, load = load)
+        else:
+            rospy.logwarn("ArmInterface: Frames changing not available in simulated environment")
+            return False
+
     def reset_EE_frame(self):
         """
         Reset EE frame to default. (defined by 
@@ -1056,7 +1334,7 @@ class ArmInterface(object):
                 rospy.loginfo("ArmInterface: EE Frame already reset")
                 return
 
-            return self.pause_controllers_and_do(self._frames_interface.reset_EE_frame)
+            return self._change_frames(self._frames_interface.reset_EE_frame)
 
         else:
             rospy.logwarn("ArmInterface: Frames changing not available in simulated environment")
@@ -1080,7 +1358,7 @@ class ArmInterface(object):
                 rospy.loginfo("ArmInterface: EE Frame already at the target frame.")
                 return True
 
-            return self.pause_controllers_and_do(self._frames_interface.set_EE_frame,frame)
+            return self._change_frames(self._frames_interface.set_EE_frame,frame)
 
         else:
             rospy.logwarn("ArmInterface: Frames changing not available in simulated environment")
@@ -1099,7 +1377,7 @@ class ArmInterface(object):
             retval = True
             if not self._frames_interface.EE_frame_already_set(self._frames_interface.get_link_tf(frame_name)):
 
-                return self.pause_controllers_and_do(self._frames_interface.set_EE_frame_to_link,frame_name = frame_name, timeout = timeout)
+                return self._change_frames(self._frames_interface.set_EE_frame_to_link,frame_name = frame_name, timeout = timeout)
 
         else:
             rospy.logwarn("ArmInterface: Frames changing not available in simulated environment")
@@ -0,0 +1,354 @@
+# /***************************************************************************
+
+#
+# @package: franka_interface
+# @metapackage: franka_ros_interface
+# @author: Saif Sidhik <sxs1412@bham.ac.uk>
+#
+
+# **************************************************************************/
+
+# /***************************************************************************
+# Copyright (c) 2019-2020, Saif Sidhik
+
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+
+#     http://www.apache.org/licenses/LICENSE-2.0
+
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# **************************************************************************/
+
+"""
+ @info:
+       Client for the shared memory state and command transport of the driver
+       (franka_interface/shared_memory_transport.h). Lets processes on the robot
+       computer read the 1 kHz robot state and send joint commands without going
+       through ROS serialisation.
+
+"""
+
+import os
+import mmap
+import time
+import struct
+import rospy
+import numpy as np
+
+from franka_core_msgs.msg import JointCommand
+
+# must match franka_interface::SharedMemoryLayout
+_MAGIC = 0x464b5348
+_VERSION = 2
+_SIZE = 1664
+_HEADER_FORMAT = '<II'
+_STATE_OFFSET = 64
+_STATE_FORMAT = '<Qd' + '7d' * 7 + '16d6d42d49dII'
+_COMMAND_OFFSET = 1408
+_COMMAND_FORMAT = '<QdiI21d'
+_COUNTER_FORMAT = '<Q'
+_COUNTER_SIZE = struct.calcsize(_COUNTER_FORMAT)
+
+_STATE_FIELDS = ['q', 'dq', 'tau_J', 'q_d', 'dq_d', 'tau_J_d', 'tau_ext_hat_filtered']
+
+# franka_interface::SharedRobotState
+_STATE_DTYPE = np.dtype([('sequence', '<u8'), ('time', '<f8')] +
+                        [(field, '<f8', (7,)) for field in _STATE_FIELDS] +
+                        [('O_T_EE', '<f8', (16,)), ('O_F_ext_hat_K', '<f8', (6,)),
+                         ('O_Jac_EE', '<f8', (42,)), ('mass_matrix', '<f8', (49,)),
+                         ('robot_mode', '<u4'), ('contact_flags', '<u4')])
+assert _STATE_DTYPE.itemsize == struct.calcsize(_STATE_FORMAT)
+
+
+def _robot_config_param(arm_namespace, name, default):
+    # like the driver, robot_config is looked up in the namespace of the arm; a relative name
+    # resolves in the namespace of this node
+    prefix = '' if arm_namespace is None else arm_namespace.rstrip('/') + '/'
+    return rospy.get_param(prefix + 'robot_config/' + name, default)
+
+
+def default_name(arm_namespace = None):
+    """
+    :param arm_namespace: namespace of the arm (e.g. '/left' for an arm of multi_arm_interface.launch);
+        None for the namespace of this node
+    :type arm_namespace: str
+    :return: shared memory object name of the driver, from robot_config of the arm
+    :rtype: str
+    """
+    return _robot_config_param(arm_namespace, 'shared_memory/name',
+                               '/franka_ros_interface_' + _robot_config_param(arm_namespace, 'arm_id', 'panda'))
+
+
+def available(name = None, arm_namespace = None):
+    """
+    :param arm_namespace: namespace of the arm, see default_name(); only used if name is None
+    :type arm_namespace: str
+    :return: True if the driver shares its state with this machine (shared memory enabled and
+        the segment exists with a compatible layout)
+    :rtype: bool
+    """
+    if name is None:
+        if not _robot_config_param(arm_namespace, 'shared_memory/enabled', False):
+            return False
+        name = default_name(arm_namespace)
+    path = '/dev/shm/' + name.lstrip('/')
+    try:
+        with open(path, 'rb') as segment:
+            header = segment.read(struct.calcsize(_HEADER_FORMAT))
+    except (IOError, OSError):
+        return False
+    return len(header) == struct.calcsize(_HEADER_FORMAT) and \
+        struct.unpack(_HEADER_FORMAT, header) == (_MAGIC, _VERSION)
+
+
+class SharedMemoryClient(object):
+    """
+    Reads the robot state snapshot written by the state controller on every control
+    tick, and writes joint commands into the command slot read by the joint controllers.
+
+    Requires robot_config/shared_memory/enabled to be set for the driver. Only one
+    client may write commands at a time.
+
+    :param name: shared memory object name; read from robot_config/shared_memory/name if None
+    :type name: str
+    :param arm_namespace: namespace of the arm, see default_name(); only used if name is None
+    :type arm_namespace: str
+    """
+
+    def __init__(self, name = None, arm_namespace = None):
+        if name is None:
+            name = default_name(arm_namespace)
+
+        path = '/dev/shm/' + name.lstrip('/')
+        if not os.path.exists(path):
+            raise IOError("SharedMemoryClient: %s does not exist. Is shared memory enabled for the driver?" % path)
+
+        fd = os.open(path, os.O_RDWR)
+        try:
+            self._mm = mmap.mmap(fd, _SIZE, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+        finally:
+            os.close(fd)
+
+        magic, version = struct.unpack_from(_HEADER_FORMAT, self._mm, 0)
+        if magic != _MAGIC or version != _VERSION:
+            self._mm.close()
+            raise IOError("SharedMemoryClient: %s has an incompatible layout" % path)
+
+        # continue the sequence of previous clients so that the first command is not mistaken for an old one
+        command = self._read_locked(_COMMAND_OFFSET, _COMMAND_FORMAT)
+        self._command_sequence = command[0] if command is not None else 0
+
+    def close(self):
+        self._mm.close()
+
+    def _read_locked(self, offset, fmt, attempts = 100):
+        size = struct.calcsize(fmt)
+        for _ in range(attempts):
+            start = struct.unpack_from(_COUNTER_FORMAT, self._mm, offset)[0]
+            if start & 1:
+                continue
+            data = self._mm[offset + _COUNTER_SIZE : offset + _COUNTER_SIZE + size]
+            if struct.unpack_from(_COUNTER_FORMAT, self._mm, offset)[0] == start:
+                return struct.unpack(fmt, data)
+        return None
+
+    def _write_locked(self, offset, fmt, values):
+        # relies on the stores becoming visible in program order (as on x86)
+        counter = struct.unpack_from(_COUNTER_FORMAT, self._mm, offset)[0]
+        struct.pack_into(_COUNTER_FORMAT, self._mm, offset, counter + 1)
+        struct.pack_into(fmt, self._mm, offset + _COUNTER_SIZE, *values)
+        struct.pack_into(_COUNTER_FORMAT, self._mm, offset, counter + 2)
+
+    def get_state(self):
+        """
+        Latest robot state snapshot.
+
+        :return: dict with 'sequence' (control tick counter), 'time' (ROS time in seconds),
+            'robot_mode' (franka_core_msgs.msg.RobotState.ROBOT_MODE_*), 'contact_flags' (bit mask
+            of joint_contact, cartesian_contact, joint_collision and cartesian_collision at bits 0,
+            8, 16 and 24) and the franka::RobotState fields q, dq, tau_J, q_d, dq_d, tau_J_d, tau_ext_hat_filtered, O_T_EE (4x4),
+            O_F_ext_hat_K, O_Jac_EE (6x7) and mass_matrix (7x7) as numpy arrays; None if no
+            consistent snapshot could be read
+        :rtype: dict
+        """
+        values = self._read_locked(_STATE_OFFSET, _STATE_FORMAT)
+        if values is None:
+            return None
+        state = {'sequence': values[0], 'time': values[1]}
+        index = 2
+        for field in _STATE_FIELDS:
+            state[field] = np.asarray(values[index:index + 7])
+            index += 7
+        state['O_T_EE'] = np.asarray(values[index:index + 16]).reshape(4, 4, order = 'F')
+        index += 16
+        state['O_F_ext_hat_K'] = np.asarray(values[index:index + 6])
+        index += 6
+        state['O_Jac_EE'] = np.asarray(values[index:index + 42]).reshape(6, 7, order = 'F')
+        index += 42
+        state['mass_matrix'] = np.asarray(values[index:index + 49]).reshape(7, 7, order = 'F')
+        index += 49
+        state['robot_mode'] = values[index]
+        state['contact_flags'] = values[index + 1]
+        return state
+
+    def set_joint_command(self, mode, positions = None, velocities = None, efforts = None):
+        """
+        Writes a joint command, which is applied by the running joint controller handling
+        this mode in its next control cycle (as if it was published on
+        motion_controller/arm/joint_commands).
+
+        :param mode: JointCommand.POSITION_MODE, VELOCITY_MODE, TORQUE_MODE or IMPEDANCE_MODE
+        :type mode: int
+        :param positions: 7 joint positions, ordered as /robot_config/joint_names
+        :type positions: [float]
+        :param velocities: 7 joint velocities
+        :type velocities: [float]
+        :param efforts: 7 joint torques
+        :type efforts: [float]
+        """
+        zeros = [0.0] * 7
+        self._command_sequence += 1
+        values = [self._command_sequence, time.time(), mode, 0]
+        for v in (positions, velocities, efforts):
+            values.extend(zeros if v is None else [float(x) for x in v])
+        self._write_locked(_COMMAND_OFFSET, _COMMAND_FORMAT, values)
+
+    def set_joint_positions(self, positions):
+        self.set_joint_command(JointCommand.POSITION_MODE, positions = positions)
+
+    def set_joint_velocities(self, velocities):
+        self.set_joint_command(JointCommand.VELOCITY_MODE, velocities = velocities)
+
+    def set_joint_torques(self, torques):
+        self.set_joint_command(JointCommand.TORQUE_MODE, efforts = torques)
+
+    def set_joint_positions_velocities(self, positions, velocities):
+        self.set_joint_command(JointCommand.IMPEDANCE_MODE, positions = positions, velocities = velocities)
+
+
+class SharedStateCache(object):
+    """
+    Latest robot state from shared memory, as numpy arrays that stay valid and are updated in
+    place: the properties are views into one buffer, so reading them neither copies nor
+    allocates. update() refreshes the buffer with one consistent snapshot of a control tick;
+    the views are only consistent with each other between two updates.
+
+    The Jacobian and mass matrix are zero unless the state controller computes them
+    (robot_state_fields jacobian and mass_matrix).
+
+    :param name: shared memory object name; read from robot_config/shared_memory/name if None
+    :type name: str
+    :param arm_namespace: namespace of the arm, see default_name(); only used if name is None
+    :type arm_namespace: str
+    """
+
+    def __init__(self, name = None, arm_namespace = None):
+        if name is None:
+            name = default_name(arm_namespace)
+
+        path = '/dev/shm/' + name.lstrip('/')
+        if not os.path.exists(path):
+            raise IOError("SharedStateCache: %s does not exist. Is shared memory enabled for the driver?" % path)
+
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            self._mm = mmap.mmap(fd, _SIZE, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            os.close(fd)
+
+        if struct.unpack_from(_HEADER_FORMAT, self._mm, 0) != (_MAGIC, _VERSION):
+            self._mm.close()
+            raise IOError("SharedStateCache: %s has an incompatible layout" % path)
+
+        self._counter = np.frombuffer(self._mm, dtype = '<u8', count = 1, offset = _STATE_OFFSET)
+        self._shared = np.frombuffer(self._mm, dtype = _STATE_DTYPE, count = 1,
+                                     offset = _STATE_OFFSET + _COUNTER_SIZE)
+        self._state = np.zeros(1, dtype = _STATE_DTYPE)
+        # each attempt copies into the scratch buffer; only a consistent copy reaches self._state
+        self._scratch = np.zeros(1, dtype = _STATE_DTYPE)
+
+        # views into self._state, which update() overwrites in place
+        self._q = self._state['q'][0]
+        self._dq = self._state['dq'][0]
+        self._tau = self._state['tau_J'][0]
+        self._O_T_EE = self._state['O_T_EE'][0].reshape(4, 4, order = 'F')
+        self._O_F_ext_hat_K = self._state['O_F_ext_hat_K'][0]
+        self._jacobian = self._state['O_Jac_EE'][0].reshape(6, 7, order = 'F')
+        self._mass_matrix = self._state['mass_matrix'][0].reshape(7, 7, order = 'F')
+
+    def close(self):
+        del self._counter, self._shared
+        self._mm.close()
+
+    def update(self, attempts = 100):
+        """
+        Copies the latest snapshot into the buffer behind the views.
+
+        :return: False if no consistent snapshot could be read (the views keep the previous one)
+        :rtype: bool
+        """
+        for _ in range(attempts):
+            # relies on the loads happening in program order (as on x86), like SharedMemoryClient
+            start = int(self._counter[0])
+            if start & 1:
+                continue
+            np.copyto(self._scratch, self._shared)
+            if int(self._counter[0]) == start:
+                np.copyto(self._state, self._scratch)
+                return True
+        return False
+
+    @property
+    def sequence(self):
+        """ control tick counter of the snapshot (0 until the state controller has written one) """
+        return int(self._state['sequence'][0])
+
+    @property
+    def time(self):
+        """ ROS time of the snapshot in seconds """
+        return float(self._state['time'][0])
+
+    @property
+    def robot_mode(self):
+        """ franka_core_msgs.msg.RobotState.ROBOT_MODE_* """
+        return int(self._state['robot_mode'][0])
+
+    @property
+    def q(self):
+        """ joint positions, np.ndarray (7,) """
+        return self._q
+
+    @property
+    def dq(self):
+        """ joint velocities, np.ndarray (7,) """
+        return self._dq
+
+    @property
+    def tau(self):
+        """ measured joint torques (tau_J), np.ndarray (7,) """
+        return self._tau
+
+    @property
+    def O_T_EE(self):
+        """ end effector pose in the base frame, np.ndarray (4,4) """
+        return self._O_T_EE
+
+    @property
+    def O_F_ext_hat_K(self):
+        """ external wrench at the stiffness frame in the base frame, np.ndarray (6,) """
+        return self._O_F_ext_hat_K
+
+    @property
+    def jacobian(self):
+        """ zero Jacobian of the end effector, np.ndarray (6,7) """
+        return self._jacobian
+
+    @property
+    def mass_matrix(self):
+        """ joint space mass matrix, np.ndarray (7,7) """
+        return self._mass_matrix
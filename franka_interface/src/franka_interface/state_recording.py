@@ -0,0 +1,131 @@
+# /***************************************************************************
+
+#
+# @package: franka_interface
+# @metapackage: franka_ros_interface
+# @author: Saif Sidhik <sxs1412@bham.ac.uk>
+#
+
+# **************************************************************************/
+
+# /***************************************************************************
+# Copyright (c) 2019-2020, Saif Sidhik
+
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+
+#     http://www.apache.org/licenses/LICENSE-2.0
+
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# **************************************************************************/
+
+"""
+ @info:
+       Reader for the binary state recordings written by the state controller
+       (franka_interface/state_recording.h), started and stopped with the
+       /franka_ros_interface/custom_franka_state_controller/record_state service.
+       Does not need ROS; the file is memory mapped, so only the columns that
+       are accessed are read from disk.
+
+"""
+
+import os
+import struct
+import numpy as np
+
+# must match franka_interface::StateRecordingHeader
+_MAGIC = 0x3143455254535246
+_VERSION = 1
+_HEADER_FORMAT = '<QIIIIQII'
+_COLUMN_FORMAT = '<32sII'
+_HEADER_SIZE = struct.calcsize(_HEADER_FORMAT)
+_COLUMN_SIZE = struct.calcsize(_COLUMN_FORMAT)
+
+
+class StateRecording(object):
+    """
+    A recording of the robot state of every control cycle.
+
+    Columns are the franka::RobotState fields time (ROS time in seconds), q, dq, q_d,
+    dq_d, tau_J, dtau_J, tau_J_d (commanded torques), tau_ext_hat_filtered, O_T_EE,
+    O_T_EE_d, O_F_ext_hat_K, K_F_ext_hat_K, robot_mode and control_command_success_rate.
+
+        rec = StateRecording('panda_state_20200101_120000.frrec')
+        t, q = rec['time'], rec['q']    # shapes (len(rec),) and (len(rec), 7)
+
+    :param path: recording file
+    :type path: str
+    """
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            header = f.read(4096)
+        if len(header) < _HEADER_SIZE:
+            raise IOError("StateRecording: %s is too short for a state recording" % path)
+
+        (magic, version, header_size, self._block_records, self._record_width,
+         num_records, num_columns, _) = struct.unpack_from(_HEADER_FORMAT, header, 0)
+        if magic != _MAGIC or version != _VERSION or self._block_records == 0:
+            raise IOError("StateRecording: %s is not a compatible state recording" % path)
+
+        self._columns = {}
+        self._names = []
+        for c in range(num_columns):
+            name, width, offset = struct.unpack_from(_COLUMN_FORMAT, header, _HEADER_SIZE + c * _COLUMN_SIZE)
+            name = name.split(b'\0', 1)[0].decode('ascii')
+            self._columns[name] = (width, offset)
+            self._names.append(name)
+
+        block_size = self._block_records * self._record_width
+        num_blocks = (os.path.getsize(path) - header_size) // (block_size * 8)
+        # num_records is 0 if the recorder did not finish the file; all complete blocks are valid then
+        self._len = num_blocks * self._block_records
+        if num_records:
+            self._len = min(self._len, num_records)
+
+        self._data = None
+        if num_blocks > 0:
+            self._data = np.memmap(path, dtype = '<f8', mode = 'r', offset = header_size,
+                                   shape = (num_blocks, block_size))
+
+    def __len__(self):
+        return self._len
+
+    @property
+    def names(self):
+        """
+        :return: column names, in file order
+        :rtype: [str]
+        """
+        return list(self._names)
+
+    def __getitem__(self, name):
+        return self.column(name)
+
+    def column(self, name):
+        """
+        :param name: column name, e.g. 'q' or 'tau_J_d'
+        :type name: str
+        :return: the column for all records, shape (len(self),) for scalar columns and
+            (len(self), width) otherwise; O_T_EE and O_T_EE_d are column-major 4x4
+            matrices, use reshape(-1, 4, 4).transpose(0, 2, 1) for [i, row, col] indexing
+        :rtype: numpy.ndarray
+        """
+        width, offset = self._columns[name]
+        if self._data is None:
+            return np.zeros((0,) if width == 1 else (0, width))
+        b = self._block_records
+        values = self._data[:, offset * b:(offset + width) * b].reshape(-1, width)[:self._len]
+        return values[:, 0] if width == 1 else values
+
+    def as_dict(self):
+        """
+        :return: all columns, see column()
+        :rtype: dict
+        """
+        return {name: self.column(name) for name in self._names}
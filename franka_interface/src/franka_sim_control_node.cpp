@@ -0,0 +1,317 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+// Drop-in replacement of custom_franka_control_node that runs the controllers on a
+// SimulatedFrankaHW instead of a robot.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <actionlib/server/simple_action_server.h>
+#include <controller_manager/controller_manager.h>
+#include <geometry_msgs/Wrench.h>
+#include <ros/ros.h>
+#include <rosgraph_msgs/Clock.h>
+
+#include <franka_interface/control_loop_monitor.h>
+#include <franka_interface/motion_controller_interface.h>
+#include <franka_interface/motion_primitive_server.h>
+#include <franka_interface/multi_arm_state.h>
+#include <franka_interface/simulated_franka_hw.h>
+#include <franka_interface/startup_timer.h>
+
+#include <franka_control/ErrorRecoveryAction.h>
+#include <franka_control/services.h>
+#include <franka_core_msgs/ResetSimulation.h>
+#include <franka_core_msgs/SetFrames.h>
+
+class ServiceContainer {
+ public:
+  template <typename T, typename... TArgs>
+  ServiceContainer& advertiseService(TArgs&&... args) {
+    ros::ServiceServer server = franka_control::advertiseService<T>(std::forward<TArgs>(args)...);
+    services_.push_back(server);
+    return *this;
+  }
+
+ private:
+  std::vector<ros::ServiceServer> services_;
+};
+
+template <size_t N, typename T>
+std::array<double, N> toArray(const T& values) {
+  std::array<double, N> array{};
+  std::copy(values.cbegin(), values.cbegin() + std::min(N, values.size()), array.begin());
+  return array;
+}
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "custom_franka_sim_control_node");
+  franka_interface::StartupTimer startup_timer;
+  ros::NodeHandle public_node_handle;
+  ros::NodeHandle node_handle("~");
+
+  std::vector<std::string> joint_names_vector;
+  if (!node_handle.getParam("/robot_config/joint_names", joint_names_vector) || joint_names_vector.size() != 7) {
+    ROS_ERROR("Invalid or no joint_names parameters provided");
+    return 1;
+  }
+
+  std::array<std::string, 7> joint_names;
+  std::copy(joint_names_vector.cbegin(), joint_names_vector.cend(), joint_names.begin());
+
+  std::string arm_id;
+  if (!node_handle.getParam("/robot_config/arm_id", arm_id)) {
+    ROS_ERROR("Invalid or no arm_id parameter provided");
+    return 1;
+  }
+
+  // start in the neutral pose unless told otherwise
+  std::array<double, 7> initial_positions{};
+  std::vector<double> initial_positions_vector;
+  if (node_handle.getParam("initial_positions", initial_positions_vector)) {
+    if (initial_positions_vector.size() != 7) {
+      ROS_ERROR("Invalid initial_positions parameter provided");
+      return 1;
+    }
+    initial_positions = toArray<7>(initial_positions_vector);
+  } else {
+    for (size_t i = 0; i < 7; ++i) {
+      if (!node_handle.getParam("/robot_config/neutral_pose/" + joint_names[i], initial_positions[i])) {
+        ROS_ERROR("Invalid or no neutral_pose parameter provided for %s", joint_names[i].c_str());
+        return 1;
+      }
+    }
+  }
+
+  franka_interface::SimulatedFrankaHW::Parameters parameters;
+  int substeps = static_cast<int>(parameters.substeps);
+  node_handle.param("substeps", substeps, substeps);
+  parameters.substeps = static_cast<size_t>(std::max(substeps, 1));
+  std::vector<double> values;
+  if (node_handle.getParam("armature", values)) {
+    if (values.size() != 7) {
+      ROS_ERROR("Invalid armature parameter provided");
+      return 1;
+    }
+    parameters.armature = toArray<7>(values);
+  }
+  if (node_handle.getParam("damping", values)) {
+    if (values.size() != 7) {
+      ROS_ERROR("Invalid damping parameter provided");
+      return 1;
+    }
+    parameters.damping = toArray<7>(values);
+  }
+
+  // With simulated time, the node is the clock and may run at any speed (0: as fast as the
+  // controllers can be updated). With wall-clock time it has to keep up with it.
+  bool use_sim_time = false;
+  public_node_handle.param("/use_sim_time", use_sim_time, false);
+  double real_time_factor = 1.0;
+  node_handle.param("real_time_factor", real_time_factor, 1.0);
+  if (!use_sim_time && real_time_factor != 1.0) {
+    ROS_WARN("real_time_factor requires /use_sim_time to be set, running in real time");
+    real_time_factor = 1.0;
+  }
+
+  startup_timer.phaseFinished("parameters");
+
+  franka_interface::SimulatedFrankaHW franka_control(joint_names, arm_id, initial_positions,
+                                                     parameters);
+
+  // the simulated arm is the only one of the node
+  auto multi_arm_state =
+      std::make_shared<franka_interface::MultiArmState>(std::vector<std::string>{arm_id});
+  franka_interface::MultiArmStateInterface multi_arm_state_interface;
+  multi_arm_state_interface.registerHandle(
+      franka_interface::MultiArmStateHandle("multi_arm_state", multi_arm_state));
+  franka_control.registerInterface(&multi_arm_state_interface);
+  franka_interface::SharedRobotState shared_state;
+
+  ServiceContainer services;
+  services
+      .advertiseService<franka_control::SetJointImpedance>(
+          node_handle, "/franka_ros_interface/franka_control/set_joint_impedance",
+          [](auto&& /*req*/, auto&& /*res*/) {})
+      .advertiseService<franka_control::SetCartesianImpedance>(
+          node_handle, "/franka_ros_interface/franka_control/set_cartesian_impedance",
+          [](auto&& /*req*/, auto&& /*res*/) {})
+      .advertiseService<franka_control::SetEEFrame>(
+          node_handle, "/franka_ros_interface/franka_control/set_EE_frame",
+          [&franka_control](auto&& req, auto&& /*res*/) {
+            franka_control.setEEFrame(toArray<16>(req.F_T_EE));
+          })
+      .advertiseService<franka_control::SetKFrame>(
+          node_handle, "/franka_ros_interface/franka_control/set_K_frame",
+          [&franka_control](auto&& req, auto&& /*res*/) {
+            franka_control.setKFrame(toArray<16>(req.EE_T_K));
+          })
+      .advertiseService<franka_control::SetForceTorqueCollisionBehavior>(
+          node_handle, "/franka_ros_interface/franka_control/set_force_torque_collision_behavior",
+          [](auto&& /*req*/, auto&& /*res*/) {})
+      .advertiseService<franka_control::SetFullCollisionBehavior>(
+          node_handle, "/franka_ros_interface/franka_control/set_full_collision_behavior",
+          [](auto&& /*req*/, auto&& /*res*/) {})
+      .advertiseService<franka_control::SetLoad>(
+          node_handle, "/franka_ros_interface/franka_control/set_load",
+          [&franka_control](auto&& req, auto&& /*res*/) {
+            franka_control.setLoad(req.mass, toArray<3>(req.F_x_center_load),
+                                   toArray<9>(req.load_inertia));
+          });
+
+  ros::ServiceServer reset_service =
+      node_handle.advertiseService<franka_core_msgs::ResetSimulation::Request,
+                                   franka_core_msgs::ResetSimulation::Response>(
+          "/franka_ros_interface/franka_control/reset_simulation",
+          [&](franka_core_msgs::ResetSimulation::Request& request,
+              franka_core_msgs::ResetSimulation::Response& response) {
+            if (request.positions.empty()) {
+              franka_control.reset(initial_positions);
+            } else if (request.positions.size() == 7) {
+              franka_control.reset(toArray<7>(request.positions));
+            } else {
+              response.success = false;
+              response.message = "positions must be empty or contain 7 joint positions";
+              return true;
+            }
+            response.success = true;
+            return true;
+          });
+
+  // the simulation takes the changes at the start of a cycle, so the controllers keep running
+  ros::ServiceServer set_frames_service =
+      node_handle.advertiseService<franka_core_msgs::SetFrames::Request,
+                                   franka_core_msgs::SetFrames::Response>(
+          "/franka_ros_interface/franka_control/set_frames",
+          [&franka_control](franka_core_msgs::SetFrames::Request& request,
+                            franka_core_msgs::SetFrames::Response& response) {
+            franka_interface::SimulatedFrankaHW::FrameChanges changes;
+            changes.set_EE_frame = request.set_EE_frame;
+            changes.F_T_EE = toArray<16>(request.F_T_EE);
+            changes.set_K_frame = request.set_K_frame;
+            changes.EE_T_K = toArray<16>(request.EE_T_K);
+            changes.set_load = request.set_load;
+            changes.load_mass = request.mass;
+            changes.F_x_Cload = toArray<3>(request.F_x_center_load);
+            changes.load_inertia = toArray<9>(request.load_inertia);
+            franka_control.setFrames(changes);
+            response.success = true;
+            response.message = "frames set";
+            return true;
+          });
+
+  // wrench exerted on the arm at the stiffness frame, in base frame coordinates
+  ros::Subscriber wrench_subscriber = node_handle.subscribe<geometry_msgs::Wrench>(
+      "/franka_ros_interface/franka_control/simulated_external_wrench", 1,
+      [&franka_control](const geometry_msgs::WrenchConstPtr& msg) {
+        franka_control.setExternalWrench({{msg->force.x, msg->force.y, msg->force.z,
+                                           msg->torque.x, msg->torque.y, msg->torque.z}});
+      });
+
+  // there are no robot errors to recover from in simulation
+  actionlib::SimpleActionServer<franka_control::ErrorRecoveryAction> recovery_action_server(
+      node_handle, "/franka_ros_interface/franka_control/error_recovery",
+      [&](const franka_control::ErrorRecoveryGoalConstPtr&) {
+        recovery_action_server.setSucceeded();
+        ROS_INFO("Recovered from error");
+      },
+      false);
+
+  ros::Publisher clock_publisher;
+  if (use_sim_time) {
+    clock_publisher = public_node_handle.advertise<rosgraph_msgs::Clock>("/clock", 1);
+  }
+
+  startup_timer.phaseFinished("hardware interface and services");
+
+  boost::shared_ptr<controller_manager::ControllerManager> control_manager;
+
+  control_manager.reset(new controller_manager::ControllerManager(&franka_control, public_node_handle));
+
+  franka_interface::MotionControllerInterface motion_controller_interface_;
+  motion_controller_interface_.init(public_node_handle, control_manager);
+
+  franka_interface::ControlLoopMonitor control_loop_monitor;
+  control_loop_monitor.init(public_node_handle, control_manager);
+  startup_timer.phaseFinished("controller manager");
+
+  motion_controller_interface_.preloadControllers(startup_timer);
+
+  franka_interface::MotionPrimitiveServer motion_primitive_server;
+  if (!motion_primitive_server.init(public_node_handle, motion_controller_interface_,
+                                    multi_arm_state, 0, [](std::string& /*error*/) { return true; })) {
+    return 1;
+  }
+
+  recovery_action_server.start();
+  startup_timer.phaseFinished("motion primitives");
+
+  // Start background threads for message handling
+  ros::AsyncSpinner spinner(4);
+  spinner.start();
+  ROS_INFO_STREAM("Control node startup: " << startup_timer.report());
+
+  // The simulation advances in fixed 1 ms steps, independent of how long a step takes, so
+  // runs are reproducible.
+  const ros::Duration period(0.001);
+  ros::Time now = use_sim_time ? ros::Time(0) : ros::Time::now();
+  rosgraph_msgs::Clock clock;
+  const auto wall_start = std::chrono::steady_clock::now();
+  uint64_t steps = 0;
+
+  while (ros::ok()) {
+    now += period;
+    if (use_sim_time) {
+      clock.clock = now;
+      clock_publisher.publish(clock);
+    }
+
+    control_loop_monitor.cycleStarted(period);
+    franka_control.read(now, period);
+    franka_interface::toSharedRobotState(franka_control.robotState(), now.toSec(), shared_state);
+    multi_arm_state->write(0, shared_state);
+    control_manager->update(now, period);
+    franka_control.write(now, period);
+    motion_controller_interface_.cycleFinished();
+    control_loop_monitor.cycleFinished();
+
+    ++steps;
+    if (real_time_factor > 0.0) {
+      std::this_thread::sleep_until(
+          wall_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(steps * period.toSec() / real_time_factor)));
+    }
+  }
+
+  return 0;
+}
@@ -27,12 +27,14 @@
 # **************************************************************************/
 
 import rospy
+import threading
 import numpy as np
 from copy import deepcopy
 from controller_manager_msgs.msg import ControllerState
 from controller_manager_msgs.srv import *
 import socket
-from franka_core_msgs.msg import JointControllerStates
+from franka_core_msgs.msg import JointControllerStates, ControllerManagerState
+from franka_core_msgs.srv import SwitchToController
 
 from franka_tools import ControllerParamConfigClient
 
@@ -182,10 +184,30 @@ class FrankaControllerManagerInterface(object):
                                                   ListControllerTypes,
                                                   persistent=True)
 
+        # atomic switching of the motion controller by the driver (not provided e.g. by panda_simulator)
+        self._switch_to_srv = rospy.ServiceProxy(self._ns + "/motion_controller/arm/switch_to",
+                                                 SwitchToController)
+        try:
+            self._switch_to_srv.wait_for_service(0.5)
+        except rospy.ROSException:
+            rospy.loginfo("FrankaControllerManagerInterface: switch_to service not found. Controllers will be switched one by one.")
+            self._switch_to_srv = None
+
         self._in_sim = sim
 
         self._controller_lister = ControllerLister(self._cm_ns)
 
+        # The driver publishes the controllers whenever they change (latched). Once it has, the
+        # queries below are answered from this cache; after a change made by this interface the
+        # cache is refreshed through the services once, as the update may still be on its way.
+        self._cache_lock = threading.Lock()
+        self._cached_controllers = None
+        self._has_state_topic = False
+        self._cache_stale = True
+        self._rosparam_controllers = None
+        self._manager_state_subscriber = rospy.Subscriber("%s/motion_controller/arm/controller_manager_state" %(self._ns),
+                                                    ControllerManagerState, self._on_controller_manager_state, queue_size = 1)
+
         self._controller_names_from_rosparam = {
             'joint_position_controller': _get_controller_name_from_rosparam_server('/controllers_config/position_controller'),
             'joint_velocity_controller': _get_controller_name_from_rosparam_server('/controllers_config/velocity_controller'),
@@ -217,6 +239,40 @@ class FrankaControllerManagerInterface(object):
 
         if self._state_subscriber:
             self._state_subscriber.unregister()
+        if self._manager_state_subscriber:
+            self._manager_state_subscriber.unregister()
+
+    def _on_controller_manager_state(self, msg):
+        controllers = [ControllerState(name = c.name[1:] if c.name[:1] == '/' else c.name,
+                                       state = c.state, type = c.type) for c in msg.controllers]
+        controllers = self._add_rosparam_controllers(controllers, refresh = False)
+        with self._cache_lock:
+            self._cached_controllers = controllers
+            self._has_state_topic = True
+            self._cache_stale = False
+
+    def _invalidate_cache(self):
+        with self._cache_lock:
+            self._cache_stale = True
+
+    def _add_rosparam_controllers(self, controllers, refresh = True):
+        """
+        Append the controllers configured in the parameter server but not loaded, as
+        'uninitialized'. The configurations are read from the parameter server only when
+        refresh is set or they have not been read yet.
+        """
+        if refresh or self._rosparam_controllers is None:
+            all_ctrls_ns = _resolve_controllers_ns(self._cm_ns)
+            self._rosparam_controllers = [ControllerState(name = name,
+                                                          type = _rosparam_controller_type(all_ctrls_ns, name),
+                                                          state = 'uninitialized')
+                                          for name in get_rosparam_controller_names(all_ctrls_ns)]
+        for uninit_ctrl in self._rosparam_controllers:
+            name = uninit_ctrl.name[1:] if uninit_ctrl.name[:1] == '/' else uninit_ctrl.name
+            if not any(name == ctrl.name for ctrl in controllers):
+                controllers.append(ControllerState(name = name, type = uninit_ctrl.type,
+                                                   state = uninit_ctrl.state))
+        return controllers
 
 
     def _on_controller_state(self, msg):
@@ -243,6 +299,7 @@ class FrankaControllerManagerInterface(object):
         :param name: name of the controller to be loaded
         """
         self._load_srv.call(LoadControllerRequest(name=name))
+        self._invalidate_cache()
 
     def unload_controller(self, name):
         """
@@ -252,6 +309,7 @@ class FrankaControllerManagerInterface(object):
         :param name: name of the controller to be unloaded
         """
         self._unload_srv.call(UnloadControllerRequest(name=name))
+        self._invalidate_cache()
 
     def start_controller(self, name):
         """
@@ -268,6 +326,7 @@ class FrankaControllerManagerInterface(object):
                                       strictness=strict)
         rospy.logdebug("FrankaControllerManagerInterface: Starting controller: %s"%name)
         self._switch_srv.call(req)
+        self._invalidate_cache()
 
         self._assert_one_active_controller()
 
@@ -292,6 +351,7 @@ class FrankaControllerManagerInterface(object):
                                       strictness=strict)
         rospy.logdebug("FrankaControllerManagerInterface: Stopping controller: %s"%name)
         self._switch_srv.call(req)
+        self._invalidate_cache()
 
 
     def list_loaded_controllers(self):
@@ -323,29 +383,31 @@ class FrankaControllerManagerInterface(object):
         :return: List of controllers associated to a controller manager
             namespace. Contains both stopped/running controllers, as returned by
             the `list_controllers` service, plus uninitialized controllers with
-            configurations loaded in the parameter server.
+            configurations loaded in the parameter server. Answered from the
+            controller_manager_state topic of the driver when it is available,
+            without a service call.
         :rtype: [ControllerState obj]
         """
         if not self._cm_ns:
             return []
 
+        with self._cache_lock:
+            if self._has_state_topic and not self._cache_stale:
+                return deepcopy(self._cached_controllers)
+
         # Add loaded controllers first
         controllers = self._controller_lister()
-
-        # Append potential controller configs found in the parameter server
-        all_ctrls_ns = _resolve_controllers_ns(self._cm_ns)
-        for name in get_rosparam_controller_names(all_ctrls_ns):
-
-            add_ctrl = not any(name == ctrl.name for ctrl in controllers)
-            if add_ctrl:
-                type_str = _rosparam_controller_type(all_ctrls_ns, name)
-                uninit_ctrl = ControllerState(name=name,
-                                              type=type_str,
-                                              state='uninitialized')
-                controllers.append(uninit_ctrl)
         for c in controllers:
             if c.name[0] == '/':
                 c.name = c.name[1:]
+
+        # Append potential controller configs found in the parameter server
+        controllers = self._add_rosparam_controllers(controllers)
+
+        with self._cache_lock:
+            if self._has_state_topic:
+                self._cached_controllers = deepcopy(controllers)
+                self._cache_stale = False
         return controllers
 
     def controller_dict(self):
@@ -383,7 +445,9 @@ class FrankaControllerManagerInterface(object):
         curr_ctrlr = self._current_controller
         switch_ctrl = (curr_ctrlr != controller_name)
 
-        if switch_ctrl:
+        if switch_ctrl and self.has_switch_to_service():
+            self.switch_to(controller_name)
+        elif switch_ctrl:
             active_controllers = self.list_active_controllers(only_motion_controllers = True)
             for ctrlr in active_controllers:
                 self.stop_controller(ctrlr.name)
@@ -399,6 +463,42 @@ class FrankaControllerManagerInterface(object):
         return curr_ctrlr
 
 
+    def has_switch_to_service(self):
+        """
+        :return: True if the driver switches motion controllers atomically (:py:meth:`switch_to`)
+        :rtype: bool
+        """
+        return self._switch_to_srv is not None
+
+    def switch_to(self, controller_name, timeout = 0.):
+        """
+        Make the given controller the only running motion controller, in a single switch
+        done by the driver. Controllers preloaded by the driver start without delay, others
+        are loaded first. Returns once the control loop has updated the new controller.
+        Requires :py:meth:`has_switch_to_service`.
+
+        :type controller_name: str
+        :param controller_name: name of controller to start
+        :type timeout: float
+        :param timeout: seconds to wait for the first update of the controller (0: 1 second)
+        :return: True if the controller is running
+        :rtype: bool
+        """
+        if controller_name[0] == '/':
+            controller_name = controller_name[1:]
+        try:
+            res = self._switch_to_srv(controller_name = controller_name, timeout = timeout)
+            self._invalidate_cache()
+        except rospy.ServiceException as e:
+            rospy.logerr("FrankaControllerManagerInterface: switch_to service call failed: %s"%e)
+            return False
+        if not res.success:
+            rospy.logerr("FrankaControllerManagerInterface: %s"%res.message)
+            return False
+        self._current_controller = controller_name
+        rospy.logdebug("FrankaControllerManagerInterface: %s"%res.message)
+        return True
+
     def is_running(self, controller_name):
         """
         Check if the given controller is running.
@@ -575,6 +675,9 @@ class FrankaControllerManagerInterface(object):
     @property
     def cartesian_impedance_controller(self):
         return self._ns[1:] + "/cartesian_impedance_controller"
+    @property
+    def cartesian_streaming_controller(self):
+        return self._ns[1:] + "/cartesian_streaming_controller"
 
     '''
     @property
@@ -24,12 +24,14 @@
 # limitations under the License.
 # **************************************************************************/
 
-import tf
+import errno
+import threading
+import tf2_ros
 import numpy as np
 import quaternion
-from franka_control.srv import SetEEFrame, SetKFrame
+from franka_control.srv import SetEEFrame, SetKFrame, SetLoad
+from franka_core_msgs.srv import SetFrames, SetFramesRequest
 import rospy
-import franka_dataflow
 
 from collections import namedtuple
 _FRAME_NAMES = namedtuple('Constants', ['EE_FRAME', 'K_FRAME'])
@@ -38,6 +40,30 @@ DEFAULT_TRANSFORMATIONS = _FRAME_NAMES( [0.707099974155426, -0.707099974155426,
     [1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.10339999943971634, 1.0]  # K_FRAME
     ) # default when the franka_ros control is launched
 
+# services of the control node, relative to the namespace of the arm (e.g. /franka_ros_interface, /left/franka_ros_interface)
+SET_EE_FRAME_SERVICE = 'franka_control/set_EE_frame'
+SET_K_FRAME_SERVICE = 'franka_control/set_K_frame'
+SET_LOAD_SERVICE = 'franka_control/set_load'
+SET_FRAMES_SERVICE = 'franka_control/set_frames'
+
+_tf_lock = threading.Lock()
+_tf_buffer = None
+_tf_listener = None
+
+def _shared_tf_buffer():
+    """
+    :return: the TF buffer shared by all FrankaFramesInterface instances of the process. It is
+        created (with its listener) on first use and keeps filling from then on, so that later
+        lookups do not wait for the TF tree to arrive again.
+    :rtype: tf2_ros.Buffer
+    """
+    global _tf_buffer, _tf_listener
+    with _tf_lock:
+        if _tf_buffer is None:
+            _tf_buffer = tf2_ros.Buffer()
+            _tf_listener = tf2_ros.TransformListener(_tf_buffer)
+        return _tf_buffer
+
 
 class FrankaFramesInterface(object):
     """
@@ -45,14 +71,106 @@ class FrankaFramesInterface(object):
 
         Has to be updated externally each time franka states is updated. This is done by default within the PandaArm class (panda_robot package: https://github.com/justagist/panda_robot ).
 
-        .. note: All controllers have to be unloaded before switching frames. This has to be done externally (also automatically handled in PandaArm class).
+        .. note: All controllers have to be unloaded before switching frames. This has to be done externally (also automatically handled in PandaArm class),
+            unless the control node provides the set_frames service (see :py:meth:`set_frames`), which pauses them itself.
 
     """
 
-    def __init__(self):
+    def __init__(self, ns = "franka_ros_interface"):
+        """
+        :param ns: namespace of the arm, in which the franka_control services are found (e.g.
+            /left/franka_ros_interface with multi_arm_interface.launch); a relative name is
+            resolved in the namespace of the node
+        :type ns: str
+        """
+        self._ns = rospy.resolve_name(ns)
         self._current_EE_frame_transformation = None
         self._current_K_frame_transformation = None
-        
+        # service proxies by service name, created on first use
+        self._service_proxies = {}
+        self._has_set_frames_service = None
+        # start filling the TF buffer, so that it holds the tree by the first lookup
+        _shared_tf_buffer()
+
+    def _service_name(self, service):
+        return self._ns + '/' + service
+
+    def _service_proxy(self, service, service_class):
+        proxy = self._service_proxies.get(service)
+        if proxy is None:
+            name = self._service_name(service)
+            rospy.wait_for_service(name)
+            proxy = self._service_proxies[service] = rospy.ServiceProxy(name, service_class)
+        return proxy
+
+    def has_set_frames_service(self):
+        """
+        :return: True if the control node sets EE frame, K frame and load in one call
+            (franka_core_msgs/SetFrames), pausing the motion controllers itself.
+        :rtype: bool
+        """
+        if self._has_set_frames_service is None:
+            try:
+                rospy.wait_for_service(self._service_name(SET_FRAMES_SERVICE), timeout = 0.5)
+                self._has_set_frames_service = True
+            except rospy.ROSException:
+                self._has_set_frames_service = False
+        return self._has_set_frames_service
+
+    def set_frames(self, EE_frame = None, K_frame = None, load = None):
+        """
+        Set any of the EE frame, the K frame and the load in one request. With the set_frames
+        service of the control node, the motion controllers are paused by the node and the
+        changes are applied together between two control cycles; otherwise the separate services
+        are called in turn and the motion controllers have to be stopped externally.
+
+        :type EE_frame: [float (16,)] / np.ndarray (4x4)
+        :param EE_frame: transformation matrix of new EE frame wrt flange frame (column major); None to keep the current one
+        :type K_frame: [float (16,)] / np.ndarray (4x4)
+        :param K_frame: transformation matrix of new K frame wrt EE frame (column major); None to keep the current one
+        :type load: (float, [float (3,)], [float (9,)] / np.ndarray (3x3))
+        :param load: mass [kg], center of mass in the flange frame [m] and inertia matrix [kg m^2] (column major) of the load; None to keep the current one
+        :rtype: bool
+        :return: success status of the service request(s)
+        """
+        if EE_frame is not None:
+            EE_frame = self._assert_frame_validity(EE_frame)
+        if K_frame is not None:
+            K_frame = self._assert_frame_validity(K_frame)
+        if load is not None:
+            mass, F_x_center_load, load_inertia = load
+            if isinstance(load_inertia, np.ndarray):
+                load_inertia = load_inertia.flatten('F').tolist()
+            assert len(F_x_center_load) == 3 and len(load_inertia) == 9, "FrankaFramesInterface: Invalid load. Should be (mass, center of mass (3 elements), inertia (9 elements))."
+            load = (mass, list(F_x_center_load), list(load_inertia))
+
+        if not self.has_set_frames_service():
+            success = True
+            if EE_frame is not None:
+                success = self._request_setEE_service(EE_frame) and success
+            if K_frame is not None:
+                success = self._request_setK_service(K_frame) and success
+            if load is not None:
+                success = self._request_setLoad_service(*load) and success
+            return success
+
+        request = SetFramesRequest()
+        if EE_frame is not None:
+            request.set_EE_frame = True
+            request.F_T_EE = EE_frame
+        if K_frame is not None:
+            request.set_K_frame = True
+            request.EE_T_K = K_frame
+        if load is not None:
+            request.set_load = True
+            request.mass, request.F_x_center_load, request.load_inertia = load
+        try:
+            response = self._service_proxy(SET_FRAMES_SERVICE, SetFrames)(request)
+            rospy.loginfo("Set Frames Request Status: %s. \n\tDetails: %s"%("Success" if response.success else "Failed!", response.message))
+            return response.success
+        except rospy.ServiceException as e:
+            rospy.logwarn("Set Frames Request: Service call failed: %s"%e)
+            return False
 
 
     def set_EE_frame(self, frame):
@@ -67,6 +185,8 @@ class FrankaFramesInterface(object):
         """
         frame = self._assert_frame_validity(frame)
 
+        if self.has_set_frames_service():
+            return self.set_frames(EE_frame = frame)
         return self._request_setEE_service(frame)
 
 
@@ -102,28 +222,27 @@ class FrankaFramesInterface(object):
         :type frame_name: str
         :param parent: Name of parent frame (default: '/panda_link8')
         :type parent: str
+        :param timeout: time to wait for the transform [s], only needed until the shared TF buffer holds it
+        :type timeout: float
         """
-        listener = tf.TransformListener()
-        err = "FrankaFramesInterface: Error while looking up transform from Flange frame to link frame %s"%frame_name
-        def body():
-            try:
-                listener.lookupTransform(parent, frame_name, rospy.Time(0))
-            except (tf.LookupException, tf.ConnectivityException, tf.ExtrapolationException):
-                return False
-            return True
-
-        franka_dataflow.wait_for(lambda: body(), timeout = timeout, raise_on_error = True, timeout_msg = err)
+        # tf2 frame ids have no leading slash
+        try:
+            transform = _shared_tf_buffer().lookup_transform(parent.lstrip('/'), frame_name.lstrip('/'),
+                                                             rospy.Time(0), rospy.Duration(timeout))
+        except tf2_ros.TransformException as e:
+            raise OSError(errno.ETIMEDOUT, "FrankaFramesInterface: Error while looking up transform from frame %s to link frame %s: %s"%(parent, frame_name, e))
 
-        t,rot = listener.lookupTransform(parent, frame_name, rospy.Time(0))
+        t = transform.transform.translation
+        rot = transform.transform.rotation
 
-        rot = np.quaternion(rot[3],rot[0],rot[1],rot[2])
+        rot = np.quaternion(rot.w,rot.x,rot.y,rot.z)
 
         rot = quaternion.as_rotation_matrix(rot)
 
         trans_mat = np.eye(4)
 
         trans_mat[:3,:3] = rot
-        trans_mat[:3,3] = np.array(t)
+        trans_mat[:3,3] = np.array([t.x, t.y, t.z])
 
         return trans_mat
 
@@ -193,13 +312,11 @@ class FrankaFramesInterface(object):
 
     def _request_setEE_service(self, trans_mat):
 
-        rospy.wait_for_service('/franka_ros_interface/franka_control/set_EE_frame')
         try:
-            service_handle = rospy.ServiceProxy('/franka_ros_interface/franka_control/set_EE_frame', SetEEFrame)
-            response = service_handle(F_T_EE = trans_mat)
+            response = self._service_proxy(SET_EE_FRAME_SERVICE, SetEEFrame)(F_T_EE = trans_mat)
             rospy.loginfo("Set EE Frame Request Status: %s. \n\tDetails: %s"%("Success" if response.success else "Failed!", response.error))
             return response.success
-        except rospy.ServiceException, e:
+        except rospy.ServiceException as e:
             rospy.logwarn("Set EE Frame Request: Service call failed: %s"%e)
             return False
 
@@ -216,6 +333,8 @@ class FrankaFramesInterface(object):
         """
         frame = self._assert_frame_validity(frame)
 
+        if self.has_set_frames_service():
+            return self.set_frames(K_frame = frame)
         return self._request_setK_service(frame)
 
     def set_K_frame_to_link(self, frame_name, timeout = 5.0):
@@ -229,29 +348,7 @@ class FrankaFramesInterface(object):
         :return: [success status of service request, error msg if any]
         """
 
-        listener = tf.TransformListener()
-        err = "FrankaFramesInterface: Error while looking up transform from EE frame to link frame %s"%frame_name
-        def body():
-            try:
-                listener.lookupTransform('/panda_EE', frame_name, rospy.Time(0))
-            except (tf.LookupException, tf.ConnectivityException, tf.ExtrapolationException):
-                return False
-            return True
-
-        franka_dataflow.wait_for(lambda: body(), timeout = timeout, raise_on_error = True, timeout_msg = err)
-
-        t,rot = listener.lookupTransform('/panda_EE', frame_name, rospy.Time(0))
-
-        rot = np.quaternion(rot[3],rot[0],rot[1],rot[2])
-
-        rot = quaternion.as_rotation_matrix(rot)
-
-        trans_mat = np.eye(4)
-
-        trans_mat[:3,:3] = rot
-        trans_mat[:3,3] = np.array(t)
-
-        return self.set_K_frame(trans_mat)
+        return self.set_K_frame(self.get_link_tf(frame_name, timeout, parent = '/panda_EE'))
         
 
     def get_K_frame(self, as_mat = False):
@@ -280,17 +377,25 @@ class FrankaFramesInterface(object):
         return list(self._current_K_frame_transformation) == list(DEFAULT_TRANSFORMATIONS.K_FRAME)
 
     def _request_setK_service(self, trans_mat):
-        print trans_mat
-        rospy.wait_for_service('/franka_ros_interface/franka_control/set_K_frame')
+
         try:
-            service_handle = rospy.ServiceProxy('/franka_ros_interface/franka_control/set_K_frame', SetKFrame)
-            response = service_handle(EE_T_K = trans_mat)
+            response = self._service_proxy(SET_K_FRAME_SERVICE, SetKFrame)(EE_T_K = trans_mat)
             rospy.loginfo("Set K Frame Request Status: %s. \n\tDetails: %s"%("Success" if response.success else "Failed!", response.error))
             return response.success
-        except rospy.ServiceException, e:
+        except rospy.ServiceException as e:
             rospy.logwarn("Set K Frame Request: Service call failed: %s"%e)
             return False
 
+    def _request_setLoad_service(self, mass, F_x_center_load, load_inertia):
+
+        try:
+            response = self._service_proxy(SET_LOAD_SERVICE, SetLoad)(mass = mass, F_x_center_load = F_x_center_load, load_inertia = load_inertia)
+            rospy.loginfo("Set Load Request Status: %s. \n\tDetails: %s"%("Success" if response.success else "Failed!", response.error))
+            return response.success
+        except rospy.ServiceException as e:
+            rospy.logwarn("Set Load Request: Service call failed: %s"%e)
+            return False
+
 
 if __name__ == '__main__':
     # main()
@@ -27,46 +27,57 @@
 **************************************************************************/
 
 #include <franka_interface/motion_controller_interface.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
 #include <controller_manager_msgs/SwitchController.h>
 
 namespace franka_interface {
 
+constexpr double MotionControllerInterface::kDefaultSwitchTimeout;
+
 void MotionControllerInterface::init(ros::NodeHandle& nh,
         boost::shared_ptr<controller_manager::ControllerManager> controller_manager) {
-  current_mode_ = -1;
+  current_mode_.store(-1);
 
-  if (!nh.getParam("/controllers_config/position_controller", position_controller_name_)) {
+  if (!nh.getParam("controllers_config/position_controller", position_controller_name_)) {
         position_controller_name_ = "position_joint_position_controller";
     }
-  if (!nh.getParam("/controllers_config/torque_controller", torque_controller_name_)) {
+  if (!nh.getParam("controllers_config/torque_controller", torque_controller_name_)) {
         torque_controller_name_ = "effort_joint_torque_controller";
     }
-  if (!nh.getParam("/controllers_config/impedance_controller", impedance_controller_name_)) {
+  if (!nh.getParam("controllers_config/impedance_controller", impedance_controller_name_)) {
         impedance_controller_name_ = "effort_joint_impedance_controller";
     }
 
-  if (!nh.getParam("/controllers_config/force_controller", force_controller_name_)) {
+  if (!nh.getParam("controllers_config/force_controller", force_controller_name_)) {
         force_controller_name_ = "force_controller";
     }
-  if (!nh.getParam("/controllers_config/ntorque_controller", ntorque_controller_name_)) {
+  if (!nh.getParam("controllers_config/ntorque_controller", ntorque_controller_name_)) {
         force_controller_name_ = "torque_controller";
     }
-  if (!nh.getParam("/controllers_config/joint_impedance_controller", joint_impedance_controller_name_)) {
+  if (!nh.getParam("controllers_config/joint_impedance_controller", joint_impedance_controller_name_)) {
         joint_impedance_controller_name_ = "joint_impedance_controller";
     }
-  if (!nh.getParam("/controllers_config/cartesian_impedance_controller", cartesian_impedance_controller_name_)) {
+  if (!nh.getParam("controllers_config/cartesian_impedance_controller", cartesian_impedance_controller_name_)) {
         cartesian_impedance_controller_name_ = "cartesian_impedance_controller";
    }
-  if (!nh.getParam("/controllers_config/velocity_controller", velocity_controller_name_)) {
+  if (!nh.getParam("controllers_config/velocity_controller", velocity_controller_name_)) {
         velocity_controller_name_ = "velocity_joint_velocity_controller";
     }
-  if (!nh.getParam("/controllers_config/trajectory_controller", trajectory_controller_name_)) {
+  if (!nh.getParam("controllers_config/trajectory_controller", trajectory_controller_name_)) {
         trajectory_controller_name_ = "position_joint_trajectory_controller";
     }
-  if (!nh.getParam("/controllers_config/default_controller", default_controller_name_)) {
+  if (!nh.getParam("controllers_config/default_controller", default_controller_name_)) {
         default_controller_name_ = "position_joint_trajectory_controller";
     }
 
+  nh_ = nh;
+  nh.param("controllers_config/preload", preload_, true);
+
   current_controller_name_ = default_controller_name_;
 
   all_controllers_.clear();
@@ -78,13 +89,24 @@ void MotionControllerInterface::init(ros::NodeHandle& nh,
   all_controllers_.push_back(cartesian_impedance_controller_name_);
   all_controllers_.push_back(joint_impedance_controller_name_);
   all_controllers_.push_back(velocity_controller_name_);
+  std::vector<std::string> other_controllers;
+  nh.getParam("controllers_config/other_controllers", other_controllers);
+  for (const std::string& name : other_controllers) {
+    if (std::find(all_controllers_.cbegin(), all_controllers_.cend(), name) == all_controllers_.cend() &&
+        name != trajectory_controller_name_) {
+      all_controllers_.push_back(name);
+      controller_name_to_mode_map_[name] = -1;
+    }
+  }
   all_controllers_.push_back(trajectory_controller_name_);
+  trajectory_controller_index_ = all_controllers_.size() - 1;
 
   bool default_defined = false;
 
   for (size_t i = 0; i < all_controllers_.size(); ++i){
     if (all_controllers_[i] == default_controller_name_){
       default_defined = true;
+      default_controller_index_ = i;
       break;
     }
   }
@@ -103,162 +125,291 @@ void MotionControllerInterface::init(ros::NodeHandle& nh,
     ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Default controller not present in the provided controllers!");
   }
 
+  const size_t num_controllers = all_controllers_.size();
+  for (size_t i = 0; i < num_controllers; ++i) {
+    int mode = controller_name_to_mode_map_[all_controllers_[i]];
+    if (mode != -1) {
+      mode_to_controller_index_.insert({mode, i});
+    }
+  }
+  // going from one controller to another only the former needs to be stopped, as long as no
+  // other controller was started through the controller manager directly
+  switch_plans_.assign(num_controllers, std::vector<SwitchPlan>(num_controllers));
+  for (size_t from = 0; from < num_controllers; ++from) {
+    for (size_t to = 0; to < num_controllers; ++to) {
+      switch_plans_[from][to].start_controllers.push_back(all_controllers_[to]);
+      if (all_controllers_[from] != all_controllers_[to]) {
+        switch_plans_[from][to].stop_controllers.push_back(all_controllers_[from]);
+      }
+    }
+  }
+  running_controllers_.reserve(num_controllers);
+  current_controller_index_ = default_controller_index_;
+
   controller_manager_ = controller_manager;
-  joint_command_sub_ = nh.subscribe("/franka_ros_interface/motion_controller/arm/joint_commands", 1,
+  joint_command_sub_ = nh.subscribe("franka_ros_interface/motion_controller/arm/joint_commands", 1,
                        &MotionControllerInterface::jointCommandCallback, this);
+  switch_to_service_ = nh.advertiseService("franka_ros_interface/motion_controller/arm/switch_to",
+                                           &MotionControllerInterface::switchToCallback, this);
 
-  // Command Timeout
-  joint_command_timeout_sub_ = nh.subscribe("/franka_ros_interface/motion_controller/arm/joint_command_timeout", 1,
-                       &MotionControllerInterface::jointCommandTimeoutCallback, this);
-  double command_timeout_default;
-  nh.param<double>("/controllers_config/command_timeout", command_timeout_default, 0.2);
-  auto p_cmd_timeout_length = std::make_shared<ros::Duration>(std::min(1.0,
-                                std::max(0.0, command_timeout_default)));
-  box_timeout_length_.set(p_cmd_timeout_length);
+  // switches through this interface are published right away, others (spawners, the controller
+  // manager services) when the timer notices them
+  controller_state_pub_ = nh.advertise<franka_core_msgs::ControllerManagerState>(
+      "franka_ros_interface/motion_controller/arm/controller_manager_state", 1, true);
+  double state_check_rate(10.0);
+  nh.param("controllers_config/state_check_rate", state_check_rate, state_check_rate);
+  if (!(state_check_rate > 0.0)) {
+    ROS_WARN_STREAM_NAMED("MotionControllerInterface", "Invalid controllers_config/state_check_rate "
+                          << state_check_rate << ", using 10 Hz");
+    state_check_rate = 10.0;
+  }
+  publishControllerState(true);
+  controller_state_timer_ = nh.createTimer(ros::Duration(1.0 / state_check_rate),
+                                           &MotionControllerInterface::controllerStateTimerCallback,
+                                           this);
+
+  // The command timeout is checked by the controllers themselves in their control loop (see
+  // franka_ros_controllers::CommandWatchdog).
 
   ROS_INFO_STREAM("MotionControllerInterface Initialised");
+}
 
-  // Update at 100Hz
-  cmd_timeout_timer_ = nh.createTimer(100, &MotionControllerInterface::commandTimeoutCheck, this);
+void MotionControllerInterface::preloadControllers(StartupTimer& timer) {
+  if (!preload_) {
+    return;
+  }
+  for (const std::string& name : all_controllers_) {
+    if (name == default_controller_name_ || name == trajectory_controller_name_ ||
+        controller_manager_->getControllerByName(name) != nullptr ||
+        !nh_.hasParam(name + "/type")) {
+      continue;
+    }
+    if (!controller_manager_->loadController(name)) {
+      ROS_WARN_STREAM_NAMED("MotionControllerInterface", "Failed to preload " << name
+                            << ", it will be loaded when it is first used");
+    }
+    timer.phaseFinished(name.substr(name.rfind('/') + 1));
+  }
+}
+
+bool MotionControllerInterface::switchToDefaultController() {
+  return switchToController(default_controller_index_);
 }
 
-void MotionControllerInterface::commandTimeoutCheck(const ros::TimerEvent& e) {
-  // lock out other thread(s) which are getting called back via ros.
+bool MotionControllerInterface::startTrajectoryController() {
+  if (isRunning(trajectory_controller_name_)) {
+    return true;
+  }
   std::lock_guard<std::mutex> guard(mtx_);
-  // Check Command Timeout
-  std::shared_ptr<const ros::Duration>  p_timeout_length;
-  box_timeout_length_.get(p_timeout_length);
-  std::shared_ptr<const ros::Time>  p_cmd_msg_time;
-  box_cmd_timeout_.get(p_cmd_msg_time);
-  bool command_timeout = (p_cmd_msg_time && p_timeout_length &&
-      ((ros::Time::now() - *p_cmd_msg_time.get()) > (*p_timeout_length.get())));
-  if(command_timeout && (current_controller_name_ != default_controller_name_)) {
-    // Timeout violated, force robot back to Default Controller Mode
-
-    ROS_WARN_STREAM("MotionControllerInterface: Command timeout violated: Switching to Default control mode." << default_controller_name_);
-    switchToDefaultController();
+  if (controller_manager_->getControllerByName(trajectory_controller_name_) == nullptr &&
+      !controller_manager_->loadController(trajectory_controller_name_)) {
+    ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Failed to load "
+                            << trajectory_controller_name_);
+    return false;
   }
+  return switchToController(trajectory_controller_index_);
 }
 
-bool MotionControllerInterface::switchToDefaultController() {
+bool MotionControllerInterface::pauseMotionControllersAndDo(
+    const std::function<bool(std::string&)>& apply, std::string& error) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  const std::vector<std::string> none;
+  std::vector<std::string> paused;
+  for (const std::string& name : all_controllers_) {
+    if (isRunning(name) && std::find(paused.cbegin(), paused.cend(), name) == paused.cend()) {
+      paused.push_back(name);
+    }
+  }
+  if (!paused.empty() &&
+      !controller_manager_->switchController(
+          none, paused, controller_manager_msgs::SwitchController::Request::STRICT)) {
+    error = "failed to stop the motion controllers";
+    return false;
+  }
+  bool applied = apply(error);
+  bool restarted =
+      paused.empty() ||
+      controller_manager_->switchController(
+          paused, none, controller_manager_msgs::SwitchController::Request::STRICT);
+  if (!restarted) {
+    ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Failed to restart the paused controllers");
+    error = applied ? "failed to restart the motion controllers"
+                    : error + "; failed to restart the motion controllers";
+  }
+  publishControllerState(false);
+  return applied && restarted;
+}
 
-  std::vector<std::string> start_controllers; 
-  std::vector<std::string> stop_controllers;
+bool MotionControllerInterface::isRunning(const std::string& controller_name) const {
+  controller_interface::ControllerBase* controller =
+      controller_manager_->getControllerByName(controller_name);
+  return controller != nullptr && controller->isRunning();
+}
 
-  for (size_t i = 0; i < all_controllers_.size(); ++i) {
+bool MotionControllerInterface::switchToController(size_t controller_index) {
+  auto switch_start = std::chrono::steady_clock::now();
+  const SwitchPlan& plan = switch_plans_[current_controller_index_][controller_index];
 
-    if (all_controllers_[i] == default_controller_name_)
-      start_controllers.push_back(all_controllers_[i]);
-    else stop_controllers.push_back(all_controllers_[i]);
-  }
-  if (!controller_manager_->switchController(start_controllers, stop_controllers,
-                              controller_manager_msgs::SwitchController::Request::BEST_EFFORT))
-    {
-      ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Failed to switch controllers");
-      return false;
+  auto find_running_controllers = [&]() {
+    running_controllers_.clear();
+    for (size_t i = 0; i < all_controllers_.size(); ++i) {
+      if (all_controllers_[i] != all_controllers_[controller_index] && isRunning(all_controllers_[i])) {
+        running_controllers_.push_back(all_controllers_[i]);
+      }
     }
-    current_controller_name_ = start_controllers[0];
-    current_mode_ = controller_name_to_mode_map_[current_controller_name_];
-    ROS_INFO_STREAM("MotionControllerInterface: Controller " << start_controllers[0]
-                            << " started; Controllers " << stop_controllers[0] <<
-                            ", " << stop_controllers[1] <<
-                            ", " << stop_controllers[2] <<
-                            ", " << stop_controllers[3] <<
-                            ", " << stop_controllers[4] <<
-                            ", " << stop_controllers[5] << " stopped.");
+  };
+
+  // the plan is only valid if the controller started last is still the one running
+  bool use_plan = isRunning(all_controllers_[current_controller_index_]);
+  if (!use_plan) {
+    find_running_controllers();
+  }
+  bool switched = controller_manager_->switchController(
+      plan.start_controllers, use_plan ? plan.stop_controllers : running_controllers_,
+      controller_manager_msgs::SwitchController::Request::BEST_EFFORT);
+  if (!switched && use_plan) {
+    // e.g. a conflicting controller was started through the controller manager services
+    find_running_controllers();
+    use_plan = false;
+    switched = controller_manager_->switchController(
+        plan.start_controllers, running_controllers_,
+        controller_manager_msgs::SwitchController::Request::BEST_EFFORT);
+  }
+  if (!switched || !isRunning(all_controllers_[controller_index])) {
+    ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Failed to switch controllers");
+    return false;
+  }
+  double switch_time = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - switch_start).count();
+
+  current_controller_index_ = controller_index;
+  current_controller_name_ = all_controllers_[controller_index];
+  current_mode_.store(controller_name_to_mode_map_[current_controller_name_],
+                      std::memory_order_release);
+
+  std::ostringstream stopped;
+  for (const std::string& name : use_plan ? plan.stop_controllers : running_controllers_) {
+    stopped << (stopped.tellp() > 0 ? ", " : "") << name;
+  }
+  ROS_INFO_STREAM("MotionControllerInterface: Controller " << current_controller_name_
+                  << " started; Controllers " << (stopped.tellp() > 0 ? stopped.str() : "(none)")
+                  << " stopped. Switch took " << switch_time << " ms.");
+  publishControllerState(false);
   return true;
 }
 
-
-void MotionControllerInterface::jointCommandTimeoutCallback(const std_msgs::Float64 msg) {
-  ROS_INFO_STREAM("MotionControllerInterface: Joint command timeout: " << msg.data);
-  auto p_cmd_timeout_length = std::make_shared<ros::Duration>(
-                                std::min(1.0, std::max(0.0, double(msg.data))));
-  box_timeout_length_.set(p_cmd_timeout_length);
+void MotionControllerInterface::publishControllerState(bool force) {
+  std::lock_guard<std::mutex> guard(state_mtx_);
+  controller_manager_->getControllerNames(controller_names_);
+  std::vector<controller_manager_msgs::ControllerState>& controllers =
+      controller_state_msg_.controllers;
+  bool changed = force || controllers.size() != controller_names_.size();
+  controllers.resize(controller_names_.size());
+  for (size_t i = 0; i < controller_names_.size(); ++i) {
+    const std::string& name = controller_names_[i];
+    const char* state = isRunning(name) ? "running" : "stopped";
+    if (controllers[i].name == name && controllers[i].state == state) {
+      continue;
+    }
+    changed = true;
+    auto type = controller_types_.find(name);
+    if (type == controller_types_.end()) {
+      // the type of a loaded controller does not change, so ask the parameter server only once
+      std::string type_name;
+      nh_.getParam(name + "/type", type_name);
+      type = controller_types_.emplace(name, type_name).first;
+    }
+    controllers[i].name = name;
+    controllers[i].state = state;
+    controllers[i].type = type->second;
+  }
+  if (changed) {
+    controller_state_msg_.header.stamp = ros::Time::now();
+    controller_state_pub_.publish(controller_state_msg_);
+  }
 }
 
-bool MotionControllerInterface::switchControllers(int control_mode) {
-  std::vector<std::string> start_controllers;
-  std::vector<std::string> stop_controllers;
 
-  if(current_mode_ != control_mode)
+bool MotionControllerInterface::switchToCallback(
+    franka_core_msgs::SwitchToController::Request& request,
+    franka_core_msgs::SwitchToController::Response& response) {
+  auto request_start = std::chrono::steady_clock::now();
+  auto elapsed = [&request_start]() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - request_start).count();
+  };
+  const std::string name = !request.controller_name.empty() && request.controller_name[0] == '/'
+                               ? request.controller_name.substr(1)
+                               : request.controller_name;
+  auto controller = std::find(all_controllers_.cbegin(), all_controllers_.cend(), name);
+  if (controller == all_controllers_.cend()) {
+    response.success = false;
+    response.message = "'" + name + "' is not one of the motion controllers of controllers_config";
+    return true;
+  }
+
+  uint64_t switch_cycle = 0;
   {
-    switch (control_mode)
-    {
-      case franka_core_msgs::JointCommand::POSITION_MODE:
-        start_controllers.push_back(position_controller_name_);
-        stop_controllers.push_back(impedance_controller_name_);
-        stop_controllers.push_back(torque_controller_name_);
-        stop_controllers.push_back(velocity_controller_name_);
-        stop_controllers.push_back(trajectory_controller_name_);
-        stop_controllers.push_back(force_controller_name_);
-        stop_controllers.push_back(ntorque_controller_name_);
-        stop_controllers.push_back(cartesian_impedance_controller_name_);
-        stop_controllers.push_back(joint_impedance_controller_name_);
-        break;
-      case franka_core_msgs::JointCommand::IMPEDANCE_MODE:
-        start_controllers.push_back(impedance_controller_name_);
-        stop_controllers.push_back(position_controller_name_);
-        stop_controllers.push_back(torque_controller_name_);
-        stop_controllers.push_back(velocity_controller_name_);
-        stop_controllers.push_back(trajectory_controller_name_);
-        stop_controllers.push_back(force_controller_name_);
-        stop_controllers.push_back(ntorque_controller_name_);
-        stop_controllers.push_back(cartesian_impedance_controller_name_);
-        stop_controllers.push_back(joint_impedance_controller_name_);
-        break;
-      case franka_core_msgs::JointCommand::TORQUE_MODE:
-        start_controllers.push_back(torque_controller_name_);
-        stop_controllers.push_back(position_controller_name_);
-        stop_controllers.push_back(impedance_controller_name_);
-        stop_controllers.push_back(velocity_controller_name_);
-        stop_controllers.push_back(trajectory_controller_name_);
-        stop_controllers.push_back(force_controller_name_);
-        stop_controllers.push_back(ntorque_controller_name_);
-        stop_controllers.push_back(cartesian_impedance_controller_name_);
-        stop_controllers.push_back(joint_impedance_controller_name_);
-        break;
-      case franka_core_msgs::JointCommand::VELOCITY_MODE:
-        start_controllers.push_back(velocity_controller_name_);
-        stop_controllers.push_back(position_controller_name_);
-        stop_controllers.push_back(impedance_controller_name_);
-        stop_controllers.push_back(torque_controller_name_);
-        stop_controllers.push_back(trajectory_controller_name_);
-        stop_controllers.push_back(force_controller_name_);
-        stop_controllers.push_back(ntorque_controller_name_);
-        stop_controllers.push_back(cartesian_impedance_controller_name_);
-        stop_controllers.push_back(joint_impedance_controller_name_);
-        break;        
-      default:
-        ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Unknown JointCommand mode "
-                                << control_mode << ". Ignoring command.");
-        return false;
+    std::lock_guard<std::mutex> guard(mtx_);
+    response.previous_controller = current_controller_name_;
+    if (isRunning(name)) {
+      response.success = true;
+      response.message = name + " is running already";
+      response.switch_duration = elapsed();
+      return true;
     }
-    if (!controller_manager_->switchController(start_controllers, stop_controllers,
-                              controller_manager_msgs::SwitchController::Request::BEST_EFFORT))
-    {
-      ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Failed to switch controllers");
-      return false;
+    if (controller_manager_->getControllerByName(name) == nullptr &&
+        !controller_manager_->loadController(name)) {
+      response.success = false;
+      response.message = "failed to load " + name;
+      return true;
+    }
+    if (!switchToController(controller - all_controllers_.cbegin())) {
+      response.success = false;
+      response.message = "failed to switch from " + response.previous_controller + " to " + name;
+      return true;
+    }
+    switch_cycle = update_cycles_.load(std::memory_order_acquire);
+  }
+
+  // the switch is done at the end of a cycle, which may not have been counted yet; the cycle
+  // after it is the first one that updates the new controller
+  const double timeout = request.timeout > 0.0 ? request.timeout : kDefaultSwitchTimeout;
+  while (update_cycles_.load(std::memory_order_acquire) < switch_cycle + 2) {
+    if (elapsed() > timeout) {
+      response.success = false;
+      response.message = name + " was started but not updated within " +
+                         std::to_string(timeout) + " s";
+      response.switch_duration = elapsed();
+      return true;
     }
-    current_mode_ = control_mode;
-    current_controller_name_ = start_controllers[0];
-    ROS_INFO_STREAM("MotionControllerInterface: Controller " << start_controllers[0]
-                            << " started; Controllers " << stop_controllers[0] <<
-                            ", " << stop_controllers[1] <<
-                            ", " << stop_controllers[2] <<
-                            ", " << stop_controllers[3] <<
-                            ", " << stop_controllers[4] <<
-                            ", " << stop_controllers[5] << " stopped.");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
   }
+  response.success = true;
+  response.switch_duration = elapsed();
+  response.message = "switched from " + response.previous_controller + " to " + name + " in " +
+                     std::to_string(response.switch_duration * 1e3) + " ms";
   return true;
 }
 
+bool MotionControllerInterface::switchControllers(int control_mode) {
+  if (current_mode_.load(std::memory_order_relaxed) == control_mode) {
+    return true;
+  }
+  auto controller = mode_to_controller_index_.find(control_mode);
+  if (controller == mode_to_controller_index_.end()) {
+    ROS_ERROR_STREAM_NAMED("MotionControllerInterface", "Unknown JointCommand mode "
+                            << control_mode << ". Ignoring command.");
+    return false;
+  }
+  return switchToController(controller->second);
+}
+
 void MotionControllerInterface::jointCommandCallback(const franka_core_msgs::JointCommandConstPtr& msg) {
-  // lock out other thread(s) which are getting called back via ros.
-  std::lock_guard<std::mutex> guard(mtx_);
-  if(switchControllers(msg->mode)) {
-    auto p_cmd_msg_time = std::make_shared<ros::Time>(ros::Time::now());
-    box_cmd_timeout_.set(p_cmd_msg_time);
+  // commands for the running mode are the common case and need neither the lock nor a switch
+  if (msg->mode != current_mode_.load(std::memory_order_acquire)) {
+    // lock out other thread(s) which are getting called back via ros.
+    std::lock_guard<std::mutex> guard(mtx_);
+    switchControllers(msg->mode);
   }
 }
 
@@ -0,0 +1,331 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/motion_primitive_server.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <franka_core_msgs/RobotState.h>
+
+namespace franka_interface {
+
+constexpr double MotionPrimitiveServer::kDefaultPositionTolerance;
+constexpr double MotionPrimitiveServer::kDefaultTimeout;
+constexpr double MotionPrimitiveServer::kSettleTime;
+
+bool MotionPrimitiveServer::init(ros::NodeHandle& nh,
+                                 MotionControllerInterface& motion_controller_interface,
+                                 std::shared_ptr<const MultiArmState> multi_arm_state,
+                                 size_t arm_index, ErrorRecovery error_recovery) {
+  if (!nh.getParam("robot_config/joint_names", joint_names_) || joint_names_.size() != 7) {
+    ROS_ERROR("MotionPrimitiveServer: Invalid or no robot_config/joint_names parameter provided");
+    return false;
+  }
+  for (size_t i = 0; i < 7; ++i) {
+    if (!nh.getParam("robot_config/joint_config/joint_velocity_limit/" + joint_names_[i],
+                     velocity_limits_[i]) ||
+        velocity_limits_[i] <= 0.0) {
+      ROS_ERROR_STREAM("MotionPrimitiveServer: Invalid or no velocity limit of "
+                       << joint_names_[i] << " provided");
+      return false;
+    }
+    if (!nh.getParam("robot_config/joint_config/joint_acceleration_limit/" + joint_names_[i],
+                     acceleration_limits_[i]) ||
+        acceleration_limits_[i] <= 0.0) {
+      ROS_ERROR_STREAM("MotionPrimitiveServer: Invalid or no acceleration limit of "
+                       << joint_names_[i] << " provided");
+      return false;
+    }
+  }
+  nh.param<double>("control_node_config/motion_primitives/check_rate", check_rate_, 1000.0);
+  nh.param<double>("control_node_config/motion_primitives/feedback_rate", feedback_rate_, 20.0);
+  if (check_rate_ <= 0.0 || feedback_rate_ <= 0.0) {
+    ROS_ERROR("MotionPrimitiveServer: check_rate and feedback_rate must be positive");
+    return false;
+  }
+  nh.param<double>("control_node_config/motion_primitives/sample_period", sample_period_, 0.01);
+  nh.param<int>("control_node_config/motion_primitives/grid_points_per_segment",
+                grid_points_per_segment_, 100);
+  if (sample_period_ <= 0.0 || grid_points_per_segment_ <= 0) {
+    ROS_ERROR("MotionPrimitiveServer: sample_period and grid_points_per_segment must be positive");
+    return false;
+  }
+
+  motion_controller_interface_ = &motion_controller_interface;
+  multi_arm_state_ = std::move(multi_arm_state);
+  arm_index_ = arm_index;
+  error_recovery_ = std::move(error_recovery);
+
+  trajectory_client_ = std::make_unique<TrajectoryClient>(
+      nh, motion_controller_interface.trajectoryControllerName() + "/follow_joint_trajectory",
+      false);
+  server_ = std::make_unique<actionlib::SimpleActionServer<franka_core_msgs::JointMotionAction>>(
+      nh, "franka_ros_interface/motion_primitives/joint_motion",
+      [this](const franka_core_msgs::JointMotionGoalConstPtr& goal) { execute(goal); }, false);
+  server_->start();
+  time_parameterize_service_ =
+      nh.advertiseService("franka_ros_interface/motion_primitives/time_parameterize_path",
+                          &MotionPrimitiveServer::timeParameterizePath, this);
+
+  ROS_INFO_STREAM("MotionPrimitiveServer Initialised");
+  return true;
+}
+
+bool MotionPrimitiveServer::makeTrajectory(const Goal& goal, const std::array<double, 7>& start,
+                                           control_msgs::FollowJointTrajectoryGoal& trajectory,
+                                           std::string& error) const {
+  if (goal.waypoints.empty()) {
+    error = "no waypoints";
+    return false;
+  }
+  bool timed = std::any_of(goal.waypoints.cbegin(), goal.waypoints.cend(),
+                           [](const trajectory_msgs::JointTrajectoryPoint& point) {
+                             return !point.time_from_start.isZero();
+                           });
+
+  std::vector<std::array<double, 7>> path{start};
+  ros::Duration time_from_start(0.0);
+  for (size_t i = 0; i < goal.waypoints.size(); ++i) {
+    const trajectory_msgs::JointTrajectoryPoint& waypoint = goal.waypoints[i];
+    if (waypoint.positions.size() != 7 ||
+        !(waypoint.velocities.empty() || waypoint.velocities.size() == 7)) {
+      error = "waypoint " + std::to_string(i) + " needs 7 positions and no or 7 velocities";
+      return false;
+    }
+    if (!std::all_of(waypoint.positions.cbegin(), waypoint.positions.cend(),
+                     [](double position) { return std::isfinite(position); })) {
+      error = "waypoint " + std::to_string(i) + " has non-finite positions";
+      return false;
+    }
+    path.emplace_back();
+    std::copy(waypoint.positions.cbegin(), waypoint.positions.cend(), path.back().begin());
+    if (timed) {
+      if (waypoint.time_from_start <= time_from_start) {
+        error = "time_from_start must be strictly increasing and positive";
+        return false;
+      }
+      time_from_start = waypoint.time_from_start;
+    }
+  }
+
+  trajectory.trajectory.joint_names = joint_names_;
+  if (!timed) {
+    return timePath(path, goal.speed_ratio, sample_period_, trajectory.trajectory, error);
+  }
+  trajectory.trajectory.points = goal.waypoints;
+  for (trajectory_msgs::JointTrajectoryPoint& point : trajectory.trajectory.points) {
+    if (point.velocities.empty()) {
+      point.velocities.assign(7, 0.0);
+    }
+  }
+  return true;
+}
+
+bool MotionPrimitiveServer::timePath(const std::vector<std::array<double, 7>>& path,
+                                     double speed_ratio, double sample_period,
+                                     trajectory_msgs::JointTrajectory& trajectory,
+                                     std::string& error) const {
+  JointTrajectoryTiming timing(velocity_limits_, acceleration_limits_,
+                               static_cast<size_t>(grid_points_per_segment_));
+  if (!timing.compute(path, speed_ratio, error)) {
+    return false;
+  }
+  timing.toMessage(sample_period, trajectory);
+  return true;
+}
+
+bool MotionPrimitiveServer::timeParameterizePath(
+    franka_core_msgs::TimeParameterizePath::Request& request,
+    franka_core_msgs::TimeParameterizePath::Response& response) {
+  std::vector<std::array<double, 7>> path(request.waypoints.size());
+  for (size_t i = 0; i < request.waypoints.size(); ++i) {
+    if (request.waypoints[i].positions.size() != 7) {
+      response.message = "waypoint " + std::to_string(i) + " needs 7 positions";
+      return true;
+    }
+    std::copy(request.waypoints[i].positions.cbegin(), request.waypoints[i].positions.cend(),
+              path[i].begin());
+  }
+  response.trajectory.joint_names = joint_names_;
+  response.success = timePath(path, request.speed_ratio,
+                              request.sample_period > 0.0 ? request.sample_period : sample_period_,
+                              response.trajectory, response.message);
+  if (response.success) {
+    response.message = "duration " +
+                       std::to_string(response.trajectory.points.back().time_from_start.toSec()) +
+                       " s";
+  }
+  return true;
+}
+
+void MotionPrimitiveServer::execute(const franka_core_msgs::JointMotionGoalConstPtr& goal) {
+  const ros::Time start = ros::Time::now();
+  SharedRobotState state;
+  if (!multi_arm_state_->latest(arm_index_, state)) {
+    finish(Result::CONTROLLER_FAILED, "no robot state available", state, start);
+    return;
+  }
+
+  control_msgs::FollowJointTrajectoryGoal trajectory;
+  std::string error;
+  if (goal->stop_condition > Goal::IGNORE_CONTACT) {
+    finish(Result::INVALID_GOAL, "unknown stop_condition", state, start);
+    return;
+  }
+  if (!makeTrajectory(*goal, state.q, trajectory, error)) {
+    finish(Result::INVALID_GOAL, error, state, start);
+    return;
+  }
+  if (!motion_controller_interface_->startTrajectoryController()) {
+    finish(Result::CONTROLLER_FAILED, "could not start the trajectory controller", state, start);
+    return;
+  }
+  if (!trajectory_client_->waitForServer(ros::Duration(1.0))) {
+    finish(Result::CONTROLLER_FAILED, "trajectory controller action server is not available",
+           state, start);
+    return;
+  }
+
+  std::array<double, 7> target;
+  std::copy(goal->waypoints.back().positions.cbegin(), goal->waypoints.back().positions.cend(),
+            target.begin());
+  const double tolerance =
+      goal->position_tolerance > 0.0 ? goal->position_tolerance : kDefaultPositionTolerance;
+  const ros::Duration timeout(goal->timeout > 0.0 ? goal->timeout : kDefaultTimeout);
+  const ros::Duration trajectory_duration = trajectory.trajectory.points.back().time_from_start;
+
+  trajectory_client_->sendGoal(trajectory);
+  // the trajectory is unstamped, so it starts when the controller receives it
+  const ros::Time trajectory_end = ros::Time::now() + trajectory_duration;
+  MotionCompletion completion(target, tolerance, trajectory_end);
+  // completion is only checked from the end of the trajectory on; leave the arm time to settle
+  const ros::Time deadline =
+      std::max(start + timeout, trajectory_end + ros::Duration(kSettleTime));
+
+  const ros::Duration feedback_period(1.0 / feedback_rate_);
+  ros::Time next_feedback = start;
+  franka_core_msgs::JointMotionFeedback feedback;
+  ros::Rate rate(check_rate_);
+  while (ros::ok()) {
+    if (server_->isPreemptRequested()) {
+      trajectory_client_->cancelGoal();
+      finish(Result::PREEMPTED, "preempted", state, start);
+      return;
+    }
+
+    if (multi_arm_state_->latest(arm_index_, state)) {
+      if ((state.contact_flags & SharedRobotState::kCollision) != 0 &&
+          goal->stop_condition != Goal::IGNORE_CONTACT) {
+        trajectory_client_->cancelGoal();
+        if (goal->stop_condition == Goal::STOP_ON_COLLISION) {
+          finish(Result::COLLISION, "collision detected", state, start);
+          return;
+        }
+        // a collision reaching the threshold of the collision behaviour causes a reflex, which
+        // shows in the robot mode within a few cycles
+        if (goal->recover_from_reflex) {
+          const ros::Time reflex_deadline = ros::Time::now() + ros::Duration(0.1);
+          SharedRobotState latest = state;
+          while (latest.robot_mode != franka_core_msgs::RobotState::ROBOT_MODE_REFLEX &&
+                 ros::Time::now() < reflex_deadline && ros::ok()) {
+            rate.sleep();
+            multi_arm_state_->latest(arm_index_, latest);
+          }
+          if (latest.robot_mode == franka_core_msgs::RobotState::ROBOT_MODE_REFLEX &&
+              !error_recovery_(error)) {
+            finish(Result::REFLEX, "error recovery failed: " + error, state, start);
+            return;
+          }
+        }
+        finish(Result::SUCCEEDED, "contact", state, start);
+        return;
+      }
+
+      const bool trajectory_succeeded =
+          trajectory_client_->getState() == actionlib::SimpleClientGoalState::SUCCEEDED;
+      if (completion.reached(ros::Time::now(), state.q, trajectory_succeeded)) {
+        if (goal->stop_condition == Goal::STOP_ON_CONTACT) {
+          finish(Result::NO_CONTACT, "reached the last waypoint without a contact", state, start);
+        } else {
+          finish(Result::SUCCEEDED, "", state, start);
+        }
+        return;
+      }
+      if (state.robot_mode == franka_core_msgs::RobotState::ROBOT_MODE_REFLEX) {
+        trajectory_client_->cancelGoal();
+        finish(Result::REFLEX, "the robot stopped in a reflex", state, start);
+        return;
+      }
+
+      const ros::Time now = ros::Time::now();
+      if (now >= next_feedback) {
+        feedback.time_from_start = (now - start).toSec();
+        feedback.position_error = completion.positionError();
+        server_->publishFeedback(feedback);
+        next_feedback = now + feedback_period;
+      }
+    }
+
+    actionlib::SimpleClientGoalState trajectory_state = trajectory_client_->getState();
+    if (trajectory_state == actionlib::SimpleClientGoalState::REJECTED ||
+        trajectory_state == actionlib::SimpleClientGoalState::ABORTED) {
+      finish(Result::CONTROLLER_FAILED,
+             "trajectory controller: " + trajectory_state.toString() + " " +
+                 trajectory_state.getText(),
+             state, start);
+      return;
+    }
+    if (ros::Time::now() >= deadline) {
+      trajectory_client_->cancelGoal();
+      finish(Result::TIMEOUT, "timed out", state, start);
+      return;
+    }
+    rate.sleep();
+  }
+  trajectory_client_->cancelGoal();
+  finish(Result::PREEMPTED, "shutting down", state, start);
+}
+
+void MotionPrimitiveServer::finish(int32_t error_code, const std::string& error_string,
+                                   const SharedRobotState& state, const ros::Time& start) {
+  Result result;
+  result.error_code = error_code;
+  result.error_string = error_string;
+  result.positions.assign(state.q.cbegin(), state.q.cend());
+  result.collision = (state.contact_flags & SharedRobotState::kCollision) != 0;
+  result.duration = (ros::Time::now() - start).toSec();
+  if (error_code == Result::SUCCEEDED) {
+    server_->setSucceeded(result, error_string);
+  } else if (error_code == Result::PREEMPTED) {
+    server_->setPreempted(result, error_string);
+  } else {
+    ROS_WARN_STREAM("MotionPrimitiveServer: Motion aborted: " << error_string);
+    server_->setAborted(result, error_string);
+  }
+}
+
+}  // namespace franka_interface
@@ -0,0 +1,276 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/panda_model.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace franka_interface {
+
+namespace {
+
+constexpr double kFlangeOffset = 0.107;  // [m] along z of the link 7 frame
+const Eigen::Vector3d kGravity(0.0, 0.0, -9.81);
+
+Eigen::Matrix3d inertia(double xx, double xy, double xz, double yy, double yz, double zz) {
+  Eigen::Matrix3d I;
+  I << xx, xy, xz, xy, yy, yz, xz, yz, zz;
+  return I;
+}
+
+Eigen::Isometry3d toIsometry(const std::array<double, 16>& transform) {
+  Eigen::Isometry3d T;
+  T.matrix() = Eigen::Map<const Eigen::Matrix4d>(transform.data());
+  return T;
+}
+
+// inertia of a body of the given mass about a point that is offset from its center of mass
+Eigen::Matrix3d parallelAxis(const Eigen::Matrix3d& inertia, double mass,
+                             const Eigen::Vector3d& offset) {
+  return inertia +
+         mass * (offset.squaredNorm() * Eigen::Matrix3d::Identity() - offset * offset.transpose());
+}
+
+// transform from the frame of the link to the frame of the previous link (modified DH)
+Eigen::Isometry3d jointTransform(double a, double d, double alpha, double theta) {
+  const double ct = std::cos(theta);
+  const double st = std::sin(theta);
+  const double ca = std::cos(alpha);
+  const double sa = std::sin(alpha);
+  Eigen::Isometry3d T;
+  T.matrix() << ct, -st, 0.0, a,
+                st * ca, ct * ca, -sa, -sa * d,
+                st * sa, ct * sa, ca, ca * d,
+                0.0, 0.0, 0.0, 1.0;
+  return T;
+}
+
+}  // anonymous namespace
+
+PandaModel::PandaModel() {
+  // clang-format off
+  //          a        d      alpha    mass         center of mass
+  arm_[0] = {0.0,     0.333, 0.0,      4.970684, { 3.875e-03,  2.081e-03, -0.1750},
+             inertia(7.0337e-01, -1.3900e-04,  6.7720e-03, 7.0661e-01,  1.9169e-02, 9.1170e-03)};
+  arm_[1] = {0.0,     0.0,   -M_PI_2,  0.646926, {-3.141e-03, -2.872e-02,  3.495e-03},
+             inertia(7.9620e-03, -3.9250e-03,  1.0254e-02, 2.8110e-02,  7.0400e-04, 2.5995e-02)};
+  arm_[2] = {0.0,     0.316, M_PI_2,   3.228604, { 2.7518e-02, 3.9252e-02, -6.6502e-02},
+             inertia(3.7242e-02, -4.7610e-03, -1.1396e-02, 3.6155e-02, -1.2805e-02, 1.0830e-02)};
+  arm_[3] = {0.0825,  0.0,   M_PI_2,   3.587895, {-5.317e-02,  1.04419e-01, 2.7454e-02},
+             inertia(2.5853e-02,  7.7960e-03, -1.3320e-03, 1.9552e-02,  8.6410e-03, 2.8323e-02)};
+  arm_[4] = {-0.0825, 0.384, -M_PI_2,  1.225946, {-1.1953e-02, 4.1065e-02, -3.8437e-02},
+             inertia(3.5549e-02, -2.1170e-03, -4.0370e-03, 2.9474e-02,  2.2900e-04, 8.6270e-03)};
+  arm_[5] = {0.0,     0.0,   M_PI_2,   1.666555, { 6.0149e-02, -1.4117e-02, -1.0517e-02},
+             inertia(1.9640e-03,  1.0900e-04, -1.1580e-03, 4.3540e-03,  3.4100e-04, 5.4330e-03)};
+  arm_[6] = {0.088,   0.0,   M_PI_2,   7.35522e-01, {1.0517e-02, -4.252e-03,  6.1597e-02},
+             inertia(1.2516e-02, -4.2800e-04, -1.1960e-03, 1.0027e-02, -7.4100e-04, 4.8150e-03)};
+  // clang-format on
+  // Franka Hand, as configured by default in Desk
+  setLoad(0.73, {{-0.01, 0.0, 0.03}}, {{0.001, 0.0, 0.0, 0.0, 0.0025, 0.0, 0.0, 0.0, 0.0017}});
+}
+
+void PandaModel::setLoad(double mass,
+                         const std::array<double, 3>& F_x_Cload,
+                         const std::array<double, 9>& load_inertia) {
+  links_ = arm_;
+  Link& link = links_[6];
+  const Link& arm = arm_[6];
+  const Eigen::Vector3d load_com =
+      Eigen::Map<const Eigen::Vector3d>(F_x_Cload.data()) + Eigen::Vector3d(0.0, 0.0, kFlangeOffset);
+  link.mass = arm.mass + mass;
+  if (link.mass <= 0.0) {
+    return;
+  }
+  link.com = (arm.mass * arm.com + mass * load_com) / link.mass;
+  link.inertia = parallelAxis(arm.inertia, arm.mass, arm.com - link.com) +
+                 parallelAxis(Eigen::Map<const Eigen::Matrix3d>(load_inertia.data()), mass,
+                              load_com - link.com);
+}
+
+void PandaModel::linkPoses(const Vector7d& q, std::array<Eigen::Isometry3d, 7>& T_0_i) const {
+  Eigen::Isometry3d T = Eigen::Isometry3d::Identity();
+  for (size_t i = 0; i < 7; ++i) {
+    const Link& link = links_[i];
+    T = T * jointTransform(link.a, link.d, link.alpha, q[i]);
+    T_0_i[i] = T;
+  }
+}
+
+Eigen::Isometry3d PandaModel::framePose(franka::Frame frame,
+                                        const std::array<Eigen::Isometry3d, 7>& T_0_i,
+                                        const std::array<double, 16>& F_T_EE,
+                                        const std::array<double, 16>& EE_T_K) const {
+  const size_t index = static_cast<size_t>(frame);
+  if (index < 7) {
+    return T_0_i[index];
+  }
+  Eigen::Isometry3d T = T_0_i[6] * Eigen::Translation3d(0.0, 0.0, kFlangeOffset);
+  if (frame == franka::Frame::kFlange) {
+    return T;
+  }
+  T = T * toIsometry(F_T_EE);
+  if (frame == franka::Frame::kEndEffector) {
+    return T;
+  }
+  return T * toIsometry(EE_T_K);
+}
+
+std::array<double, 16> PandaModel::pose(franka::Frame frame, const Vector7d& q,
+                                        const std::array<double, 16>& F_T_EE,
+                                        const std::array<double, 16>& EE_T_K) const {
+  std::array<Eigen::Isometry3d, 7> T_0_i;
+  linkPoses(q, T_0_i);
+  std::array<double, 16> pose;
+  Eigen::Map<Eigen::Matrix4d>(pose.data()) = framePose(frame, T_0_i, F_T_EE, EE_T_K).matrix();
+  return pose;
+}
+
+std::array<double, 42> PandaModel::zeroJacobian(franka::Frame frame, const Vector7d& q,
+                                                const std::array<double, 16>& F_T_EE,
+                                                const std::array<double, 16>& EE_T_K) const {
+  std::array<Eigen::Isometry3d, 7> T_0_i;
+  linkPoses(q, T_0_i);
+  const Eigen::Vector3d p = framePose(frame, T_0_i, F_T_EE, EE_T_K).translation();
+  // joint i rotates about z of the frame of link i + 1, and only moves the frames after it
+  const size_t joints = std::min<size_t>(static_cast<size_t>(frame) + 1, 7);
+  std::array<double, 42> jacobian{};
+  Eigen::Map<Eigen::Matrix<double, 6, 7>> J(jacobian.data());
+  for (size_t i = 0; i < joints; ++i) {
+    const Eigen::Vector3d z = T_0_i[i].linear().col(2);
+    J.col(i) << z.cross(p - T_0_i[i].translation()), z;
+  }
+  return jacobian;
+}
+
+PandaModel::Vector7d PandaModel::inverseDynamics(const Vector7d& q, const Vector7d& dq,
+                                                 const Vector7d& ddq, bool with_gravity) const {
+  // forward recursion of the link velocities and accelerations, in the link frames; gravity is
+  // an upward acceleration of the base
+  std::array<Eigen::Matrix3d, 7> R;  // rotation of the frame of link i + 1 w.r.t. the previous
+  std::array<Eigen::Vector3d, 7> p;  // origin of the frame of link i + 1 in the previous frame
+  std::array<Eigen::Vector3d, 7> F;  // net force on link i + 1, at its center of mass
+  std::array<Eigen::Vector3d, 7> N;  // net moment on link i + 1, about its center of mass
+  const Eigen::Vector3d z = Eigen::Vector3d::UnitZ();
+  Eigen::Vector3d w = Eigen::Vector3d::Zero();
+  Eigen::Vector3d dw = Eigen::Vector3d::Zero();
+  Eigen::Vector3d dv = with_gravity ? Eigen::Vector3d(-kGravity) : Eigen::Vector3d::Zero();
+  for (size_t i = 0; i < 7; ++i) {
+    const Link& link = links_[i];
+    const Eigen::Isometry3d T = jointTransform(link.a, link.d, link.alpha, q[i]);
+    R[i] = T.linear();
+    p[i] = T.translation();
+    const Eigen::Matrix3d Rt = R[i].transpose();
+
+    dv = Rt * (dv + dw.cross(p[i]) + w.cross(w.cross(p[i])));
+    dw = Rt * dw + (Rt * w).cross(dq[i] * z) + ddq[i] * z;
+    w = Rt * w + dq[i] * z;
+
+    const Eigen::Vector3d dv_com = dv + dw.cross(link.com) + w.cross(w.cross(link.com));
+    F[i] = link.mass * dv_com;
+    N[i] = link.inertia * dw + w.cross(link.inertia * w);
+  }
+
+  // backward recursion of the forces and moments transmitted by the joints
+  Vector7d tau;
+  Eigen::Vector3d f = Eigen::Vector3d::Zero();
+  Eigen::Vector3d n = Eigen::Vector3d::Zero();
+  for (int i = 6; i >= 0; --i) {
+    Eigen::Vector3d f_next = Eigen::Vector3d::Zero();
+    Eigen::Vector3d n_next = Eigen::Vector3d::Zero();
+    if (i < 6) {
+      f_next = R[i + 1] * f;
+      n_next = R[i + 1] * n + p[i + 1].cross(f_next);
+    }
+    f = f_next + F[i];
+    n = n_next + N[i] + links_[i].com.cross(F[i]);
+    tau[i] = n.dot(z);
+  }
+  return tau;
+}
+
+PandaModel::Vector7d PandaModel::gravity(const Vector7d& q) const {
+  return inverseDynamics(q, Vector7d::Zero(), Vector7d::Zero(), true);
+}
+
+PandaModel::Vector7d PandaModel::coriolis(const Vector7d& q, const Vector7d& dq) const {
+  return inverseDynamics(q, dq, Vector7d::Zero(), false);
+}
+
+PandaModel::Matrix7d PandaModel::mass(const Vector7d& q) const {
+  // M = sum over the links of m J_v^T J_v + J_w^T I J_w, with the Jacobians of the centers of
+  // mass: a fraction of the cost of one Newton-Euler pass per column
+  std::array<Eigen::Isometry3d, 7> T_0_i;
+  linkPoses(q, T_0_i);
+  Matrix7d M = Matrix7d::Zero();
+  Eigen::Matrix<double, 3, 7> J_v;
+  Eigen::Matrix<double, 3, 7> J_w;
+  for (size_t k = 0; k < 7; ++k) {
+    const Link& link = links_[k];
+    const Eigen::Vector3d com = T_0_i[k] * link.com;
+    const Eigen::Matrix3d inertia =
+        T_0_i[k].linear() * link.inertia * T_0_i[k].linear().transpose();
+    const int joints = static_cast<int>(k) + 1;
+    for (int i = 0; i < joints; ++i) {
+      const Eigen::Vector3d z = T_0_i[i].linear().col(2);
+      J_v.col(i) = z.cross(com - T_0_i[i].translation());
+      J_w.col(i) = z;
+    }
+    M.topLeftCorner(joints, joints) +=
+        link.mass * J_v.leftCols(joints).transpose() * J_v.leftCols(joints) +
+        J_w.leftCols(joints).transpose() * inertia * J_w.leftCols(joints);
+  }
+  return M;
+}
+
+std::array<double, 7> PandaModelSource::getCoriolis() const {
+  std::array<double, 7> coriolis;
+  Eigen::Map<PandaModel::Vector7d>(coriolis.data()) =
+      model_.coriolis(Eigen::Map<const PandaModel::Vector7d>(robot_state_.q.data()),
+                      Eigen::Map<const PandaModel::Vector7d>(robot_state_.dq.data()));
+  return coriolis;
+}
+
+std::array<double, 7> PandaModelSource::getGravity() const {
+  std::array<double, 7> gravity;
+  Eigen::Map<PandaModel::Vector7d>(gravity.data()) =
+      model_.gravity(Eigen::Map<const PandaModel::Vector7d>(robot_state_.q.data()));
+  return gravity;
+}
+
+std::array<double, 49> PandaModelSource::getMass() const {
+  std::array<double, 49> mass;
+  Eigen::Map<PandaModel::Matrix7d>(mass.data()) =
+      model_.mass(Eigen::Map<const PandaModel::Vector7d>(robot_state_.q.data()));
+  return mass;
+}
+
+std::array<double, 42> PandaModelSource::getZeroJacobian(const franka::Frame& frame) const {
+  return model_.zeroJacobian(frame, Eigen::Map<const PandaModel::Vector7d>(robot_state_.q.data()),
+                             robot_state_.F_T_EE, robot_state_.EE_T_K);
+}
+
+}  // namespace franka_interface
@@ -0,0 +1,216 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/realtime_settings.h>
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace franka_interface {
+
+namespace {
+
+bool readSize(const ros::NodeHandle& node_handle, const std::string& name, size_t& value,
+              std::string& error) {
+  int bytes = static_cast<int>(value);
+  node_handle.param("control_node_config/realtime/" + name, bytes, bytes);
+  if (bytes < 0) {
+    error = name + " must not be negative";
+    return false;
+  }
+  value = static_cast<size_t>(bytes);
+  return true;
+}
+
+bool readCpus(const ros::NodeHandle& node_handle, const std::string& name, std::vector<int>& cpus,
+              std::string& error) {
+  node_handle.getParam("control_node_config/realtime/" + name, cpus);
+  for (int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      error = name + " contains the invalid core " + std::to_string(cpu);
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string describeCpus(const cpu_set_t& cpu_set) {
+  std::ostringstream stream;
+  const char* separator = "";
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      stream << separator << cpu;
+      separator = ",";
+    }
+  }
+  return stream.str();
+}
+
+}  // anonymous namespace
+
+bool RealtimeSettings::read(const ros::NodeHandle& node_handle, std::string& error) {
+  node_handle.param("control_node_config/realtime/control_priority", control_priority,
+                    control_priority);
+  if (control_priority < 0 || control_priority > sched_get_priority_max(SCHED_FIFO)) {
+    error = "control_priority must be in [0, " +
+            std::to_string(sched_get_priority_max(SCHED_FIFO)) + "]";
+    return false;
+  }
+  node_handle.param("control_node_config/realtime/command_priority", command_priority,
+                    command_priority);
+  if (command_priority < 0 || command_priority > sched_get_priority_max(SCHED_FIFO)) {
+    error = "command_priority must be in [0, " +
+            std::to_string(sched_get_priority_max(SCHED_FIFO)) + "]";
+    return false;
+  }
+  node_handle.param("control_node_config/realtime/lock_memory", lock_memory, lock_memory);
+  return readCpus(node_handle, "control_cpus", control_cpus, error) &&
+         readCpus(node_handle, "spinner_cpus", spinner_cpus, error) &&
+         readCpus(node_handle, "command_cpus", command_cpus, error) &&
+         readSize(node_handle, "background_threads", background_threads, error) &&
+         readSize(node_handle, "prefault_stack", prefault_stack, error) &&
+         readSize(node_handle, "prefault_heap", prefault_heap, error);
+}
+
+bool lockProcessMemory(const RealtimeSettings& settings, std::string& report) {
+  std::ostringstream stream;
+  // the heap is pre-faulted before mlockall(MCL_CURRENT), so that its pages are among the
+  // current ones that get locked even if later allocations are not
+  bool heap_prefaulted = false;
+  if (settings.prefault_heap > 0) {
+    // keep freed memory in the heap instead of trimming it or serving large blocks with mmap,
+    // so that the pre-faulted pages stay mapped and are reused
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    auto* heap = static_cast<volatile char*>(std::malloc(settings.prefault_heap));
+    if (heap != nullptr) {
+      const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+      for (size_t i = 0; i < settings.prefault_heap; i += page) {
+        heap[i] = 0;
+      }
+      std::free(const_cast<char*>(heap));
+      heap_prefaulted = true;
+    }
+  }
+  bool locked = false;
+  if (settings.lock_memory) {
+    rlimit limit{};
+    bool unlimited = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY;
+    int flags = unlimited ? MCL_CURRENT | MCL_FUTURE : MCL_CURRENT;
+    if (mlockall(flags) != 0) {
+      report = std::string("mlockall failed: ") + std::strerror(errno) +
+               " (raise the memlock limit of the user)";
+      return false;
+    }
+    locked = true;
+    stream << (unlimited ? "memory locked (current and future pages)"
+                         : "memory locked (current pages only, RLIMIT_MEMLOCK is finite)");
+  } else {
+    stream << "memory not locked";
+  }
+  if (heap_prefaulted) {
+    stream << ", " << settings.prefault_heap << " bytes of heap pre-faulted"
+           << (locked ? " and locked" : " (not locked)");
+  } else if (settings.prefault_heap > 0) {
+    stream << ", could not allocate " << settings.prefault_heap << " bytes of heap to pre-fault";
+  }
+  report = stream.str();
+  return true;
+}
+
+bool configureCurrentThread(int priority, const std::vector<int>& cpus, std::string& error) {
+  if (!cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    if (result != 0) {
+      error = std::string("could not set the CPU affinity: ") + std::strerror(result);
+      return false;
+    }
+  }
+  if (priority > 0) {
+    sched_param parameters{};
+    parameters.sched_priority = priority;
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+    if (result != 0) {
+      error = "could not set SCHED_FIFO priority " + std::to_string(priority) + ": " +
+              std::strerror(result) + " (raise the rtprio limit of the user)";
+      return false;
+    }
+  }
+  return true;
+}
+
+void prefaultStack(size_t bytes) {
+  if (bytes == 0) {
+    return;
+  }
+  volatile char* stack = static_cast<volatile char*>(alloca(bytes));
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  for (size_t i = 0; i < bytes; i += page) {
+    stack[i] = 0;
+  }
+}
+
+std::string describeCurrentThread() {
+  std::ostringstream stream;
+  int policy = SCHED_OTHER;
+  sched_param parameters{};
+  if (pthread_getschedparam(pthread_self(), &policy, &parameters) == 0) {
+    switch (policy) {
+      case SCHED_FIFO:
+        stream << "SCHED_FIFO priority " << parameters.sched_priority;
+        break;
+      case SCHED_RR:
+        stream << "SCHED_RR priority " << parameters.sched_priority;
+        break;
+      default:
+        stream << "SCHED_OTHER";
+        break;
+    }
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0) {
+    stream << ", cores " << describeCpus(cpu_set);
+  }
+  return stream.str();
+}
+
+}  // namespace franka_interface
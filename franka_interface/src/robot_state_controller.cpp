@@ -29,18 +29,25 @@
 #include <franka_interface/robot_state_controller.h>
 
 #include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include <franka/errors.h>
 #include <franka_hw/franka_cartesian_command_interface.h>
+#include <franka_interface/arm_namespace.h>
 #include <franka_msgs/Errors.h>
 #include <hardware_interface/hardware_interface.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 #include <tf/tf.h>
 #include <tf/transform_datatypes.h>
+#include <tf2_ros/static_transform_broadcaster.h>
 
 namespace {
 
@@ -51,110 +58,78 @@ tf::Transform convertArrayToTf(const std::array<double, 16>& transform) {
   return tf::Transform(rotation, translation);
 }
 
-franka_msgs::Errors errorsToMessage(const franka::Errors& error) {
-  franka_msgs::Errors message;
-  message.joint_position_limits_violation =
-      static_cast<decltype(message.joint_position_limits_violation)>(
-          error.joint_position_limits_violation);
-  message.cartesian_position_limits_violation =
-      static_cast<decltype(message.cartesian_position_limits_violation)>(
-          error.cartesian_position_limits_violation);
-  message.self_collision_avoidance_violation =
-      static_cast<decltype(message.self_collision_avoidance_violation)>(
-          error.self_collision_avoidance_violation);
-  message.joint_velocity_violation =
-      static_cast<decltype(message.joint_velocity_violation)>(error.joint_velocity_violation);
-  message.cartesian_velocity_violation =
-      static_cast<decltype(message.cartesian_velocity_violation)>(
-          error.cartesian_velocity_violation);
-  message.force_control_safety_violation =
-      static_cast<decltype(message.force_control_safety_violation)>(
-          error.force_control_safety_violation);
-  message.joint_reflex = static_cast<decltype(message.joint_reflex)>(error.joint_reflex);
-  message.cartesian_reflex =
-      static_cast<decltype(message.cartesian_reflex)>(error.cartesian_reflex);
-  message.max_goal_pose_deviation_violation =
-      static_cast<decltype(message.max_goal_pose_deviation_violation)>(
-          error.max_goal_pose_deviation_violation);
-  message.max_path_pose_deviation_violation =
-      static_cast<decltype(message.max_path_pose_deviation_violation)>(
-          error.max_path_pose_deviation_violation);
-  message.cartesian_velocity_profile_safety_violation =
-      static_cast<decltype(message.cartesian_velocity_profile_safety_violation)>(
-          error.cartesian_velocity_profile_safety_violation);
-  message.joint_position_motion_generator_start_pose_invalid =
-      static_cast<decltype(message.joint_position_motion_generator_start_pose_invalid)>(
-          error.joint_position_motion_generator_start_pose_invalid);
-  message.joint_motion_generator_position_limits_violation =
-      static_cast<decltype(message.joint_motion_generator_position_limits_violation)>(
-          error.joint_motion_generator_position_limits_violation);
-  message.joint_motion_generator_velocity_limits_violation =
-      static_cast<decltype(message.joint_motion_generator_velocity_limits_violation)>(
-          error.joint_motion_generator_velocity_limits_violation);
-  message.joint_motion_generator_velocity_discontinuity =
-      static_cast<decltype(message.joint_motion_generator_velocity_discontinuity)>(
-          error.joint_motion_generator_velocity_discontinuity);
-  message.joint_motion_generator_acceleration_discontinuity =
-      static_cast<decltype(message.joint_motion_generator_acceleration_discontinuity)>(
-          error.joint_motion_generator_acceleration_discontinuity);
-  message.cartesian_position_motion_generator_start_pose_invalid =
-      static_cast<decltype(message.cartesian_position_motion_generator_start_pose_invalid)>(
-          error.cartesian_position_motion_generator_start_pose_invalid);
-  message.cartesian_motion_generator_elbow_limit_violation =
-      static_cast<decltype(message.cartesian_motion_generator_elbow_limit_violation)>(
-          error.cartesian_motion_generator_elbow_limit_violation);
-  message.cartesian_motion_generator_velocity_limits_violation =
-      static_cast<decltype(message.cartesian_motion_generator_velocity_limits_violation)>(
-          error.cartesian_motion_generator_velocity_limits_violation);
-  message.cartesian_motion_generator_velocity_discontinuity =
-      static_cast<decltype(message.cartesian_motion_generator_velocity_discontinuity)>(
-          error.cartesian_motion_generator_velocity_discontinuity);
-  message.cartesian_motion_generator_acceleration_discontinuity =
-      static_cast<decltype(message.cartesian_motion_generator_acceleration_discontinuity)>(
-          error.cartesian_motion_generator_acceleration_discontinuity);
-  message.cartesian_motion_generator_elbow_sign_inconsistent =
-      static_cast<decltype(message.cartesian_motion_generator_elbow_sign_inconsistent)>(
-          error.cartesian_motion_generator_elbow_sign_inconsistent);
-  message.cartesian_motion_generator_start_elbow_invalid =
-      static_cast<decltype(message.cartesian_motion_generator_start_elbow_invalid)>(
-          error.cartesian_motion_generator_start_elbow_invalid);
-  message.cartesian_motion_generator_joint_position_limits_violation =
-      static_cast<decltype(message.cartesian_motion_generator_joint_position_limits_violation)>(
-          error.cartesian_motion_generator_joint_position_limits_violation);
-  message.cartesian_motion_generator_joint_velocity_limits_violation =
-      static_cast<decltype(message.cartesian_motion_generator_joint_velocity_limits_violation)>(
-          error.cartesian_motion_generator_joint_velocity_limits_violation);
-  message.cartesian_motion_generator_joint_velocity_discontinuity =
-      static_cast<decltype(message.cartesian_motion_generator_joint_velocity_discontinuity)>(
-          error.cartesian_motion_generator_joint_velocity_discontinuity);
-  message.cartesian_motion_generator_joint_acceleration_discontinuity =
-      static_cast<decltype(message.cartesian_motion_generator_joint_acceleration_discontinuity)>(
-          error.cartesian_motion_generator_joint_acceleration_discontinuity);
-  message.cartesian_position_motion_generator_invalid_frame =
-      static_cast<decltype(message.cartesian_position_motion_generator_invalid_frame)>(
-          error.cartesian_position_motion_generator_invalid_frame);
-  message.force_controller_desired_force_tolerance_violation =
-      static_cast<decltype(message.force_controller_desired_force_tolerance_violation)>(
-          error.force_controller_desired_force_tolerance_violation);
-  message.controller_torque_discontinuity =
-      static_cast<decltype(message.controller_torque_discontinuity)>(
-          error.controller_torque_discontinuity);
-  message.start_elbow_sign_inconsistent =
-      static_cast<decltype(message.start_elbow_sign_inconsistent)>(
-          error.start_elbow_sign_inconsistent);
-  message.communication_constraints_violation =
-      static_cast<decltype(message.communication_constraints_violation)>(
-          error.communication_constraints_violation);
-  message.power_limit_violation =
-      static_cast<decltype(message.power_limit_violation)>(error.power_limit_violation);
-  message.joint_p2p_insufficient_torque_for_planning =
-      static_cast<decltype(message.joint_p2p_insufficient_torque_for_planning)>(
-          error.joint_p2p_insufficient_torque_for_planning);
-  message.tau_j_range_violation =
-      static_cast<decltype(message.tau_j_range_violation)>(error.tau_j_range_violation);
-  message.instability_detected =
-      static_cast<decltype(message.instability_detected)>(error.instability_detected);
-  return message;
+// one broadcaster for the arms of the node, since the latched /tf_static message of a node has
+// to hold the transforms of all of them
+struct SharedStaticBroadcaster {
+  std::mutex mutex;
+  tf2_ros::StaticTransformBroadcaster broadcaster;
+};
+
+SharedStaticBroadcaster& sharedStaticBroadcaster() {
+  static SharedStaticBroadcaster shared;
+  return shared;
+}
+
+// the errors of libfranka in the order of the fields of franka_msgs/Errors; error i is bit i of
+// the error masks of franka_core_msgs/RobotState and RobotErrors
+#define FRANKA_INTERFACE_ERRORS(X)                               \
+  X(joint_position_limits_violation)                             \
+  X(cartesian_position_limits_violation)                         \
+  X(self_collision_avoidance_violation)                          \
+  X(joint_velocity_violation)                                    \
+  X(cartesian_velocity_violation)                                \
+  X(force_control_safety_violation)                              \
+  X(joint_reflex)                                                \
+  X(cartesian_reflex)                                            \
+  X(max_goal_pose_deviation_violation)                           \
+  X(max_path_pose_deviation_violation)                           \
+  X(cartesian_velocity_profile_safety_violation)                 \
+  X(joint_position_motion_generator_start_pose_invalid)          \
+  X(joint_motion_generator_position_limits_violation)            \
+  X(joint_motion_generator_velocity_limits_violation)            \
+  X(joint_motion_generator_velocity_discontinuity)               \
+  X(joint_motion_generator_acceleration_discontinuity)           \
+  X(cartesian_position_motion_generator_start_pose_invalid)      \
+  X(cartesian_motion_generator_elbow_limit_violation)            \
+  X(cartesian_motion_generator_velocity_limits_violation)        \
+  X(cartesian_motion_generator_velocity_discontinuity)           \
+  X(cartesian_motion_generator_acceleration_discontinuity)       \
+  X(cartesian_motion_generator_elbow_sign_inconsistent)          \
+  X(cartesian_motion_generator_start_elbow_invalid)              \
+  X(cartesian_motion_generator_joint_position_limits_violation)  \
+  X(cartesian_motion_generator_joint_velocity_limits_violation)  \
+  X(cartesian_motion_generator_joint_velocity_discontinuity)     \
+  X(cartesian_motion_generator_joint_acceleration_discontinuity) \
+  X(cartesian_position_motion_generator_invalid_frame)           \
+  X(force_controller_desired_force_tolerance_violation)          \
+  X(controller_torque_discontinuity)                             \
+  X(start_elbow_sign_inconsistent)                               \
+  X(communication_constraints_violation)                         \
+  X(power_limit_violation)                                       \
+  X(joint_p2p_insufficient_torque_for_planning)                  \
+  X(tau_j_range_violation)                                       \
+  X(instability_detected)
+
+uint64_t errorsToMask(const franka::Errors& errors) {
+  uint64_t mask(0);
+  uint64_t bit(1);
+#define FRANKA_INTERFACE_SET_BIT(name) \
+  if (errors.name) {                   \
+    mask |= bit;                       \
+  }                                    \
+  bit <<= 1;
+  FRANKA_INTERFACE_ERRORS(FRANKA_INTERFACE_SET_BIT)
+#undef FRANKA_INTERFACE_SET_BIT
+  return mask;
+}
+
+void maskToMessage(uint64_t mask, franka_msgs::Errors& message) {
+  uint64_t bit(1);
+#define FRANKA_INTERFACE_SET_FIELD(name)                                 \
+  message.name = static_cast<decltype(message.name)>((mask & bit) != 0); \
+  bit <<= 1;
+  FRANKA_INTERFACE_ERRORS(FRANKA_INTERFACE_SET_FIELD)
+#undef FRANKA_INTERFACE_SET_FIELD
 }
 
 }  // anonymous namespace
@@ -162,7 +137,7 @@ franka_msgs::Errors errorsToMessage(const franka::Errors& error) {
 namespace franka_interface {
 
 bool CustomFrankaStateController::init(hardware_interface::RobotHW* robot_hardware,
-                                 ros::NodeHandle& root_node_handle,
+                                 ros::NodeHandle& /*root_node_handle*/,
                                  ros::NodeHandle& controller_node_handle) {
   franka_state_interface_ = robot_hardware->get<franka_hw::FrankaStateInterface>();
   if (franka_state_interface_ == nullptr) {
@@ -178,7 +153,37 @@ bool CustomFrankaStateController::init(hardware_interface::RobotHW* robot_hardwa
     ROS_INFO_STREAM("CustomFrankaStateController: Did not find publish_rate. Using default "
                     << publish_rate << " [Hz].");
   }
-  trigger_publish_ = franka_hw::TriggerRate(publish_rate);
+  // every topic can run at its own rate; those not configured use publish_rate
+  auto get_topic_rate = [&](const std::string& topic) {
+    double rate(publish_rate);
+    controller_node_handle.param<double>("publish_rates/" + topic, rate, publish_rate);
+    return rate;
+  };
+  trigger_franka_state_ = franka_hw::TriggerRate(get_topic_rate("robot_state"));
+  trigger_joint_states_ = franka_hw::TriggerRate(get_topic_rate("joint_states"));
+  trigger_transforms_ = franka_hw::TriggerRate(get_topic_rate("tf"));
+  trigger_tip_state_ = franka_hw::TriggerRate(get_topic_rate("tip_state"));
+
+  const std::map<std::string, RobotStateField> field_names{{"dynamics", kDynamics},
+                                                           {"mass_matrix", kMassMatrix},
+                                                           {"jacobian", kJacobian},
+                                                           {"ee_velocity", kEEVelocity},
+                                                           {"errors", kErrors}};
+  std::vector<std::string> robot_state_fields;
+  if (!controller_node_handle.getParam("robot_state_fields", robot_state_fields)) {
+    for (const auto& field : field_names) {
+      robot_state_fields.push_back(field.first);
+    }
+  }
+  for (const std::string& field : robot_state_fields) {
+    auto it = field_names.find(field);
+    if (it == field_names.end()) {
+      ROS_ERROR_STREAM("CustomFrankaStateController: Unknown entry '" << field
+                       << "' in robot_state_fields, aborting controller init!");
+      return false;
+    }
+    robot_state_fields_ |= it->second;
+  }
 
   if (!controller_node_handle.getParam("joint_names", joint_names_) ||
       joint_names_.size() != robot_state_.q.size()) {
@@ -196,32 +201,62 @@ bool CustomFrankaStateController::init(hardware_interface::RobotHW* robot_hardwa
     return false;
   }
 
-  auto* model_interface = robot_hardware->get<franka_hw::FrankaModelInterface>();
-  if (model_interface == nullptr) {
-    ROS_ERROR_STREAM(
-        "CustomFrankaStateController: Error getting model interface from hardware");
-    return false;
-  }
   try {
-    model_handle_ = std::make_unique<franka_hw::FrankaModelHandle>(
-        model_interface->getHandle(arm_id_ + "_model"));
+    model_handle_ = franka_interface::getModelCacheHandle(robot_hardware, arm_id_);
   } catch (hardware_interface::HardwareInterfaceException& ex) {
     ROS_ERROR_STREAM(
         "CustomFrankaStateController: Exception getting model handle from interface: "
         << ex.what());
     return false;
   }
+  if (model_handle_ == nullptr) {
+    ROS_ERROR_STREAM(
+        "CustomFrankaStateController: Error getting model interface from hardware");
+    return false;
+  }
+
+  ros::NodeHandle arm_node_handle = armNodeHandle(controller_node_handle);
+  bool shared_memory_enabled(false);
+  arm_node_handle.param<bool>("robot_config/shared_memory/enabled", shared_memory_enabled, false);
+  if (shared_memory_enabled) {
+    std::string shared_memory_name;
+    arm_node_handle.param<std::string>("robot_config/shared_memory/name", shared_memory_name,
+                                       "/franka_ros_interface_" + arm_id_);
+    std::string error;
+    if (!shared_memory_.open(shared_memory_name, error)) {
+      ROS_ERROR_STREAM("CustomFrankaStateController: Could not open shared memory: " << error);
+      return false;
+    }
+    ROS_INFO_STREAM("CustomFrankaStateController: Writing robot state to shared memory "
+                    << shared_memory_name);
+  }
+
+  arm_node_handle.param<std::string>("robot_config/state_recording/directory",
+                                     recording_directory_, "");
+  record_state_service_ = controller_node_handle.advertiseService(
+      "record_state", &CustomFrankaStateController::recordStateCallback, this);
 
-  publisher_transforms_.init(root_node_handle, "/tf", 1);
   publisher_franka_state_.init(controller_node_handle, "robot_state", 1);
   publisher_joint_states_.init(controller_node_handle, "joint_states", 1);
   publisher_joint_states_desired_.init(controller_node_handle, "joint_states_desired", 1);
   publisher_tip_state_.init(controller_node_handle, "tip_state", 1);
+  publisher_errors_.init(controller_node_handle, "errors", 1, true);
 
+  {
+    // the optional fields are variable length so that disabled ones are not serialised
+    std::lock_guard<realtime_tools::RealtimePublisher<franka_core_msgs::RobotState> > lock(
+        publisher_franka_state_);
+    bool dynamics = robot_state_fields_ & kDynamics;
+    publisher_franka_state_.msg_.gravity.resize(dynamics ? robot_state_.q.size() : 0);
+    publisher_franka_state_.msg_.coriolis.resize(dynamics ? robot_state_.q.size() : 0);
+    publisher_franka_state_.msg_.mass_matrix.resize(robot_state_fields_ & kMassMatrix ? 49 : 0);
+    publisher_franka_state_.msg_.O_Jac_EE.resize(robot_state_fields_ & kJacobian ? 42 : 0);
+    publisher_franka_state_.msg_.O_dP_EE.resize(robot_state_fields_ & kEEVelocity ? 6 : 0);
+  }
   {
     std::lock_guard<realtime_tools::RealtimePublisher<sensor_msgs::JointState> > lock(
         publisher_joint_states_);
-    publisher_joint_states_.msg_.name.resize(joint_names_.size());
+    publisher_joint_states_.msg_.name = joint_names_;
     publisher_joint_states_.msg_.position.resize(robot_state_.q.size());
     publisher_joint_states_.msg_.velocity.resize(robot_state_.dq.size());
     publisher_joint_states_.msg_.effort.resize(robot_state_.tau_J.size());
@@ -229,34 +264,22 @@ bool CustomFrankaStateController::init(hardware_interface::RobotHW* robot_hardwa
   {
     std::lock_guard<realtime_tools::RealtimePublisher<sensor_msgs::JointState> > lock(
         publisher_joint_states_desired_);
-    publisher_joint_states_desired_.msg_.name.resize(joint_names_.size());
+    publisher_joint_states_desired_.msg_.name = joint_names_;
     publisher_joint_states_desired_.msg_.position.resize(robot_state_.q_d.size());
     publisher_joint_states_desired_.msg_.velocity.resize(robot_state_.dq_d.size());
     publisher_joint_states_desired_.msg_.effort.resize(robot_state_.tau_J_d.size());
   }
-  {
-    std::lock_guard<realtime_tools::RealtimePublisher<tf2_msgs::TFMessage> > lock(
-        publisher_transforms_);
-    publisher_transforms_.msg_.transforms.resize(2);
-    tf::Quaternion quaternion(0.0, 0.0, 0.0, 1.0);
-    tf::Vector3 translation(0.0, 0.0, 0.05);
-    tf::Transform transform(quaternion, translation);
-    tf::StampedTransform stamped_transform(transform, ros::Time::now(), arm_id_ + "_link8",
-                                           arm_id_ + "_EE");
-    geometry_msgs::TransformStamped transform_message;
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[0] = transform_message;
-    translation = tf::Vector3(0.0, 0.0, 0.0);
-    transform = tf::Transform(quaternion, translation);
-    stamped_transform =
-        tf::StampedTransform(transform, ros::Time::now(), arm_id_ + "_EE", arm_id_ + "_K");
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[1] = transform_message;
-  }
+  link0_frame_ = arm_id_ + "_link0";
+  link8_frame_ = arm_id_ + "_link8";
+  ee_frame_ = arm_id_ + "_EE";
+  k_frame_ = arm_id_ + "_K";
+  static_frames_timer_ = controller_node_handle.createWallTimer(
+      ros::WallDuration(0.1), &CustomFrankaStateController::publishStaticTransforms, this);
   {
     std::lock_guard<realtime_tools::RealtimePublisher<franka_core_msgs::EndPointState> > lock(
         publisher_tip_state_);
-    publisher_tip_state_.msg_.O_F_ext_hat_K.header.frame_id = arm_id_ + "_link0";
+    publisher_tip_state_.msg_.header.frame_id = link0_frame_;
+    publisher_tip_state_.msg_.O_F_ext_hat_K.header.frame_id = link0_frame_;
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.force.x = 0.0;
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.force.y = 0.0;
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.force.z = 0.0;
@@ -264,7 +287,7 @@ bool CustomFrankaStateController::init(hardware_interface::RobotHW* robot_hardwa
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.torque.y = 0.0;
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.torque.z = 0.0;
 
-    publisher_tip_state_.msg_.K_F_ext_hat_K.header.frame_id = arm_id_ + "_K";
+    publisher_tip_state_.msg_.K_F_ext_hat_K.header.frame_id = k_frame_;
     publisher_tip_state_.msg_.K_F_ext_hat_K.wrench.force.x = 0.0;
     publisher_tip_state_.msg_.K_F_ext_hat_K.wrench.force.y = 0.0;
     publisher_tip_state_.msg_.K_F_ext_hat_K.wrench.force.z = 0.0;
@@ -276,30 +299,160 @@ bool CustomFrankaStateController::init(hardware_interface::RobotHW* robot_hardwa
 }
 
 void CustomFrankaStateController::update(const ros::Time& time, const ros::Duration& /* period */) {
-  if (trigger_publish_()) {
-    robot_state_ = franka_state_handle_->getRobotState();
+  bool publish_franka_state = trigger_franka_state_();
+  bool publish_transforms = trigger_transforms_();
+  bool publish_tip_state = trigger_tip_state_();
+  bool publish_joint_states = trigger_joint_states_();
+  bool write_shared_state = shared_memory_.isOpen();
+  bool record_state = recorder_.isRecording();
+  if (!(publish_franka_state || publish_transforms || publish_tip_state || publish_joint_states ||
+        write_shared_state || record_state)) {
+    return;
+  }
+  robot_state_ = franka_state_handle_->getRobotState();
+  current_errors_mask_ = errorsToMask(robot_state_.current_errors);
+  last_motion_errors_mask_ = errorsToMask(robot_state_.last_motion_errors);
+  publishErrors(time);
+  if (write_shared_state) {
+    writeSharedState(time);
+  }
+  if (record_state) {
+    recordState(time);
+  }
+  if (publish_franka_state) {
     publishFrankaState(time);
-    publishTransforms(time);
+  }
+  if (publish_transforms) {
+    checkStaticTransforms(time);
+  }
+  if (publish_tip_state) {
     publishEndPointState(time);
+  }
+  if (publish_joint_states) {
     publishJointStates(time);
-    sequence_number_++;
   }
+  sequence_number_++;
 }
 
-void CustomFrankaStateController::publishFrankaState(const ros::Time& time) {
+void CustomFrankaStateController::writeSharedState(const ros::Time& time) {
+  toSharedRobotState(robot_state_, time.toSec(), shared_state_);
+  // computed once per cycle by the model cache, and shared with the running controllers
+  if (robot_state_fields_ & kJacobian) {
+    shared_state_.O_Jac_EE = model_handle_->getZeroJacobian(franka::Frame::kEndEffector);
+  }
+  if (robot_state_fields_ & kMassMatrix) {
+    shared_state_.mass_matrix = model_handle_->getMass();
+  }
+  shared_memory_.writeState(shared_state_);
+}
 
-    std::array<double, 7> coriolis = model_handle_->getCoriolis();
-    std::array<double, 7> gravity = model_handle_->getGravity();
+void CustomFrankaStateController::recordState(const ros::Time& time) {
+  record_.time = time.toSec();
+  record_.q = robot_state_.q;
+  record_.dq = robot_state_.dq;
+  record_.q_d = robot_state_.q_d;
+  record_.dq_d = robot_state_.dq_d;
+  record_.tau_J = robot_state_.tau_J;
+  record_.dtau_J = robot_state_.dtau_J;
+  record_.tau_J_d = robot_state_.tau_J_d;
+  record_.tau_ext_hat_filtered = robot_state_.tau_ext_hat_filtered;
+  record_.O_T_EE = robot_state_.O_T_EE;
+  record_.O_T_EE_d = robot_state_.O_T_EE_d;
+  record_.O_F_ext_hat_K = robot_state_.O_F_ext_hat_K;
+  record_.K_F_ext_hat_K = robot_state_.K_F_ext_hat_K;
+  record_.robot_mode = static_cast<double>(robot_state_.robot_mode);
+  record_.control_command_success_rate = robot_state_.control_command_success_rate;
+  recorder_.record(record_);
+}
 
-    std::array<double, 49> mass_matrix = model_handle_->getMass();
-    std::array<double, 42> O_Jac_EE = model_handle_->getZeroJacobian(franka::Frame::kEndEffector);
-    Eigen::Map<Eigen::Matrix<double, 6, 7>> jacobian(O_Jac_EE.data());
-    Eigen::Map<Eigen::Matrix<double, 7, 1>> dq(robot_state_.dq.data());
+bool CustomFrankaStateController::recordStateCallback(
+    franka_core_msgs::RecordState::Request& request,
+    franka_core_msgs::RecordState::Response& response) {
+  std::lock_guard<std::mutex> lock(recording_mutex_);
+  if (!request.enable) {
+    response.path = recorder_.path();
+    if (!recorder_.isRecording()) {
+      response.success = false;
+      response.message = "Not recording";
+      return true;
+    }
+    response.records = recorder_.stop();
+    response.success = !recorder_.failed();
+    std::stringstream message;
+    message << "Recorded " << response.records << " control cycles to " << response.path;
+    if (recorder_.dropped() > 0) {
+      message << " (" << recorder_.dropped() << " dropped)";
+    }
+    if (recorder_.failed()) {
+      message << ", but writing the file failed";
+    }
+    response.message = message.str();
+    ROS_INFO_STREAM("CustomFrankaStateController: " << response.message);
+    return true;
+  }
 
-//  jacobian * dq
-    Eigen::Matrix<double, 6, 1> ee_vel = jacobian * dq;
+  std::string path = request.path;
+  if (path.empty()) {
+    std::string directory = recording_directory_;
+    if (directory.empty()) {
+      // where ROS puts its logs
+      const char* ros_home = std::getenv("ROS_HOME");
+      const char* home = std::getenv("HOME");
+      directory = ros_home != nullptr ? ros_home : std::string(home != nullptr ? home : ".") + "/.ros";
+    }
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+    path = directory + "/" + arm_id_ + "_state_" + stamp + ".frrec";
+  }
+  std::string error;
+  response.success = recorder_.start(path, error);
+  response.path = recorder_.path();
+  response.message = response.success ? "Recording to " + path : error;
+  if (response.success) {
+    ROS_INFO_STREAM("CustomFrankaStateController: " << response.message);
+  } else {
+    ROS_ERROR_STREAM("CustomFrankaStateController: Could not start recording: " << error);
+  }
+  return true;
+}
 
+void CustomFrankaStateController::publishFrankaState(const ros::Time& time) {
     if (publisher_franka_state_.trylock()) {
+        // model quantities are only computed for the groups that are published
+        if (robot_state_fields_ & kDynamics) {
+            const std::array<double, 7>& coriolis = model_handle_->getCoriolis();
+            const std::array<double, 7>& gravity = model_handle_->getGravity();
+            for (size_t i = 0; i < robot_state_.q.size(); i++) {
+                publisher_franka_state_.msg_.gravity[i] = gravity[i];
+                publisher_franka_state_.msg_.coriolis[i] = coriolis[i];
+            }
+        }
+        if (robot_state_fields_ & kMassMatrix) {
+            const std::array<double, 49>& mass_matrix = model_handle_->getMass();
+            for (size_t i = 0; i < mass_matrix.size(); i++) {
+                publisher_franka_state_.msg_.mass_matrix[i] = mass_matrix[i];
+            }
+        }
+        if (robot_state_fields_ & (kJacobian | kEEVelocity)) {
+            const std::array<double, 42>& O_Jac_EE =
+                model_handle_->getZeroJacobian(franka::Frame::kEndEffector);
+            if (robot_state_fields_ & kJacobian) {
+                for (size_t i = 0; i < O_Jac_EE.size(); i++) {
+                    publisher_franka_state_.msg_.O_Jac_EE[i] = O_Jac_EE[i];
+                }
+            }
+            if (robot_state_fields_ & kEEVelocity) {
+                //  jacobian * dq
+                Eigen::Map<const Eigen::Matrix<double, 6, 7>> jacobian(O_Jac_EE.data());
+                Eigen::Map<const Eigen::Matrix<double, 7, 1>> dq(robot_state_.dq.data());
+                Eigen::Matrix<double, 6, 1> ee_vel = jacobian * dq;
+                for (size_t i = 0; i < 6; i++) {
+                    publisher_franka_state_.msg_.O_dP_EE[i] = ee_vel(i, 0);
+                }
+            }
+        }
+
         static_assert(
                 sizeof(robot_state_.cartesian_collision) == sizeof(robot_state_.cartesian_contact),
                 "Robot state Cartesian members do not have same size");
@@ -315,7 +468,6 @@ void CustomFrankaStateController::publishFrankaState(const ros::Time& time) {
         for (size_t i = 0; i < robot_state_.cartesian_collision.size(); i++) {
             publisher_franka_state_.msg_.cartesian_collision[i] = robot_state_.cartesian_collision[i];
             publisher_franka_state_.msg_.cartesian_contact[i] = robot_state_.cartesian_contact[i];
-            publisher_franka_state_.msg_.O_dP_EE[i] = ee_vel(i,0);
         }
 
     static_assert(sizeof(robot_state_.q) == sizeof(robot_state_.q_d),
@@ -340,8 +492,6 @@ void CustomFrankaStateController::publishFrankaState(const ros::Time& time) {
           publisher_franka_state_.msg_.joint_collision[i] = robot_state_.joint_collision[i];
           publisher_franka_state_.msg_.joint_contact[i] = robot_state_.joint_contact[i];
           publisher_franka_state_.msg_.tau_ext_hat_filtered[i] = robot_state_.tau_ext_hat_filtered[i];
-          publisher_franka_state_.msg_.gravity[i] = gravity[i];
-          publisher_franka_state_.msg_.coriolis[i] = coriolis[i];
       }
 
     static_assert(sizeof(robot_state_.O_T_EE) == sizeof(robot_state_.F_T_EE),
@@ -373,18 +523,18 @@ void CustomFrankaStateController::publishFrankaState(const ros::Time& time) {
           publisher_franka_state_.msg_.F_x_Ctotal[i] = robot_state_.F_x_Ctotal[i];
       }
 
-      for (size_t i = 0; i < mass_matrix.size(); i++) {
-          publisher_franka_state_.msg_.mass_matrix[i] = mass_matrix[i];
+      publisher_franka_state_.msg_.time = robot_state_.time.toSec();
+      // the error structs are only rewritten when the errors change
+      if ((robot_state_fields_ & kErrors) &&
+          publisher_franka_state_.msg_.current_errors_mask != current_errors_mask_) {
+          maskToMessage(current_errors_mask_, publisher_franka_state_.msg_.current_errors);
       }
-
-      for (size_t i = 0; i < O_Jac_EE.size(); i++) {
-          publisher_franka_state_.msg_.O_Jac_EE[i] = O_Jac_EE[i];
+      if ((robot_state_fields_ & kErrors) &&
+          publisher_franka_state_.msg_.last_motion_errors_mask != last_motion_errors_mask_) {
+          maskToMessage(last_motion_errors_mask_, publisher_franka_state_.msg_.last_motion_errors);
       }
-
-      publisher_franka_state_.msg_.time = robot_state_.time.toSec();
-      publisher_franka_state_.msg_.current_errors = errorsToMessage(robot_state_.current_errors);
-      publisher_franka_state_.msg_.last_motion_errors =
-        errorsToMessage(robot_state_.last_motion_errors);
+      publisher_franka_state_.msg_.current_errors_mask = current_errors_mask_;
+      publisher_franka_state_.msg_.last_motion_errors_mask = last_motion_errors_mask_;
 
       switch (robot_state_.robot_mode) {
           case franka::RobotMode::kOther:
@@ -431,7 +581,6 @@ void CustomFrankaStateController::publishJointStates(const ros::Time& time) {
     static_assert(sizeof(robot_state_.q) == sizeof(robot_state_.tau_J),
                   "Robot state joint members do not have same size");
     for (size_t i = 0; i < robot_state_.q.size(); i++) {
-      publisher_joint_states_.msg_.name[i] = joint_names_[i];
       publisher_joint_states_.msg_.position[i] = robot_state_.q[i];
       publisher_joint_states_.msg_.velocity[i] = robot_state_.dq[i];
       publisher_joint_states_.msg_.effort[i] = robot_state_.tau_J[i];
@@ -446,7 +595,6 @@ void CustomFrankaStateController::publishJointStates(const ros::Time& time) {
     static_assert(sizeof(robot_state_.q_d) == sizeof(robot_state_.tau_J_d),
                   "Robot state joint members do not have same size");
     for (size_t i = 0; i < robot_state_.q_d.size(); i++) {
-      publisher_joint_states_desired_.msg_.name[i] = joint_names_[i];
       publisher_joint_states_desired_.msg_.position[i] = robot_state_.q_d[i];
       publisher_joint_states_desired_.msg_.velocity[i] = robot_state_.dq_d[i];
       publisher_joint_states_desired_.msg_.effort[i] = robot_state_.tau_J_d[i];
@@ -457,19 +605,56 @@ void CustomFrankaStateController::publishJointStates(const ros::Time& time) {
   }
 }
 
-void CustomFrankaStateController::publishTransforms(const ros::Time& time) {
-  if (publisher_transforms_.trylock()) {
-    tf::StampedTransform stamped_transform(convertArrayToTf(robot_state_.F_T_EE), time,
-                                           arm_id_ + "_link8", arm_id_ + "_EE");
-    geometry_msgs::TransformStamped transform_message;
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[0] = transform_message;
-    stamped_transform = tf::StampedTransform(convertArrayToTf(robot_state_.EE_T_K), time,
-                                             arm_id_ + "_EE", arm_id_ + "_K");
-    transformStampedTFToMsg(stamped_transform, transform_message);
-    publisher_transforms_.msg_.transforms[1] = transform_message;
-    publisher_transforms_.unlockAndPublish();
+void CustomFrankaStateController::publishErrors(const ros::Time& time) {
+  if (errors_published_ && publisher_errors_.msg_.current_errors == current_errors_mask_ &&
+      publisher_errors_.msg_.last_motion_errors == last_motion_errors_mask_) {
+    return;
+  }
+  // retried in the next cycle if the publisher is busy
+  if (publisher_errors_.trylock()) {
+    publisher_errors_.msg_.header.stamp = time;
+    publisher_errors_.msg_.current_errors = current_errors_mask_;
+    publisher_errors_.msg_.last_motion_errors = last_motion_errors_mask_;
+    publisher_errors_.unlockAndPublish();
+    errors_published_ = true;
+  }
+}
+
+void CustomFrankaStateController::checkStaticTransforms(const ros::Time& time) {
+  if (static_frames_sent_ && robot_state_.F_T_EE == sent_static_frames_.F_T_EE &&
+      robot_state_.EE_T_K == sent_static_frames_.EE_T_K) {
+    return;
+  }
+  StaticFrames frames;
+  frames.stamp = time;
+  frames.F_T_EE = robot_state_.F_T_EE;
+  frames.EE_T_K = robot_state_.EE_T_K;
+  // retried at the next check if the timer has not caught up yet
+  if (static_frames_.push(frames)) {
+    sent_static_frames_ = frames;
+    static_frames_sent_ = true;
+  }
+}
+
+void CustomFrankaStateController::publishStaticTransforms(const ros::WallTimerEvent& /*event*/) {
+  StaticFrames frames;
+  bool changed = false;
+  while (static_frames_.pop(frames)) {
+    changed = true;
+  }
+  if (!changed) {
+    return;
   }
+  std::vector<geometry_msgs::TransformStamped> transforms(2);
+  transformStampedTFToMsg(tf::StampedTransform(convertArrayToTf(frames.F_T_EE), frames.stamp,
+                                               link8_frame_, ee_frame_),
+                          transforms[0]);
+  transformStampedTFToMsg(tf::StampedTransform(convertArrayToTf(frames.EE_T_K), frames.stamp,
+                                               ee_frame_, k_frame_),
+                          transforms[1]);
+  SharedStaticBroadcaster& shared = sharedStaticBroadcaster();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  shared.broadcaster.sendTransform(transforms);
 }
 
 void CustomFrankaStateController::publishEndPointState(const ros::Time& time) {
@@ -482,7 +667,6 @@ void CustomFrankaStateController::publishEndPointState(const ros::Time& time) {
 //      publisher_tip_state_.msg_.O_dP_EE_d[i] = robot_state_.O_dP_EE_d[i];
 //      publisher_tip_state_.msg_.O_ddP_EE_c[i] = robot_state_.O_ddP_EE_c[i];
 //    }
-    publisher_tip_state_.msg_.O_F_ext_hat_K.header.frame_id = arm_id_ + "_link0";
     publisher_tip_state_.msg_.O_F_ext_hat_K.header.stamp = time;
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.force.x = robot_state_.O_F_ext_hat_K[0];
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.force.y = robot_state_.O_F_ext_hat_K[1];
@@ -491,7 +675,6 @@ void CustomFrankaStateController::publishEndPointState(const ros::Time& time) {
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.torque.y = robot_state_.O_F_ext_hat_K[4];
     publisher_tip_state_.msg_.O_F_ext_hat_K.wrench.torque.z = robot_state_.O_F_ext_hat_K[5];
 
-    publisher_tip_state_.msg_.K_F_ext_hat_K.header.frame_id = arm_id_ + "_K";
     publisher_tip_state_.msg_.K_F_ext_hat_K.header.stamp = time;
     publisher_tip_state_.msg_.K_F_ext_hat_K.wrench.force.x = robot_state_.K_F_ext_hat_K[0];
     publisher_tip_state_.msg_.K_F_ext_hat_K.wrench.force.y = robot_state_.K_F_ext_hat_K[1];
@@ -500,7 +683,6 @@ void CustomFrankaStateController::publishEndPointState(const ros::Time& time) {
     publisher_tip_state_.msg_.K_F_ext_hat_K.wrench.torque.y = robot_state_.K_F_ext_hat_K[4];
     publisher_tip_state_.msg_.K_F_ext_hat_K.wrench.torque.z = robot_state_.K_F_ext_hat_K[5];
 
-    publisher_tip_state_.msg_.header.frame_id = arm_id_ + "_link0";
     publisher_tip_state_.msg_.header.seq = sequence_number_;
     publisher_tip_state_.msg_.header.stamp = time;
 
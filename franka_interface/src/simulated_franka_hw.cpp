@@ -0,0 +1,425 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/simulated_franka_hw.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/Cholesky>
+#include <hardware_interface/internal/demangle_symbol.h>
+#include <ros/console.h>
+
+namespace franka_interface {
+
+constexpr std::array<double, 7> SimulatedFrankaHW::kLowerLimits;
+constexpr std::array<double, 7> SimulatedFrankaHW::kUpperLimits;
+
+namespace {
+
+// Franka Hand, as configured by default in Desk
+constexpr double kHandMass = 0.73;
+constexpr std::array<double, 3> kHandCenterOfMass{{-0.01, 0.0, 0.03}};
+constexpr std::array<double, 9> kHandInertia{{0.001, 0.0, 0.0, 0.0, 0.0025, 0.0, 0.0, 0.0, 0.0017}};
+constexpr std::array<double, 16> kHandEEFrame{
+    {0.7071, -0.7071, 0.0, 0.0, 0.7071, 0.7071, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.1034, 1.0}};
+constexpr std::array<double, 16> kIdentity{
+    {1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0}};
+
+using Matrix67d = Eigen::Matrix<double, 6, 7>;
+
+Matrix67d toMatrix(const std::array<double, 42>& jacobian) {
+  return Eigen::Map<const Matrix67d>(jacobian.data());
+}
+
+}  // anonymous namespace
+
+SimulatedFrankaHW::SimulatedFrankaHW(const std::array<std::string, 7>& joint_names,
+                                     const std::string& arm_id,
+                                     const std::array<double, 7>& q,
+                                     const Parameters& parameters)
+    : parameters_(parameters),
+      model_cache_(std::make_shared<FrankaModelCache>(
+          std::make_unique<PandaModelSource>(model_, robot_state_))),
+      q_(Eigen::Map<const PandaModel::Vector7d>(q.data())),
+      dq_(PandaModel::Vector7d::Zero()),
+      ddq_(PandaModel::Vector7d::Zero()),
+      tau_(PandaModel::Vector7d::Zero()),
+      O_F_ext_(Eigen::Matrix<double, 6, 1>::Zero()) {
+  parameters_.substeps = std::max<size_t>(parameters_.substeps, 1);
+  clampToLimits();
+
+  robot_state_.F_T_EE = kHandEEFrame;
+  robot_state_.EE_T_K = kIdentity;
+  robot_state_.m_ee = kHandMass;
+  robot_state_.F_x_Cee = kHandCenterOfMass;
+  robot_state_.I_ee = kHandInertia;
+  robot_state_.m_total = kHandMass;
+  robot_state_.F_x_Ctotal = kHandCenterOfMass;
+  robot_state_.I_total = kHandInertia;
+  pending_.F_T_EE = robot_state_.F_T_EE;
+  pending_.EE_T_K = robot_state_.EE_T_K;
+  holdCommands();
+  updateRobotState(ros::Duration(0.0));
+
+  franka_hw::FrankaStateHandle franka_state_handle(arm_id + "_robot", robot_state_);
+  franka_state_interface_.registerHandle(franka_state_handle);
+  model_cache_interface_.registerHandle(FrankaModelCacheHandle(arm_id + "_model", model_cache_));
+
+  for (size_t i = 0; i < joint_names.size(); ++i) {
+    hardware_interface::JointStateHandle joint_state_handle(
+        joint_names[i], &robot_state_.q[i], &robot_state_.dq[i], &robot_state_.tau_J[i]);
+    joint_state_interface_.registerHandle(joint_state_handle);
+    position_joint_interface_.registerHandle(
+        hardware_interface::JointHandle(joint_state_handle, &position_command_[i]));
+    velocity_joint_interface_.registerHandle(
+        hardware_interface::JointHandle(joint_state_handle, &velocity_command_[i]));
+    effort_joint_interface_.registerHandle(
+        hardware_interface::JointHandle(joint_state_handle, &effort_command_[i]));
+  }
+
+  registerInterface(&joint_state_interface_);
+  registerInterface(&position_joint_interface_);
+  registerInterface(&velocity_joint_interface_);
+  registerInterface(&effort_joint_interface_);
+  registerInterface(&franka_state_interface_);
+  registerInterface(&model_cache_interface_);
+}
+
+SimulatedFrankaHW::CommandMode SimulatedFrankaHW::commandMode(
+    const hardware_interface::ControllerInfo& info) {
+  using hardware_interface::internal::demangledTypeName;
+  static const std::string kPosition = demangledTypeName<hardware_interface::PositionJointInterface>();
+  static const std::string kVelocity = demangledTypeName<hardware_interface::VelocityJointInterface>();
+  static const std::string kEffort = demangledTypeName<hardware_interface::EffortJointInterface>();
+
+  CommandMode mode = CommandMode::kNone;
+  for (const auto& claimed : info.claimed_resources) {
+    if (claimed.resources.empty()) {
+      continue;
+    }
+    if (claimed.hardware_interface == kEffort) {
+      mode = CommandMode::kEffort;
+    } else if (claimed.hardware_interface == kVelocity && mode != CommandMode::kEffort) {
+      mode = CommandMode::kVelocity;
+    } else if (claimed.hardware_interface == kPosition && mode == CommandMode::kNone) {
+      mode = CommandMode::kPosition;
+    }
+  }
+  return mode;
+}
+
+bool SimulatedFrankaHW::switchModes(const std::list<hardware_interface::ControllerInfo>& start_list,
+                                    const std::list<hardware_interface::ControllerInfo>& stop_list,
+                                    std::map<std::string, CommandMode>& modes) const {
+  modes = controller_modes_;
+  for (const auto& info : stop_list) {
+    modes.erase(info.name);
+  }
+  for (const auto& info : start_list) {
+    CommandMode mode = commandMode(info);
+    if (mode != CommandMode::kNone) {
+      modes[info.name] = mode;
+    }
+  }
+  for (const auto& entry : modes) {
+    if (entry.second != modes.begin()->second) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SimulatedFrankaHW::prepareSwitch(
+    const std::list<hardware_interface::ControllerInfo>& start_list,
+    const std::list<hardware_interface::ControllerInfo>& stop_list) {
+  std::map<std::string, CommandMode> modes;
+  if (!switchModes(start_list, stop_list, modes)) {
+    ROS_ERROR(
+        "SimulatedFrankaHW: Cannot run controllers using different command interfaces at the "
+        "same time");
+    return false;
+  }
+  return true;
+}
+
+void SimulatedFrankaHW::doSwitch(const std::list<hardware_interface::ControllerInfo>& start_list,
+                                 const std::list<hardware_interface::ControllerInfo>& stop_list) {
+  std::map<std::string, CommandMode> modes;
+  switchModes(start_list, stop_list, modes);
+  controller_modes_.swap(modes);
+
+  CommandMode mode = activeMode();
+  if (mode != mode_) {
+    mode_ = mode;
+    if (mode_ != CommandMode::kEffort) {
+      // motions start and end at rest
+      dq_.setZero();
+      ddq_.setZero();
+    }
+    holdCommands();
+  }
+}
+
+SimulatedFrankaHW::CommandMode SimulatedFrankaHW::activeMode() const {
+  return controller_modes_.empty() ? CommandMode::kNone : controller_modes_.begin()->second;
+}
+
+bool SimulatedFrankaHW::controllerActive() const {
+  return mode_ != CommandMode::kNone;
+}
+
+void SimulatedFrankaHW::holdCommands() {
+  Eigen::Map<PandaModel::Vector7d>(position_command_.data()) = q_;
+  velocity_command_.fill(0.0);
+  effort_command_.fill(0.0);
+  tau_.setZero();
+}
+
+void SimulatedFrankaHW::reset(const std::array<double, 7>& q) {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  pending_.reset = true;
+  pending_.q = q;
+  has_pending_ = true;
+}
+
+void SimulatedFrankaHW::setExternalWrench(const std::array<double, 6>& O_F_ext) {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  pending_.O_F_ext = O_F_ext;
+  has_pending_ = true;
+}
+
+void SimulatedFrankaHW::setEEFrame(const std::array<double, 16>& F_T_EE) {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  pending_.F_T_EE = F_T_EE;
+  has_pending_ = true;
+}
+
+void SimulatedFrankaHW::setKFrame(const std::array<double, 16>& EE_T_K) {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  pending_.EE_T_K = EE_T_K;
+  has_pending_ = true;
+}
+
+void SimulatedFrankaHW::setLoad(double mass,
+                                const std::array<double, 3>& F_x_Cload,
+                                const std::array<double, 9>& load_inertia) {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  pending_.load = true;
+  pending_.load_mass = mass;
+  pending_.F_x_Cload = F_x_Cload;
+  pending_.load_inertia = load_inertia;
+  has_pending_ = true;
+}
+
+void SimulatedFrankaHW::setFrames(const FrameChanges& changes) {
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  if (changes.set_EE_frame) {
+    pending_.F_T_EE = changes.F_T_EE;
+  }
+  if (changes.set_K_frame) {
+    pending_.EE_T_K = changes.EE_T_K;
+  }
+  if (changes.set_load) {
+    pending_.load = true;
+    pending_.load_mass = changes.load_mass;
+    pending_.F_x_Cload = changes.F_x_Cload;
+    pending_.load_inertia = changes.load_inertia;
+  }
+  has_pending_ = true;
+}
+
+void SimulatedFrankaHW::read(const ros::Time& /*time*/, const ros::Duration& period) {
+  {
+    // a setter holding the lock is not waited for; its changes are applied in the next cycle
+    std::unique_lock<std::mutex> lock(pending_mutex_, std::try_to_lock);
+    if (lock.owns_lock() && has_pending_) {
+      applyPendingChanges();
+    }
+  }
+  updateRobotState(period);
+  model_cache_->invalidate();
+}
+
+void SimulatedFrankaHW::applyPendingChanges() {
+  if (pending_.reset) {
+    std::copy(pending_.q.cbegin(), pending_.q.cend(), q_.data());
+    dq_.setZero();
+    ddq_.setZero();
+    clampToLimits();
+    holdCommands();
+    pending_.reset = false;
+  }
+  O_F_ext_ = Eigen::Map<const Eigen::Matrix<double, 6, 1>>(pending_.O_F_ext.data());
+  robot_state_.F_T_EE = pending_.F_T_EE;
+  robot_state_.EE_T_K = pending_.EE_T_K;
+  if (pending_.load) {
+    // the model carries hand and payload as one body, as m_total of the robot state
+    const double total_mass = kHandMass + pending_.load_mass;
+    Eigen::Vector3d hand_com = Eigen::Map<const Eigen::Vector3d>(kHandCenterOfMass.data());
+    Eigen::Vector3d load_com = Eigen::Map<const Eigen::Vector3d>(pending_.F_x_Cload.data());
+    Eigen::Vector3d total_com = hand_com;
+    Eigen::Matrix3d total_inertia = Eigen::Map<const Eigen::Matrix3d>(kHandInertia.data());
+    if (total_mass > 0.0) {
+      total_com = (kHandMass * hand_com + pending_.load_mass * load_com) / total_mass;
+      auto shifted = [&total_com](const Eigen::Matrix3d& inertia, double mass,
+                                  const Eigen::Vector3d& com) {
+        const Eigen::Vector3d offset = com - total_com;
+        return Eigen::Matrix3d(inertia + mass * (offset.squaredNorm() * Eigen::Matrix3d::Identity() -
+                                                 offset * offset.transpose()));
+      };
+      total_inertia =
+          shifted(total_inertia, kHandMass, hand_com) +
+          shifted(Eigen::Map<const Eigen::Matrix3d>(pending_.load_inertia.data()),
+                  pending_.load_mass, load_com);
+    }
+    robot_state_.m_load = pending_.load_mass;
+    robot_state_.F_x_Cload = pending_.F_x_Cload;
+    robot_state_.I_load = pending_.load_inertia;
+    robot_state_.m_total = total_mass;
+    Eigen::Map<Eigen::Vector3d>(robot_state_.F_x_Ctotal.data()) = total_com;
+    Eigen::Map<Eigen::Matrix3d>(robot_state_.I_total.data()) = total_inertia;
+    model_.setLoad(total_mass, robot_state_.F_x_Ctotal, robot_state_.I_total);
+    pending_.load = false;
+  }
+  has_pending_ = false;
+}
+
+void SimulatedFrankaHW::write(const ros::Time& /*time*/, const ros::Duration& period) {
+  const double dt = period.toSec();
+  if (dt <= 0.0) {
+    return;
+  }
+  const PandaModel::Vector7d q = q_;
+  const PandaModel::Vector7d dq = dq_;
+  switch (mode_) {
+    case CommandMode::kEffort:
+      std::copy(effort_command_.cbegin(), effort_command_.cend(), tau_.data());
+      for (size_t i = 0; i < parameters_.substeps; ++i) {
+        stepDynamics(dt / parameters_.substeps);
+      }
+      break;
+    case CommandMode::kPosition:
+      std::copy(position_command_.cbegin(), position_command_.cend(), q_.data());
+      clampToLimits();
+      dq_ = (q_ - q) / dt;
+      break;
+    case CommandMode::kVelocity:
+      std::copy(velocity_command_.cbegin(), velocity_command_.cend(), dq_.data());
+      q_ += dq_ * dt;
+      clampToLimits();
+      break;
+    case CommandMode::kNone:
+      break;
+  }
+  ddq_ = (dq_ - dq) / dt;
+}
+
+void SimulatedFrankaHW::stepDynamics(double dt) {
+  PandaModel::Matrix7d M = model_.mass(q_);
+  M.diagonal() += Eigen::Map<const PandaModel::Vector7d>(parameters_.armature.data());
+  const Matrix67d jacobian = toMatrix(
+      model_.zeroJacobian(franka::Frame::kStiffness, q_, robot_state_.F_T_EE, robot_state_.EE_T_K));
+  // gravity is compensated, as by the robot in torque control
+  const PandaModel::Vector7d tau =
+      tau_ + jacobian.transpose() * O_F_ext_ - model_.coriolis(q_, dq_) -
+      Eigen::Map<const PandaModel::Vector7d>(parameters_.damping.data()).cwiseProduct(dq_);
+  dq_ += dt * M.ldlt().solve(tau);
+  q_ += dt * dq_;
+  clampToLimits();
+}
+
+void SimulatedFrankaHW::clampToLimits() {
+  for (size_t i = 0; i < 7; ++i) {
+    if (q_[i] <= kLowerLimits[i] || q_[i] >= kUpperLimits[i]) {
+      q_[i] = std::min(std::max(q_[i], kLowerLimits[i]), kUpperLimits[i]);
+      dq_[i] = 0.0;
+    }
+  }
+}
+
+void SimulatedFrankaHW::updateRobotState(const ros::Duration& period) {
+  const std::array<double, 7> tau_J_previous = robot_state_.tau_J;
+  Eigen::Map<PandaModel::Vector7d>(robot_state_.q.data()) = q_;
+  Eigen::Map<PandaModel::Vector7d>(robot_state_.dq.data()) = dq_;
+  robot_state_.theta = robot_state_.q;
+  robot_state_.dtheta = robot_state_.dq;
+  if (mode_ == CommandMode::kPosition) {
+    robot_state_.q_d = position_command_;
+  } else {
+    robot_state_.q_d = robot_state_.q;
+  }
+  robot_state_.dq_d = robot_state_.dq;
+  Eigen::Map<PandaModel::Vector7d>(robot_state_.ddq_d.data()) = ddq_;
+
+  const Matrix67d stiffness_jacobian = toMatrix(
+      model_.zeroJacobian(franka::Frame::kStiffness, q_, robot_state_.F_T_EE, robot_state_.EE_T_K));
+  const PandaModel::Vector7d tau_ext = stiffness_jacobian.transpose() * O_F_ext_;
+  Eigen::Map<PandaModel::Vector7d>(robot_state_.tau_ext_hat_filtered.data()) = tau_ext;
+  if (mode_ == CommandMode::kEffort) {
+    Eigen::Map<PandaModel::Vector7d>(robot_state_.tau_J_d.data()) = tau_;
+    Eigen::Map<PandaModel::Vector7d>(robot_state_.tau_J.data()) = tau_ + model_.gravity(q_);
+  } else {
+    robot_state_.tau_J_d.fill(0.0);
+    Eigen::Map<PandaModel::Vector7d>(robot_state_.tau_J.data()) =
+        model_.inverseDynamics(q_, dq_, ddq_, true) - tau_ext;
+  }
+  const double dt = period.toSec();
+  for (size_t i = 0; i < 7; ++i) {
+    robot_state_.dtau_J[i] = dt > 0.0 ? (robot_state_.tau_J[i] - tau_J_previous[i]) / dt : 0.0;
+  }
+
+  robot_state_.O_T_EE =
+      model_.pose(franka::Frame::kEndEffector, q_, robot_state_.F_T_EE, robot_state_.EE_T_K);
+  robot_state_.O_T_EE_d = robot_state_.O_T_EE;
+  robot_state_.O_T_EE_c = robot_state_.O_T_EE;
+  const Eigen::Matrix<double, 6, 1> O_dP_EE =
+      toMatrix(model_.zeroJacobian(franka::Frame::kEndEffector, q_, robot_state_.F_T_EE,
+                                   robot_state_.EE_T_K)) *
+      dq_;
+  Eigen::Map<Eigen::Matrix<double, 6, 1>>(robot_state_.O_dP_EE_d.data()) = O_dP_EE;
+  Eigen::Map<Eigen::Matrix<double, 6, 1>>(robot_state_.O_dP_EE_c.data()) = O_dP_EE;
+  robot_state_.elbow = {{q_[2], q_[3] < 0.0 ? -1.0 : 1.0}};
+  robot_state_.elbow_d = robot_state_.elbow;
+  robot_state_.elbow_c = robot_state_.elbow;
+
+  const std::array<double, 16> O_T_K =
+      model_.pose(franka::Frame::kStiffness, q_, robot_state_.F_T_EE, robot_state_.EE_T_K);
+  const Eigen::Matrix3d R_O_K =
+      Eigen::Map<const Eigen::Matrix4d>(O_T_K.data()).topLeftCorner<3, 3>();
+  Eigen::Map<Eigen::Matrix<double, 6, 1>>(robot_state_.O_F_ext_hat_K.data()) = O_F_ext_;
+  Eigen::Map<Eigen::Vector3d>(robot_state_.K_F_ext_hat_K.data()) =
+      R_O_K.transpose() * O_F_ext_.head<3>();
+  Eigen::Map<Eigen::Vector3d>(robot_state_.K_F_ext_hat_K.data() + 3) =
+      R_O_K.transpose() * O_F_ext_.tail<3>();
+
+  robot_state_.robot_mode = controllerActive() ? franka::RobotMode::kMove : franka::RobotMode::kIdle;
+  robot_state_.control_command_success_rate = 1.0;
+  robot_state_.time = franka::Duration(robot_state_.time.toMSec() +
+                                       static_cast<uint64_t>(std::lround(period.toSec() * 1e3)));
+}
+
+}  // namespace franka_interface
@@ -0,0 +1,298 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/state_recording.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace franka_interface {
+
+namespace {
+
+constexpr size_t kRecordWidth = sizeof(StateRecord) / sizeof(double);
+
+bool writeAll(int fd, const void* data, size_t size, off_t offset) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t written = pwrite(fd, bytes, size, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+constexpr uint64_t StateRecordingHeader::kMagic;
+constexpr uint32_t StateRecordingHeader::kVersion;
+constexpr uint32_t StateRecordingHeader::kHeaderSize;
+constexpr uint32_t StateRecordingHeader::kBlockRecords;
+constexpr size_t StateRecordingHeader::kMaxColumns;
+
+StateRecordingHeader StateRecordingHeader::forStateRecord() {
+  StateRecordingHeader header;
+  header.record_width = kRecordWidth;
+  auto add = [&header](const char* name, size_t offset, size_t size) {
+    StateRecordingColumn& column = header.columns[header.num_columns++];
+    std::strncpy(column.name.data(), name, column.name.size() - 1);
+    column.width = size / sizeof(double);
+    column.offset = offset / sizeof(double);
+  };
+#define FRANKA_INTERFACE_ADD_COLUMN(field) \
+  add(#field, offsetof(StateRecord, field), sizeof(StateRecord::field))
+  FRANKA_INTERFACE_ADD_COLUMN(time);
+  FRANKA_INTERFACE_ADD_COLUMN(q);
+  FRANKA_INTERFACE_ADD_COLUMN(dq);
+  FRANKA_INTERFACE_ADD_COLUMN(q_d);
+  FRANKA_INTERFACE_ADD_COLUMN(dq_d);
+  FRANKA_INTERFACE_ADD_COLUMN(tau_J);
+  FRANKA_INTERFACE_ADD_COLUMN(dtau_J);
+  FRANKA_INTERFACE_ADD_COLUMN(tau_J_d);
+  FRANKA_INTERFACE_ADD_COLUMN(tau_ext_hat_filtered);
+  FRANKA_INTERFACE_ADD_COLUMN(O_T_EE);
+  FRANKA_INTERFACE_ADD_COLUMN(O_T_EE_d);
+  FRANKA_INTERFACE_ADD_COLUMN(O_F_ext_hat_K);
+  FRANKA_INTERFACE_ADD_COLUMN(K_F_ext_hat_K);
+  FRANKA_INTERFACE_ADD_COLUMN(robot_mode);
+  FRANKA_INTERFACE_ADD_COLUMN(control_command_success_rate);
+#undef FRANKA_INTERFACE_ADD_COLUMN
+  return header;
+}
+
+StateRecorder::~StateRecorder() {
+  stop();
+}
+
+bool StateRecorder::start(const std::string& path, std::string& error) {
+  if (isRecording()) {
+    error = "already recording to " + path_;
+    return false;
+  }
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0) {
+    error = "could not create " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  std::vector<char> header(StateRecordingHeader::kHeaderSize, 0);
+  StateRecordingHeader description = StateRecordingHeader::forStateRecord();
+  std::memcpy(header.data(), &description, sizeof(description));
+  if (!writeAll(fd, header.data(), header.size(), 0)) {
+    error = "could not write " + path + ": " + std::strerror(errno);
+    ::close(fd);
+    return false;
+  }
+
+  path_ = path;
+  fd_ = fd;
+  block_.assign(StateRecordingHeader::kBlockRecords * kRecordWidth, 0.0);
+  block_fill_ = 0;
+  num_records_ = 0;
+  write_failed_ = false;
+  dropped_.store(0, std::memory_order_relaxed);
+  // the writer thread is not running, so the consumer side is free to discard what a push
+  // racing with the previous stop() may have left behind
+  buffer_.clear();
+  stopping_.store(false, std::memory_order_relaxed);
+  writer_ = std::thread(&StateRecorder::run, this);
+  recording_.store(true, std::memory_order_release);
+  return true;
+}
+
+uint64_t StateRecorder::stop() {
+  if (!writer_.joinable()) {
+    return 0;
+  }
+  recording_.store(false, std::memory_order_release);
+  stopping_.store(true, std::memory_order_release);
+  writer_.join();
+
+  if (block_fill_ > 0) {
+    // pad the column segments of the last block with zeros
+    const StateRecordingHeader description = StateRecordingHeader::forStateRecord();
+    for (uint32_t c = 0; c < description.num_columns; ++c) {
+      const StateRecordingColumn& column = description.columns[c];
+      double* segment = block_.data() + column.offset * StateRecordingHeader::kBlockRecords;
+      std::fill(segment + block_fill_ * column.width,
+                segment + StateRecordingHeader::kBlockRecords * column.width, 0.0);
+    }
+    writeBlock();
+  }
+  uint64_t num_records = num_records_;
+  if (!writeAll(fd_, &num_records, sizeof(num_records),
+                offsetof(StateRecordingHeader, num_records))) {
+    write_failed_ = true;
+  }
+  ::close(fd_);
+  fd_ = -1;
+  return num_records_;
+}
+
+void StateRecorder::run() {
+  const StateRecordingHeader description = StateRecordingHeader::forStateRecord();
+  StateRecord record;
+  for (;;) {
+    // read the flag before draining, so that nothing pushed before stop() is left behind
+    bool stopping = stopping_.load(std::memory_order_acquire);
+    bool any = false;
+    while (buffer_.pop(record)) {
+      any = true;
+      const double* values = reinterpret_cast<const double*>(&record);
+      for (uint32_t c = 0; c < description.num_columns; ++c) {
+        const StateRecordingColumn& column = description.columns[c];
+        std::copy(values + column.offset, values + column.offset + column.width,
+                  block_.data() + column.offset * StateRecordingHeader::kBlockRecords +
+                      block_fill_ * column.width);
+      }
+      if (++block_fill_ == StateRecordingHeader::kBlockRecords) {
+        writeBlock();
+      }
+    }
+    if (stopping) {
+      return;
+    }
+    if (!any) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+}
+
+bool StateRecorder::writeBlock() {
+  const size_t block_bytes = block_.size() * sizeof(double);
+  const off_t offset =
+      StateRecordingHeader::kHeaderSize +
+      static_cast<off_t>(num_records_ / StateRecordingHeader::kBlockRecords) * block_bytes;
+  if (!write_failed_ && !writeAll(fd_, block_.data(), block_bytes, offset)) {
+    write_failed_ = true;
+  }
+  num_records_ += block_fill_;
+  block_fill_ = 0;
+  return !write_failed_;
+}
+
+bool StateRecordingReader::open(const std::string& path, std::string& error) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error = "could not open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(StateRecordingHeader)) {
+    error = path + " is too short for a state recording";
+    ::close(fd);
+    return false;
+  }
+  void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    error = "could not map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  mapping_ = mapping;
+  mapping_size_ = status.st_size;
+
+  std::memcpy(&header_, mapping_, sizeof(header_));
+  if (header_.magic != StateRecordingHeader::kMagic ||
+      header_.version != StateRecordingHeader::kVersion ||
+      header_.header_size < sizeof(StateRecordingHeader) || header_.block_records == 0 ||
+      header_.num_columns > StateRecordingHeader::kMaxColumns) {
+    error = path + " is not a compatible state recording";
+    close();
+    return false;
+  }
+  for (uint32_t c = 0; c < header_.num_columns; ++c) {
+    const StateRecordingColumn& column = header_.columns[c];
+    if (column.offset + column.width > header_.record_width) {
+      error = path + " has an invalid column table";
+      close();
+      return false;
+    }
+    header_.columns[c].name.back() = '\0';
+  }
+
+  const size_t block_size = static_cast<size_t>(header_.block_records) * header_.record_width;
+  const size_t num_blocks =
+      block_size == 0 ? 0 : (mapping_size_ - header_.header_size) / (block_size * sizeof(double));
+  num_records_ = num_blocks * header_.block_records;
+  if (header_.num_records != 0) {
+    // the recording was completed; the last block may be partially filled
+    num_records_ = std::min<size_t>(num_records_, header_.num_records);
+  }
+  data_ = reinterpret_cast<const double*>(static_cast<const char*>(mapping_) + header_.header_size);
+  return true;
+}
+
+void StateRecordingReader::close() {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_size_);
+  }
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  data_ = nullptr;
+  num_records_ = 0;
+}
+
+const StateRecordingColumn* StateRecordingReader::column(const std::string& name) const {
+  for (uint32_t c = 0; c < header_.num_columns; ++c) {
+    if (name == header_.columns[c].name.data()) {
+      return &header_.columns[c];
+    }
+  }
+  return nullptr;
+}
+
+bool StateRecordingReader::read(const std::string& name, std::vector<double>& values) const {
+  const StateRecordingColumn* column = this->column(name);
+  if (column == nullptr) {
+    return false;
+  }
+  values.resize(num_records_ * column->width);
+  const size_t block_size = static_cast<size_t>(header_.block_records) * header_.record_width;
+  for (size_t first = 0; first < num_records_; first += header_.block_records) {
+    const double* segment = data_ + (first / header_.block_records) * block_size +
+                            static_cast<size_t>(column->offset) * header_.block_records;
+    const size_t count = std::min<size_t>(header_.block_records, num_records_ - first);
+    std::copy(segment, segment + count * column->width, values.begin() + first * column->width);
+  }
+  return true;
+}
+
+}  // namespace franka_interface
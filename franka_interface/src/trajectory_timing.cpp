@@ -0,0 +1,322 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include <franka_interface/trajectory_timing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace franka_interface {
+
+namespace {
+
+// tangents below this do not bound the path velocity
+constexpr double kMinTangent{1e-9};
+// bound of the squared path velocity where no joint moves along the path
+constexpr double kMaxPathVelocitySquared{1e6};
+constexpr int kBisectionSteps{60};
+
+double distance(const JointTrajectoryTiming::Positions& a,
+                const JointTrajectoryTiming::Positions& b) {
+  double squared(0.0);
+  for (size_t j = 0; j < 7; ++j) {
+    squared += (a[j] - b[j]) * (a[j] - b[j]);
+  }
+  return std::sqrt(squared);
+}
+
+}  // anonymous namespace
+
+JointTrajectoryTiming::JointTrajectoryTiming(const Positions& velocity_limits,
+                                             const Positions& acceleration_limits,
+                                             size_t grid_points_per_segment)
+    : velocity_limits_(velocity_limits),
+      acceleration_limits_(acceleration_limits),
+      grid_points_per_segment_(std::max<size_t>(grid_points_per_segment, 1)) {}
+
+bool JointTrajectoryTiming::compute(const std::vector<Positions>& waypoints, double speed_ratio,
+                                    std::string& error) {
+  if (!(speed_ratio > 0.0 && speed_ratio <= 1.0)) {
+    error = "speed_ratio must be in (0, 1]";
+    return false;
+  }
+  if (waypoints.empty()) {
+    error = "no waypoints";
+    return false;
+  }
+  for (size_t j = 0; j < 7; ++j) {
+    if (!(velocity_limits_[j] > 0.0 && acceleration_limits_[j] > 0.0)) {
+      error = "the joint limits must be positive";
+      return false;
+    }
+    scaled_velocity_limits_[j] = velocity_limits_[j] * speed_ratio;
+    scaled_acceleration_limits_[j] = acceleration_limits_[j] * speed_ratio * speed_ratio;
+  }
+
+  // knots at the cumulative distance
+  knots_.clear();
+  positions_.clear();
+  for (size_t i = 0; i < waypoints.size(); ++i) {
+    if (!std::all_of(waypoints[i].cbegin(), waypoints[i].cend(),
+                     [](double position) { return std::isfinite(position); })) {
+      error = "waypoint " + std::to_string(i) + " has non-finite positions";
+      return false;
+    }
+    double step = positions_.empty() ? 0.0 : distance(positions_.back(), waypoints[i]);
+    if (positions_.empty() || step > 1e-9) {
+      knots_.push_back(positions_.empty() ? 0.0 : knots_.back() + step);
+      positions_.push_back(waypoints[i]);
+    }
+  }
+  const size_t n = knots_.size();
+
+  // shape-preserving (Fritsch-Carlson) tangents, secants at the ends
+  tangents_.assign(n, Positions{});
+  for (size_t j = 0; j < 7 && n > 1; ++j) {
+    for (size_t k = 0; k < n; ++k) {
+      if (k == 0 || k == n - 1) {
+        size_t a = k == 0 ? 0 : n - 2;
+        tangents_[k][j] = (positions_[a + 1][j] - positions_[a][j]) / (knots_[a + 1] - knots_[a]);
+        continue;
+      }
+      double h0 = knots_[k] - knots_[k - 1];
+      double h1 = knots_[k + 1] - knots_[k];
+      double d0 = (positions_[k][j] - positions_[k - 1][j]) / h0;
+      double d1 = (positions_[k + 1][j] - positions_[k][j]) / h1;
+      if (d0 * d1 <= 0.0) {
+        tangents_[k][j] = 0.0;
+      } else {
+        double w0 = 2.0 * h1 + h0;
+        double w1 = h1 + 2.0 * h0;
+        tangents_[k][j] = (w0 + w1) / (w0 / d0 + w1 / d1);
+      }
+    }
+  }
+
+  // grid of grid_points_per_segment_ intervals per segment, including the knots
+  s_.clear();
+  for (size_t k = 0; k + 1 < n; ++k) {
+    double h = knots_[k + 1] - knots_[k];
+    for (size_t m = 0; m < grid_points_per_segment_; ++m) {
+      s_.push_back(knots_[k] + h * m / grid_points_per_segment_);
+    }
+  }
+  s_.push_back(knots_.back());
+  const size_t points = s_.size();
+  dq_ds_.resize(points);
+  ddq_ds_start_.resize(points - 1);
+  dq_ds_end_.resize(points - 1);
+  ddq_ds_end_.resize(points - 1);
+  Positions q, unused;
+  for (size_t i = 0; i + 1 < points; ++i) {
+    size_t k = i / grid_points_per_segment_;
+    evaluateSegment(k, s_[i], q, dq_ds_[i], ddq_ds_start_[i]);
+    evaluateSegment(k, s_[i + 1], q, dq_ds_end_[i], ddq_ds_end_[i]);
+  }
+  evaluatePath(s_.back(), q, dq_ds_.back(), unused);
+  // the squared path velocity is linear in s on every interval, so bounding it at both ends by
+  // the largest tangent on the interval keeps the joint velocities within the limits throughout
+  std::vector<double> x_velocity(points, kMaxPathVelocitySquared);
+  for (size_t i = 0; i + 1 < points; ++i) {
+    const double ds = s_[i + 1] - s_[i];
+    for (size_t j = 0; j < 7; ++j) {
+      // the tangent is quadratic: largest at an end or where the curvature changes sign
+      double tangent = std::max(std::abs(dq_ds_[i][j]), std::abs(dq_ds_end_[i][j]));
+      const double c0 = ddq_ds_start_[i][j];
+      const double c1 = ddq_ds_end_[i][j];
+      if (c0 * c1 < 0.0) {
+        tangent = std::max(tangent, std::abs(dq_ds_[i][j] + 0.5 * c0 * ds * c0 / (c0 - c1)));
+      }
+      if (tangent > kMinTangent) {
+        double bound = scaled_velocity_limits_[j] / tangent;
+        x_velocity[i] = std::min(x_velocity[i], bound * bound);
+        x_velocity[i + 1] = std::min(x_velocity[i + 1], bound * bound);
+      }
+    }
+  }
+
+  // backward pass: largest squared path velocity at every grid point from which the end is
+  // reachable at rest
+  std::vector<double> x_max(points, 0.0);
+  for (size_t i = points - 1; i-- > 0;) {
+    const double ds = s_[i + 1] - s_[i];
+    auto reachable = [&](double x) {
+      double lower, upper;
+      if (!accelerationBounds(i, x, lower, upper)) {
+        return false;
+      }
+      lower = std::max(lower, -x / (2.0 * ds));
+      upper = std::min(upper, (x_max[i + 1] - x) / (2.0 * ds));
+      return lower <= upper;
+    };
+    if (reachable(x_velocity[i])) {
+      x_max[i] = x_velocity[i];
+      continue;
+    }
+    // the reachable velocities form an interval starting at rest
+    double low(0.0), high(x_velocity[i]);
+    for (int step = 0; step < kBisectionSteps; ++step) {
+      double middle = 0.5 * (low + high);
+      (reachable(middle) ? low : high) = middle;
+    }
+    x_max[i] = low;
+  }
+
+  // forward pass: accelerate as hard as the limits and the reachable velocities allow
+  x_.assign(points, 0.0);
+  times_.assign(points, 0.0);
+  for (size_t i = 0; i + 1 < points; ++i) {
+    const double ds = s_[i + 1] - s_[i];
+    double lower, upper;
+    if (!accelerationBounds(i, x_[i], lower, upper)) {
+      upper = lower = -x_[i] / (2.0 * ds);  // numerically out of bounds: slow down
+    }
+    double u = std::max(std::min(upper, (x_max[i + 1] - x_[i]) / (2.0 * ds)), -x_[i] / (2.0 * ds));
+    x_[i + 1] = std::min(std::max(x_[i] + 2.0 * ds * u, 0.0), x_max[i + 1]);
+    double speed = std::sqrt(x_[i]) + std::sqrt(x_[i + 1]);
+    if (speed < std::numeric_limits<double>::epsilon()) {
+      error = "the path cannot be timed within the joint limits";
+      return false;
+    }
+    times_[i + 1] = times_[i] + 2.0 * ds / speed;
+  }
+  return true;
+}
+
+void JointTrajectoryTiming::sample(double time, Positions& positions, Positions& velocities,
+                                   Positions& accelerations) const {
+  velocities.fill(0.0);
+  accelerations.fill(0.0);
+  if (s_.size() < 2) {
+    positions = positions_.empty() ? Positions{} : positions_.front();
+    return;
+  }
+  time = std::min(std::max(time, 0.0), times_.back());
+  size_t i = std::upper_bound(times_.cbegin(), times_.cend(), time) - times_.cbegin();
+  i = std::min(std::max<size_t>(i, 1), times_.size() - 1) - 1;
+
+  const double ds = s_[i + 1] - s_[i];
+  const double u = (x_[i + 1] - x_[i]) / (2.0 * ds);
+  const double tau = time - times_[i];
+  const double s_dot = std::max(std::sqrt(x_[i]) + u * tau, 0.0);
+  const double s = std::min(s_[i] + std::sqrt(x_[i]) * tau + 0.5 * u * tau * tau, s_[i + 1]);
+
+  Positions dq_ds, ddq_ds;
+  evaluatePath(s, positions, dq_ds, ddq_ds);
+  for (size_t j = 0; j < 7; ++j) {
+    velocities[j] = dq_ds[j] * s_dot;
+    accelerations[j] = dq_ds[j] * u + ddq_ds[j] * s_dot * s_dot;
+  }
+}
+
+void JointTrajectoryTiming::toMessage(double sample_period,
+                                      trajectory_msgs::JointTrajectory& trajectory) const {
+  const double end = duration();
+  const size_t count = std::max<size_t>(static_cast<size_t>(std::ceil(end / sample_period)), 1);
+  trajectory.points.resize(count);
+  Positions positions, velocities, accelerations;
+  for (size_t k = 0; k < count; ++k) {
+    // the last point is the end of the trajectory, at least one sample period from the start
+    double time = k + 1 == count ? end : (k + 1) * sample_period;
+    sample(time, positions, velocities, accelerations);
+    trajectory_msgs::JointTrajectoryPoint& point = trajectory.points[k];
+    point.positions.assign(positions.cbegin(), positions.cend());
+    point.velocities.assign(velocities.cbegin(), velocities.cend());
+    point.accelerations.assign(accelerations.cbegin(), accelerations.cend());
+    point.time_from_start = ros::Duration(std::max(time, sample_period));
+  }
+}
+
+void JointTrajectoryTiming::evaluatePath(double s, Positions& q, Positions& dq_ds,
+                                         Positions& ddq_ds) const {
+  dq_ds.fill(0.0);
+  ddq_ds.fill(0.0);
+  if (knots_.size() < 2) {
+    q = positions_.front();
+    return;
+  }
+  size_t k = std::upper_bound(knots_.cbegin(), knots_.cend(), s) - knots_.cbegin();
+  evaluateSegment(std::min(std::max<size_t>(k, 1), knots_.size() - 1) - 1, s, q, dq_ds, ddq_ds);
+}
+
+void JointTrajectoryTiming::evaluateSegment(size_t k, double s, Positions& q, Positions& dq_ds,
+                                            Positions& ddq_ds) const {
+  // cubic Hermite segment between knots k and k + 1
+  const double h = knots_[k + 1] - knots_[k];
+  const double t = std::min(std::max((s - knots_[k]) / h, 0.0), 1.0);
+  const double t2 = t * t;
+  const double t3 = t2 * t;
+  for (size_t j = 0; j < 7; ++j) {
+    const double p0 = positions_[k][j];
+    const double p1 = positions_[k + 1][j];
+    const double m0 = tangents_[k][j] * h;
+    const double m1 = tangents_[k + 1][j] * h;
+    q[j] = (2.0 * t3 - 3.0 * t2 + 1.0) * p0 + (t3 - 2.0 * t2 + t) * m0 +
+           (-2.0 * t3 + 3.0 * t2) * p1 + (t3 - t2) * m1;
+    dq_ds[j] = ((6.0 * t2 - 6.0 * t) * p0 + (3.0 * t2 - 4.0 * t + 1.0) * m0 +
+                (-6.0 * t2 + 6.0 * t) * p1 + (3.0 * t2 - 2.0 * t) * m1) /
+               h;
+    ddq_ds[j] = ((12.0 * t - 6.0) * p0 + (6.0 * t - 4.0) * m0 + (-12.0 * t + 6.0) * p1 +
+                 (6.0 * t - 2.0) * m1) /
+                (h * h);
+  }
+}
+
+bool JointTrajectoryTiming::accelerationBounds(size_t i, double x, double& lower,
+                                               double& upper) const {
+  // joint accelerations dq_ds * u + ddq_ds * x at the start of the interval and at its end,
+  // where x has grown by 2 * ds * u. In between they are quadratic in s, with a quadratic
+  // coefficient c * u (c from the constant third derivative of the path), and exceed the linear
+  // interpolation of the ends by at most |c * u| / 4; both ends are kept within the limits
+  // reduced by that
+  lower = -std::numeric_limits<double>::infinity();
+  upper = std::numeric_limits<double>::infinity();
+  const double ds = s_[i + 1] - s_[i];
+  for (size_t j = 0; j < 7; ++j) {
+    const double limit = scaled_acceleration_limits_[j];
+    const std::array<double, 2> a{{dq_ds_[i][j], dq_ds_end_[i][j] + 2.0 * ds * ddq_ds_end_[i][j]}};
+    const std::array<double, 2> b{{ddq_ds_start_[i][j] * x, ddq_ds_end_[i][j] * x}};
+    const double c = 2.5 * ds * (ddq_ds_end_[i][j] - ddq_ds_start_[i][j]);
+    for (size_t end = 0; end < 2; ++end) {
+      // |a u + b| + |c u| / 4 <= limit for both signs of the curvature term
+      for (double sign : {-0.25, 0.25}) {
+        const double slope = a[end] + sign * c;
+        if (std::abs(slope) > kMinTangent) {
+          double bound0 = (-limit - b[end]) / slope;
+          double bound1 = (limit - b[end]) / slope;
+          lower = std::max(lower, std::min(bound0, bound1));
+          upper = std::min(upper, std::max(bound0, bound1));
+        } else if (std::abs(b[end]) > limit) {
+          return false;
+        }
+      }
+    }
+  }
+  return lower <= upper;
+}
+
+}  // namespace franka_interface
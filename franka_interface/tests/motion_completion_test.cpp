@@ -0,0 +1,99 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+// End-of-motion check of the motion primitives: a path that returns to its start must not
+// count as arrived while its trajectory is still running.
+
+#include <array>
+#include <string>
+
+#include <gtest/gtest.h>
+#include <ros/time.h>
+
+#include <franka_interface/motion_completion.h>
+#include <franka_interface/trajectory_timing.h>
+
+namespace franka_interface {
+namespace {
+
+using Positions = std::array<double, 7>;
+
+// joint_velocity_limit and joint_acceleration_limit of config/robot_config.yaml
+const Positions kVelocityLimits{{2.175, 2.175, 2.175, 2.175, 2.61, 2.61, 2.61}};
+const Positions kAccelerationLimits{{15.0, 7.5, 10.0, 12.5, 15.0, 20.0, 20.0}};
+const Positions kStart{{0.0, -0.785, 0.0, -2.356, 0.0, 1.571, 0.785}};
+const double kTolerance(0.00085);
+const ros::Time kSent(100.0);
+
+TEST(MotionCompletion, PathReturningToStart) {
+  Positions away = kStart;
+  away[0] += 0.5;
+  away[3] += 0.3;
+  JointTrajectoryTiming timing(kVelocityLimits, kAccelerationLimits);
+  std::string error;
+  ASSERT_TRUE(timing.compute({kStart, away, kStart}, 1.0, error)) << error;
+  const ros::Duration duration(timing.duration());
+  MotionCompletion completion(kStart, kTolerance, kSent + duration);
+
+  // the arm follows the trajectory exactly; it starts and ends within the tolerance
+  Positions q, dq, ddq;
+  size_t close_to_target(0);
+  for (double t = 0.0; t < timing.duration(); t += 0.001) {
+    timing.sample(t, q, dq, ddq);
+    EXPECT_FALSE(completion.reached(kSent + ros::Duration(t), q, false)) << "at " << t << " s";
+    close_to_target += completion.positionError() < kTolerance ? 1 : 0;
+  }
+  EXPECT_GT(close_to_target, 0u);
+  timing.sample(timing.duration(), q, dq, ddq);
+  EXPECT_TRUE(completion.reached(kSent + duration, q, false));
+  EXPECT_LT(completion.positionError(), 1e-9);
+}
+
+TEST(MotionCompletion, TrajectorySucceededBeforeItsEnd) {
+  // e.g. the controller clock runs ahead of this one
+  MotionCompletion completion(kStart, kTolerance, kSent + ros::Duration(2.0));
+  EXPECT_FALSE(completion.reached(kSent + ros::Duration(1.9), kStart, false));
+  EXPECT_TRUE(completion.reached(kSent + ros::Duration(1.9), kStart, true));
+}
+
+TEST(MotionCompletion, WaitsForTolerance) {
+  MotionCompletion completion(kStart, kTolerance, kSent + ros::Duration(1.0));
+  Positions q = kStart;
+  q[6] += 2.0 * kTolerance;
+  EXPECT_FALSE(completion.reached(kSent + ros::Duration(5.0), q, true));
+  EXPECT_NEAR(completion.positionError(), 2.0 * kTolerance, 1e-12);
+  q[6] = kStart[6] + 0.5 * kTolerance;
+  EXPECT_TRUE(completion.reached(kSent + ros::Duration(5.0), q, false));
+}
+
+}  // anonymous namespace
+}  // namespace franka_interface
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
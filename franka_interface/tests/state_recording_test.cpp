@@ -0,0 +1,181 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+// Round trip of the state recording format: records written by StateRecorder are read back by
+// StateRecordingReader, across several blocks and a partially filled last one, and compared
+// field by field.
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <franka_interface/state_recording.h>
+
+namespace franka_interface {
+namespace {
+
+constexpr size_t kRecordWidth = sizeof(StateRecord) / sizeof(double);
+
+// distinct and exactly representable for every field of every record
+double expectedValue(size_t record, size_t field) { return record * 1000.0 + field; }
+
+StateRecord makeRecord(size_t record) {
+  StateRecord state;
+  double* fields = reinterpret_cast<double*>(&state);
+  for (size_t field = 0; field < kRecordWidth; ++field) {
+    fields[field] = expectedValue(record, field);
+  }
+  return state;
+}
+
+class StateRecordingTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = "/tmp/state_recording_test_" + std::to_string(getpid()) + ".frrec";
+  }
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  // records count records and waits until the recorder stopped
+  void record(size_t count) {
+    std::string error;
+    ASSERT_TRUE(recorder_.start(path_, error)) << error;
+    for (size_t r = 0; r < count; ++r) {
+      recorder_.record(makeRecord(r));
+      if (r % 512 == 511) {
+        // stay within the buffer of the recorder, as a 1 kHz control loop would
+        usleep(1000);
+      }
+    }
+    EXPECT_EQ(recorder_.stop(), count);
+    EXPECT_EQ(recorder_.dropped(), 0u);
+    EXPECT_FALSE(recorder_.failed());
+  }
+
+  std::string path_;
+  StateRecorder recorder_;
+};
+
+TEST_F(StateRecordingTest, HeaderDescribesStateRecord) {
+  record(1);
+  StateRecordingReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.open(path_, error)) << error;
+  const StateRecordingHeader& header = reader.header();
+  EXPECT_EQ(header.record_width, kRecordWidth);
+  EXPECT_EQ(header.block_records, StateRecordingHeader::kBlockRecords);
+  EXPECT_EQ(header.num_records, 1u);
+
+  // the columns cover every field exactly once, in order
+  uint32_t offset(0);
+  for (uint32_t c = 0; c < header.num_columns; ++c) {
+    EXPECT_EQ(header.columns[c].offset, offset) << header.columns[c].name.data();
+    offset += header.columns[c].width;
+  }
+  EXPECT_EQ(offset, kRecordWidth);
+
+  const StateRecordingColumn* q = reader.column("q");
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(q->width, 7u);
+  EXPECT_EQ(q->offset, offsetof(StateRecord, q) / sizeof(double));
+  const StateRecordingColumn* pose = reader.column("O_T_EE");
+  ASSERT_NE(pose, nullptr);
+  EXPECT_EQ(pose->width, 16u);
+  EXPECT_EQ(reader.column("no_such_column"), nullptr);
+}
+
+TEST_F(StateRecordingTest, RoundTrip) {
+  // two full blocks and a partial one
+  const size_t count = 2 * StateRecordingHeader::kBlockRecords + 123;
+  record(count);
+
+  StateRecordingReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.open(path_, error)) << error;
+  ASSERT_EQ(reader.size(), count);
+  const StateRecordingHeader& header = reader.header();
+  for (uint32_t c = 0; c < header.num_columns; ++c) {
+    const StateRecordingColumn& column = header.columns[c];
+    SCOPED_TRACE(column.name.data());
+    for (size_t r = 0; r < count; ++r) {
+      for (size_t e = 0; e < column.width; ++e) {
+        ASSERT_EQ(reader.value(column, r, e), expectedValue(r, column.offset + e))
+            << "record " << r << ", element " << e;
+      }
+    }
+
+    std::vector<double> values;
+    ASSERT_TRUE(reader.read(column.name.data(), values));
+    ASSERT_EQ(values.size(), count * column.width);
+    for (size_t r = 0; r < count; ++r) {
+      for (size_t e = 0; e < column.width; ++e) {
+        ASSERT_EQ(values[r * column.width + e], expectedValue(r, column.offset + e))
+            << "record " << r << ", element " << e;
+      }
+    }
+  }
+  std::vector<double> values;
+  EXPECT_FALSE(reader.read("no_such_column", values));
+}
+
+TEST_F(StateRecordingTest, RestartOverwrites) {
+  record(3 * StateRecordingHeader::kBlockRecords);
+  record(10);
+  StateRecordingReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.open(path_, error)) << error;
+  ASSERT_EQ(reader.size(), 10u);
+  const StateRecordingColumn* time = reader.column("time");
+  ASSERT_NE(time, nullptr);
+  EXPECT_EQ(reader.value(*time, 9), expectedValue(9, time->offset));
+}
+
+TEST_F(StateRecordingTest, RejectsOtherFiles) {
+  StateRecordingReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.open(path_, error));
+  EXPECT_FALSE(error.empty());
+
+  std::ofstream file(path_, std::ios::binary);
+  file << std::string(StateRecordingHeader::kHeaderSize, 'x');
+  file.close();
+  EXPECT_FALSE(reader.open(path_, error));
+  EXPECT_EQ(reader.size(), 0u);
+}
+
+}  // anonymous namespace
+}  // namespace franka_interface
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,225 @@
+/***************************************************************************
+
+*
+* @package: franka_interface
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+// Checks the trajectories of JointTrajectoryTiming against the limits of robot_config.yaml: they
+// pass through the waypoints in order, start and end there at rest, and keep the joint
+// velocities and accelerations within the limits.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <franka_interface/trajectory_timing.h>
+
+namespace franka_interface {
+namespace {
+
+using Positions = JointTrajectoryTiming::Positions;
+
+// joint_velocity_limit and joint_acceleration_limit of config/robot_config.yaml
+const Positions kVelocityLimits{{2.175, 2.175, 2.175, 2.175, 2.61, 2.61, 2.61}};
+const Positions kAccelerationLimits{{15.0, 7.5, 10.0, 12.5, 15.0, 20.0, 20.0}};
+const Positions kStart{{0.0, -0.785, 0.0, -2.356, 0.0, 1.571, 0.785}};
+
+const double kSamplePeriod(1e-4);
+const double kPositionTolerance(1e-3);  // [rad] within a sample period at the highest velocity
+const double kLimitTolerance(1e-9);
+
+Positions offset(const Positions& positions, const Positions& delta, double scale = 1.0) {
+  Positions result;
+  for (size_t j = 0; j < 7; ++j) {
+    result[j] = positions[j] + scale * delta[j];
+  }
+  return result;
+}
+
+double distance(const Positions& a, const Positions& b) {
+  double largest(0.0);
+  for (size_t j = 0; j < 7; ++j) {
+    largest = std::max(largest, std::abs(a[j] - b[j]));
+  }
+  return largest;
+}
+
+// samples the computed trajectory densely and checks it against the waypoints and limits
+void checkTrajectory(const JointTrajectoryTiming& timing, const std::vector<Positions>& waypoints,
+                     double speed_ratio) {
+  ASSERT_GT(timing.duration(), 0.0);
+  Positions positions, velocities, accelerations;
+
+  timing.sample(0.0, positions, velocities, accelerations);
+  EXPECT_LT(distance(positions, waypoints.front()), 1e-9);
+  EXPECT_LT(distance(velocities, Positions{}), 1e-9);
+
+  size_t next_waypoint(1);
+  double closest(std::numeric_limits<double>::infinity());
+  for (double time = 0.0; time <= timing.duration(); time += kSamplePeriod) {
+    timing.sample(time, positions, velocities, accelerations);
+    for (size_t j = 0; j < 7; ++j) {
+      ASSERT_LE(std::abs(velocities[j]), kVelocityLimits[j] * speed_ratio * (1.0 + kLimitTolerance))
+          << "joint " << j << " at " << time << " s";
+      ASSERT_LE(std::abs(accelerations[j]),
+                kAccelerationLimits[j] * speed_ratio * speed_ratio * (1.0 + kLimitTolerance))
+          << "joint " << j << " at " << time << " s";
+    }
+    // waypoints are passed in order: the next one is reached before the one after it
+    if (next_waypoint < waypoints.size()) {
+      double d = distance(positions, waypoints[next_waypoint]);
+      closest = std::min(closest, d);
+      if (d < kPositionTolerance) {
+        ++next_waypoint;
+        closest = std::numeric_limits<double>::infinity();
+      }
+    }
+  }
+  EXPECT_EQ(next_waypoint, waypoints.size())
+      << "waypoint " << next_waypoint << " missed by " << closest << " rad";
+
+  timing.sample(timing.duration(), positions, velocities, accelerations);
+  EXPECT_LT(distance(positions, waypoints.back()), 1e-9);
+  EXPECT_LT(distance(velocities, Positions{}), 1e-9);
+}
+
+void computeAndCheck(const std::vector<Positions>& waypoints, double speed_ratio = 1.0) {
+  JointTrajectoryTiming timing(kVelocityLimits, kAccelerationLimits);
+  std::string error;
+  ASSERT_TRUE(timing.compute(waypoints, speed_ratio, error)) << error;
+  checkTrajectory(timing, waypoints, speed_ratio);
+}
+
+TEST(JointTrajectoryTiming, SingleJointStep) {
+  for (size_t joint = 0; joint < 7; ++joint) {
+    SCOPED_TRACE("joint " + std::to_string(joint));
+    Positions step{};
+    step[joint] = 1.0;
+    computeAndCheck({kStart, offset(kStart, step)});
+  }
+}
+
+TEST(JointTrajectoryTiming, AllJointsStep) {
+  const Positions step{{1.0, -1.0, 1.0, 1.0, -1.0, 1.0, -1.0}};
+  computeAndCheck({kStart, offset(kStart, step)});
+}
+
+TEST(JointTrajectoryTiming, StepReachesVelocityLimit) {
+  // 1 rad on joint 1 is long enough to cruise at the velocity limit
+  Positions step{};
+  step[0] = 1.0;
+  JointTrajectoryTiming timing(kVelocityLimits, kAccelerationLimits);
+  std::string error;
+  ASSERT_TRUE(timing.compute({kStart, offset(kStart, step)}, 1.0, error)) << error;
+  Positions positions, velocities, accelerations;
+  timing.sample(0.5 * timing.duration(), positions, velocities, accelerations);
+  EXPECT_NEAR(velocities[0], kVelocityLimits[0], 1e-3);
+  // trapezoidal profile: accelerate, cruise, decelerate
+  const double cruise = 1.0 / kVelocityLimits[0] - kVelocityLimits[0] / kAccelerationLimits[0];
+  EXPECT_NEAR(timing.duration(), cruise + 2.0 * kVelocityLimits[0] / kAccelerationLimits[0], 0.01);
+}
+
+TEST(JointTrajectoryTiming, SpeedRatioSlowsDown) {
+  const Positions step{{1.0, 0.5, -0.5, 1.0, 0.0, -1.0, 1.0}};
+  const std::vector<Positions> waypoints{kStart, offset(kStart, step)};
+  computeAndCheck(waypoints, 0.5);
+
+  JointTrajectoryTiming full(kVelocityLimits, kAccelerationLimits);
+  JointTrajectoryTiming half(kVelocityLimits, kAccelerationLimits);
+  std::string error;
+  ASSERT_TRUE(full.compute(waypoints, 1.0, error)) << error;
+  ASSERT_TRUE(half.compute(waypoints, 0.5, error)) << error;
+  EXPECT_NEAR(half.duration(), 2.0 * full.duration(), 1e-6 * full.duration());
+}
+
+TEST(JointTrajectoryTiming, CollinearWaypoints) {
+  const Positions step{{0.5, 0.25, -0.5, 0.5, 0.0, -0.5, 0.5}};
+  const std::vector<Positions> waypoints{kStart, offset(kStart, step, 0.5), offset(kStart, step),
+                                         offset(kStart, step, 2.0)};
+  computeAndCheck(waypoints);
+
+  // a straight line, like the step between the ends, and just as fast
+  JointTrajectoryTiming through(kVelocityLimits, kAccelerationLimits);
+  JointTrajectoryTiming direct(kVelocityLimits, kAccelerationLimits);
+  std::string error;
+  ASSERT_TRUE(through.compute(waypoints, 1.0, error)) << error;
+  ASSERT_TRUE(direct.compute({waypoints.front(), waypoints.back()}, 1.0, error)) << error;
+  EXPECT_NEAR(through.duration(), direct.duration(), 0.01 * direct.duration());
+  Positions positions, velocities, accelerations;
+  for (double fraction : {0.25, 0.5, 0.75}) {
+    through.sample(fraction * through.duration(), positions, velocities, accelerations);
+    for (size_t j = 0; j < 7; ++j) {
+      // on the line through the waypoints
+      EXPECT_NEAR((positions[j] - kStart[j]) * step[0], (positions[0] - kStart[0]) * step[j],
+                  1e-6);
+    }
+  }
+}
+
+TEST(JointTrajectoryTiming, DuplicateWaypoints) {
+  const Positions a = offset(kStart, Positions{{0.5, 0.0, 0.0, 0.5, 0.0, 0.0, 0.0}});
+  const Positions b = offset(kStart, Positions{{0.5, 0.5, 0.0, 0.0, 0.0, 0.0, -0.5}});
+  computeAndCheck({kStart, kStart, a, a, a, b, b});
+}
+
+TEST(JointTrajectoryTiming, ReversingWaypoints) {
+  Positions step{};
+  step[3] = 1.0;
+  computeAndCheck({kStart, offset(kStart, step), kStart, offset(kStart, step, 0.5)});
+}
+
+TEST(JointTrajectoryTiming, SingleWaypointStaysAtRest) {
+  JointTrajectoryTiming timing(kVelocityLimits, kAccelerationLimits);
+  std::string error;
+  ASSERT_TRUE(timing.compute({kStart, kStart}, 1.0, error)) << error;
+  EXPECT_EQ(timing.duration(), 0.0);
+  Positions positions, velocities, accelerations;
+  timing.sample(1.0, positions, velocities, accelerations);
+  EXPECT_LT(distance(positions, kStart), 1e-12);
+  EXPECT_LT(distance(velocities, Positions{}), 1e-12);
+}
+
+TEST(JointTrajectoryTiming, RejectsInvalidInput) {
+  JointTrajectoryTiming timing(kVelocityLimits, kAccelerationLimits);
+  std::string error;
+  EXPECT_FALSE(timing.compute({kStart}, 0.0, error));
+  EXPECT_FALSE(timing.compute({kStart}, 1.5, error));
+  EXPECT_FALSE(timing.compute({}, 1.0, error));
+  Positions invalid = kStart;
+  invalid[2] = std::nan("");
+  EXPECT_FALSE(timing.compute({kStart, invalid}, 1.0, error));
+  EXPECT_FALSE(error.empty());
+}
+
+}  // anonymous namespace
+}  // namespace franka_interface
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+// Kept apart from the benchmark code, so that the compiler does not see the replaced allocation
+// functions inlined next to the standard containers.
+
+#include "allocation_counter.h"
+
+#include <cerrno>
+#include <cstdlib>
+
+namespace {
+
+thread_local bool t_count_allocations = false;
+thread_local uint64_t t_allocations = 0;
+
+inline void countAllocation() {
+  if (t_count_allocations) {
+    t_allocations++;
+  }
+}
+
+}  // anonymous namespace
+
+// The C allocation functions are interposed rather than operator new: every form of new (plain,
+// array, nothrow, aligned) allocates through them, and so do Eigen's dynamic matrices
+// (aligned_malloc), which do not use new at all. glibc provides the originals as __libc_*.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) noexcept {
+  countAllocation();
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+  countAllocation();
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) noexcept {
+  countAllocation();
+  return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) noexcept {
+  if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+  countAllocation();
+  void* memory = __libc_memalign(alignment, size);
+  if (memory == nullptr) {
+    return ENOMEM;
+  }
+  *p = memory;
+  return 0;
+}
+
+void free(void* p) noexcept {
+  __libc_free(p);
+}
+
+}  // extern "C"
+
+namespace franka_ros_controllers {
+namespace benchmarks {
+
+void AllocationCounter::enable(bool enable) {
+  t_count_allocations = enable;
+}
+
+uint64_t AllocationCounter::count() {
+  return t_allocations;
+}
+
+}  // namespace benchmarks
+}  // namespace franka_ros_controllers
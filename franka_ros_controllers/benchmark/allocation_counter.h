@@ -0,0 +1,47 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+namespace franka_ros_controllers {
+namespace benchmarks {
+
+/**
+ * Counts the heap allocations (malloc and its relatives, through which operator new and Eigen
+ * allocate) of the calling thread while counting is enabled, so that the threads of ROS and of
+ * the realtime publishers do not show up. Defined in allocation_counter.cpp, which replaces the
+ * allocation functions of the executable it is linked into.
+ */
+class AllocationCounter {
+ public:
+  static void enable(bool enable);
+  static uint64_t count();
+};
+
+}  // namespace benchmarks
+}  // namespace franka_ros_controllers
@@ -0,0 +1,103 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#include "benchmark_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace franka_ros_controllers {
+namespace benchmarks {
+
+CacheMissCounter::CacheMissCounter() {
+  perf_event_attr attr{};
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+CacheMissCounter::~CacheMissCounter() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void CacheMissCounter::start() {
+  if (!available()) {
+    return;
+  }
+  ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+  ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+uint64_t CacheMissCounter::stop() {
+  uint64_t count = 0;
+  if (available()) {
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+      count = 0;
+    }
+  }
+  return count;
+}
+
+UpdateCounters::UpdateCounters() {
+  allocations_start_ = AllocationCounter::count();
+  AllocationCounter::enable(true);
+  cache_misses_.start();
+}
+
+UpdateCounters::~UpdateCounters() {
+  cache_misses_.stop();
+  AllocationCounter::enable(false);
+}
+
+void UpdateCounters::report(benchmark::State& state) {
+  if (reported_) {
+    return;
+  }
+  reported_ = true;
+  uint64_t cache_misses = cache_misses_.stop();
+  AllocationCounter::enable(false);
+  state.counters["allocs/update"] = benchmark::Counter(
+      static_cast<double>(AllocationCounter::count() - allocations_start_),
+      benchmark::Counter::kAvgIterations);
+  if (cache_misses_.available()) {
+    state.counters["cache_misses/update"] =
+        benchmark::Counter(static_cast<double>(cache_misses), benchmark::Counter::kAvgIterations);
+  } else {
+    state.SetLabel("no perf counters");
+  }
+}
+
+}  // namespace benchmarks
+}  // namespace franka_ros_controllers
@@ -0,0 +1,83 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+#include "allocation_counter.h"
+
+namespace franka_ros_controllers {
+namespace benchmarks {
+
+/**
+ * Counts the last level cache misses of the calling thread in user space with perf_event_open.
+ * Unavailable unless perf events are permitted (kernel.perf_event_paranoid <= 2, or
+ * CAP_PERFMON) and the CPU exposes the event, e.g. not in most virtual machines.
+ */
+class CacheMissCounter {
+ public:
+  CacheMissCounter();
+  ~CacheMissCounter();
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  bool available() const { return fd_ >= 0; }
+  void start();
+  uint64_t stop();
+
+ private:
+  int fd_{-1};
+};
+
+/**
+ * Measures allocations and cache misses around the timed loop of a benchmark and reports them
+ * per iteration, as the allocs/update and cache_misses/update counters:
+ *
+ *   UpdateCounters counters;
+ *   for (auto _ : state) { ... }
+ *   counters.report(state);
+ */
+class UpdateCounters {
+ public:
+  UpdateCounters();
+  ~UpdateCounters();
+
+  /**
+   * Stops counting and adds the counters to the results of the benchmark.
+   */
+  void report(benchmark::State& state);
+
+ private:
+  CacheMissCounter cache_misses_;
+  uint64_t allocations_start_{0};
+  bool reported_{false};
+};
+
+}  // namespace benchmarks
+}  // namespace franka_ros_controllers
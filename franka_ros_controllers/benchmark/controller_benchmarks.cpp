@@ -0,0 +1,191 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+// Times update() of the controllers and of CustomFrankaStateController on a MockFrankaHW, e.g.
+//
+//   roslaunch franka_ros_controllers controller_benchmarks.launch
+//   roslaunch franka_ros_controllers controller_benchmarks.launch recording:=<state recording> \
+//       args:="--benchmark_filter=update/joint_impedance_controller"
+//
+// Besides the time per update, the allocs/update and cache_misses/update counters are reported
+// for the thread running update(). Needs a ROS master (started by roslaunch), as the controllers
+// advertise and subscribe to topics in init().
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <controller_interface/controller_base.h>
+#include <ros/ros.h>
+
+#include <franka_interface/robot_state_controller.h>
+#include <franka_ros_controllers/cartesian_impedance_controller.h>
+#include <franka_ros_controllers/cartesian_streaming_controller.h>
+#include <franka_ros_controllers/effort_joint_impedance_controller.h>
+#include <franka_ros_controllers/effort_joint_position_controller.h>
+#include <franka_ros_controllers/effort_joint_torque_controller.h>
+#include <franka_ros_controllers/force_controller.h>
+#include <franka_ros_controllers/joint_impedance_controller.h>
+#include <franka_ros_controllers/ntorque_controller.h>
+#include <franka_ros_controllers/position_joint_position_controller.h>
+#include <franka_ros_controllers/velocity_joint_velocity_controller.h>
+
+#include "benchmark_counters.h"
+#include "mock_franka_hw.h"
+
+namespace franka_ros_controllers {
+namespace benchmarks {
+namespace {
+
+const std::string kNamespace = "/franka_ros_interface/";
+const ros::Duration kPeriod(0.001);
+
+std::vector<franka::RobotState> g_trajectory;
+std::string g_arm_id;
+std::vector<std::string> g_joint_names;
+
+/**
+ * Initialises and starts the controller on a MockFrankaHW, then times hardware read plus
+ * controller update, as in one cycle of the control node.
+ */
+void runController(benchmark::State& state,
+                   controller_interface::ControllerBase& controller,
+                   const std::string& name) {
+  MockFrankaHW hardware(g_arm_id, g_joint_names, g_trajectory);
+  ros::NodeHandle root_node_handle;
+  ros::NodeHandle controller_node_handle(kNamespace + name);
+  controller_interface::ControllerBase::ClaimedResources claimed_resources;
+  if (!controller.initRequest(&hardware, root_node_handle, controller_node_handle,
+                              claimed_resources)) {
+    state.SkipWithError(("could not initialise " + name).c_str());
+    return;
+  }
+  ros::Time time = ros::Time::now();
+  controller.startRequest(time);
+
+  UpdateCounters counters;
+  for (auto _ : state) {
+    hardware.read();
+    time += kPeriod;
+    controller.updateRequest(time, kPeriod);
+  }
+  counters.report(state);
+  controller.stopRequest(time);
+}
+
+template <typename Controller>
+void BM_ControllerUpdate(benchmark::State& state, const std::string& name) {
+  Controller controller;
+  runController(state, controller, name);
+}
+
+/**
+ * CustomFrankaStateController publishing either all topics or only robot_state every cycle.
+ */
+void BM_StateControllerUpdate(benchmark::State& state, bool robot_state_only) {
+  const std::string name = "custom_franka_state_controller";
+  const std::string rates = kNamespace + name + "/publish_rates/";
+  ros::param::set(kNamespace + name + "/publish_rate", 1e9);
+  for (const std::string& topic : {"joint_states", "tf", "tip_state"}) {
+    ros::param::set(rates + topic, robot_state_only ? 1e-9 : 1e9);
+  }
+  ros::param::set(rates + "robot_state", 1e9);
+  franka_interface::CustomFrankaStateController controller;
+  runController(state, controller, name);
+}
+
+// baseline cost of the mock hardware included in every other benchmark
+void BM_MockFrankaHWRead(benchmark::State& state) {
+  MockFrankaHW hardware(g_arm_id, g_joint_names, g_trajectory);
+  UpdateCounters counters;
+  for (auto _ : state) {
+    hardware.read();
+    benchmark::DoNotOptimize(hardware.robotState());
+  }
+  counters.report(state);
+}
+
+template <typename Controller>
+void registerController(const std::string& name) {
+  benchmark::RegisterBenchmark(("update/" + name).c_str(), [name](benchmark::State& state) {
+    BM_ControllerUpdate<Controller>(state, name);
+  });
+}
+
+}  // anonymous namespace
+}  // namespace benchmarks
+}  // namespace franka_ros_controllers
+
+int main(int argc, char** argv) {
+  using namespace franka_ros_controllers;
+  using namespace franka_ros_controllers::benchmarks;
+
+  ros::init(argc, argv, "controller_benchmarks", ros::init_options::AnonymousName);
+  benchmark::Initialize(&argc, argv);
+  ros::NodeHandle node_handle("~");
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  node_handle.param<std::string>("/robot_config/arm_id", g_arm_id, "panda");
+  if (!node_handle.getParam("/robot_config/joint_names", g_joint_names) ||
+      g_joint_names.size() != 7) {
+    ROS_ERROR("controller_benchmarks: Invalid or no /robot_config/joint_names parameter");
+    return 1;
+  }
+  std::string recording;
+  if (node_handle.getParam("recording", recording) && !recording.empty()) {
+    std::string error;
+    g_trajectory = recordedTrajectory(recording, error);
+    if (g_trajectory.empty()) {
+      ROS_ERROR_STREAM("controller_benchmarks: Could not read recording: " << error);
+      return 1;
+    }
+    ROS_INFO_STREAM("controller_benchmarks: Replaying " << g_trajectory.size()
+                    << " robot states from " << recording);
+  } else {
+    g_trajectory = syntheticTrajectory();
+  }
+
+  benchmark::RegisterBenchmark("read/mock_franka_hw", &BM_MockFrankaHWRead);
+  benchmark::RegisterBenchmark("update/custom_franka_state_controller",
+                               [](benchmark::State& state) { BM_StateControllerUpdate(state, false); });
+  benchmark::RegisterBenchmark("publishFrankaState/custom_franka_state_controller",
+                               [](benchmark::State& state) { BM_StateControllerUpdate(state, true); });
+  registerController<PositionJointPositionController>("position_joint_position_controller");
+  registerController<VelocityJointVelocityController>("velocity_joint_velocity_controller");
+  registerController<EffortJointImpedanceController>("effort_joint_impedance_controller");
+  registerController<EffortJointPositionController>("effort_joint_position_controller");
+  registerController<EffortJointTorqueController>("effort_joint_torque_controller");
+  registerController<ForceController>("force_controller");
+  registerController<CartesianImpedanceController>("cartesian_impedance_controller");
+  registerController<JointImpedanceController>("joint_impedance_controller");
+  registerController<CartesianStreamingController>("cartesian_streaming_controller");
+  registerController<NTorqueController>("ntorque_controller");
+
+  benchmark::RunSpecifiedBenchmarks();
+  ros::shutdown();
+  return 0;
+}
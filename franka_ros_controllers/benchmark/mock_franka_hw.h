@@ -0,0 +1,251 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <franka/robot_state.h>
+#include <franka_hw/franka_cartesian_command_interface.h>
+#include <franka_hw/franka_state_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
+#include <franka_interface/state_recording.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/robot_hw.h>
+
+namespace franka_ros_controllers {
+namespace benchmarks {
+
+/**
+ * Model quantities that vary smoothly with the joint state and keep the matrices well
+ * conditioned. They are not the Panda's: the benchmarks time our code, not libfranka's model.
+ */
+class SyntheticModelSource : public franka_interface::FrankaModelSource {
+ public:
+  explicit SyntheticModelSource(const franka::RobotState& robot_state)
+      : robot_state_(robot_state) {}
+
+  std::array<double, 7> getCoriolis() const override {
+    std::array<double, 7> coriolis{};
+    for (size_t i = 0; i < 7; ++i) {
+      coriolis[i] = 0.1 * robot_state_.dq[i] * std::cos(robot_state_.q[i]);
+    }
+    return coriolis;
+  }
+
+  std::array<double, 7> getGravity() const override {
+    std::array<double, 7> gravity{};
+    for (size_t i = 0; i < 7; ++i) {
+      gravity[i] = 10.0 * std::sin(robot_state_.q[i]) / (1.0 + i);
+    }
+    return gravity;
+  }
+
+  std::array<double, 49> getMass() const override {
+    std::array<double, 49> mass{};
+    for (size_t c = 0; c < 7; ++c) {
+      for (size_t r = 0; r < 7; ++r) {
+        mass[7 * c + r] = r == c ? 2.0 - 0.2 * r : 0.05 * std::cos(robot_state_.q[r] - robot_state_.q[c]);
+      }
+    }
+    return mass;
+  }
+
+  std::array<double, 42> getZeroJacobian(const franka::Frame& /*frame*/) const override {
+    std::array<double, 42> jacobian{};
+    for (size_t c = 0; c < 7; ++c) {
+      for (size_t r = 0; r < 6; ++r) {
+        jacobian[6 * c + r] = std::cos(robot_state_.q[c] + 0.7 * r) * (1.0 + 0.1 * c);
+      }
+    }
+    return jacobian;
+  }
+
+ private:
+  const franka::RobotState& robot_state_;
+};
+
+/**
+ * RobotHW with the interfaces of franka_hw::FrankaCombinableHW and a FrankaModelCacheInterface,
+ * replaying a list of robot states instead of talking to a robot. Commands are accepted and
+ * ignored.
+ */
+class MockFrankaHW : public hardware_interface::RobotHW {
+ public:
+  MockFrankaHW(const std::string& arm_id,
+               const std::vector<std::string>& joint_names,
+               std::vector<franka::RobotState> trajectory)
+      : trajectory_(std::move(trajectory)),
+        model_cache_(std::make_shared<franka_interface::FrankaModelCache>(
+            std::make_unique<SyntheticModelSource>(robot_state_))) {
+    robot_state_ = trajectory_.at(0);
+    franka_hw::FrankaStateHandle state_handle(arm_id + "_robot", robot_state_);
+    franka_state_interface_.registerHandle(state_handle);
+    franka_pose_cartesian_interface_.registerHandle(
+        franka_hw::FrankaCartesianPoseHandle(state_handle, pose_command_, elbow_command_));
+    model_cache_interface_.registerHandle(
+        franka_interface::FrankaModelCacheHandle(arm_id + "_model", model_cache_));
+
+    for (size_t i = 0; i < joint_names.size() && i < 7; ++i) {
+      hardware_interface::JointStateHandle joint_state_handle(
+          joint_names[i], &robot_state_.q[i], &robot_state_.dq[i], &robot_state_.tau_J[i]);
+      joint_state_interface_.registerHandle(joint_state_handle);
+      position_joint_interface_.registerHandle(
+          hardware_interface::JointHandle(joint_state_handle, &position_command_[i]));
+      velocity_joint_interface_.registerHandle(
+          hardware_interface::JointHandle(joint_state_handle, &velocity_command_[i]));
+      effort_joint_interface_.registerHandle(
+          hardware_interface::JointHandle(joint_state_handle, &effort_command_[i]));
+    }
+
+    registerInterface(&joint_state_interface_);
+    registerInterface(&position_joint_interface_);
+    registerInterface(&velocity_joint_interface_);
+    registerInterface(&effort_joint_interface_);
+    registerInterface(&franka_state_interface_);
+    registerInterface(&franka_pose_cartesian_interface_);
+    registerInterface(&model_cache_interface_);
+  }
+
+  /**
+   * Moves on to the next robot state of the trajectory, as the control node does every cycle.
+   */
+  void read() {
+    if (++index_ == trajectory_.size()) {
+      index_ = 0;
+    }
+    robot_state_ = trajectory_[index_];
+    model_cache_->invalidate();
+  }
+
+  const franka::RobotState& robotState() const { return robot_state_; }
+
+ private:
+  std::vector<franka::RobotState> trajectory_;
+  size_t index_{0};
+  franka::RobotState robot_state_;
+  std::array<double, 7> position_command_{};
+  std::array<double, 7> velocity_command_{};
+  std::array<double, 7> effort_command_{};
+  std::array<double, 16> pose_command_{};
+  std::array<double, 2> elbow_command_{};
+
+  std::shared_ptr<franka_interface::FrankaModelCache> model_cache_;
+  hardware_interface::JointStateInterface joint_state_interface_;
+  hardware_interface::PositionJointInterface position_joint_interface_;
+  hardware_interface::VelocityJointInterface velocity_joint_interface_;
+  hardware_interface::EffortJointInterface effort_joint_interface_;
+  franka_hw::FrankaStateInterface franka_state_interface_;
+  franka_hw::FrankaPoseCartesianInterface franka_pose_cartesian_interface_;
+  franka_interface::FrankaModelCacheInterface model_cache_interface_;
+};
+
+/**
+ * @return a 1 kHz trajectory of smooth joint motions around the neutral pose.
+ */
+inline std::vector<franka::RobotState> syntheticTrajectory(size_t length = 10000) {
+  const std::array<double, 7> neutral{{0.0, -0.785, 0.0, -2.356, 0.0, 1.571, 0.785}};
+  std::vector<franka::RobotState> trajectory(length);
+  for (size_t k = 0; k < length; ++k) {
+    franka::RobotState& state = trajectory[k];
+    const double t = 0.001 * k;
+    for (size_t i = 0; i < 7; ++i) {
+      const double w = 2.0 * M_PI * (0.2 + 0.05 * i);
+      state.q[i] = neutral[i] + 0.2 * std::sin(w * t);
+      state.dq[i] = 0.2 * w * std::cos(w * t);
+      state.q_d[i] = state.q[i];
+      state.dq_d[i] = state.dq[i];
+      state.tau_J[i] = 5.0 * std::sin(w * t + i);
+      state.tau_J_d[i] = state.tau_J[i];
+      state.tau_ext_hat_filtered[i] = 0.1 * std::sin(3.0 * w * t);
+    }
+    state.O_T_EE = {{1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0,
+                     0.3 + 0.05 * std::sin(t), 0.05 * std::cos(t), 0.5, 1.0}};
+    state.O_T_EE_d = state.O_T_EE;
+    state.F_T_EE = {{0.707, -0.707, 0.0, 0.0, 0.707, 0.707, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0,
+                     0.0, 0.0, 0.1034, 1.0}};
+    state.EE_T_K = {{1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0,
+                     0.0, 0.0, 0.0, 1.0}};
+    state.robot_mode = franka::RobotMode::kMove;
+    state.control_command_success_rate = 1.0;
+    state.time = franka::Duration(k);
+  }
+  return trajectory;
+}
+
+/**
+ * Reads the robot states of a state recording (see franka_interface/state_recording.h), e.g.
+ * to benchmark on the motions of an actual task.
+ *
+ * @param[in] path recording to read.
+ * @param[out] error description of the failure.
+ * @return the trajectory, empty on failure.
+ */
+inline std::vector<franka::RobotState> recordedTrajectory(const std::string& path,
+                                                          std::string& error) {
+  franka_interface::StateRecordingReader reader;
+  if (!reader.open(path, error)) {
+    return {};
+  }
+  if (reader.size() == 0) {
+    error = path + " contains no records";
+    return {};
+  }
+  std::vector<franka::RobotState> trajectory = syntheticTrajectory(reader.size());
+  auto copy = [&](const std::string& name, auto member) {
+    const franka_interface::StateRecordingColumn* column = reader.column(name);
+    if (column == nullptr) {
+      return;
+    }
+    for (size_t k = 0; k < trajectory.size(); ++k) {
+      auto& field = trajectory[k].*member;
+      for (size_t i = 0; i < field.size() && i < column->width; ++i) {
+        field[i] = reader.value(*column, k, i);
+      }
+    }
+  };
+  copy("q", &franka::RobotState::q);
+  copy("dq", &franka::RobotState::dq);
+  copy("q_d", &franka::RobotState::q_d);
+  copy("dq_d", &franka::RobotState::dq_d);
+  copy("tau_J", &franka::RobotState::tau_J);
+  copy("dtau_J", &franka::RobotState::dtau_J);
+  copy("tau_J_d", &franka::RobotState::tau_J_d);
+  copy("tau_ext_hat_filtered", &franka::RobotState::tau_ext_hat_filtered);
+  copy("O_T_EE", &franka::RobotState::O_T_EE);
+  copy("O_T_EE_d", &franka::RobotState::O_T_EE_d);
+  copy("O_F_ext_hat_K", &franka::RobotState::O_F_ext_hat_K);
+  copy("K_F_ext_hat_K", &franka::RobotState::K_F_ext_hat_K);
+  return trajectory;
+}
+
+}  // namespace benchmarks
+}  // namespace franka_ros_controllers
@@ -15,8 +15,11 @@
 #include <ros/time.h>
 #include <Eigen/Dense>
 
+#include <franka_ros_controllers/command_mailbox.h>
+#include <franka_ros_controllers/contact_guard.h>
 #include <franka_ros_controllers/compliance_paramConfig.h>
 #include <franka_hw/franka_model_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
 #include <franka_hw/franka_state_interface.h>
 #include <franka_core_msgs/CartImpedanceStiffness.h>
 
@@ -25,11 +28,15 @@ namespace franka_ros_controllers {
 class CartesianImpedanceController : public controller_interface::MultiInterfaceController<
                                             franka_hw::FrankaModelInterface,
                                             hardware_interface::EffortJointInterface,
-                                            franka_hw::FrankaStateInterface> {
+                                            franka_hw::FrankaStateInterface,
+                                            franka_interface::FrankaModelCacheInterface> {
  public:
+  // FrankaModelCacheInterface is optional, so all interfaces are checked in init()
+  CartesianImpedanceController() : MultiInterfaceController(true) {}
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& node_handle) override;
   void starting(const ros::Time&) override;
   void update(const ros::Time&, const ros::Duration& period) override;
+  void stopping(const ros::Time&) override;
 
  private:
   // Saturation
@@ -37,13 +44,23 @@ class CartesianImpedanceController : public controller_interface::MultiInterface
       const Eigen::Matrix<double, 7, 1>& tau_d_calculated,
       const Eigen::Matrix<double, 7, 1>& tau_J_d);  // NOLINT (readability-identifier-naming)
 
+  // Projects tau onto the nullspace of the damped pseudo-inverse of the Jacobian transpose,
+  // (I - J^T (J J^T + lambda^2 I)^-1 J) tau, without forming the 7x7 projector.
+  Eigen::Matrix<double, 7, 1> projectToNullspace(const Eigen::Matrix<double, 6, 7>& jacobian,
+                                                 const Eigen::Matrix<double, 7, 1>& tau) const;
+
   std::unique_ptr<franka_hw::FrankaStateHandle> state_handle_;
-  std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
+  std::unique_ptr<franka_interface::FrankaModelCacheHandle> model_handle_;
   std::vector<hardware_interface::JointHandle> joint_handles_;
 
   double filter_params_{0.005};
   double nullspace_stiffness_{20.0};
   double nullspace_stiffness_target_{20.0};
+  // the nullspace term is skipped once its stiffness has decayed below this
+  static constexpr double kMinNullspaceStiffness{1e-6};
+  // projector from the SVD pseudo-inverse instead of the closed-form damped inverse (same
+  // result, several times the cost)
+  bool svd_nullspace_projection_{false};
   const double delta_tau_max_{1.0};
   std::vector<double> stiffness_gains_;
   Eigen::Matrix<double, 6, 6> cartesian_stiffness_;
@@ -58,11 +75,15 @@ class CartesianImpedanceController : public controller_interface::MultiInterface
 
   // Equilibrium pose subscriber
   ros::Subscriber sub_equilibrium_pose_;
+  CommandMailbox<CartesianPoseCommand> equilibrium_pose_mailbox_;
   void equilibriumPoseCallback(const geometry_msgs::PoseStampedConstPtr& msg);
 
   // Stiffness subscriber 
   ros::Subscriber stiffness_params_;
+  CommandMailbox<std::array<double, 6>> stiffness_mailbox_;
   void stiffnessParamCallback(const franka_core_msgs::CartImpedanceStiffness& msg);
+
+  ContactGuard contact_guard_;
 };
 
 }  // namespace franka_ros_controllers
@@ -0,0 +1,195 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <Eigen/Dense>
+
+namespace franka_ros_controllers {
+
+/**
+ * Velocity, acceleration and jerk limits of one component (translation or rotation) of a
+ * Cartesian motion, in [m] or [rad] and [s].
+ */
+struct CartesianLimits {
+  double velocity{1.0};
+  double acceleration{5.0};
+  double jerk{1000.0};
+};
+
+/**
+ * Generates a Cartesian pose setpoint per control cycle that tracks a streamed target with
+ * bounded velocity, acceleration and jerk.
+ *
+ * The target is a pose plus a velocity (twist in the base frame) by which it moves on in every
+ * cycle, so that it can be given as a pose, a twist or a pose with the velocity of the stream.
+ * The setpoint follows the target with a velocity feed-forward and a proportional correction,
+ * which is reduced near the target so that the setpoint can brake without overshooting. Each
+ * translational axis and each component of the rotation vector (base frame) is limited
+ * separately, as franka::limitRate() does: jerk bounds the change of the acceleration, and the
+ * acceleration is reduced towards the velocity limits so that they are approached without a jerk
+ * beyond the limit.
+ *
+ * Fixed-size Eigen only, so all methods are realtime safe; owned by the control loop.
+ */
+class CartesianSetpointTracker {
+ public:
+  using Vector6d = Eigen::Matrix<double, 6, 1>;
+
+  /**
+   * @param[in] gain [1/s] of the correction of the tracking error.
+   */
+  void configure(const CartesianLimits& translation, const CartesianLimits& rotation,
+                 double gain) {
+    for (size_t i = 0; i < 6; ++i) {
+      const CartesianLimits& limits = i < 3 ? translation : rotation;
+      max_velocity_[i] = limits.velocity;
+      max_acceleration_[i] = limits.acceleration;
+      max_jerk_[i] = limits.jerk;
+    }
+    gain_ = gain;
+  }
+
+  /**
+   * Starts at rest at the given pose (column-major homogeneous transform, as O_T_EE_d), which
+   * becomes the target. Call from starting().
+   */
+  void reset(const std::array<double, 16>& pose) {
+    Eigen::Map<const Eigen::Matrix4d> transform(pose.data());
+    position_ = transform.block<3, 1>(0, 3);
+    orientation_ = Eigen::Quaterniond(transform.block<3, 3>(0, 0)).normalized();
+    velocity_.setZero();
+    acceleration_.setZero();
+    target_position_ = position_;
+    target_orientation_ = orientation_;
+    target_velocity_.setZero();
+  }
+
+  /**
+   * Sets a new target pose, which then moves on with velocity (see setTargetVelocity()).
+   */
+  void setTarget(const Eigen::Vector3d& position, const Eigen::Quaterniond& orientation,
+                 const Vector6d& velocity) {
+    target_position_ = position;
+    target_orientation_ = orientation.normalized();
+    setTargetVelocity(velocity);
+  }
+
+  /**
+   * Moves the current target on with velocity, clamped to the velocity limits so that the
+   * target cannot run away from the setpoint.
+   */
+  void setTargetVelocity(const Vector6d& velocity) {
+    target_velocity_ = velocity.cwiseMax(-max_velocity_).cwiseMin(max_velocity_);
+  }
+
+  /**
+   * Stops the target where it is; the setpoint brakes to it.
+   */
+  void stopTarget() { target_velocity_.setZero(); }
+
+  /**
+   * Advances the target and the setpoint by one cycle.
+   *
+   * @param[in] dt [s] since the previous cycle.
+   * @param[out] pose setpoint of this cycle (column-major homogeneous transform).
+   */
+  void step(double dt, std::array<double, 16>& pose) {
+    target_position_ += target_velocity_.head<3>() * dt;
+    target_orientation_ = (rotationFrom(target_velocity_.tail<3>() * dt) * target_orientation_)
+                              .normalized();
+
+    Vector6d error;
+    error.head<3>() = target_position_ - position_;
+    Eigen::Quaterniond difference = target_orientation_ * orientation_.conjugate();
+    if (difference.w() < 0.0) {
+      difference.coeffs() = -difference.coeffs();
+    }
+    Eigen::AngleAxisd rotation_error(difference);
+    error.tail<3>() = rotation_error.axis() * rotation_error.angle();
+
+    for (size_t i = 0; i < 6; ++i) {
+      // braking from v over the distance d at half the acceleration limit needs v^2 <= a * d
+      double distance = std::abs(error[i]);
+      double correction = std::min(gain_ * distance, std::sqrt(max_acceleration_[i] * distance));
+      double v_desired = target_velocity_[i] + std::copysign(correction, error[i]);
+
+      double v = velocity_[i];
+      double a = (v_desired - v) / dt;
+      a = std::min(std::max(a, acceleration_[i] - max_jerk_[i] * dt),
+                   acceleration_[i] + max_jerk_[i] * dt);
+      double braking_gain = max_jerk_[i] / max_acceleration_[i];
+      double upper = std::min(braking_gain * (max_velocity_[i] - v), max_acceleration_[i]);
+      double lower = std::max(braking_gain * (-max_velocity_[i] - v), -max_acceleration_[i]);
+      a = std::min(std::max(a, lower), upper);
+      double v_next = std::min(std::max(v + a * dt, -max_velocity_[i]), max_velocity_[i]);
+      acceleration_[i] = (v_next - v) / dt;
+      velocity_[i] = v_next;
+    }
+
+    position_ += velocity_.head<3>() * dt;
+    orientation_ = (rotationFrom(velocity_.tail<3>() * dt) * orientation_).normalized();
+
+    Eigen::Map<Eigen::Matrix4d> transform(pose.data());
+    transform.setIdentity();
+    transform.block<3, 3>(0, 0) = orientation_.toRotationMatrix();
+    transform.block<3, 1>(0, 3) = position_;
+  }
+
+  const Vector6d& velocity() const { return velocity_; }
+  const Eigen::Vector3d& targetPosition() const { return target_position_; }
+  const Eigen::Quaterniond& targetOrientation() const { return target_orientation_; }
+
+ private:
+  static Eigen::Quaterniond rotationFrom(const Eigen::Vector3d& rotation_vector) {
+    double angle = rotation_vector.norm();
+    if (angle < 1e-12) {
+      return Eigen::Quaterniond::Identity();
+    }
+    return Eigen::Quaterniond(Eigen::AngleAxisd(angle, rotation_vector / angle));
+  }
+
+  Vector6d max_velocity_{Vector6d::Ones()};
+  Vector6d max_acceleration_{Vector6d::Constant(5.0)};
+  Vector6d max_jerk_{Vector6d::Constant(1000.0)};
+  double gain_{10.0};
+
+  Eigen::Vector3d position_{Eigen::Vector3d::Zero()};
+  Eigen::Quaterniond orientation_{Eigen::Quaterniond::Identity()};
+  Vector6d velocity_{Vector6d::Zero()};
+  Vector6d acceleration_{Vector6d::Zero()};
+
+  Eigen::Vector3d target_position_{Eigen::Vector3d::Zero()};
+  Eigen::Quaterniond target_orientation_{Eigen::Quaterniond::Identity()};
+  Vector6d target_velocity_{Vector6d::Zero()};
+};
+
+}  // namespace franka_ros_controllers
@@ -0,0 +1,112 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <controller_interface/multi_interface_controller.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <hardware_interface/robot_hw.h>
+#include <ros/message_event.h>
+#include <ros/node_handle.h>
+#include <ros/time.h>
+#include <Eigen/Dense>
+
+#include <franka_hw/franka_cartesian_command_interface.h>
+#include <franka_ros_controllers/cartesian_setpoint_tracker.h>
+#include <franka_ros_controllers/command_latency_tracer.h>
+#include <franka_ros_controllers/command_mailbox.h>
+#include <franka_ros_controllers/command_watchdog.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * Streams Cartesian setpoints to the internal Cartesian motion generator and impedance
+ * controller of the robot through the FrankaPoseCartesianInterface.
+ *
+ * The end-effector pose (O_T_EE) is commanded as geometry_msgs/PoseStamped on
+ * franka_ros_interface/motion_controller/arm/cartesian_pose_target, or moved with a twist in the
+ * base frame (geometry_msgs/TwistStamped) on
+ * franka_ros_interface/motion_controller/arm/cartesian_twist_target, both in the arm namespace.
+ * The velocity of a pose stream is estimated from consecutive poses and their header stamps,
+ * and the target is extrapolated with it for up to 1.5 intervals of the stream, which bridges
+ * the jitter of the stream without letting the target run far beyond a pose that turns out to
+ * be the last one; poses more than max_extrapolation apart are not treated as a stream. A twist
+ * moves the target for at most max_twist_duration, so twists have to be repeated to keep moving;
+ * the command timeout (see CommandWatchdog) stops the target as well, but may be disabled. A
+ * CartesianSetpointTracker follows the target at control rate within the velocity, acceleration
+ * and jerk limits of the controller parameters.
+ */
+class CartesianStreamingController : public controller_interface::MultiInterfaceController<
+                                         franka_hw::FrankaPoseCartesianInterface> {
+ public:
+  bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& node_handle) override;
+  void starting(const ros::Time&) override;
+  void update(const ros::Time&, const ros::Duration& period) override;
+  void stopping(const ros::Time&) override;
+
+ private:
+  static constexpr double kNominalPeriod{0.001};  // [s], used for the zero period of a restart
+  static constexpr double kQuaternionNormTolerance{1e-3};
+
+  static bool readLimits(ros::NodeHandle& node_handle, const std::string& name,
+                         CartesianLimits& limits);
+
+  void poseTargetCallback(const ros::MessageEvent<geometry_msgs::PoseStamped const>& event);
+  void twistTargetCallback(const ros::MessageEvent<geometry_msgs::TwistStamped const>& event);
+
+  std::unique_ptr<franka_hw::FrankaCartesianPoseHandle> cartesian_pose_handle_;
+  CartesianSetpointTracker tracker_;
+  std::array<double, 16> pose_command_{};
+  double max_extrapolation_{0.1};  // [s]
+  double max_twist_duration_{0.1};  // [s]
+
+  ros::Subscriber pose_target_subscriber_;
+  ros::Subscriber twist_target_subscriber_;
+  CommandMailbox<CartesianStreamCommand> pose_target_mailbox_;
+  CommandMailbox<CartesianStreamCommand> twist_target_mailbox_;
+  CommandLatencyTracer latency_tracer_;
+  CommandWatchdog command_watchdog_;
+  std::atomic<uint64_t> rejected_targets_{0};
+
+  // owned by the pose callback: the previous pose, for the velocity of the stream
+  ros::Time last_pose_stamp_;
+  Eigen::Vector3d last_position_{Eigen::Vector3d::Zero()};
+  Eigen::Quaterniond last_orientation_{Eigen::Quaterniond::Identity()};
+
+  // control loop only
+  bool extrapolating_{false};  // the target moves with the velocity of a pose stream or twist
+  ros::Time extrapolation_end_;
+};
+
+}  // namespace franka_ros_controllers
@@ -0,0 +1,182 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <franka_core_msgs/CommandLatency.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/histogram.h>
+#include <franka_ros_controllers/command_mailbox.h>
+#include <ros/console.h>
+#include <ros/message_event.h>
+#include <ros/node_handle.h>
+#include <ros/time.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * Traces joint commands from the client to the control cycle that applied them and publishes
+ * the latency of each stage (see franka_core_msgs::CommandLatency) on
+ * franka_ros_interface/motion_controller/arm/command_latency in the arm namespace.
+ *
+ * The subscriber callback takes the command as a ros::MessageEvent and stores received() in the
+ * CommandTrace of the command it hands to the control loop; update() calls applied() for every
+ * command it reads from its mailbox, which happens exactly once, in the first cycle that uses
+ * it. Statistics are accumulated since init() and published from a timer on the spinner
+ * threads, whenever new commands were applied.
+ *
+ * Disabled unless the controller's latency_tracing/enabled parameter (default
+ * controllers_config/latency_tracing/enabled in the arm namespace) is set, in which case
+ * received() returns an empty trace and applied() does nothing.
+ */
+class CommandLatencyTracer {
+ public:
+  /**
+   * Reads the configuration and, if enabled, advertises the topic and starts the publishing
+   * timer. Call from init().
+   *
+   * @param[in] node_handle node handle in the controller namespace.
+   * @param[in] controller_name prefix for log messages.
+   */
+  void init(ros::NodeHandle& node_handle, const std::string& controller_name) {
+    ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+    bool default_enabled(false);
+    arm_node_handle.param<bool>("controllers_config/latency_tracing/enabled", default_enabled,
+                                default_enabled);
+    node_handle.param<bool>("latency_tracing/enabled", enabled_, default_enabled);
+    if (!enabled_) {
+      return;
+    }
+    double publish_rate(1.0);
+    arm_node_handle.param<double>("controllers_config/latency_tracing/publish_rate", publish_rate,
+                                  publish_rate);
+    if (!(publish_rate > 0.0)) {
+      ROS_WARN_STREAM(controller_name << ": Invalid latency_tracing/publish_rate " << publish_rate
+                      << ", using 1 Hz");
+      publish_rate = 1.0;
+    }
+    controller_ = node_handle.getNamespace();
+    publisher_ = arm_node_handle.advertise<franka_core_msgs::CommandLatency>(
+        "franka_ros_interface/motion_controller/arm/command_latency", 10);
+    publish_timer_ = node_handle.createTimer(ros::Duration(1.0 / publish_rate),
+                                             &CommandLatencyTracer::publish, this);
+    ROS_INFO_STREAM(controller_name << ": Tracing command latency, published at " << publish_rate
+                    << " Hz on " << publisher_.getTopic());
+  }
+
+  bool enabled() const { return enabled_; }
+
+  /**
+   * Stamps a command in its subscriber callback.
+   *
+   * @param[in] event the command, with the time roscpp read it from the connection.
+   * @return trace to hand to the control loop with the command.
+   */
+  template <typename Message>
+  CommandTrace received(const ros::MessageEvent<Message const>& event) const {
+    CommandTrace trace;
+    if (!enabled_) {
+      return trace;
+    }
+    trace.callback_ns = static_cast<int64_t>(ros::Time::now().toNSec());
+    trace.stamp_ns = static_cast<int64_t>(event.getConstMessage()->header.stamp.toNSec());
+    trace.receipt_ns = event.getReceiptTime().isZero()
+                           ? trace.callback_ns
+                           : static_cast<int64_t>(event.getReceiptTime().toNSec());
+    return trace;
+  }
+
+  /**
+   * Records a command applied in this cycle. Realtime safe; must only be called from update().
+   *
+   * @param[in] trace trace returned by received() for the command.
+   * @param[in] time time of the control cycle, as passed to update().
+   */
+  void applied(const CommandTrace& trace, const ros::Time& time) {
+    if (trace.callback_ns == 0) {
+      return;
+    }
+    const int64_t now_ns = static_cast<int64_t>(time.toNSec());
+    callback_queue_.add((trace.callback_ns - trace.receipt_ns) * 1e-9);
+    control_loop_.add((now_ns - trace.callback_ns) * 1e-9);
+    if (trace.stamp_ns == 0) {
+      increment(unstamped_commands_);
+    } else if (trace.stamp_ns > trace.receipt_ns) {
+      increment(clock_skew_commands_);
+    } else {
+      network_.add((trace.receipt_ns - trace.stamp_ns) * 1e-9);
+      total_.add((now_ns - trace.stamp_ns) * 1e-9);
+    }
+    increment(commands_);
+  }
+
+ private:
+  static void increment(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  void publish(const ros::TimerEvent& /*e*/) {
+    uint64_t commands = commands_.load(std::memory_order_relaxed);
+    if (commands == published_commands_ || publisher_.getNumSubscribers() == 0) {
+      return;
+    }
+    published_commands_ = commands;
+    franka_core_msgs::CommandLatency msg;
+    msg.header.stamp = ros::Time::now();
+    msg.controller = controller_;
+    msg.commands = commands;
+    msg.unstamped_commands = unstamped_commands_.load(std::memory_order_relaxed);
+    msg.clock_skew_commands = clock_skew_commands_.load(std::memory_order_relaxed);
+    network_.fill(msg.network);
+    callback_queue_.fill(msg.callback_queue);
+    control_loop_.fill(msg.control_loop);
+    total_.fill(msg.total);
+    publisher_.publish(msg);
+  }
+
+  bool enabled_{false};
+  std::string controller_;
+
+  using LatencyHistogram = franka_interface::Histogram<franka_interface::LogBins>;
+  LatencyHistogram network_;
+  LatencyHistogram callback_queue_;
+  LatencyHistogram control_loop_;
+  LatencyHistogram total_;
+  std::atomic<uint64_t> commands_{0};
+  std::atomic<uint64_t> unstamped_commands_{0};
+  std::atomic<uint64_t> clock_skew_commands_{0};
+
+  // owned by the timer callback
+  uint64_t published_commands_{0};
+  ros::Publisher publisher_;
+  ros::Timer publish_timer_;
+};
+
+}  // namespace franka_ros_controllers
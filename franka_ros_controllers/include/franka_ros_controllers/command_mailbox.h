@@ -0,0 +1,164 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace franka_ros_controllers {
+
+/**
+ * ROS times [ns] of a command on its way to the control loop, see CommandLatencyTracer.
+ * All zero unless latency tracing is enabled.
+ */
+struct CommandTrace {
+  int64_t stamp_ns{0};     // header.stamp set by the client, 0 if it left it unset
+  int64_t receipt_ns{0};   // message read from the connection by roscpp
+  int64_t callback_ns{0};  // subscriber callback started
+};
+
+/**
+ * Joint space target handed from a subscriber callback to the control loop.
+ * Fields that a controller does not use are left untouched.
+ */
+struct JointTargetCommand {
+  std::array<double, 7> position{};
+  std::array<double, 7> velocity{};
+  std::array<double, 7> effort{};
+  // set for rejected commands: the control loop should hold its current state instead
+  bool hold{false};
+  CommandTrace trace;
+};
+
+/**
+ * Cartesian equilibrium pose; orientation is stored as (x, y, z, w).
+ */
+struct CartesianPoseCommand {
+  std::array<double, 3> position{};
+  std::array<double, 4> orientation{{0.0, 0.0, 0.0, 1.0}};
+};
+
+/**
+ * Streamed Cartesian target: a pose moving on with velocity, or only the velocity (twist in the
+ * base frame, linear then angular) for the current target.
+ */
+struct CartesianStreamCommand {
+  std::array<double, 3> position{};
+  std::array<double, 4> orientation{{0.0, 0.0, 0.0, 1.0}};  // (x, y, z, w)
+  std::array<double, 6> velocity{};
+  double duration{0.0};  // [s] for which the target moves with velocity, 0: until the next one
+  CommandTrace trace;
+};
+
+/**
+ * Wait-free triple buffer for passing commands from a single non-realtime writer
+ * (a ROS subscriber callback) to the realtime update() loop.
+ *
+ * Unlike realtime_tools::RealtimeBuffer, neither side ever takes a mutex: the writer
+ * fills a private slot and swaps it with the shared one in a single atomic exchange, and
+ * the reader does the same with its own slot when a new command is pending. The reader
+ * therefore always sees a complete command, never a mix of two. Commands that are
+ * replaced before the control loop picks them up are counted in overwrittenCount().
+ *
+ * roscpp does not run the callbacks of one subscriber concurrently, so each subscriber
+ * should write to its own mailbox.
+ */
+template <typename T>
+class CommandMailbox {
+ public:
+  CommandMailbox() = default;
+  CommandMailbox(const CommandMailbox&) = delete;
+  CommandMailbox& operator=(const CommandMailbox&) = delete;
+
+  /**
+   * Publishes a new command. Must only be called from the (single) writer thread.
+   *
+   * @param[in] command Command to be picked up by the next readFromRT().
+   */
+  void writeFromNonRT(const T& command) {
+    slots_[back_] = command;
+    uint8_t previous = shared_.exchange(back_ | kFreshBit, std::memory_order_acq_rel);
+    if (previous & kFreshBit) {
+      overwritten_.fetch_add(1, std::memory_order_relaxed);
+    }
+    back_ = previous & kIndexMask;
+    written_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Fetches the latest command if one arrived since the last call. Wait-free and
+   * allocation-free; safe to call from update().
+   *
+   * @param[out] command Filled with the latest command; untouched when nothing is pending.
+   * @return true if a new command was copied into command.
+   */
+  bool readFromRT(T& command) {
+    if (!(shared_.load(std::memory_order_acquire) & kFreshBit)) {
+      return false;
+    }
+    front_ = shared_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    command = slots_[front_];
+    return true;
+  }
+
+  /**
+   * Drops any pending command, e.g. from starting() so that a command received while the
+   * controller was stopped is not applied on activation.
+   */
+  void clear() {
+    if (shared_.load(std::memory_order_acquire) & kFreshBit) {
+      front_ = shared_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    }
+  }
+
+  /**
+   * @return number of commands replaced by a newer one before the control loop read them.
+   */
+  uint64_t overwrittenCount() const { return overwritten_.load(std::memory_order_relaxed); }
+
+  /**
+   * @return total number of commands written to the mailbox.
+   */
+  uint64_t writtenCount() const { return written_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr uint8_t kIndexMask{0x3};
+  static constexpr uint8_t kFreshBit{0x4};
+
+  std::array<T, 3> slots_{};
+  // index of the slot currently shared between writer and reader, plus kFreshBit while
+  // it holds a command the reader has not seen yet
+  std::atomic<uint8_t> shared_{1};
+  uint8_t back_{0};   // owned by the writer
+  uint8_t front_{2};  // owned by the reader
+
+  std::atomic<uint64_t> overwritten_{0};
+  std::atomic<uint64_t> written_{0};
+};
+
+}  // namespace franka_ros_controllers
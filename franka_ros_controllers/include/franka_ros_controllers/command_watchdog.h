@@ -0,0 +1,131 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <franka_interface/arm_namespace.h>
+#include <ros/console.h>
+#include <ros/node_handle.h>
+#include <ros/time.h>
+#include <std_msgs/Float64.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * Detects, in the control loop, that commands stopped arriving.
+ *
+ * update() stamps every command it takes from its mailbox (or from shared memory) with the time
+ * of the control cycle, calls expired() every cycle and brings the robot to a safe state itself
+ * (hold position, ramp velocity down, ...) as soon as the timeout is exceeded, without waiting
+ * for a controller switch. Arrival and expiry are both measured on the control loop clock; the
+ * simulation steps that clock itself, so ros::Time::now() in the command callbacks can differ.
+ *
+ * The timeout is the controller's command_timeout parameter (default
+ * controllers_config/command_timeout in the arm namespace), clipped to [0, 1] s; 0 disables the
+ * watchdog. Clients can change it at runtime on
+ * franka_ros_interface/motion_controller/arm/joint_command_timeout in the arm namespace.
+ */
+class CommandWatchdog {
+ public:
+  /**
+   * Reads the timeout and subscribes to timeout changes. Call from init().
+   *
+   * @param[in] node_handle node handle in the controller namespace.
+   * @param[in] controller_name prefix for log messages.
+   */
+  void init(ros::NodeHandle& node_handle, const std::string& controller_name) {
+    ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+    double default_timeout(0.2);
+    arm_node_handle.param<double>("controllers_config/command_timeout", default_timeout, default_timeout);
+    double timeout(default_timeout);
+    node_handle.param<double>("command_timeout", timeout, default_timeout);
+    controller_name_ = controller_name;
+    setTimeout(timeout);
+    timeout_subscriber_ = arm_node_handle.subscribe(
+        "franka_ros_interface/motion_controller/arm/joint_command_timeout", 1,
+        &CommandWatchdog::timeoutCallback, this);
+  }
+
+  /**
+   * Stamps a new command taken by update() in the cycle at time. Realtime safe.
+   */
+  void commandReceived(const ros::Time& time) { last_command_ns_ = time.toNSec(); }
+
+  /**
+   * Restarts the timeout from the given time. Call from starting().
+   */
+  void starting(const ros::Time& time) {
+    commandReceived(time);
+    expired_ = false;
+  }
+
+  /**
+   * Realtime safe; call once per update().
+   *
+   * @return true while no command arrived within the timeout.
+   */
+  bool expired(const ros::Time& time) {
+    int64_t timeout_ns = timeout_ns_.load(std::memory_order_relaxed);
+    bool expired =
+        timeout_ns > 0 && static_cast<int64_t>(time.toNSec()) - last_command_ns_ > timeout_ns;
+    if (expired && !expired_) {
+      timeouts_++;
+    }
+    expired_ = expired;
+    return expired;
+  }
+
+  /**
+   * @return how often the timeout was exceeded.
+   */
+  uint64_t timeouts() const { return timeouts_; }
+
+ private:
+  void setTimeout(double timeout) {
+    timeout = std::min(1.0, std::max(0.0, timeout));
+    ROS_INFO_STREAM(controller_name_ << ": Command timeout " << timeout << " s"
+                    << (timeout > 0.0 ? "" : " (disabled)"));
+    timeout_ns_.store(static_cast<int64_t>(timeout * 1e9), std::memory_order_relaxed);
+  }
+
+  void timeoutCallback(const std_msgs::Float64& msg) { setTimeout(msg.data); }
+
+  std::string controller_name_;
+  std::atomic<int64_t> timeout_ns_{0};
+  ros::Subscriber timeout_subscriber_;
+
+  // control loop only
+  int64_t last_command_ns_{0};
+  bool expired_{false};
+  uint64_t timeouts_{0};
+};
+
+}  // namespace franka_ros_controllers
@@ -0,0 +1,287 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <franka/robot_state.h>
+#include <franka_core_msgs/ContactEvent.h>
+#include <franka_core_msgs/ContactGuard.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_ros_controllers/command_mailbox.h>
+#include <realtime_tools/realtime_publisher.h>
+#include <ros/console.h>
+#include <ros/node_handle.h>
+#include <ros/time.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * Thresholds of a ContactGuard; 0 disables a check.
+ */
+struct ContactGuardSettings {
+  bool enabled{false};
+  double force_threshold{0.0};   // [N] norm of the force of K_F_ext_hat_K
+  double torque_threshold{0.0};  // [Nm] norm of the torque of K_F_ext_hat_K
+  std::array<double, 7> joint_torque_thresholds{};  // [Nm] |tau_ext_hat_filtered|
+  uint8_t reaction{franka_core_msgs::ContactGuard::REPORT};
+};
+
+/**
+ * Detects contacts in the control loop, from the external wrench and joint torques estimated
+ * by the robot.
+ *
+ * update() calls check() every cycle, which compares the estimates with the thresholds and, in
+ * the cycle that first exceeds one, latches the contact. With the HOLD reaction check() keeps
+ * returning true from then on and the controller holds contactPositions() (or contactPose())
+ * instead of its commands, so a guarded move stops in the cycle of the contact rather than
+ * after a round trip through a ROS node. The event (trigger, wrench, joint state, stamp of the
+ * cycle) is published on franka_ros_interface/motion_controller/arm/contact_events.
+ *
+ * The defaults are read from controllers_config/contact_guard in the arm namespace. Clients
+ * change them and re-arm the guard on franka_ros_interface/motion_controller/arm/contact_guard
+ * (franka_core_msgs/ContactGuard); restarting the controller re-arms it as well.
+ */
+class ContactGuard {
+ public:
+  /**
+   * Reads the default thresholds, subscribes to threshold changes and advertises the events.
+   * Call from init().
+   *
+   * @param[in] node_handle node handle in the controller namespace.
+   * @param[in] controller_name prefix for log messages, reported in the events.
+   * @return false if the default thresholds are invalid.
+   */
+  bool init(ros::NodeHandle& node_handle, const std::string& controller_name) {
+    ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+    controller_name_ = controller_name;
+    franka_core_msgs::ContactGuard defaults;
+    arm_node_handle.param<bool>("controllers_config/contact_guard/enabled", defaults.enabled, false);
+    arm_node_handle.param<double>("controllers_config/contact_guard/force_threshold",
+                                  defaults.force_threshold, 0.0);
+    arm_node_handle.param<double>("controllers_config/contact_guard/torque_threshold",
+                                  defaults.torque_threshold, 0.0);
+    arm_node_handle.getParam("controllers_config/contact_guard/joint_torque_thresholds",
+                             defaults.joint_torque_thresholds);
+    bool hold(false);
+    arm_node_handle.param<bool>("controllers_config/contact_guard/hold", hold, false);
+    defaults.reaction = hold ? franka_core_msgs::ContactGuard::HOLD
+                             : franka_core_msgs::ContactGuard::REPORT;
+    std::string error;
+    if (!toSettings(defaults, settings_, error)) {
+      ROS_ERROR_STREAM(controller_name_ << ": Invalid controllers_config/contact_guard: " << error);
+      return false;
+    }
+
+    event_publisher_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/contact_events", 10);
+    event_publisher_.msg_.controller_name = controller_name_;
+    settings_subscriber_ = arm_node_handle.subscribe(
+        "franka_ros_interface/motion_controller/arm/contact_guard", 1,
+        &ContactGuard::settingsCallback, this);
+    return true;
+  }
+
+  /**
+   * Re-arms the guard with the latest thresholds. Call from starting().
+   */
+  void starting() {
+    ContactGuardSettings settings;
+    if (settings_mailbox_.readFromRT(settings)) {
+      settings_ = settings;
+    }
+    triggered_ = false;
+  }
+
+  /**
+   * Realtime safe; call once per update(), after the commands were applied, so that a held
+   * contact overrides them.
+   *
+   * @return true while the controller has to hold the position of a detected contact.
+   */
+  bool check(const franka::RobotState& state, const ros::Time& time) {
+    ContactGuardSettings settings;
+    if (settings_mailbox_.readFromRT(settings)) {
+      settings_ = settings;
+      triggered_ = false;
+    }
+    if (event_pending_) {
+      publishEvent();
+    }
+    if (triggered_) {
+      return settings_.reaction == franka_core_msgs::ContactGuard::HOLD;
+    }
+    if (!settings_.enabled) {
+      return false;
+    }
+
+    int joint(-1);
+    uint8_t trigger;
+    const auto& wrench = state.K_F_ext_hat_K;
+    if (settings_.force_threshold > 0.0 &&
+        std::sqrt(wrench[0] * wrench[0] + wrench[1] * wrench[1] + wrench[2] * wrench[2]) >
+            settings_.force_threshold) {
+      trigger = franka_core_msgs::ContactEvent::FORCE;
+    } else if (settings_.torque_threshold > 0.0 &&
+               std::sqrt(wrench[3] * wrench[3] + wrench[4] * wrench[4] + wrench[5] * wrench[5]) >
+                   settings_.torque_threshold) {
+      trigger = franka_core_msgs::ContactEvent::TORQUE;
+    } else {
+      for (size_t i = 0; i < 7; ++i) {
+        if (settings_.joint_torque_thresholds[i] > 0.0 &&
+            std::abs(state.tau_ext_hat_filtered[i]) > settings_.joint_torque_thresholds[i]) {
+          joint = static_cast<int>(i);
+          break;
+        }
+      }
+      if (joint < 0) {
+        return false;
+      }
+      trigger = franka_core_msgs::ContactEvent::JOINT_TORQUE;
+    }
+
+    triggered_ = true;
+    contacts_++;
+    contact_q_ = state.q;
+    contact_pose_ = state.O_T_EE;
+    event_.time = time;
+    event_.trigger = trigger;
+    event_.joint = joint;
+    event_.wrench = wrench;
+    event_.tau_ext = state.tau_ext_hat_filtered;
+    event_pending_ = true;
+    publishEvent();
+    return settings_.reaction == franka_core_msgs::ContactGuard::HOLD;
+  }
+
+  /**
+   * @return joint positions of the cycle that detected the last contact.
+   */
+  const std::array<double, 7>& contactPositions() const { return contact_q_; }
+
+  /**
+   * @return end effector pose (O_T_EE, column major) of the cycle that detected the last contact.
+   */
+  const std::array<double, 16>& contactPose() const { return contact_pose_; }
+
+  /**
+   * @return how many contacts were detected.
+   */
+  uint64_t contacts() const { return contacts_; }
+
+ private:
+  struct Event {
+    ros::Time time;
+    uint8_t trigger{0};
+    int joint{-1};
+    std::array<double, 6> wrench{};
+    std::array<double, 7> tau_ext{};
+  };
+
+  static bool toSettings(const franka_core_msgs::ContactGuard& msg, ContactGuardSettings& settings,
+                         std::string& error) {
+    if (!(msg.force_threshold >= 0.0) || !(msg.torque_threshold >= 0.0)) {
+      error = "thresholds must not be negative";
+      return false;
+    }
+    if (!msg.joint_torque_thresholds.empty() && msg.joint_torque_thresholds.size() != 7) {
+      error = "joint_torque_thresholds must be empty or have 7 entries";
+      return false;
+    }
+    if (msg.reaction != franka_core_msgs::ContactGuard::REPORT &&
+        msg.reaction != franka_core_msgs::ContactGuard::HOLD) {
+      error = "unknown reaction " + std::to_string(msg.reaction);
+      return false;
+    }
+    settings.enabled = msg.enabled;
+    settings.force_threshold = msg.force_threshold;
+    settings.torque_threshold = msg.torque_threshold;
+    settings.joint_torque_thresholds.fill(0.0);
+    for (size_t i = 0; i < msg.joint_torque_thresholds.size(); ++i) {
+      if (!(msg.joint_torque_thresholds[i] >= 0.0)) {
+        error = "thresholds must not be negative";
+        return false;
+      }
+      settings.joint_torque_thresholds[i] = msg.joint_torque_thresholds[i];
+    }
+    settings.reaction = msg.reaction;
+    return true;
+  }
+
+  void settingsCallback(const franka_core_msgs::ContactGuard& msg) {
+    ContactGuardSettings settings;
+    std::string error;
+    if (!toSettings(msg, settings, error)) {
+      ROS_ERROR_STREAM(controller_name_ << ": Rejected contact guard: " << error);
+      return;
+    }
+    // picked up by update(), which re-arms the guard
+    settings_mailbox_.writeFromNonRT(settings);
+  }
+
+  // retried in the next cycles while the publisher is busy, so no event is lost
+  void publishEvent() {
+    if (!event_publisher_.trylock()) {
+      return;
+    }
+    auto& msg = event_publisher_.msg_;
+    msg.header.stamp = event_.time;
+    msg.trigger = event_.trigger;
+    msg.joint = event_.joint;
+    msg.reaction = settings_.reaction;
+    msg.K_F_ext_hat_K.force.x = event_.wrench[0];
+    msg.K_F_ext_hat_K.force.y = event_.wrench[1];
+    msg.K_F_ext_hat_K.force.z = event_.wrench[2];
+    msg.K_F_ext_hat_K.torque.x = event_.wrench[3];
+    msg.K_F_ext_hat_K.torque.y = event_.wrench[4];
+    msg.K_F_ext_hat_K.torque.z = event_.wrench[5];
+    std::copy(event_.tau_ext.begin(), event_.tau_ext.end(), msg.tau_ext_hat_filtered.begin());
+    std::copy(contact_q_.begin(), contact_q_.end(), msg.q.begin());
+    event_publisher_.unlockAndPublish();
+    event_pending_ = false;
+  }
+
+  std::string controller_name_;
+  CommandMailbox<ContactGuardSettings> settings_mailbox_;
+  ros::Subscriber settings_subscriber_;
+  realtime_tools::RealtimePublisher<franka_core_msgs::ContactEvent> event_publisher_;
+
+  // control loop only
+  ContactGuardSettings settings_;
+  bool triggered_{false};
+  bool event_pending_{false};
+  Event event_;
+  std::array<double, 7> contact_q_{};
+  std::array<double, 16> contact_pose_{};
+  uint64_t contacts_{0};
+};
+
+}  // namespace franka_ros_controllers
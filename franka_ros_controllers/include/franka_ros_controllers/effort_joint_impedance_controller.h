@@ -33,8 +33,18 @@
 #include <dynamic_reconfigure/server.h>
 #include <franka_ros_controllers/joint_controller_paramsConfig.h>
 #include <franka_core_msgs/JointCommand.h>
+#include <franka_core_msgs/JointCommandChunk.h>
 #include <franka_core_msgs/JointControllerStates.h>
 #include <franka_core_msgs/JointLimits.h>
+#include <franka_ros_controllers/command_latency_tracer.h>
+#include <franka_ros_controllers/command_mailbox.h>
+#include <franka_ros_controllers/command_watchdog.h>
+#include <franka_ros_controllers/contact_guard.h>
+#include <franka_ros_controllers/joint_control_kernel.h>
+#include <franka_ros_controllers/joint_limit_checker.h>
+#include <franka_ros_controllers/sample_batch_publisher.h>
+#include <franka_ros_controllers/shared_command_reader.h>
+#include <franka_ros_controllers/joint_trajectory_interpolator.h>
 
 #include <franka_hw/trigger_rate.h>
 #include <realtime_tools/realtime_publisher.h>
@@ -47,6 +57,7 @@
 #include <ros/time.h>
 
 #include <franka_hw/franka_model_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
 
 
 namespace franka_ros_controllers {
@@ -54,35 +65,30 @@ namespace franka_ros_controllers {
 class EffortJointImpedanceController : public controller_interface::MultiInterfaceController<
                                             franka_hw::FrankaModelInterface,
                                             franka_hw::FrankaStateInterface,
-                                            hardware_interface::EffortJointInterface> {
+                                            hardware_interface::EffortJointInterface,
+                                            franka_interface::FrankaModelCacheInterface> {
  public:
+  // FrankaModelCacheInterface is optional, so all interfaces are checked in init()
+  EffortJointImpedanceController() : MultiInterfaceController(true) {}
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& node_handle) override;
   void starting(const ros::Time&) override;
   void update(const ros::Time&, const ros::Duration& period) override;
+  void stopping(const ros::Time&) override;
 
  private:
-  // Saturation
-  std::array<double, 7> saturateTorqueRate(
-      const std::array<double, 7>& tau_d_calculated,
-      const std::array<double, 7>& tau_J_d);  // NOLINT (readability-identifier-naming)
-
-  std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
+  std::unique_ptr<franka_interface::FrankaModelCacheHandle> model_handle_;
   std::vector<hardware_interface::JointHandle> joint_handles_;
 
   static constexpr double kDeltaTauMax{1.0};
 
   double filter_params_{0.005};
-  std::vector<double> k_gains_;
-  std::vector<double> k_gains_target_;
-  std::vector<double> d_gains_;
-  std::vector<double> d_gains_target_;
   double coriolis_factor_{1.0};
+  JointControlKernel<7, ImpedanceLaw> kernel_;
   std::array<double, 7> pos_d_;
   std::array<double, 7> initial_pos_;
   std::array<double, 7> prev_pos_;
   std::array<double, 7> pos_d_target_;
   std::array<double, 7> dq_d_;
-  std::array<double, 7> dq_filtered_;
 
 
   franka_hw::FrankaStateInterface* franka_state_interface_{};
@@ -92,6 +98,14 @@ class EffortJointImpedanceController : public controller_interface::MultiInterfa
   std::array<double, 7> last_tau_d_{};
 
   ros::Subscriber desired_joints_subscriber_;
+  CommandMailbox<JointTargetCommand> joint_command_mailbox_;
+  SharedJointCommandReader shared_command_reader_;
+  CommandLatencyTracer latency_tracer_;
+  CommandWatchdog command_watchdog_;
+  ContactGuard contact_guard_;
+  JointLimitChecker limit_checker_;
+  ros::Subscriber command_chunk_subscriber_;
+  JointTrajectoryInterpolator trajectory_interpolator_;
   std::unique_ptr< dynamic_reconfigure::Server<franka_ros_controllers::joint_controller_paramsConfig> > dynamic_server_controller_config_;
   ros::NodeHandle dynamic_reconfigure_controller_gains_node_;
 
@@ -99,13 +113,12 @@ class EffortJointImpedanceController : public controller_interface::MultiInterfa
 
   franka_hw::TriggerRate trigger_publish_;
   realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> publisher_controller_states_;
-
-  bool checkPositionLimits(std::vector<double> positions);
-  bool checkVelocityLimits(std::vector<double> positions);
+  SampleBatchPublisher<JointControllerSample> sample_publisher_;
 
   void controllerConfigCallback(franka_ros_controllers::joint_controller_paramsConfig& config,
                                uint32_t level);
-  void jointCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg);
+  void jointCmdCallback(const ros::MessageEvent<franka_core_msgs::JointCommand const>& event);
+  void jointCommandChunkCallback(const franka_core_msgs::JointCommandChunkConstPtr& msg);
 };
 
 }  // namespace franka_ros_controllers
\ No newline at end of file
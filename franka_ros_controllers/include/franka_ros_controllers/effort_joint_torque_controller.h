@@ -33,6 +33,12 @@
 #include <franka_core_msgs/JointCommand.h>
 #include <franka_core_msgs/JointControllerStates.h>
 #include <franka_core_msgs/JointLimits.h>
+#include <franka_ros_controllers/command_latency_tracer.h>
+#include <franka_ros_controllers/command_mailbox.h>
+#include <franka_ros_controllers/command_watchdog.h>
+#include <franka_ros_controllers/joint_limit_checker.h>
+#include <franka_ros_controllers/sample_batch_publisher.h>
+#include <franka_ros_controllers/shared_command_reader.h>
 
 #include <franka_hw/trigger_rate.h>
 #include <realtime_tools/realtime_publisher.h>
@@ -45,16 +51,21 @@
 #include <mutex>
 
 #include <franka_hw/franka_model_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
 
 namespace franka_ros_controllers {
 
 class EffortJointTorqueController : public controller_interface::MultiInterfaceController<
                                             franka_hw::FrankaModelInterface,
-                                            hardware_interface::EffortJointInterface> {
+                                            hardware_interface::EffortJointInterface,
+                                            franka_interface::FrankaModelCacheInterface> {
  public:
+  // FrankaModelCacheInterface is optional, so all interfaces are checked in init()
+  EffortJointTorqueController() : MultiInterfaceController(true) {}
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& node_handle) override;
   void starting(const ros::Time&) override;
   void update(const ros::Time&, const ros::Duration& period) override;
+  void stopping(const ros::Time&) override;
 
  private:
   // Saturation
@@ -62,7 +73,7 @@ class EffortJointTorqueController : public controller_interface::MultiInterfaceC
       const std::array<double, 7>& tau_d_calculated,
       const std::array<double, 7>& prev_tau);  // NOLINT (readability-identifier-naming)
 
-  std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
+  std::unique_ptr<franka_interface::FrankaModelCacheHandle> model_handle_;
   std::vector<hardware_interface::JointHandle> joint_handles_;
 
   static constexpr double kDeltaTauMax{1.0};
@@ -76,15 +87,19 @@ class EffortJointTorqueController : public controller_interface::MultiInterfaceC
   std::array<double, 7> last_tau_d_{};
 
   ros::Subscriber desired_joints_subscriber_;
+  CommandMailbox<JointTargetCommand> joint_command_mailbox_;
+  SharedJointCommandReader shared_command_reader_;
+  CommandLatencyTracer latency_tracer_;
+  CommandWatchdog command_watchdog_;
+  JointLimitChecker limit_checker_;
 
   franka_core_msgs::JointLimits joint_limits_;
 
   franka_hw::TriggerRate trigger_publish_;
   realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> publisher_controller_states_;
+  SampleBatchPublisher<JointControllerSample> sample_publisher_;
 
-  bool checkTorqueLimits(std::vector<double> torques);
-
-  void jointCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg);
+  void jointCmdCallback(const ros::MessageEvent<franka_core_msgs::JointCommand const>& event);
 };
 
 }  // namespace franka_ros_controllers
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <controller_interface/multi_interface_controller.h>
 #include <dynamic_reconfigure/server.h>
 #include <franka_hw/franka_model_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
 #include <franka_hw/franka_state_interface.h>
 #include <hardware_interface/joint_command_interface.h>
 #include <hardware_interface/robot_hw.h>
@@ -17,6 +18,7 @@
 #include <ros/time.h>
 #include <Eigen/Core>
 
+#include <franka_ros_controllers/command_mailbox.h>
 #include <franka_ros_controllers/desired_mass_paramConfig.h>
 
 namespace franka_ros_controllers {
@@ -24,11 +26,15 @@ namespace franka_ros_controllers {
 class ForceController : public controller_interface::MultiInterfaceController<
                                    franka_hw::FrankaModelInterface,
                                    hardware_interface::EffortJointInterface,
-                                   franka_hw::FrankaStateInterface> {
+                                   franka_hw::FrankaStateInterface,
+                                   franka_interface::FrankaModelCacheInterface> {
  public:
+  // FrankaModelCacheInterface is optional, so all interfaces are checked in init()
+  ForceController() : MultiInterfaceController(true) {}
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& node_handle) override;
   void starting(const ros::Time&) override;
   void update(const ros::Time&, const ros::Duration& period) override;
+  void stopping(const ros::Time&) override;
 
  private:
   // Saturation
@@ -36,7 +42,7 @@ class ForceController : public controller_interface::MultiInterfaceController<
       const Eigen::Matrix<double, 7, 1>& tau_d_calculated,
       const Eigen::Matrix<double, 7, 1>& tau_J_d);  // NOLINT (readability-identifier-naming)
 
-  std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
+  std::unique_ptr<franka_interface::FrankaModelCacheHandle> model_handle_;
   std::unique_ptr<franka_hw::FrankaStateHandle> state_handle_;
   std::vector<hardware_interface::JointHandle> joint_handles_;
 
@@ -55,6 +61,7 @@ class ForceController : public controller_interface::MultiInterfaceController<
 
   // Stiffness subscriber 
   ros::Subscriber force_params_;
+  CommandMailbox<std::array<double, 6>> wrench_mailbox_;
   void forceParamCallback(const geometry_msgs::Wrench& msg);
 
 };
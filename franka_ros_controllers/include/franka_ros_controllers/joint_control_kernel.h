@@ -0,0 +1,203 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace franka_ros_controllers {
+
+/**
+ * PD law on the position error; the error derivative is a finite difference over one cycle:
+ * tau = K (q_d - q) + D d/dt (q_d - q).
+ */
+template <int Dof>
+struct PdLaw {
+  using Vector = Eigen::Matrix<double, Dof, 1>;
+
+  Vector error{Vector::Zero()};
+  Vector error_dot{Vector::Zero()};
+  Vector error_last{Vector::Zero()};
+
+  void reset() {
+    error.setZero();
+    error_dot.setZero();
+    error_last.setZero();
+  }
+
+  void compute(const Eigen::Map<const Vector>& q, const Eigen::Map<const Vector>& /*dq*/,
+               const Eigen::Map<const Vector>& q_d, const Eigen::Map<const Vector>& /*dq_d*/,
+               double period, const Vector& stiffness, const Vector& damping, Vector& tau) {
+    error = q_d - q;
+    if (period > 0.0) {
+      error_dot = (error - error_last) / period;
+    }
+    tau = stiffness.cwiseProduct(error) + damping.cwiseProduct(error_dot);
+    error_last = error;
+  }
+};
+
+/**
+ * Joint impedance law with coriolis compensation on low-pass filtered joint velocities:
+ * tau = coriolis_factor * c + K (q_d - q) + D (dq_d - dq_filtered).
+ */
+template <int Dof>
+struct ImpedanceLaw {
+  using Vector = Eigen::Matrix<double, Dof, 1>;
+
+  double coriolis_factor{1.0};
+  double velocity_filter{0.99};  // weight of the latest velocity sample
+  Vector dq_filtered{Vector::Zero()};
+
+  void reset() { dq_filtered.setZero(); }
+
+  void compute(const Eigen::Map<const Vector>& q, const Eigen::Map<const Vector>& dq,
+               const Eigen::Map<const Vector>& q_d, const Eigen::Map<const Vector>& dq_d,
+               double /*period*/, const Vector& stiffness, const Vector& damping, Vector& tau,
+               const std::array<double, Dof>& coriolis) {
+    dq_filtered = (1.0 - velocity_filter) * dq_filtered + velocity_filter * dq;
+    tau = coriolis_factor * Eigen::Map<const Vector>(coriolis.data()) +
+          stiffness.cwiseProduct(q_d - q) + damping.cwiseProduct(dq_d - dq_filtered);
+  }
+};
+
+/**
+ * Joint space control loop shared by the effort joint controllers: evaluates the control law,
+ * limits the torque rate and moves the gains towards their targets, all on fixed-size Eigen
+ * vectors so that the whole cycle is unrolled (and vectorised where Eigen can) for the given
+ * number of joints, without allocating.
+ *
+ * The controllers only pick the law and supply targets and robot state, e.g.
+ * JointControlKernel<7, ImpedanceLaw> for joint impedance control of the Panda. Extra arguments
+ * of update() are passed on to the law (the coriolis vector for ImpedanceLaw).
+ *
+ * update() and the accessors belong to the control loop; the gain targets may also be written
+ * by a dynamic reconfigure callback, as the controllers did before.
+ */
+template <int Dof, template <int> class Law>
+class JointControlKernel {
+ public:
+  using Vector = Eigen::Matrix<double, Dof, 1>;
+  using Array = std::array<double, Dof>;
+
+  /**
+   * Sets both the gains and their targets, i.e. without filtering.
+   *
+   * @param[in] stiffness Dof stiffness (P) gains.
+   * @param[in] damping Dof damping (D) gains.
+   */
+  void setGains(const std::vector<double>& stiffness, const std::vector<double>& damping) {
+    for (int i = 0; i < Dof; ++i) {
+      stiffness_[i] = stiffness[i];
+      damping_[i] = damping[i];
+    }
+    stiffness_target_ = stiffness_;
+    damping_target_ = damping_;
+  }
+
+  void setGains(const Array& stiffness, const Array& damping) {
+    stiffness_ = Eigen::Map<const Vector>(stiffness.data());
+    damping_ = Eigen::Map<const Vector>(damping.data());
+    stiffness_target_ = stiffness_;
+    damping_target_ = damping_;
+  }
+
+  /**
+   * Targets that the gains approach every cycle, see setGainFilter().
+   */
+  Vector& stiffnessTarget() { return stiffness_target_; }
+  Vector& dampingTarget() { return damping_target_; }
+
+  const Vector& stiffness() const { return stiffness_; }
+  const Vector& damping() const { return damping_; }
+
+  /**
+   * @param[in] filter weight of the target in the gain update of every cycle; 1 applies
+   * targets immediately.
+   */
+  void setGainFilter(double filter) { gain_filter_ = filter; }
+
+  /**
+   * @param[in] max_torque_rate maximum change of the commanded torque per cycle [Nm].
+   */
+  void setMaxTorqueRate(double max_torque_rate) { max_torque_rate_ = max_torque_rate; }
+
+  Law<Dof>& law() { return law_; }
+  const Law<Dof>& law() const { return law_; }
+
+  /**
+   * Clears the state of the law (filters, previous errors). Call from starting().
+   */
+  void reset() { law_.reset(); }
+
+  /**
+   * Computes the torque command of this cycle. Realtime safe.
+   *
+   * @param[in] q measured joint positions.
+   * @param[in] dq measured joint velocities.
+   * @param[in] q_d desired joint positions.
+   * @param[in] dq_d desired joint velocities.
+   * @param[in] tau_J_d torque commanded in the previous cycle, for the rate limit.
+   * @param[in] period control period [s].
+   * @return the rate limited torque command, valid until the next call.
+   */
+  template <typename... LawArgs>
+  const Array& update(const Array& q, const Array& dq, const Array& q_d, const Array& dq_d,
+                      const Array& tau_J_d, double period, const LawArgs&... law_args) {
+    law_.compute(Eigen::Map<const Vector>(q.data()), Eigen::Map<const Vector>(dq.data()),
+                 Eigen::Map<const Vector>(q_d.data()), Eigen::Map<const Vector>(dq_d.data()),
+                 period, stiffness_, damping_, tau_, law_args...);
+
+    Eigen::Map<const Vector> previous(tau_J_d.data());
+    Eigen::Map<Vector>(tau_saturated_.data()) =
+        previous + (tau_ - previous).cwiseMax(-max_torque_rate_).cwiseMin(max_torque_rate_);
+
+    stiffness_ = gain_filter_ * stiffness_target_ + (1.0 - gain_filter_) * stiffness_;
+    damping_ = gain_filter_ * damping_target_ + (1.0 - gain_filter_) * damping_;
+    return tau_saturated_;
+  }
+
+  /**
+   * @return the torque computed by the law in the last update(), before the rate limit.
+   */
+  const Vector& command() const { return tau_; }
+
+ private:
+  Law<Dof> law_;
+  Vector stiffness_{Vector::Zero()};
+  Vector damping_{Vector::Zero()};
+  Vector stiffness_target_{Vector::Zero()};
+  Vector damping_target_{Vector::Zero()};
+  double gain_filter_{1.0};
+  double max_torque_rate_{1.0};
+  Vector tau_{Vector::Zero()};
+  Array tau_saturated_{};
+};
+
+}  // namespace franka_ros_controllers
@@ -2,12 +2,12 @@
 // Use of this source code is governed by the Apache-2.0 license, see LICENSE
 #pragma once
 
+#include <cmath>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include <franka_ros_controllers/joint_controller_paramsConfig.h>
-#include <franka_core_msgs/JointLimits.h>
 #include <controller_interface/multi_interface_controller.h>
 #include <hardware_interface/joint_command_interface.h>
 #include <hardware_interface/robot_hw.h>
@@ -16,8 +16,14 @@
 #include <ros/time.h>
 
 #include <franka_ros_controllers/JointTorqueComparison.h>
+#include <franka_ros_controllers/JointTorqueComparisonSamples.h>
+#include <franka_ros_controllers/command_mailbox.h>
+#include <franka_ros_controllers/joint_control_kernel.h>
+#include <franka_ros_controllers/joint_limit_checker.h>
+#include <franka_ros_controllers/sample_batch_publisher.h>
 #include <franka_hw/franka_cartesian_command_interface.h>
 #include <franka_hw/franka_model_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
 #include <franka_hw/trigger_rate.h>
 
 #include <franka_core_msgs/JICmd.h>
@@ -25,25 +31,56 @@
 
 namespace franka_ros_controllers {
 
+/**
+ * One control cycle of JointTorqueComparison, for SampleBatchPublisher.
+ */
+struct JointTorqueComparisonSample {
+  using Batch = JointTorqueComparisonSamples;
+
+  double time{0.0};  // [s], ROS time of the cycle
+  std::array<double, 7> tau_commanded{};
+  std::array<double, 7> tau_measured{};
+
+  void appendTo(Batch& batch) const {
+    batch.stamps.push_back(ros::Time(time));
+    double error_rms(0.0);
+    for (size_t i = 0; i < 7; ++i) {
+      double tau_error = tau_commanded[i] - tau_measured[i];
+      error_rms += std::sqrt(std::pow(tau_error, 2.0)) / 7.0;
+      batch.tau_error.push_back(tau_error);
+    }
+    batch.tau_commanded.insert(batch.tau_commanded.end(), tau_commanded.begin(), tau_commanded.end());
+    batch.tau_measured.insert(batch.tau_measured.end(), tau_measured.begin(), tau_measured.end());
+    batch.root_mean_square_error.push_back(error_rms);
+  }
+
+  static void clearBatch(Batch& batch) {
+    batch.stamps.clear();
+    batch.tau_error.clear();
+    batch.tau_commanded.clear();
+    batch.tau_measured.clear();
+    batch.root_mean_square_error.clear();
+  }
+};
+
 class JointImpedanceController : public controller_interface::MultiInterfaceController<
                                             franka_hw::FrankaModelInterface,
                                             hardware_interface::EffortJointInterface,
-                                            franka_hw::FrankaPoseCartesianInterface> {
+                                            franka_hw::FrankaPoseCartesianInterface,
+                                            franka_interface::FrankaModelCacheInterface> {
  public:
+  // FrankaModelCacheInterface is optional, so all interfaces are checked in init()
+  JointImpedanceController() : MultiInterfaceController(true) {}
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& node_handle) override;
   void starting(const ros::Time&) override;
   void update(const ros::Time&, const ros::Duration& period) override;
+  void stopping(const ros::Time&) override;
 
  private:
-  // Saturation
-  std::array<double, 7> saturateTorqueRate(
-      const std::array<double, 7>& tau_d_calculated,
-      const std::array<double, 7>& tau_J_d);  // NOLINT (readability-identifier-naming)
-
   std::unique_ptr<franka_hw::FrankaCartesianPoseHandle> cartesian_pose_handle_;
-  std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
+  std::unique_ptr<franka_interface::FrankaModelCacheHandle> model_handle_;
   std::vector<hardware_interface::JointHandle> joint_handles_;
-  franka_core_msgs::JointLimits joint_limits_;
+  JointLimitChecker limit_checker_;
 
   static constexpr double kDeltaTauMax{1.0};
   double radius_{0.1};
@@ -52,10 +89,8 @@ class JointImpedanceController : public controller_interface::MultiInterfaceCont
   double angle_{0.0};
   double vel_current_{0.0};
 
-  std::vector<double> k_gains_;
-  std::vector<double> d_gains_;
   double coriolis_factor_{1.0};
-  std::array<double, 7> dq_filtered_;
+  JointControlKernel<7, ImpedanceLaw> kernel_;
   std::array<double, 16> initial_pose_;
 
   std::array<double, 7> pos_d_;
@@ -63,16 +98,16 @@ class JointImpedanceController : public controller_interface::MultiInterfaceCont
   std::array<double, 7> prev_pos_;
   std::array<double, 7> pos_d_target_;
   std::array<double, 7> dq_d_;
-  //std::array<double, 7> dq_filtered_;
 
   franka_hw::TriggerRate rate_trigger_{1.0};
   std::array<double, 7> last_tau_d_{};
   realtime_tools::RealtimePublisher<JointTorqueComparison> torques_publisher_;
+  SampleBatchPublisher<JointTorqueComparisonSample> torque_sample_publisher_;
 
   ros::Subscriber desired_joints_subscriber_;
   ros::Subscriber stiffness_params_;
-  bool checkPositionLimits(std::vector<double> positions);
-  bool checkVelocityLimits(std::vector<double> positions);
+  CommandMailbox<JointTargetCommand> joint_command_mailbox_;
+  CommandMailbox<std::array<double, 7>> stiffness_mailbox_;
   void jointCmdCallback(const franka_core_msgs::JICmd& msg);
   void stiffnessParamCallback(const franka_core_msgs::JointImpedanceStiffness& msg);
 
@@ -0,0 +1,317 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <franka_interface/arm_namespace.h>
+#include <ros/console.h>
+#include <ros/node_handle.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * Joint limits of /robot_config/joint_config in fixed-size arrays, and the checks of the
+ * commands of the joint controllers against them.
+ *
+ * Commands (positions, velocities, efforts) are checked where they arrive, by checkPositions(),
+ * checkVelocities() and checkEfforts(). A command beyond the limits is clamped into them if
+ * command_limits/clamp is set (controller namespace, default controllers_config/command_limits/
+ * clamp in the arm namespace), and rejected otherwise; the controllers hold their position for
+ * a rejected command. Commands containing NaN are always rejected.
+ *
+ * The setpoints that the joint position and velocity controllers send to the robot in every
+ * cycle are additionally limited by limitPositionSetpoint() and limitVelocitySetpoint() to the
+ * velocity, acceleration and jerk limits, so that neither a clamped or rejected command nor a
+ * jump of the target makes the setpoint jump (controllers_config/command_limits/
+ * limit_setpoints). A missing acceleration or jerk limit disables that part of the limiting.
+ *
+ * All checks are realtime safe; the command checks may run concurrently in callback threads and
+ * in the control loop, the setpoint limits only in the control loop.
+ */
+class JointLimitChecker {
+ public:
+  using Values = std::array<double, 7>;
+
+  // limits that init() requires; the others are unlimited if they are not configured
+  enum Limit : uint32_t {
+    kPosition = 1 << 0,
+    kVelocity = 1 << 1,
+    kAcceleration = 1 << 2,
+    kJerk = 1 << 3,
+    kEffort = 1 << 4,
+  };
+
+  /**
+   * Reads the limits of the joints of /robot_config/joint_names and the clamping settings.
+   * Call from init().
+   *
+   * @param[in] node_handle node handle in the controller namespace.
+   * @param[in] controller_name prefix for log messages.
+   * @param[in] required Limit bits of the limits the controller needs.
+   * @return false if a required limit is missing for a joint.
+   */
+  bool init(ros::NodeHandle& node_handle, const std::string& controller_name,
+            uint32_t required) {
+    ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+    std::vector<std::string> joint_names;
+    if (!arm_node_handle.getParam("robot_config/joint_names", joint_names) ||
+        joint_names.size() != 7) {
+      ROS_ERROR_STREAM(controller_name << ": Invalid or no joint_names parameters provided");
+      return false;
+    }
+    if (!readLimits(arm_node_handle, "joint_position_limit/lower", joint_names,
+                    required & kPosition, controller_name, position_lower_, -1.0) ||
+        !readLimits(arm_node_handle, "joint_position_limit/upper", joint_names,
+                    required & kPosition, controller_name, position_upper_) ||
+        !readLimits(arm_node_handle, "joint_velocity_limit", joint_names, required & kVelocity,
+                    controller_name, velocity_) ||
+        !readLimits(arm_node_handle, "joint_acceleration_limit", joint_names,
+                    required & kAcceleration, controller_name, acceleration_) ||
+        !readLimits(arm_node_handle, "joint_jerk_limit", joint_names, required & kJerk,
+                    controller_name, jerk_) ||
+        !readLimits(arm_node_handle, "joint_effort_limit", joint_names, required & kEffort,
+                    controller_name, effort_)) {
+      return false;
+    }
+    for (size_t i = 0; i < 7; ++i) {
+      velocity_lower_[i] = -velocity_[i];
+      effort_lower_[i] = -effort_[i];
+      // without an acceleration or jerk limit the velocity limit can be approached directly
+      braking_gain_[i] = std::isfinite(acceleration_[i]) && std::isfinite(jerk_[i])
+                             ? jerk_[i] / acceleration_[i]
+                             : kUnlimitedBrakingGain;
+    }
+
+    bool clamp(false);
+    arm_node_handle.param<bool>("controllers_config/command_limits/clamp", clamp, clamp);
+    node_handle.param<bool>("command_limits/clamp", clamp_, clamp);
+    bool limit_setpoints(true);
+    arm_node_handle.param<bool>("controllers_config/command_limits/limit_setpoints",
+                                limit_setpoints, limit_setpoints);
+    node_handle.param<bool>("command_limits/limit_setpoints", limit_setpoints_, limit_setpoints);
+    ROS_INFO_STREAM(controller_name << ": Commands beyond the joint limits are "
+                    << (clamp_ ? "clamped" : "rejected"));
+    return true;
+  }
+
+  /**
+   * Checks joint positions against the position limits. Thread safe, realtime safe.
+   *
+   * @param[in,out] positions commanded positions; clamped into the limits if clamping is set.
+   * @return false if the positions are beyond the limits and were not clamped.
+   */
+  bool checkPositions(Values& positions) {
+    return accept(positions, position_lower_, position_upper_);
+  }
+
+  /**
+   * Checks joint velocities against the velocity limits, like checkPositions().
+   */
+  bool checkVelocities(Values& velocities) {
+    return accept(velocities, velocity_lower_, velocity_);
+  }
+
+  /**
+   * Checks joint torques against the effort limits, like checkPositions().
+   */
+  bool checkEfforts(Values& efforts) { return accept(efforts, effort_lower_, effort_); }
+
+  /**
+   * Starts a new stream of setpoints from the given state. Call from starting().
+   */
+  void resetSetpoints(const Values& position, const Values& velocity) {
+    last_position_ = position;
+    last_velocity_ = velocity;
+    last_acceleration_.fill(0.0);
+  }
+
+  /**
+   * Limits the position setpoint of this cycle to the position limits and, through the
+   * difference to the setpoint of the previous cycle, to the velocity, acceleration and jerk
+   * limits. Realtime safe; call once per cycle from update().
+   *
+   * @param[in,out] position setpoint to send this cycle.
+   * @param[in] period [s] since the previous setpoint.
+   * @return true if the setpoint was changed.
+   */
+  bool limitPositionSetpoint(Values& position, double period) {
+    if (!limit_setpoints_) {
+      return false;
+    }
+    const double dt = period > 0.0 ? period : kNominalPeriod;
+    Values velocity;
+    for (size_t i = 0; i < 7; ++i) {
+      velocity[i] =
+          (std::min(std::max(position[i], position_lower_[i]), position_upper_[i]) -
+           last_position_[i]) / dt;
+    }
+    limitVelocityStep(velocity, dt);
+    bool changed = false;
+    for (size_t i = 0; i < 7; ++i) {
+      double limited = std::min(std::max(last_position_[i] + velocity[i] * dt, position_lower_[i]),
+                                position_upper_[i]);
+      changed |= limited != position[i];
+      position[i] = limited;
+    }
+    last_position_ = position;
+    if (changed) {
+      limited_setpoints_++;
+    }
+    return changed;
+  }
+
+  /**
+   * Limits the velocity setpoint of this cycle to the velocity limits and, through the
+   * difference to the setpoints of the previous cycles, to the acceleration and jerk limits.
+   * Realtime safe; call once per cycle from update().
+   *
+   * @param[in,out] velocity setpoint to send this cycle.
+   * @param[in] period [s] since the previous setpoint.
+   * @return true if the setpoint was changed.
+   */
+  bool limitVelocitySetpoint(Values& velocity, double period) {
+    if (!limit_setpoints_) {
+      return false;
+    }
+    const Values requested = velocity;
+    limitVelocityStep(velocity, period > 0.0 ? period : kNominalPeriod);
+    bool changed = requested != velocity;
+    if (changed) {
+      limited_setpoints_++;
+    }
+    return changed;
+  }
+
+  uint64_t clampedCommands() const { return clamped_.load(std::memory_order_relaxed); }
+  uint64_t rejectedCommands() const { return rejected_.load(std::memory_order_relaxed); }
+  uint64_t limitedSetpoints() const { return limited_setpoints_; }
+
+ private:
+  static constexpr double kNominalPeriod{0.001};  // [s], used for the zero period of a restart
+  static constexpr double kUnlimitedBrakingGain{1e9};  // [1/s]
+
+  static bool readLimits(ros::NodeHandle& arm_node_handle, const std::string& name,
+                         const std::vector<std::string>& joint_names, bool required,
+                         const std::string& controller_name, Values& limits,
+                         double sign = 1.0) {
+    std::map<std::string, double> limit_map;
+    arm_node_handle.getParam("robot_config/joint_config/" + name, limit_map);
+    size_t missing = 0;
+    for (size_t i = 0; i < 7; ++i) {
+      auto limit = limit_map.find(joint_names[i]);
+      if (limit != limit_map.end()) {
+        limits[i] = limit->second;
+      } else if (required) {
+        ROS_ERROR_STREAM(controller_name << ": Unable to find the " << name << " of joint "
+                         << joint_names[i] << " in robot_config/joint_config, aborting "
+                         "controller init!");
+        return false;
+      } else {
+        limits[i] = sign * std::numeric_limits<double>::infinity();
+        missing++;
+      }
+    }
+    if (missing > 0) {
+      ROS_INFO_STREAM(controller_name << ": No " << name << " for " << missing
+                      << " joints, they are not limited");
+    }
+    return true;
+  }
+
+  bool accept(Values& values, const Values& lower, const Values& upper) {
+    Values clamped;
+    bool beyond = false;
+    bool nan = false;
+    for (size_t i = 0; i < 7; ++i) {
+      clamped[i] = std::min(std::max(values[i], lower[i]), upper[i]);
+      beyond |= clamped[i] != values[i];
+      nan |= values[i] != values[i];
+    }
+    if (!beyond) {
+      return true;
+    }
+    if (clamp_ && !nan) {
+      values = clamped;
+      clamped_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // As franka::limitRate(): jerk bounds the change of the acceleration, and the acceleration is
+  // reduced towards the velocity limits so that they are approached without a jerk beyond the
+  // limit.
+  void limitVelocityStep(Values& velocity, double dt) {
+    for (size_t i = 0; i < 7; ++i) {
+      double a = (velocity[i] - last_velocity_[i]) / dt;
+      a = std::min(std::max(a, last_acceleration_[i] - jerk_[i] * dt),
+                   last_acceleration_[i] + jerk_[i] * dt);
+      double upper = std::min(braking_gain_[i] * (velocity_[i] - last_velocity_[i]),
+                              acceleration_[i]);
+      double lower = std::max(braking_gain_[i] * (velocity_lower_[i] - last_velocity_[i]),
+                              -acceleration_[i]);
+      a = std::min(std::max(a, lower), upper);
+      double v = std::min(std::max(last_velocity_[i] + a * dt, velocity_lower_[i]), velocity_[i]);
+      last_acceleration_[i] = (v - last_velocity_[i]) / dt;
+      last_velocity_[i] = v;
+      velocity[i] = v;
+    }
+  }
+
+  Values position_lower_{};
+  Values position_upper_{};
+  Values velocity_lower_{};
+  Values velocity_{};
+  Values acceleration_{};
+  Values jerk_{};
+  Values effort_lower_{};
+  Values effort_{};
+  Values braking_gain_{};  // [1/s] jerk / acceleration limit
+  bool clamp_{false};
+  bool limit_setpoints_{true};
+
+  std::atomic<uint64_t> clamped_{0};
+  std::atomic<uint64_t> rejected_{0};
+
+  // owned by the control loop
+  Values last_position_{};
+  Values last_velocity_{};
+  Values last_acceleration_{};
+  uint64_t limited_setpoints_{0};
+};
+
+}  // namespace franka_ros_controllers
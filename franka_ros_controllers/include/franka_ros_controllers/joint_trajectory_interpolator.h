@@ -0,0 +1,305 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <franka_core_msgs/JointCommandChunk.h>
+#include <ros/time.h>
+
+#include <franka_interface/spsc_ring_buffer.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * One queued joint setpoint; the segment ending at it is interpolated as given by quintic.
+ */
+struct JointSetpoint {
+  double time{0.0};  // [s], absolute ROS time
+  uint32_t generation{0};
+  bool quintic{false};
+  // velocity is estimated from the next point once that is known, see JointTrajectoryInterpolator
+  bool open_velocity{false};
+  std::array<double, 7> position{};
+  std::array<double, 7> velocity{};
+  std::array<double, 7> acceleration{};
+};
+
+/**
+ * Queues the setpoints of franka_core_msgs::JointCommandChunk messages and interpolates them at
+ * control rate.
+ *
+ * addChunk() is called from the (single) subscriber callback, sample() and the other methods
+ * from the control loop. The points are handed over through a preallocated SpscRingBuffer, so
+ * the control loop never locks or allocates. A chunk that starts a new trajectory bumps the
+ * generation counter; the control loop then skips the points of older generations still in the
+ * buffer and blends from its current target into the new trajectory.
+ *
+ * Points without velocities get them by finite differences over their neighbours. The last
+ * point of such a chunk has no successor yet: the control loop estimates its velocity when it
+ * starts the segment towards it, from the first point of the next chunk if that was appended by
+ * then, and otherwise reaches it at rest. Streaming clients that want to pass chunk boundaries
+ * without stopping therefore stay at least one point ahead, or send explicit velocities.
+ */
+class JointTrajectoryInterpolator {
+ public:
+  static constexpr size_t kCapacity{1024};
+
+  /**
+   * Validates a chunk and queues its points. Non-realtime, writer thread only.
+   *
+   * @param[in] chunk received message; positions are expected to be within the joint limits.
+   * @param[in] now current ROS time.
+   * @param[out] error reason for rejecting the chunk.
+   * @return false if the chunk was rejected; nothing is queued in that case.
+   */
+  bool addChunk(const franka_core_msgs::JointCommandChunk& chunk, const ros::Time& now,
+                std::string& error) {
+    const size_t n = chunk.points.size();
+    if (n == 0) {
+      error = "chunk has no points";
+      return false;
+    }
+    if (chunk.interpolation != franka_core_msgs::JointCommandChunk::CUBIC &&
+        chunk.interpolation != franka_core_msgs::JointCommandChunk::QUINTIC) {
+      error = "unknown interpolation type";
+      return false;
+    }
+    for (const auto& point : chunk.points) {
+      if (point.positions.size() != 7 || (!point.velocities.empty() && point.velocities.size() != 7) ||
+          (!point.accelerations.empty() && point.accelerations.size() != 7)) {
+        error = "points must have 7 positions and either 0 or 7 velocities and accelerations";
+        return false;
+      }
+    }
+    if (n > ring_.freeSpace()) {
+      error = "not enough space left in the setpoint queue";
+      return false;
+    }
+
+    const uint32_t resets = resets_.load(std::memory_order_acquire);
+    if (resets != resets_seen_) {
+      // the control loop dropped the queue; nothing is left to append to
+      resets_seen_ = resets;
+      has_last_queued_ = false;
+    }
+
+    const double now_sec = now.toSec();
+    const bool restart = !chunk.header.stamp.isZero();
+    // appending continues after the last queued point unless the queue already ran empty
+    const bool continuing = !restart && has_last_queued_ && last_queued_.time > now_sec;
+    const double base = restart ? chunk.header.stamp.toSec()
+                                : (continuing ? last_queued_.time : now_sec);
+
+    double previous_time = continuing ? last_queued_.time : (restart ? now_sec : base);
+    for (const auto& point : chunk.points) {
+      double time = base + point.time_from_start.toSec();
+      if (time <= previous_time) {
+        error = "time_from_start must be strictly increasing and lie in the future";
+        return false;
+      }
+      previous_time = time;
+    }
+
+    uint32_t generation = generation_.load(std::memory_order_relaxed);
+    if (restart) {
+      // published before the new points so that the control loop can tell them apart
+      generation_.store(++generation, std::memory_order_release);
+    }
+
+    const JointSetpoint* previous = continuing ? &last_queued_ : nullptr;
+    JointSetpoint setpoint;
+    JointSetpoint next;
+    for (size_t i = 0; i < n; ++i) {
+      const auto& point = chunk.points[i];
+      setpoint.time = base + point.time_from_start.toSec();
+      setpoint.generation = generation;
+      setpoint.quintic = chunk.interpolation == franka_core_msgs::JointCommandChunk::QUINTIC;
+      setpoint.open_velocity = false;
+      for (size_t j = 0; j < 7; ++j) {
+        setpoint.position[j] = point.positions[j];
+        setpoint.acceleration[j] = point.accelerations.empty() ? 0.0 : point.accelerations[j];
+      }
+      if (!point.velocities.empty()) {
+        std::copy(point.velocities.begin(), point.velocities.end(), setpoint.velocity.begin());
+      } else {
+        // finite differences over the neighbouring points (central where both exist); the last
+        // point of the chunk is left to the control loop, see sample()
+        const bool has_next = i + 1 < n;
+        if (has_next) {
+          next.time = base + chunk.points[i + 1].time_from_start.toSec();
+          std::copy_n(chunk.points[i + 1].positions.begin(), 7, next.position.begin());
+          const JointSetpoint* from = previous != nullptr ? previous : &setpoint;
+          double dt = next.time - from->time;
+          for (size_t j = 0; j < 7; ++j) {
+            setpoint.velocity[j] = (next.position[j] - from->position[j]) / dt;
+          }
+        } else {
+          setpoint.velocity.fill(0.0);
+          setpoint.open_velocity = true;
+        }
+      }
+      ring_.push(setpoint);
+      last_queued_ = setpoint;
+      previous = &last_queued_;
+    }
+    has_last_queued_ = true;
+    return true;
+  }
+
+  /**
+   * Drops everything queued and any trajectory in progress. Realtime side; call from starting().
+   */
+  void reset() {
+    ring_.clear();
+    active_ = false;
+    resets_.fetch_add(1, std::memory_order_release);
+  }
+
+  /**
+   * Abandons the trajectory in progress, e.g. when a single JointCommand takes over. Points
+   * queued later still start a new trajectory. Realtime side.
+   */
+  void stop() { reset(); }
+
+  /**
+   * Computes the interpolated target for the current control cycle. Realtime side.
+   *
+   * @param[in] now time of the current control cycle.
+   * @param[in,out] position current target; used as starting point when a trajectory starts,
+   * overwritten with the interpolated one.
+   * @param[in,out] velocity current target velocity, handled like position.
+   * @return true if the targets were written, i.e. while a trajectory is running and in the
+   * cycle it ends (with the final point and zero velocity).
+   */
+  bool sample(const ros::Time& now, std::array<double, 7>& position,
+              std::array<double, 7>& velocity) {
+    const double t = now.toSec();
+    const uint32_t generation = generation_.load(std::memory_order_acquire);
+    while (const JointSetpoint* next = ring_.front()) {
+      if (static_cast<int32_t>(next->generation - generation) < 0) {
+        ring_.pop();  // superseded by a newer trajectory
+        continue;
+      }
+      bool new_trajectory = !active_ || next->generation != end_.generation;
+      if (!new_trajectory && t < end_.time) {
+        break;
+      }
+      if (new_trajectory) {
+        // blend from the current target into the first point
+        start_.time = t;
+        start_.position = position;
+        start_.velocity = velocity;
+        start_.acceleration.fill(0.0);
+      } else {
+        start_ = end_;
+      }
+      end_ = *next;
+      ring_.pop();
+      active_ = true;
+      const JointSetpoint* after = ring_.front();
+      if (end_.open_velocity && after != nullptr && after->generation == end_.generation) {
+        // the next chunk was appended in time: pass through end_ instead of stopping there
+        const double dt = after->time - start_.time;
+        for (size_t j = 0; j < 7; ++j) {
+          end_.velocity[j] = (after->position[j] - start_.position[j]) / dt;
+        }
+      }
+    }
+    if (!active_) {
+      return false;
+    }
+    if (t >= end_.time) {
+      // reached the last queued point: hold it
+      position = end_.position;
+      velocity.fill(0.0);
+      active_ = false;
+      return true;
+    }
+    evaluate(t, position, velocity);
+    return true;
+  }
+
+  /**
+   * @return true while a trajectory is being followed. Realtime side.
+   */
+  bool active() const { return active_; }
+
+ private:
+  void evaluate(double t, std::array<double, 7>& position, std::array<double, 7>& velocity) const {
+    const double T = end_.time - start_.time;
+    const double s = t - start_.time;
+    if (end_.quintic) {
+      const double T2 = T * T, T3 = T2 * T, T4 = T3 * T, T5 = T4 * T;
+      for (size_t j = 0; j < 7; ++j) {
+        const double p0 = start_.position[j], v0 = start_.velocity[j], a0 = start_.acceleration[j];
+        const double p1 = end_.position[j], v1 = end_.velocity[j], a1 = end_.acceleration[j];
+        const double dp = p1 - p0;
+        const double c2 = 0.5 * a0;
+        const double c3 = (20.0 * dp - (8.0 * v1 + 12.0 * v0) * T - (3.0 * a0 - a1) * T2) / (2.0 * T3);
+        const double c4 = (-30.0 * dp + (14.0 * v1 + 16.0 * v0) * T + (3.0 * a0 - 2.0 * a1) * T2) /
+                          (2.0 * T4);
+        const double c5 = (12.0 * dp - 6.0 * (v1 + v0) * T + (a1 - a0) * T2) / (2.0 * T5);
+        position[j] = p0 + s * (v0 + s * (c2 + s * (c3 + s * (c4 + s * c5))));
+        velocity[j] = v0 + s * (2.0 * c2 + s * (3.0 * c3 + s * (4.0 * c4 + s * 5.0 * c5)));
+      }
+    } else {
+      // cubic Hermite spline
+      const double tau = s / T, tau2 = tau * tau, tau3 = tau2 * tau;
+      const double h00 = 2.0 * tau3 - 3.0 * tau2 + 1.0, h10 = tau3 - 2.0 * tau2 + tau;
+      const double h01 = -2.0 * tau3 + 3.0 * tau2, h11 = tau3 - tau2;
+      const double dh00 = 6.0 * tau2 - 6.0 * tau, dh10 = 3.0 * tau2 - 4.0 * tau + 1.0;
+      const double dh01 = -6.0 * tau2 + 6.0 * tau, dh11 = 3.0 * tau2 - 2.0 * tau;
+      for (size_t j = 0; j < 7; ++j) {
+        const double p0 = start_.position[j], m0 = start_.velocity[j] * T;
+        const double p1 = end_.position[j], m1 = end_.velocity[j] * T;
+        position[j] = h00 * p0 + h10 * m0 + h01 * p1 + h11 * m1;
+        velocity[j] = (dh00 * p0 + dh10 * m0 + dh01 * p1 + dh11 * m1) / T;
+      }
+    }
+  }
+
+  franka_interface::SpscRingBuffer<JointSetpoint, kCapacity> ring_;
+  std::atomic<uint32_t> generation_{0};
+  std::atomic<uint32_t> resets_{0};  // bumped by reset() and stop()
+
+  // owned by the writer
+  JointSetpoint last_queued_;
+  bool has_last_queued_{false};
+  uint32_t resets_seen_{0};
+
+  // owned by the control loop
+  JointSetpoint start_;
+  JointSetpoint end_;
+  bool active_{false};
+};
+
+}  // namespace franka_ros_controllers
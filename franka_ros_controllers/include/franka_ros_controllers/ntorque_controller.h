@@ -11,6 +11,7 @@
 #include <controller_interface/multi_interface_controller.h>
 #include <dynamic_reconfigure/server.h>
 #include <franka_hw/franka_model_interface.h>
+#include <franka_interface/franka_model_cache_interface.h>
 #include <franka_hw/franka_state_interface.h>
 #include <hardware_interface/joint_command_interface.h>
 #include <hardware_interface/robot_hw.h>
@@ -18,6 +19,8 @@
 #include <ros/time.h>
 #include <Eigen/Core>
 
+#include <franka_ros_controllers/command_mailbox.h>
+#include <franka_ros_controllers/joint_limit_checker.h>
 #include <franka_ros_controllers/desired_mass_paramConfig.h>
 #include <franka_core_msgs/TorqueCmd.h>
 
@@ -26,23 +29,27 @@ namespace franka_ros_controllers {
 class NTorqueController : public controller_interface::MultiInterfaceController<
                                    franka_hw::FrankaModelInterface,
                                    hardware_interface::EffortJointInterface,
-                                   franka_hw::FrankaStateInterface> {
+                                   franka_hw::FrankaStateInterface,
+                                   franka_interface::FrankaModelCacheInterface> {
  public:
+  // FrankaModelCacheInterface is optional, so all interfaces are checked in init()
+  NTorqueController() : MultiInterfaceController(true) {}
   bool init(hardware_interface::RobotHW* robot_hw, ros::NodeHandle& node_handle) override;
   void starting(const ros::Time&) override;
   void update(const ros::Time&, const ros::Duration& period) override;
+  void stopping(const ros::Time&) override;
 
  private:
   // Saturation
   Eigen::Matrix<double, 7, 1> saturateTorqueRate(
       const Eigen::Matrix<double, 7, 1>& tau_d_calculated,
       const Eigen::Matrix<double, 7, 1>& tau_J_d);  // NOLINT (readability-identifier-naming)
-  bool checkTorqueLimits(std::vector<double> torques);
 
-  std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
+  std::unique_ptr<franka_interface::FrankaModelCacheHandle> model_handle_;
   std::unique_ptr<franka_hw::FrankaStateHandle> state_handle_;
   std::vector<hardware_interface::JointHandle> joint_handles_;
   franka_core_msgs::JointLimits joint_limits_;
+  JointLimitChecker limit_checker_;
 
   Eigen::Matrix<double, 7, 1> desired_torque_;
   Eigen::Matrix<double, 7, 1> target_torque_;
@@ -57,6 +64,7 @@ class NTorqueController : public controller_interface::MultiInterfaceController<
 
   // Stiffness subscriber 
   ros::Subscriber torque_params_;
+  CommandMailbox<JointTargetCommand> torque_mailbox_;
   void torqueParamCallback(const franka_core_msgs::TorqueCmdConstPtr& msg);
 
 };
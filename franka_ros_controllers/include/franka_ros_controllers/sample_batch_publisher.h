@@ -0,0 +1,203 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <franka_core_msgs/JointControllerSamples.h>
+#include <ros/console.h>
+#include <ros/node_handle.h>
+#include <ros/publisher.h>
+#include <ros/time.h>
+
+#include <franka_interface/spsc_ring_buffer.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * One control cycle of a joint controller, as published in franka_core_msgs::JointControllerSamples.
+ */
+struct JointControllerSample {
+  using Batch = franka_core_msgs::JointControllerSamples;
+
+  double time{0.0};  // [s], ROS time of the cycle
+  std::array<double, 7> set_point{};
+  std::array<double, 7> process_value{};
+  std::array<double, 7> process_value_dot{};
+  std::array<double, 7> error{};
+  std::array<double, 7> command{};
+
+  void appendTo(Batch& batch) const {
+    batch.header.stamp = ros::Time(time);
+    batch.stamps.push_back(batch.header.stamp);
+    batch.set_point.insert(batch.set_point.end(), set_point.begin(), set_point.end());
+    batch.process_value.insert(batch.process_value.end(), process_value.begin(), process_value.end());
+    batch.process_value_dot.insert(batch.process_value_dot.end(), process_value_dot.begin(),
+                                   process_value_dot.end());
+    batch.error.insert(batch.error.end(), error.begin(), error.end());
+    batch.command.insert(batch.command.end(), command.begin(), command.end());
+  }
+
+  static void clearBatch(Batch& batch) {
+    batch.stamps.clear();
+    batch.set_point.clear();
+    batch.process_value.clear();
+    batch.process_value_dot.clear();
+    batch.error.clear();
+    batch.command.clear();
+  }
+};
+
+/**
+ * Publishes every sample pushed by the control loop, in batches, from a thread of its own.
+ *
+ * The control loop only copies a POD sample into a preallocated SpscRingBuffer, so it neither
+ * locks nor allocates, and no sample is lost unless the publishing thread falls more than
+ * Capacity samples behind (counted in the dropped_samples field of the batches). The thread
+ * wakes up at sample_publish_rate, moves everything buffered into one message and publishes it.
+ *
+ * Sample must be trivially copyable and provide
+ *  - a Batch typedef for the batch message, which has a dropped_samples field,
+ *  - void appendTo(Batch&) const, adding the sample to the batch,
+ *  - static void clearBatch(Batch&), removing all samples from a batch,
+ * see JointControllerSample.
+ *
+ * Disabled unless the controller's publish_samples parameter is set, in which case push() does
+ * nothing.
+ */
+template <typename Sample, size_t Capacity = 4096>
+class SampleBatchPublisher {
+ public:
+  using Batch = typename Sample::Batch;
+
+  SampleBatchPublisher() = default;
+  SampleBatchPublisher(const SampleBatchPublisher&) = delete;
+  SampleBatchPublisher& operator=(const SampleBatchPublisher&) = delete;
+  ~SampleBatchPublisher() { stop(); }
+
+  /**
+   * Advertises the topic and starts the publishing thread if publish_samples is set. Call from
+   * init().
+   *
+   * @param[in] node_handle node handle in the controller namespace.
+   * @param[in] topic topic to publish the batches on.
+   * @param[in] prototype batch message with the fields that do not change (names etc.) filled in.
+   * @param[in] controller_name prefix for log messages.
+   */
+  void init(ros::NodeHandle& node_handle, const std::string& topic, const Batch& prototype,
+            const std::string& controller_name) {
+    stop();
+    bool enabled(false);
+    node_handle.param<bool>("publish_samples", enabled, false);
+    if (!enabled) {
+      return;
+    }
+    double publish_rate(20.0);
+    node_handle.param<double>("sample_publish_rate", publish_rate, 20.0);
+    if (publish_rate <= 0.0) {
+      ROS_ERROR_STREAM(controller_name << ": Invalid sample_publish_rate " << publish_rate
+                       << ". Using 20 Hz instead.");
+      publish_rate = 20.0;
+    }
+    batch_ = prototype;
+    publisher_ = node_handle.advertise<Batch>(topic, 100);
+    running_.store(true, std::memory_order_relaxed);
+    thread_ = std::thread(&SampleBatchPublisher::run, this,
+                          std::chrono::duration<double>(1.0 / publish_rate));
+    enabled_ = true;
+    ROS_INFO_STREAM(controller_name << ": Publishing every control cycle on " << topic << " at "
+                    << publish_rate << " Hz.");
+  }
+
+  bool enabled() const { return enabled_; }
+
+  /**
+   * Queues the sample of this cycle. Realtime safe.
+   */
+  void push(const Sample& sample) {
+    if (!enabled()) {
+      return;
+    }
+    if (!ring_.push(sample)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Stops the publishing thread after publishing what is left in the buffer.
+   */
+  void stop() {
+    enabled_ = false;
+    running_.store(false, std::memory_order_relaxed);
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+ private:
+  void run(std::chrono::duration<double> period) {
+    auto next = std::chrono::steady_clock::now();
+    while (running_.load(std::memory_order_relaxed)) {
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+      std::this_thread::sleep_until(next);
+      publishBuffered();
+    }
+    publishBuffered();
+  }
+
+  void publishBuffered() {
+    Sample::clearBatch(batch_);
+    Sample sample;
+    bool any = false;
+    while (ring_.pop(sample)) {
+      sample.appendTo(batch_);
+      any = true;
+    }
+    if (!any) {
+      return;
+    }
+    batch_.dropped_samples = dropped_.load(std::memory_order_relaxed);
+    publisher_.publish(batch_);
+  }
+
+  bool enabled_{false};
+  franka_interface::SpscRingBuffer<Sample, Capacity> ring_;
+  std::atomic<uint64_t> dropped_{0};
+
+  // owned by the publishing thread
+  Batch batch_;
+  ros::Publisher publisher_;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+};
+
+}  // namespace franka_ros_controllers
@@ -0,0 +1,103 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/shared_memory_transport.h>
+#include <ros/node_handle.h>
+#include <ros/console.h>
+
+namespace franka_ros_controllers {
+
+/**
+ * Picks up joint commands that local clients write to the shared memory command slot (see
+ * franka_interface::SharedMemoryTransport), as an alternative to the joint_commands topic.
+ * Does nothing unless robot_config/shared_memory/enabled is set in the arm namespace.
+ */
+class SharedJointCommandReader {
+ public:
+  /**
+   * Opens the shared memory segment if enabled. Call from init().
+   *
+   * @param[in] node_handle node handle of the controller.
+   * @param[in] controller_name prefix for error messages.
+   * @return false if shared memory is enabled but could not be opened.
+   */
+  bool init(ros::NodeHandle& node_handle, const std::string& controller_name) {
+    ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+    bool enabled(false);
+    arm_node_handle.param<bool>("robot_config/shared_memory/enabled", enabled, false);
+    if (!enabled) {
+      return true;
+    }
+    std::string arm_id, name;
+    arm_node_handle.param<std::string>("robot_config/arm_id", arm_id, "panda");
+    arm_node_handle.param<std::string>("robot_config/shared_memory/name", name,
+                                   "/franka_ros_interface_" + arm_id);
+    std::string error;
+    if (!transport_.open(name, error)) {
+      ROS_ERROR_STREAM(controller_name << ": Could not open shared memory command slot: " << error);
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Ignores whatever is in the slot already. Call from starting().
+   */
+  void starting() {
+    franka_interface::SharedJointCommand command;
+    if (transport_.isOpen() && transport_.readCommand(command)) {
+      last_sequence_ = command.sequence;
+    }
+  }
+
+  /**
+   * Realtime safe.
+   *
+   * @param[in] mode franka_core_msgs::JointCommand mode handled by the calling controller.
+   * @param[out] command the new command.
+   * @return true if a command with the given mode was written since the last call.
+   */
+  bool read(int32_t mode, franka_interface::SharedJointCommand& command) {
+    if (!transport_.isOpen() || !transport_.readCommand(command) ||
+        command.sequence == last_sequence_) {
+      return false;
+    }
+    last_sequence_ = command.sequence;
+    return command.mode == mode;
+  }
+
+ private:
+  franka_interface::SharedMemoryTransport transport_;
+  uint64_t last_sequence_{0};
+};
+
+}  // namespace franka_ros_controllers
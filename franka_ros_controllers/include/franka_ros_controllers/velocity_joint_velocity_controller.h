@@ -34,6 +34,12 @@
 #include <franka_core_msgs/JointCommand.h>
 #include <franka_core_msgs/JointControllerStates.h>
 #include <franka_core_msgs/JointLimits.h>
+#include <franka_ros_controllers/command_latency_tracer.h>
+#include <franka_ros_controllers/command_mailbox.h>
+#include <franka_ros_controllers/command_watchdog.h>
+#include <franka_ros_controllers/joint_limit_checker.h>
+#include <franka_ros_controllers/sample_batch_publisher.h>
+#include <franka_ros_controllers/shared_command_reader.h>
 
 #include <mutex>
 #include <franka_hw/trigger_rate.h>
@@ -67,6 +73,11 @@ class VelocityJointVelocityController : public controller_interface::MultiInterf
 
     // joint_cmd subscriber
   ros::Subscriber desired_joints_subscriber_;
+  CommandMailbox<JointTargetCommand> joint_command_mailbox_;
+  SharedJointCommandReader shared_command_reader_;
+  CommandLatencyTracer latency_tracer_;
+  CommandWatchdog command_watchdog_;
+  JointLimitChecker limit_checker_;
 
   double filter_joint_vel_{0.3};
   double target_filter_joint_vel_{0.3};
@@ -82,13 +93,11 @@ class VelocityJointVelocityController : public controller_interface::MultiInterf
 
   franka_hw::TriggerRate trigger_publish_;
   realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> publisher_controller_states_;
-
-  bool checkVelocityLimits(std::vector<double> velocities);
-
+  SampleBatchPublisher<JointControllerSample> sample_publisher_;
 
   void jointControllerParamCallback(franka_ros_controllers::joint_controller_paramsConfig& config,
                                uint32_t level);
-  void jointVelCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg);
+  void jointVelCmdCallback(const ros::MessageEvent<franka_core_msgs::JointCommand const>& event);
 };
 
 }  // namespace franka_ros_controllers
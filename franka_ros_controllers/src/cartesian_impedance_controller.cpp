@@ -6,6 +6,8 @@
 #include <memory>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <franka/robot_state.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
@@ -16,14 +18,17 @@ namespace franka_ros_controllers {
 
 bool CartesianImpedanceController::init(hardware_interface::RobotHW* robot_hw,
                                         ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
   std::vector<double> cartesian_stiffness_vector;
   std::vector<double> cartesian_damping_vector;
 
-  sub_equilibrium_pose_ = node_handle.subscribe(
-      "/equilibrium_pose", 20, &CartesianImpedanceController::equilibriumPoseCallback, this,
+  sub_equilibrium_pose_ = command_node_handle.subscribe(
+      "equilibrium_pose", 20, &CartesianImpedanceController::equilibriumPoseCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
-  stiffness_params_ = node_handle.subscribe(
-      "/impedance_stiffness", 20, &CartesianImpedanceController::stiffnessParamCallback, this,
+  stiffness_params_ = arm_node_handle.subscribe(
+      "impedance_stiffness", 20, &CartesianImpedanceController::stiffnessParamCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
  
   std::string arm_id;
@@ -44,22 +49,28 @@ bool CartesianImpedanceController::init(hardware_interface::RobotHW* robot_hw,
         "controller init!");
     return false;
   }
-
-  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
-  if (model_interface == nullptr) {
-    ROS_ERROR_STREAM(
-        "CartesianImpedanceController: Error getting model interface from hardware");
+  std::string nullspace_projection("damped_inverse");
+  node_handle.param<std::string>("nullspace_projection", nullspace_projection, nullspace_projection);
+  if (nullspace_projection != "damped_inverse" && nullspace_projection != "svd") {
+    ROS_ERROR_STREAM("CartesianImpedanceController: Invalid nullspace_projection '"
+                     << nullspace_projection << "' (damped_inverse or svd), aborting controller init!");
     return false;
   }
+  svd_nullspace_projection_ = nullspace_projection == "svd";
+
   try {
-    model_handle_ = std::make_unique<franka_hw::FrankaModelHandle>(
-        model_interface->getHandle(arm_id + "_model"));
+    model_handle_ = franka_interface::getModelCacheHandle(robot_hw, arm_id);
   } catch (hardware_interface::HardwareInterfaceException& ex) {
     ROS_ERROR_STREAM(
         "CartesianImpedanceController: Exception getting model handle from interface: "
         << ex.what());
     return false;
   }
+  if (model_handle_ == nullptr) {
+    ROS_ERROR_STREAM(
+        "CartesianImpedanceController: Error getting model interface from hardware");
+    return false;
+  }
 
   auto* state_interface = robot_hw->get<franka_hw::FrankaStateInterface>();
   if (state_interface == nullptr) {
@@ -110,6 +121,10 @@ bool CartesianImpedanceController::init(hardware_interface::RobotHW* robot_hw,
   cartesian_stiffness_.setZero();
   cartesian_damping_.setZero();
 
+  if (!contact_guard_.init(node_handle, "CartesianImpedanceController")) {
+    return false;
+  }
+
   return true;
 }
 
@@ -118,10 +133,10 @@ void CartesianImpedanceController::starting(const ros::Time& /*time*/) {
   // to initial configuration
   franka::RobotState initial_state = state_handle_->getRobotState();
   // get jacobian
-  std::array<double, 42> jacobian_array =
+  const std::array<double, 42>& jacobian_array =
       model_handle_->getZeroJacobian(franka::Frame::kEndEffector);
   // convert to eigen
-  Eigen::Map<Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
+  Eigen::Map<const Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> dq_initial(initial_state.dq.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> q_initial(initial_state.q.data());
   Eigen::Affine3d initial_transform(Eigen::Matrix4d::Map(initial_state.O_T_EE.data()));
@@ -134,19 +149,21 @@ void CartesianImpedanceController::starting(const ros::Time& /*time*/) {
 
   // set nullspace equilibrium configuration to initial q
   q_d_nullspace_ = q_initial;
+  equilibrium_pose_mailbox_.clear();
+  contact_guard_.starting();
 }
 
-void CartesianImpedanceController::update(const ros::Time& /*time*/,
+void CartesianImpedanceController::update(const ros::Time& time,
                                                  const ros::Duration& /*period*/) {
   // get state variables
   franka::RobotState robot_state = state_handle_->getRobotState();
-  std::array<double, 7> coriolis_array = model_handle_->getCoriolis();
-  std::array<double, 42> jacobian_array =
+  const std::array<double, 7>& coriolis_array = model_handle_->getCoriolis();
+  const std::array<double, 42>& jacobian_array =
       model_handle_->getZeroJacobian(franka::Frame::kEndEffector);
 
   // convert to Eigen
-  Eigen::Map<Eigen::Matrix<double, 7, 1>> coriolis(coriolis_array.data());
-  Eigen::Map<Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
+  Eigen::Map<const Eigen::Matrix<double, 7, 1>> coriolis(coriolis_array.data());
+  Eigen::Map<const Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> q(robot_state.q.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> dq(robot_state.dq.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> tau_J_d(  // NOLINT (readability-identifier-naming)
@@ -155,6 +172,36 @@ void CartesianImpedanceController::update(const ros::Time& /*time*/,
   Eigen::Vector3d position(transform.translation());
   Eigen::Quaterniond orientation(transform.linear());
 
+  // apply new targets received by the subscriber callbacks
+  CartesianPoseCommand pose_command;
+  if (equilibrium_pose_mailbox_.readFromRT(pose_command)) {
+    position_d_target_ << pose_command.position[0], pose_command.position[1],
+        pose_command.position[2];
+    Eigen::Quaterniond last_orientation_d_target(orientation_d_target_);
+    orientation_d_target_.coeffs() << pose_command.orientation[0], pose_command.orientation[1],
+        pose_command.orientation[2], pose_command.orientation[3];
+    if (last_orientation_d_target.coeffs().dot(orientation_d_target_.coeffs()) < 0.0) {
+      orientation_d_target_.coeffs() << -orientation_d_target_.coeffs();
+    }
+  }
+  std::array<double, 6> stiffness;
+  if (stiffness_mailbox_.readFromRT(stiffness)) {
+    cartesian_stiffness_target_.setIdentity();
+    cartesian_damping_target_.setIdentity(); // Damping ratio = 1
+    for (size_t i = 0; i < 6; ++i) {
+      cartesian_stiffness_target_(i, i) = stiffness[i];
+      cartesian_damping_target_(i, i) = 2.0 * sqrt(stiffness[i]);
+    }
+  }
+  if (contact_guard_.check(robot_state, time)) {
+    // stop at the pose of the contact, bypassing the target filter
+    Eigen::Affine3d contact_transform(Eigen::Matrix4d::Map(contact_guard_.contactPose().data()));
+    position_d_target_ = contact_transform.translation();
+    orientation_d_target_ = Eigen::Quaterniond(contact_transform.linear());
+    position_d_ = position_d_target_;
+    orientation_d_ = orientation_d_target_;
+  }
+
   // compute error to desired pose
   // position error
   Eigen::Matrix<double, 6, 1> error;
@@ -172,22 +219,27 @@ void CartesianImpedanceController::update(const ros::Time& /*time*/,
   error.tail(3) << error_quaternion_angle_axis.axis() * error_quaternion_angle_axis.angle();
 
   // compute control
-  // allocate variables
-  Eigen::VectorXd tau_task(7), tau_nullspace(7), tau_d(7);
-
-  // pseudoinverse for nullspace handling
-  // kinematic pseuoinverse
-  Eigen::MatrixXd jacobian_transpose_pinv;
-  pseudoInverse(jacobian.transpose(), jacobian_transpose_pinv);
+  // fixed-size variables, nothing below allocates
+  Eigen::Matrix<double, 7, 1> tau_task, tau_nullspace, tau_d;
 
   // Cartesian PD control with damping ratio = 1
   tau_task << jacobian.transpose() *
                   (-cartesian_stiffness_ * error - cartesian_damping_ * (jacobian * dq));
   // nullspace PD control with damping ratio = 1
-  tau_nullspace << (Eigen::MatrixXd::Identity(7, 7) -
-                    jacobian.transpose() * jacobian_transpose_pinv) *
-                       (nullspace_stiffness_ * (q_d_nullspace_ - q) -
-                        (2.0 * sqrt(nullspace_stiffness_)) * dq);
+  if (nullspace_stiffness_ < kMinNullspaceStiffness) {
+    tau_nullspace.setZero();
+  } else if (svd_nullspace_projection_) {
+    // kinematic pseuoinverse
+    Eigen::Matrix<double, 6, 7> jacobian_transpose_pinv;
+    pseudoInverse(jacobian.transpose(), jacobian_transpose_pinv);
+    tau_nullspace << (Eigen::Matrix<double, 7, 7>::Identity() -
+                      jacobian.transpose() * jacobian_transpose_pinv) *
+                         (nullspace_stiffness_ * (q_d_nullspace_ - q) -
+                          (2.0 * sqrt(nullspace_stiffness_)) * dq);
+  } else {
+    tau_nullspace << projectToNullspace(jacobian, nullspace_stiffness_ * (q_d_nullspace_ - q) -
+                                                      (2.0 * sqrt(nullspace_stiffness_)) * dq);
+  }
   // Desired torque
   tau_d << tau_task + tau_nullspace + coriolis;
   // Saturate torque rate to avoid discontinuities
@@ -201,6 +253,9 @@ void CartesianImpedanceController::update(const ros::Time& /*time*/,
   cartesian_stiffness_ = filter_params_ * cartesian_stiffness_target_ + (1.0 - filter_params_) * cartesian_stiffness_;
   cartesian_damping_ = filter_params_ * cartesian_damping_target_ + (1.0 - filter_params_) * cartesian_damping_;
   nullspace_stiffness_ = filter_params_ * nullspace_stiffness_target_ + (1.0 - filter_params_) * nullspace_stiffness_;
+  if (nullspace_stiffness_target_ == 0.0 && nullspace_stiffness_ < kMinNullspaceStiffness) {
+    nullspace_stiffness_ = 0.0;  // instead of decaying into denormals
+  }
   position_d_ = filter_params_ * position_d_target_ + (1.0 - filter_params_) * position_d_;
   Eigen::AngleAxisd aa_orientation_d(orientation_d_);
   Eigen::AngleAxisd aa_orientation_d_target(orientation_d_target_);
@@ -209,6 +264,13 @@ void CartesianImpedanceController::update(const ros::Time& /*time*/,
   orientation_d_ = Eigen::Quaterniond(aa_orientation_d);
 }
 
+void CartesianImpedanceController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("CartesianImpedanceController: " << equilibrium_pose_mailbox_.overwrittenCount()
+                  << " of " << equilibrium_pose_mailbox_.writtenCount()
+                  << " equilibrium poses were overwritten before being applied; "
+                  << contact_guard_.contacts() << " contacts were detected.");
+}
+
 Eigen::Matrix<double, 7, 1> CartesianImpedanceController::saturateTorqueRate(
     const Eigen::Matrix<double, 7, 1>& tau_d_calculated,
     const Eigen::Matrix<double, 7, 1>& tau_J_d) {  // NOLINT (readability-identifier-naming)
@@ -220,36 +282,35 @@ Eigen::Matrix<double, 7, 1> CartesianImpedanceController::saturateTorqueRate(
   return tau_d_saturated;
 }
 
+Eigen::Matrix<double, 7, 1> CartesianImpedanceController::projectToNullspace(
+    const Eigen::Matrix<double, 6, 7>& jacobian,
+    const Eigen::Matrix<double, 7, 1>& tau) const {
+  // same damping as pseudoInverse(), whose damped SVD inverse of J^T equals
+  // (J J^T + lambda^2 I)^-1 J; the 6x6 system is positive definite, so LLT solves it
+  constexpr double kLambda = 0.2;
+  Eigen::Matrix<double, 6, 6> damped_jjt = jacobian * jacobian.transpose();
+  damped_jjt.diagonal().array() += kLambda * kLambda;
+  Eigen::LLT<Eigen::Matrix<double, 6, 6>> llt(damped_jjt);
+  return tau - jacobian.transpose() * llt.solve(jacobian * tau);
+}
+
 void CartesianImpedanceController::stiffnessParamCallback(
      const franka_core_msgs::CartImpedanceStiffness& msg) {
 
-  cartesian_stiffness_target_.setIdentity();
-  cartesian_damping_target_.setIdentity(); // Damping ratio = 1
   //nullspace_stiffness_target_ = config.nullspace_stiffness; TODO
 
-  cartesian_stiffness_target_(0,0) = msg.x;
-  cartesian_stiffness_target_(1,1) = msg.y;
-  cartesian_stiffness_target_(2,2) = msg.z;
-  cartesian_stiffness_target_(3,3) = msg.xrot;
-  cartesian_stiffness_target_(4,4) = msg.yrot;
-  cartesian_stiffness_target_(5,5) = msg.zrot;
-  cartesian_damping_target_(0,0) = 2.0 * sqrt(msg.x);
-  cartesian_damping_target_(1,1) = 2.0 * sqrt(msg.y);
-  cartesian_damping_target_(2,2) = 2.0 * sqrt(msg.z);
-  cartesian_damping_target_(3,3) = 2.0 * sqrt(msg.xrot);
-  cartesian_damping_target_(4,4) = 2.0 * sqrt(msg.yrot);
-  cartesian_damping_target_(5,5) = 2.0 * sqrt(msg.zrot);
+  // stiffness and damping targets are rebuilt by update()
+  stiffness_mailbox_.writeFromNonRT({{msg.x, msg.y, msg.z, msg.xrot, msg.yrot, msg.zrot}});
 }
 
 void CartesianImpedanceController::equilibriumPoseCallback(
     const geometry_msgs::PoseStampedConstPtr& msg) {
-  position_d_target_ << msg->pose.position.x, msg->pose.position.y, msg->pose.position.z;
-  Eigen::Quaterniond last_orientation_d_target(orientation_d_target_);
-  orientation_d_target_.coeffs() << msg->pose.orientation.x, msg->pose.orientation.y,
-      msg->pose.orientation.z, msg->pose.orientation.w;
-  if (last_orientation_d_target.coeffs().dot(orientation_d_target_.coeffs()) < 0.0) {
-    orientation_d_target_.coeffs() << -orientation_d_target_.coeffs();
-  }
+  CartesianPoseCommand command;
+  command.position = {{msg->pose.position.x, msg->pose.position.y, msg->pose.position.z}};
+  command.orientation = {{msg->pose.orientation.x, msg->pose.orientation.y,
+                          msg->pose.orientation.z, msg->pose.orientation.w}};
+  // the quaternion sign is aligned with the previous target in update()
+  equilibrium_pose_mailbox_.writeFromNonRT(command);
 }
 
 }  // namespace franka_ros_controllers
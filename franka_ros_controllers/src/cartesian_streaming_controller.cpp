@@ -0,0 +1,251 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+#include <franka_ros_controllers/cartesian_streaming_controller.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+
+#include <franka/robot_state.h>
+
+namespace franka_ros_controllers {
+
+constexpr double CartesianStreamingController::kQuaternionNormTolerance;
+
+bool CartesianStreamingController::readLimits(ros::NodeHandle& node_handle,
+                                              const std::string& name, CartesianLimits& limits) {
+  node_handle.param<double>(name + "/velocity", limits.velocity, limits.velocity);
+  node_handle.param<double>(name + "/acceleration", limits.acceleration, limits.acceleration);
+  node_handle.param<double>(name + "/jerk", limits.jerk, limits.jerk);
+  if (!(limits.velocity > 0.0) || !(limits.acceleration > 0.0) || !(limits.jerk > 0.0)) {
+    ROS_ERROR_STREAM("CartesianStreamingController: The " << name
+                     << " velocity, acceleration and jerk must be positive, aborting controller "
+                     "init!");
+    return false;
+  }
+  return true;
+}
+
+bool CartesianStreamingController::init(hardware_interface::RobotHW* robot_hw,
+                                        ros::NodeHandle& node_handle) {
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
+  std::string arm_id;
+  if (!node_handle.getParam("arm_id", arm_id)) {
+    ROS_ERROR("CartesianStreamingController: Could not read parameter arm_id");
+    return false;
+  }
+
+  // below the limits of libfranka (1.7 m/s, 13 m/s^2, 6500 m/s^3; 2.5 rad/s, 25 rad/s^2,
+  // 12500 rad/s^3), so that its rate limiting does not have to step in
+  CartesianLimits translation{1.0, 6.0, 3000.0};
+  CartesianLimits rotation{1.5, 12.0, 6000.0};
+  if (!readLimits(node_handle, "translation_limits", translation) ||
+      !readLimits(node_handle, "rotation_limits", rotation)) {
+    return false;
+  }
+  double tracking_gain(10.0);
+  node_handle.param<double>("tracking_gain", tracking_gain, tracking_gain);
+  if (!(tracking_gain > 0.0)) {
+    ROS_ERROR("CartesianStreamingController: tracking_gain must be positive, aborting controller "
+              "init!");
+    return false;
+  }
+  tracker_.configure(translation, rotation, tracking_gain);
+  node_handle.param<double>("max_extrapolation", max_extrapolation_, max_extrapolation_);
+  max_extrapolation_ = std::max(0.0, max_extrapolation_);
+  node_handle.param<double>("max_twist_duration", max_twist_duration_, max_twist_duration_);
+  if (!(max_twist_duration_ > 0.0)) {
+    ROS_ERROR("CartesianStreamingController: max_twist_duration must be positive, aborting "
+              "controller init!");
+    return false;
+  }
+
+  auto* cartesian_pose_interface = robot_hw->get<franka_hw::FrankaPoseCartesianInterface>();
+  if (cartesian_pose_interface == nullptr) {
+    ROS_ERROR_STREAM(
+        "CartesianStreamingController: Error getting cartesian pose interface from hardware");
+    return false;
+  }
+  try {
+    cartesian_pose_handle_ = std::make_unique<franka_hw::FrankaCartesianPoseHandle>(
+        cartesian_pose_interface->getHandle(arm_id + "_robot"));
+  } catch (hardware_interface::HardwareInterfaceException& ex) {
+    ROS_ERROR_STREAM(
+        "CartesianStreamingController: Exception getting cartesian pose handle from interface: "
+        << ex.what());
+    return false;
+  }
+
+  latency_tracer_.init(node_handle, "CartesianStreamingController");
+  command_watchdog_.init(node_handle, "CartesianStreamingController");
+
+  pose_target_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/cartesian_pose_target", 20,
+      &CartesianStreamingController::poseTargetCallback, this,
+      ros::TransportHints().reliable().tcpNoDelay());
+  twist_target_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/cartesian_twist_target", 20,
+      &CartesianStreamingController::twistTargetCallback, this,
+      ros::TransportHints().reliable().tcpNoDelay());
+
+  return true;
+}
+
+void CartesianStreamingController::starting(const ros::Time& time) {
+  // start from the last commanded pose, which the motion generator continues from
+  pose_command_ = cartesian_pose_handle_->getRobotState().O_T_EE_d;
+  tracker_.reset(pose_command_);
+  cartesian_pose_handle_->setCommand(pose_command_);
+  pose_target_mailbox_.clear();
+  twist_target_mailbox_.clear();
+  command_watchdog_.starting(time);
+  extrapolating_ = false;
+}
+
+void CartesianStreamingController::update(const ros::Time& time, const ros::Duration& period) {
+  CartesianStreamCommand command;
+  if (pose_target_mailbox_.readFromRT(command)) {
+    latency_tracer_.applied(command.trace, time);
+    command_watchdog_.commandReceived(time);
+    tracker_.setTarget(
+        Eigen::Vector3d(command.position[0], command.position[1], command.position[2]),
+        Eigen::Quaterniond(command.orientation[3], command.orientation[0],
+                           command.orientation[1], command.orientation[2]),
+        Eigen::Map<const CartesianSetpointTracker::Vector6d>(command.velocity.data()));
+    extrapolating_ = command.duration > 0.0;
+    extrapolation_end_ = time + ros::Duration(command.duration);
+  }
+  // a twist arriving in the same cycle moves the new target on
+  if (twist_target_mailbox_.readFromRT(command)) {
+    latency_tracer_.applied(command.trace, time);
+    command_watchdog_.commandReceived(time);
+    tracker_.setTargetVelocity(
+        Eigen::Map<const CartesianSetpointTracker::Vector6d>(command.velocity.data()));
+    extrapolating_ = true;
+    extrapolation_end_ = time + ros::Duration(command.duration);
+  }
+  if (extrapolating_ && (time - extrapolation_end_).toSec() > 0.0) {
+    // the next pose of the stream or the next twist is overdue: stop instead of moving further
+    tracker_.stopTarget();
+    extrapolating_ = false;
+  }
+  if (command_watchdog_.expired(time)) {
+    tracker_.stopTarget();
+  }
+
+  tracker_.step(period.toSec() > 0.0 ? period.toSec() : kNominalPeriod, pose_command_);
+  cartesian_pose_handle_->setCommand(pose_command_);
+}
+
+void CartesianStreamingController::stopping(const ros::Time& /*time*/) {
+  // the motion generator brings the robot to rest itself
+  ROS_INFO_STREAM("CartesianStreamingController: "
+                  << pose_target_mailbox_.overwrittenCount() + twist_target_mailbox_.overwrittenCount()
+                  << " of "
+                  << pose_target_mailbox_.writtenCount() + twist_target_mailbox_.writtenCount()
+                  << " targets were overwritten before being applied and "
+                  << rejected_targets_.load(std::memory_order_relaxed)
+                  << " rejected; the command timeout was exceeded " << command_watchdog_.timeouts()
+                  << " times.");
+}
+
+void CartesianStreamingController::poseTargetCallback(
+    const ros::MessageEvent<geometry_msgs::PoseStamped const>& event) {
+  const geometry_msgs::PoseStampedConstPtr& msg = event.getConstMessage();
+  const auto& p = msg->pose.position;
+  const auto& o = msg->pose.orientation;
+  Eigen::Vector3d position(p.x, p.y, p.z);
+  Eigen::Quaterniond orientation(o.w, o.x, o.y, o.z);
+  if (!position.allFinite() || !orientation.coeffs().allFinite() ||
+      std::abs(orientation.norm() - 1.0) > kQuaternionNormTolerance) {
+    ROS_ERROR_STREAM_THROTTLE(1.0, "CartesianStreamingController: Rejected an invalid pose "
+                                   "target (non-finite, or the norm of the quaternion is not within "
+                                   << kQuaternionNormTolerance << " of 1)");
+    rejected_targets_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // removes the rounding of the sender
+  orientation.normalize();
+
+  CartesianStreamCommand command;
+  // velocity of the stream, from the stamps of consecutive poses; none for unstamped poses or
+  // after a gap
+  double dt = msg->header.stamp.isZero() || last_pose_stamp_.isZero()
+                  ? 0.0
+                  : (msg->header.stamp - last_pose_stamp_).toSec();
+  if (dt > 0.0 && dt <= max_extrapolation_) {
+    Eigen::Quaterniond difference = orientation * last_orientation_.conjugate();
+    if (difference.w() < 0.0) {
+      difference.coeffs() = -difference.coeffs();
+    }
+    Eigen::AngleAxisd rotation(difference);
+    Eigen::Map<CartesianSetpointTracker::Vector6d> velocity(command.velocity.data());
+    velocity.head<3>() = (position - last_position_) / dt;
+    velocity.tail<3>() = rotation.axis() * (rotation.angle() / dt);
+    command.duration = std::min(1.5 * dt, max_extrapolation_);
+  }
+  last_pose_stamp_ = msg->header.stamp;
+  last_position_ = position;
+  last_orientation_ = orientation;
+
+  command.position = {{position.x(), position.y(), position.z()}};
+  command.orientation = {{orientation.x(), orientation.y(), orientation.z(), orientation.w()}};
+  command.trace = latency_tracer_.received(event);
+  pose_target_mailbox_.writeFromNonRT(command);
+}
+
+void CartesianStreamingController::twistTargetCallback(
+    const ros::MessageEvent<geometry_msgs::TwistStamped const>& event) {
+  const geometry_msgs::TwistStampedConstPtr& msg = event.getConstMessage();
+  const auto& v = msg->twist.linear;
+  const auto& w = msg->twist.angular;
+  CartesianStreamCommand command;
+  command.velocity = {{v.x, v.y, v.z, w.x, w.y, w.z}};
+  for (double value : command.velocity) {
+    if (!std::isfinite(value)) {
+      ROS_ERROR_STREAM_THROTTLE(1.0, "CartesianStreamingController: Rejected a non-finite twist "
+                                     "target");
+      rejected_targets_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+  command.duration = max_twist_duration_;
+  command.trace = latency_tracer_.received(event);
+  twist_target_mailbox_.writeFromNonRT(command);
+}
+
+}  // namespace franka_ros_controllers
+
+PLUGINLIB_EXPORT_CLASS(franka_ros_controllers::CartesianStreamingController,
+                       controller_interface::ControllerBase)
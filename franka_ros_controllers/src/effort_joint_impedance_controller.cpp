@@ -29,6 +29,8 @@
 #include <memory>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 
@@ -38,8 +40,11 @@ namespace franka_ros_controllers {
 
 bool EffortJointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
                                            ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
   std::string arm_id;
-  if (!node_handle.getParam("/robot_config/arm_id", arm_id)) {
+  if (!arm_node_handle.getParam("robot_config/arm_id", arm_id)) {
     ROS_ERROR("EffortJointImpedanceController: Could not read parameter arm_id");
     return false;
   }
@@ -49,87 +54,38 @@ bool EffortJointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
     ROS_ERROR("EffortJointImpedanceController: Could not get Franka state interface from hardware");
     return false;
   }
-  if (!node_handle.getParam("/robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
+  if (!arm_node_handle.getParam("robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
     ROS_ERROR(
         "EffortJointImpedanceController: Invalid or no joint_names parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-  if (!node_handle.getParam("k_gains", k_gains_) || k_gains_.size() != 7) {
+  std::vector<double> k_gains;
+  if (!node_handle.getParam("k_gains", k_gains) || k_gains.size() != 7) {
     ROS_ERROR(
         "EffortJointImpedanceController:  Invalid or no k_gain parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-  if (!node_handle.getParam("d_gains", d_gains_) || d_gains_.size() != 7) {
+  std::vector<double> d_gains;
+  if (!node_handle.getParam("d_gains", d_gains) || d_gains.size() != 7) {
     ROS_ERROR(
         "EffortJointImpedanceController:  Invalid or no d_gain parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-  k_gains_target_.clear();
-  d_gains_target_.clear();
+  kernel_.setGains(k_gains, d_gains);
+  kernel_.setGainFilter(filter_params_);
+  kernel_.setMaxTorqueRate(kDeltaTauMax);
 
-  // k_gains_target_.resize(k_gains_.size());
-  // d_gains_target_.resize(d_gains_.size());
-
-  std::map<std::string, double> pos_limit_lower_map;
-  std::map<std::string, double> pos_limit_upper_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/lower", pos_limit_lower_map) ) {
-  ROS_ERROR(
-      "EffortJointImpedanceController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/upper", pos_limit_upper_map) ) {
-  ROS_ERROR(
-      "EffortJointImpedanceController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-
-
-  std::map<std::string, double> velocity_limit_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_velocity_limit", velocity_limit_map))
-  {
-    ROS_ERROR("EffortJointImpedanceController: Failed to find joint velocity limits on the param server. Aborting controller init");
+  if (!limit_checker_.init(node_handle, "EffortJointImpedanceController",
+                           JointLimitChecker::kPosition | JointLimitChecker::kVelocity)) {
     return false;
   }
 
-  for (size_t i = 0; i < joint_limits_.joint_names.size(); ++i){
-    if (pos_limit_lower_map.find(joint_limits_.joint_names[i]) != pos_limit_lower_map.end())
-      {
-        joint_limits_.position_lower.push_back(pos_limit_lower_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("EffortJointImpedanceController: Unable to find lower position limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-    if (pos_limit_upper_map.find(joint_limits_.joint_names[i]) != pos_limit_upper_map.end())
-      {
-        joint_limits_.position_upper.push_back(pos_limit_upper_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("EffortJointImpedanceController: Unable to find upper position limit  values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-    if (velocity_limit_map.find(joint_limits_.joint_names[i]) != velocity_limit_map.end())
-      {
-        joint_limits_.velocity.push_back(velocity_limit_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("EffortJointImpedanceController: Unable to find velocity limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-    // ROS_INFO_STREAM("K: "<<k_gains_target_[i]);
-  }  
-
   double controller_state_publish_rate(30.0);
   if (!node_handle.getParam("controller_state_publish_rate", controller_state_publish_rate)) {
     ROS_INFO_STREAM("EffortJointImpedanceController: Did not find controller_state_publish_rate. Using default "
@@ -141,22 +97,21 @@ bool EffortJointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
     ROS_INFO_STREAM("EffortJointImpedanceController: coriolis_factor not found. Defaulting to "
                     << coriolis_factor_);
   }
+  kernel_.law().coriolis_factor = coriolis_factor_;
 
-  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
-  if (model_interface == nullptr) {
-    ROS_ERROR_STREAM(
-        "EffortJointImpedanceController: Error getting model interface from hardware");
-    return false;
-  }
   try {
-    model_handle_ = std::make_unique<franka_hw::FrankaModelHandle>(
-        model_interface->getHandle(arm_id + "_model"));
+    model_handle_ = franka_interface::getModelCacheHandle(robot_hw, arm_id);
   } catch (hardware_interface::HardwareInterfaceException& ex) {
     ROS_ERROR_STREAM(
         "EffortJointImpedanceController: Exception getting model handle from interface: "
         << ex.what());
     return false;
   }
+  if (model_handle_ == nullptr) {
+    ROS_ERROR_STREAM(
+        "EffortJointImpedanceController: Error getting model interface from hardware");
+    return false;
+  }
 
   try {
     franka_state_handle_ = std::make_unique<franka_hw::FrankaStateHandle>(
@@ -181,14 +136,11 @@ bool EffortJointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
           "EffortJointImpedanceController: Exception getting joint handles: " << ex.what());
       return false;
     }
-
-    k_gains_target_.push_back(k_gains_[i]);
-    d_gains_target_.push_back(d_gains_[i]);
   }
 
 
   dynamic_reconfigure_controller_gains_node_ =
-      ros::NodeHandle("/franka_ros_interface/effort_joint_impedance_controller/arm/controller_parameters_config");
+      ros::NodeHandle(arm_node_handle, "franka_ros_interface/effort_joint_impedance_controller/arm/controller_parameters_config");
 
   dynamic_server_controller_config_ = std::make_unique<
       dynamic_reconfigure::Server<franka_ros_controllers::joint_controller_paramsConfig>>(
@@ -197,11 +149,24 @@ bool EffortJointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
   dynamic_server_controller_config_->setCallback(
       boost::bind(&EffortJointImpedanceController::controllerConfigCallback, this, _1, _2));
 
-  desired_joints_subscriber_ = node_handle.subscribe(
-      "/franka_ros_interface/motion_controller/arm/joint_commands", 20, &EffortJointImpedanceController::jointCmdCallback, this,
+  desired_joints_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/joint_commands", 20, &EffortJointImpedanceController::jointCmdCallback, this,
+      ros::TransportHints().reliable().tcpNoDelay());
+
+  command_chunk_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/joint_command_chunks", 20, &EffortJointImpedanceController::jointCommandChunkCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
 
-  publisher_controller_states_.init(node_handle, "/franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
+  if (!shared_command_reader_.init(node_handle, "EffortJointImpedanceController")) {
+    return false;
+  }
+  latency_tracer_.init(node_handle, "EffortJointImpedanceController");
+  command_watchdog_.init(node_handle, "EffortJointImpedanceController");
+  if (!contact_guard_.init(node_handle, "EffortJointImpedanceController")) {
+    return false;
+  }
+
+  publisher_controller_states_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
 
   {
     std::lock_guard<realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> > lock(
@@ -212,54 +177,87 @@ bool EffortJointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
 
   }
 
-  std::fill(dq_filtered_.begin(), dq_filtered_.end(), 0);
+  franka_core_msgs::JointControllerSamples samples_prototype;
+  samples_prototype.controller_name = "effort_joint_impedance_controller";
+  samples_prototype.names = joint_limits_.joint_names;
+  sample_publisher_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_samples",
+                         samples_prototype, "EffortJointImpedanceController");
 
-  for (size_t i = 0; i < 7; ++i) { // this has to be done again; apparently when the dyn callback is initialised everything is set to zeros again!?
-    k_gains_target_[i] = k_gains_[i];
-    d_gains_target_[i] = d_gains_[i];
+  // this has to be done again; apparently when the dyn callback is initialised everything is set to zeros again!?
+  kernel_.setGains(k_gains, d_gains);
+  for (size_t i = 0; i < 7; ++i) {
+    ROS_DEBUG_STREAM("EffortJointImpedanceController: Joint " << i << ": K_des "
+                     << kernel_.stiffnessTarget()[i] << ", D_des " << kernel_.dampingTarget()[i]);
   }
 
   return true;
 }
 
-void EffortJointImpedanceController::starting(const ros::Time& /*time*/) {
+void EffortJointImpedanceController::starting(const ros::Time& time) {
   franka::RobotState robot_state = franka_state_handle_->getRobotState();
 
   for (size_t i = 0; i < 7; ++i) {
     initial_pos_[i] = robot_state.q[i];
-    std::cout << "---- Joint Number: " << i  << std::endl;
-    std::cout << "Joint Pos: " << initial_pos_[i]  << std::endl;
-    std::cout << "K_des: " << k_gains_target_[i]  << std::endl;
-    std::cout << "D_des: " << d_gains_target_[i]  << std::endl;
-    std::cout << std::endl;
   }
   prev_pos_ = initial_pos_;
   pos_d_target_ = initial_pos_;
 
-  std::fill(dq_filtered_.begin(), dq_filtered_.end(), 0);
-  dq_d_ = dq_filtered_;
+  kernel_.reset();
+  dq_d_.fill(0.0);
+  joint_command_mailbox_.clear();
+  shared_command_reader_.starting();
+  command_watchdog_.starting(time);
+  trajectory_interpolator_.reset();
+  contact_guard_.starting();
 }
 
 void EffortJointImpedanceController::update(const ros::Time& time,
                                              const ros::Duration& period) {
   franka::RobotState robot_state = franka_state_handle_->getRobotState();
-  std::array<double, 7> coriolis = model_handle_->getCoriolis();
+  const std::array<double, 7>& coriolis = model_handle_->getCoriolis();
 
-  double alpha = 0.99;
-  for (size_t i = 0; i < 7; i++) {
-    dq_filtered_[i] = (1 - alpha) * dq_filtered_[i] + alpha * robot_state.dq[i];
+  JointTargetCommand command;
+  bool new_command = joint_command_mailbox_.readFromRT(command);
+  if (new_command) {
+    latency_tracer_.applied(command.trace, time);
+    command_watchdog_.commandReceived(time);
   }
-
-  std::array<double, 7> tau_d_calculated{};
-  for (size_t i = 0; i < 7; ++i) {
-    tau_d_calculated[i] = coriolis_factor_ * coriolis[i] +
-                          k_gains_[i] * (pos_d_target_[i] - robot_state.q[i]) +
-                          d_gains_[i] * (dq_d_[i] - dq_filtered_[i]);
+  franka_interface::SharedJointCommand shared_command;
+  if (shared_command_reader_.read(franka_core_msgs::JointCommand::IMPEDANCE_MODE, shared_command)) {
+    command.position = shared_command.position;
+    command.velocity = shared_command.velocity;
+    command.hold = !limit_checker_.checkPositions(command.position) ||
+                   !limit_checker_.checkVelocities(command.velocity);
+    new_command = true;
+    command_watchdog_.commandReceived(time);
+  }
+  if (new_command) {
+    if (command.hold) {
+      pos_d_target_ = prev_pos_;
+    } else {
+      pos_d_target_ = command.position;
+      dq_d_ = command.velocity;
+    }
+    // a single command takes over from a streamed trajectory
+    trajectory_interpolator_.stop();
+  }
+  trajectory_interpolator_.sample(time, pos_d_target_, dq_d_);
+  if (!trajectory_interpolator_.active() && command_watchdog_.expired(time)) {
+    // hold the last target instead of following a stale velocity
+    dq_d_.fill(0.0);
+  }
+  if (contact_guard_.check(robot_state, time)) {
+    // stop where the contact was detected, whatever is commanded
+    trajectory_interpolator_.stop();
+    pos_d_target_ = contact_guard_.contactPositions();
+    dq_d_.fill(0.0);
   }
 
   // Maximum torque difference with a sampling rate of 1 kHz. The maximum torque rate is
   // 1000 * (1 / sampling_time).
-  std::array<double, 7> tau_d_saturated = saturateTorqueRate(tau_d_calculated, robot_state.tau_J_d);
+  const std::array<double, 7>& tau_d_saturated =
+      kernel_.update(robot_state.q, robot_state.dq, pos_d_target_, dq_d_, robot_state.tau_J_d,
+                     period.toSec(), coriolis);
 
   if (trigger_publish_() && publisher_controller_states_.trylock()) {
       for (size_t i = 0; i < 7; ++i){
@@ -269,104 +267,128 @@ void EffortJointImpedanceController::update(const ros::Time& time,
         publisher_controller_states_.msg_.joint_controller_states[i].process_value_dot = robot_state.dq[i];
         publisher_controller_states_.msg_.joint_controller_states[i].error = pos_d_target_[i] - robot_state.q[i];
         publisher_controller_states_.msg_.joint_controller_states[i].time_step = period.toSec();
-        publisher_controller_states_.msg_.joint_controller_states[i].command = tau_d_calculated[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].command = kernel_.command()[i];
 
-        publisher_controller_states_.msg_.joint_controller_states[i].p = k_gains_[i];
-        publisher_controller_states_.msg_.joint_controller_states[i].d = d_gains_[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].p = kernel_.stiffness()[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].d = kernel_.damping()[i];
         publisher_controller_states_.msg_.joint_controller_states[i].header.stamp = time;
       }
+      publisher_controller_states_.msg_.overwritten_commands = joint_command_mailbox_.overwrittenCount();
 
       publisher_controller_states_.unlockAndPublish();
     }
 
-  for (size_t i = 0; i < 7; ++i) {
-    joint_handles_[i].setCommand(tau_d_saturated[i]);
-
-    prev_pos_[i] = robot_state.q[i];
-
-    k_gains_[i] = filter_params_ * k_gains_target_[i] + (1.0 - filter_params_) * k_gains_[i];
-    d_gains_[i] = filter_params_ * d_gains_target_[i] + (1.0 - filter_params_) * d_gains_[i];
-
-
-  }
-
-}
-
-bool EffortJointImpedanceController::checkPositionLimits(std::vector<double> positions)
-{
-  for (size_t i = 0;  i < 7; ++i){
-    if (!((positions[i] <= joint_limits_.position_upper[i]) && (positions[i] >= joint_limits_.position_lower[i]))){
-      return true;
+  if (sample_publisher_.enabled()) {
+    JointControllerSample sample;
+    sample.time = time.toSec();
+    sample.set_point = pos_d_target_;
+    sample.process_value = robot_state.q;
+    sample.process_value_dot = robot_state.dq;
+    for (size_t i = 0; i < 7; ++i) {
+      sample.error[i] = pos_d_target_[i] - robot_state.q[i];
+      sample.command[i] = kernel_.command()[i];
     }
+    sample_publisher_.push(sample);
   }
 
-  return false;
-}
+  for (size_t i = 0; i < 7; ++i) {
+    joint_handles_[i].setCommand(tau_d_saturated[i]);
 
-bool EffortJointImpedanceController::checkVelocityLimits(std::vector<double> velocities)
-{
-  // bool retval = true;
-  for (size_t i = 0;  i < 7; ++i){
-    if (!(abs(velocities[i]) <= joint_limits_.velocity[i])){
-      return true;
-    }
+    prev_pos_[i] = robot_state.q[i];
   }
 
-  return false;
 }
 
-std::array<double, 7> EffortJointImpedanceController::saturateTorqueRate(
-  const std::array<double, 7>& tau_d_calculated,
-    const std::array<double, 7>& tau_J_d) {  // NOLINT (readability-identifier-naming)
-  std::array<double, 7> tau_d_saturated{};
-  for (size_t i = 0; i < 7; i++) {
-    double difference = tau_d_calculated[i] - tau_J_d[i];
-    tau_d_saturated[i] = tau_J_d[i] + std::max(std::min(difference, kDeltaTauMax), -kDeltaTauMax);
-  }
-  return tau_d_saturated;
+void EffortJointImpedanceController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("EffortJointImpedanceController: " << joint_command_mailbox_.overwrittenCount()
+                  << " of " << joint_command_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied; the command timeout was exceeded "
+                  << command_watchdog_.timeouts() << " times; "
+                  << contact_guard_.contacts() << " contacts were detected; "
+                  << limit_checker_.clampedCommands() << " commands were clamped to and "
+                  << limit_checker_.rejectedCommands() << " rejected for the joint limits.");
 }
 
-void EffortJointImpedanceController::jointCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg) {
+void EffortJointImpedanceController::jointCmdCallback(
+    const ros::MessageEvent<franka_core_msgs::JointCommand const>& event) {
+  const franka_core_msgs::JointCommandConstPtr& msg = event.getConstMessage();
 
   if (msg->mode == franka_core_msgs::JointCommand::IMPEDANCE_MODE){
-    if (msg->position.size() != 7) {
+    JointTargetCommand command;
+    if (msg->position.size() != 7 || (!msg->velocity.empty() && msg->velocity.size() != 7)) {
       ROS_ERROR_STREAM(
-          "EffortJointImpedanceController: Published Commands are not of size 7");
-      pos_d_target_ = prev_pos_;
+          "EffortJointImpedanceController: Published Commands must have 7 positions and either 0 "
+          "or 7 velocities");
+      command.hold = true;
     }
-    else if (checkPositionLimits(msg->position) || checkVelocityLimits(msg->velocity)) {
-         ROS_ERROR_STREAM(
+    else {
+      std::copy_n(msg->position.begin(), 7, command.position.begin());
+      // zero target velocity for position-only commands
+      if (!msg->velocity.empty()) {
+        std::copy_n(msg->velocity.begin(), 7, command.velocity.begin());
+      }
+      if (!limit_checker_.checkPositions(command.position) ||
+          !limit_checker_.checkVelocities(command.velocity)) {
+        ROS_ERROR_STREAM(
             "EffortJointImpedanceController: Commanded positions or velicities are beyond allowed position limits.");
-        pos_d_target_ = prev_pos_;
+        command.hold = true;
+      }
+    }
+    command.trace = latency_tracer_.received(event);
+    // picked up by update(); holds the current position if the command was rejected
+    joint_command_mailbox_.writeFromNonRT(command);
+  }
+  // else ROS_ERROR_STREAM("EffortJointImpedanceController: Published Command msg are not of JointCommand::IMPEDANCE_MODE! Dropping message");
+}
 
+void EffortJointImpedanceController::jointCommandChunkCallback(
+    const franka_core_msgs::JointCommandChunkConstPtr& msg) {
+  // points beyond the limits are clamped in a copy if clamping is configured
+  franka_core_msgs::JointCommandChunk chunk = *msg;
+  for (size_t i = 0; i < chunk.points.size(); ++i) {
+    auto& point = chunk.points[i];
+    std::array<double, 7> positions{};
+    std::array<double, 7> velocities{};
+    std::copy_n(point.positions.begin(), std::min<size_t>(point.positions.size(), 7), positions.begin());
+    std::copy_n(point.velocities.begin(), std::min<size_t>(point.velocities.size(), 7), velocities.begin());
+    if (point.positions.size() == 7 && !limit_checker_.checkPositions(positions)) {
+      ROS_ERROR_STREAM("EffortJointImpedanceController: Rejected joint command chunk: positions of point " << i
+                       << " are beyond allowed position limits.");
+      return;
     }
-    else {
-      std::copy_n(msg->position.begin(), 7, pos_d_target_.begin());
-      std::copy_n(msg->velocity.begin(), 7, dq_d_.begin()); // if velocity is not there, the controller fails!!
+    if (point.velocities.size() == 7 && !limit_checker_.checkVelocities(velocities)) {
+      ROS_ERROR_STREAM("EffortJointImpedanceController: Rejected joint command chunk: velocities of point " << i
+                       << " are beyond allowed velocity limits.");
+      return;
     }
+    std::copy_n(positions.begin(), point.positions.size() == 7 ? 7 : 0, point.positions.begin());
+    std::copy_n(velocities.begin(), point.velocities.size() == 7 ? 7 : 0, point.velocities.begin());
+  }
+  std::string error;
+  if (!trajectory_interpolator_.addChunk(chunk, ros::Time::now(), error)) {
+    ROS_ERROR_STREAM("EffortJointImpedanceController: Rejected joint command chunk: " << error);
   }
-  // else ROS_ERROR_STREAM("EffortJointImpedanceController: Published Command msg are not of JointCommand::IMPEDANCE_MODE! Dropping message");
 }
 
 void EffortJointImpedanceController::controllerConfigCallback(
     franka_ros_controllers::joint_controller_paramsConfig& config,
     uint32_t /*level*/) {
     ROS_DEBUG_STREAM("EffortJointImpedanceController: Updating Config");
-    k_gains_target_[0] = config.groups.controller_gains.j1_k;
-    k_gains_target_[1] = config.groups.controller_gains.j2_k;
-    k_gains_target_[2] = config.groups.controller_gains.j3_k;
-    k_gains_target_[3] = config.groups.controller_gains.j4_k;
-    k_gains_target_[4] = config.groups.controller_gains.j5_k;
-    k_gains_target_[5] = config.groups.controller_gains.j6_k;
-    k_gains_target_[6] = config.groups.controller_gains.j7_k;
-
-    d_gains_target_[0] = config.groups.controller_gains.j1_d;
-    d_gains_target_[1] = config.groups.controller_gains.j2_d;
-    d_gains_target_[2] = config.groups.controller_gains.j3_d;
-    d_gains_target_[3] = config.groups.controller_gains.j4_d;
-    d_gains_target_[4] = config.groups.controller_gains.j5_d;
-    d_gains_target_[5] = config.groups.controller_gains.j6_d;
-    d_gains_target_[6] = config.groups.controller_gains.j7_d;
+    kernel_.stiffnessTarget()[0] = config.groups.controller_gains.j1_k;
+    kernel_.stiffnessTarget()[1] = config.groups.controller_gains.j2_k;
+    kernel_.stiffnessTarget()[2] = config.groups.controller_gains.j3_k;
+    kernel_.stiffnessTarget()[3] = config.groups.controller_gains.j4_k;
+    kernel_.stiffnessTarget()[4] = config.groups.controller_gains.j5_k;
+    kernel_.stiffnessTarget()[5] = config.groups.controller_gains.j6_k;
+    kernel_.stiffnessTarget()[6] = config.groups.controller_gains.j7_k;
+
+    kernel_.dampingTarget()[0] = config.groups.controller_gains.j1_d;
+    kernel_.dampingTarget()[1] = config.groups.controller_gains.j2_d;
+    kernel_.dampingTarget()[2] = config.groups.controller_gains.j3_d;
+    kernel_.dampingTarget()[3] = config.groups.controller_gains.j4_d;
+    kernel_.dampingTarget()[4] = config.groups.controller_gains.j5_d;
+    kernel_.dampingTarget()[5] = config.groups.controller_gains.j6_d;
+    kernel_.dampingTarget()[6] = config.groups.controller_gains.j7_d;
 
 }
 
@@ -29,6 +29,8 @@
 #include <memory>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 
@@ -38,8 +40,11 @@ namespace franka_ros_controllers {
 
 bool EffortJointPositionController::init(hardware_interface::RobotHW* robot_hw,
                                            ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
   std::string arm_id;
-  if (!node_handle.getParam("/robot_config/arm_id", arm_id)) {
+  if (!arm_node_handle.getParam("robot_config/arm_id", arm_id)) {
     ROS_ERROR("EffortJointPositionController: Could not read parameter arm_id");
     return false;
   }
@@ -49,66 +54,37 @@ bool EffortJointPositionController::init(hardware_interface::RobotHW* robot_hw,
     ROS_ERROR("EffortJointPositionController: Could not get Franka state interface from hardware");
     return false;
   }
-  if (!node_handle.getParam("/robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
+  if (!arm_node_handle.getParam("robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
     ROS_ERROR(
         "EffortJointPositionController: Invalid or no joint_names parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-  if (!node_handle.getParam("k_gains", k_gains_) || k_gains_.size() != 7) {
+  std::vector<double> k_gains;
+  if (!node_handle.getParam("k_gains", k_gains) || k_gains.size() != 7) {
     ROS_ERROR(
         "EffortJointPositionController:  Invalid or no k_gain parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-  if (!node_handle.getParam("d_gains", d_gains_) || d_gains_.size() != 7) {
+  std::vector<double> d_gains;
+  if (!node_handle.getParam("d_gains", d_gains) || d_gains.size() != 7) {
     ROS_ERROR(
         "EffortJointPositionController:  Invalid or no d_gain parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-  k_gains_target_.clear();
-  d_gains_target_.clear();
+  kernel_.setGains(k_gains, d_gains);
+  kernel_.setGainFilter(filter_params_);
+  kernel_.setMaxTorqueRate(kDeltaTauMax);
 
-
-  std::map<std::string, double> pos_limit_lower_map;
-  std::map<std::string, double> pos_limit_upper_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/lower", pos_limit_lower_map) ) {
-  ROS_ERROR(
-      "EffortJointPositionController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/upper", pos_limit_upper_map) ) {
-  ROS_ERROR(
-      "EffortJointPositionController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-
-  for (size_t i = 0; i < joint_limits_.joint_names.size(); ++i){
-    if (pos_limit_lower_map.find(joint_limits_.joint_names[i]) != pos_limit_lower_map.end())
-      {
-        joint_limits_.position_lower.push_back(pos_limit_lower_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("EffortJointPositionController: Unable to find lower position limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-    if (pos_limit_upper_map.find(joint_limits_.joint_names[i]) != pos_limit_upper_map.end())
-      {
-        joint_limits_.position_upper.push_back(pos_limit_upper_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("EffortJointPositionController: Unable to find upper position limit  values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-  }  
+  if (!limit_checker_.init(node_handle, "EffortJointPositionController",
+                           JointLimitChecker::kPosition)) {
+    return false;
+  }
 
   double controller_state_publish_rate(30.0);
   if (!node_handle.getParam("controller_state_publish_rate", controller_state_publish_rate)) {
@@ -141,12 +117,10 @@ bool EffortJointPositionController::init(hardware_interface::RobotHW* robot_hw,
           "EffortJointPositionController: Exception getting joint handles: " << ex.what());
       return false;
     }
-    k_gains_target_.push_back(k_gains_[i]);
-    d_gains_target_.push_back(d_gains_[i]);
   }
 
   dynamic_reconfigure_controller_gains_node_ =
-      ros::NodeHandle("/franka_ros_interface/effort_joint_position_controller/arm/controller_parameters_config");
+      ros::NodeHandle(arm_node_handle, "franka_ros_interface/effort_joint_position_controller/arm/controller_parameters_config");
 
   dynamic_server_controller_config_ = std::make_unique<
       dynamic_reconfigure::Server<franka_ros_controllers::joint_controller_paramsConfig>>(
@@ -155,11 +129,23 @@ bool EffortJointPositionController::init(hardware_interface::RobotHW* robot_hw,
   dynamic_server_controller_config_->setCallback(
       boost::bind(&EffortJointPositionController::controllerConfigCallback, this, _1, _2));
 
-  desired_joints_subscriber_ = node_handle.subscribe(
-      "/franka_ros_interface/motion_controller/arm/joint_commands", 20, &EffortJointPositionController::jointCmdCallback, this,
+  desired_joints_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/joint_commands", 20, &EffortJointPositionController::jointCmdCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
 
-  publisher_controller_states_.init(node_handle, "/franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
+  command_chunk_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/joint_command_chunks", 20, &EffortJointPositionController::jointCommandChunkCallback, this,
+      ros::TransportHints().reliable().tcpNoDelay());
+
+  if (!shared_command_reader_.init(node_handle, "EffortJointPositionController")) {
+    return false;
+  }
+  latency_tracer_.init(node_handle, "EffortJointPositionController");
+  if (!contact_guard_.init(node_handle, "EffortJointPositionController")) {
+    return false;
+  }
+
+  publisher_controller_states_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
 
   {
     std::lock_guard<realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> > lock(
@@ -170,10 +156,14 @@ bool EffortJointPositionController::init(hardware_interface::RobotHW* robot_hw,
 
   }
 
-  for (size_t i = 0; i < 7; ++i) { // this has to be done again; apparently when the dyn callback is initialised everything is set to zeros again!?
-    k_gains_target_[i] = k_gains_[i];
-    d_gains_target_[i] = d_gains_[i];
-  }
+  franka_core_msgs::JointControllerSamples samples_prototype;
+  samples_prototype.controller_name = "effort_joint_position_controller";
+  samples_prototype.names = joint_limits_.joint_names;
+  sample_publisher_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_samples",
+                         samples_prototype, "EffortJointPositionController");
+
+  // this has to be done again; apparently when the dyn callback is initialised everything is set to zeros again!?
+  kernel_.setGains(k_gains, d_gains);
 
   return true;
 }
@@ -186,142 +176,171 @@ void EffortJointPositionController::starting(const ros::Time& /*time*/) {
   prev_pos_ = initial_pos_;
   pos_d_target_ = initial_pos_;
 
-  std::fill(p_error_last_.begin(), p_error_last_.end(), 0);
-  d_error_ = p_error_last_;
+  kernel_.reset();
+  joint_command_mailbox_.clear();
+  shared_command_reader_.starting();
+  trajectory_interpolator_.reset();
+  contact_guard_.starting();
 }
 
 void EffortJointPositionController::update(const ros::Time& time,
                                              const ros::Duration& period) {
   franka::RobotState robot_state = franka_state_handle_->getRobotState();
 
-  std::array<double, 7> error = p_error_last_;
-  std::array<double, 7> error_dot = d_error_;
-
-  for (size_t i = 0; i < 7; i++) {
-
-    error[i] = (pos_d_target_[i] - robot_state.q[i]);
-
-    if (period.toSec() > 0.0)
-    {
-      error_dot[i] = (error[i] - p_error_last_[i]) / period.toSec();
+  JointTargetCommand command;
+  bool new_command = joint_command_mailbox_.readFromRT(command);
+  if (new_command) {
+    latency_tracer_.applied(command.trace, time);
+  }
+  franka_interface::SharedJointCommand shared_command;
+  if (shared_command_reader_.read(franka_core_msgs::JointCommand::POSITION_MODE, shared_command)) {
+    command.position = shared_command.position;
+    command.hold = !limit_checker_.checkPositions(command.position);
+    new_command = true;
+  }
+  if (new_command) {
+    if (command.hold) {
+      pos_d_target_ = prev_pos_;
+      kernel_.reset();
+    } else {
+      pos_d_target_ = command.position;
     }
-
+    // a single command takes over from a streamed trajectory
+    trajectory_interpolator_.stop();
   }
-
-  d_error_ = error_dot;
-
-  // Compute torque command using PD control law
-  std::array<double, 7> tau_d_calculated{};
-  for (size_t i = 0; i < 7; ++i) {
-
-    tau_d_calculated[i] = k_gains_[i] * error[i]  + 
-                          d_gains_[i] * d_error_[i];
-
+  // velocities are not used by the PD law, which differentiates the position error
+  std::array<double, 7> dq_d{};
+  trajectory_interpolator_.sample(time, pos_d_target_, dq_d);
+  if (contact_guard_.check(robot_state, time)) {
+    // stop where the contact was detected, whatever is commanded
+    trajectory_interpolator_.stop();
+    pos_d_target_ = contact_guard_.contactPositions();
+    dq_d.fill(0.0);
   }
 
-  p_error_last_ = error;
-
+  // Compute torque command using PD control law
   // Maximum torque difference with a sampling rate of 1 kHz. The maximum torque rate is
   // 1000 * (1 / sampling_time).
-  std::array<double, 7> tau_d_saturated = saturateTorqueRate(tau_d_calculated, robot_state.tau_J_d);
+  const std::array<double, 7>& tau_d_saturated =
+      kernel_.update(robot_state.q, robot_state.dq, pos_d_target_, dq_d, robot_state.tau_J_d,
+                     period.toSec());
 
   if (trigger_publish_() && publisher_controller_states_.trylock()) {
       for (size_t i = 0; i < 7; ++i){
 
         publisher_controller_states_.msg_.joint_controller_states[i].set_point = pos_d_target_[i];
         publisher_controller_states_.msg_.joint_controller_states[i].process_value = robot_state.q[i];
-        publisher_controller_states_.msg_.joint_controller_states[i].process_value_dot = d_error_[i];
-        publisher_controller_states_.msg_.joint_controller_states[i].error = error[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].process_value_dot = kernel_.law().error_dot[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].error = kernel_.law().error[i];
         publisher_controller_states_.msg_.joint_controller_states[i].time_step = period.toSec();
-        publisher_controller_states_.msg_.joint_controller_states[i].command = tau_d_calculated[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].command = kernel_.command()[i];
 
-        publisher_controller_states_.msg_.joint_controller_states[i].p = k_gains_[i];
-        publisher_controller_states_.msg_.joint_controller_states[i].d = d_gains_[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].p = kernel_.stiffness()[i];
+        publisher_controller_states_.msg_.joint_controller_states[i].d = kernel_.damping()[i];
         publisher_controller_states_.msg_.joint_controller_states[i].header.stamp = time;
 
       }
+      publisher_controller_states_.msg_.overwritten_commands = joint_command_mailbox_.overwrittenCount();
 
       publisher_controller_states_.unlockAndPublish();
 
     }
 
+  if (sample_publisher_.enabled()) {
+    JointControllerSample sample;
+    sample.time = time.toSec();
+    sample.set_point = pos_d_target_;
+    sample.process_value = robot_state.q;
+    for (size_t i = 0; i < 7; ++i) {
+      sample.process_value_dot[i] = kernel_.law().error_dot[i];
+      sample.error[i] = kernel_.law().error[i];
+      sample.command[i] = kernel_.command()[i];
+    }
+    sample_publisher_.push(sample);
+  }
+
   for (size_t i = 0; i < 7; ++i) {
     joint_handles_[i].setCommand(tau_d_saturated[i]);
 
     prev_pos_[i] = robot_state.q[i];
-
-    k_gains_[i] = filter_params_ * k_gains_target_[i] + (1.0 - filter_params_) * k_gains_[i];
-    d_gains_[i] = filter_params_ * d_gains_target_[i] + (1.0 - filter_params_) * d_gains_[i];
-  }
-
-}
-
-bool EffortJointPositionController::checkPositionLimits(std::vector<double> positions)
-{
-  for (size_t i = 0;  i < 7; ++i){
-    if (!((positions[i] <= joint_limits_.position_upper[i]) && (positions[i] >= joint_limits_.position_lower[i]))){
-      return true;
-    }
   }
 
-  return false;
 }
 
-std::array<double, 7> EffortJointPositionController::saturateTorqueRate(
-  const std::array<double, 7>& tau_d_calculated,
-    const std::array<double, 7>& tau_J_d) {  // NOLINT (readability-identifier-naming)
-  std::array<double, 7> tau_d_saturated{};
-  for (size_t i = 0; i < 7; i++) {
-    double difference = tau_d_calculated[i] - tau_J_d[i];
-    tau_d_saturated[i] = tau_J_d[i] + std::max(std::min(difference, kDeltaTauMax), -kDeltaTauMax);
-  }
-  return tau_d_saturated;
+void EffortJointPositionController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("EffortJointPositionController: " << joint_command_mailbox_.overwrittenCount()
+                  << " of " << joint_command_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied; "
+                  << contact_guard_.contacts() << " contacts were detected; "
+                  << limit_checker_.clampedCommands() << " commands were clamped to and "
+                  << limit_checker_.rejectedCommands() << " rejected for the joint limits.");
 }
 
-void EffortJointPositionController::jointCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg) {
+void EffortJointPositionController::jointCmdCallback(
+    const ros::MessageEvent<franka_core_msgs::JointCommand const>& event) {
+  const franka_core_msgs::JointCommandConstPtr& msg = event.getConstMessage();
 
   if (msg->mode == franka_core_msgs::JointCommand::POSITION_MODE){
+    JointTargetCommand command;
     if (msg->position.size() != 7) {
       ROS_ERROR_STREAM(
           "EffortJointPositionController: Published Commands are not of size 7");
-      pos_d_target_ = prev_pos_;
-      std::fill(p_error_last_.begin(), p_error_last_.end(), 0);
-      d_error_ = p_error_last_;
-    }
-    else if (checkPositionLimits(msg->position)) {
-         ROS_ERROR_STREAM(
-            "PositionJointPositionController: Commanded positions are beyond allowed position limits.");
-        pos_d_target_ = prev_pos_;
-        std::fill(p_error_last_.begin(), p_error_last_.end(), 0);
-        d_error_ = p_error_last_;
+      command.hold = true;
     }
     else {
-      std::copy_n(msg->position.begin(), 7, pos_d_target_.begin());
-
+      std::copy_n(msg->position.begin(), 7, command.position.begin());
+      if (!limit_checker_.checkPositions(command.position)) {
+        ROS_ERROR_STREAM(
+            "EffortJointPositionController: Commanded positions are beyond allowed position limits.");
+        command.hold = true;
+      }
     }
+    command.trace = latency_tracer_.received(event);
+    joint_command_mailbox_.writeFromNonRT(command);
   }
   // else ROS_ERROR_STREAM("EffortJointPositionController: Published Command msg are not of JointCommand::POSITION_MODE! Dropping message");
 }
 
+void EffortJointPositionController::jointCommandChunkCallback(
+    const franka_core_msgs::JointCommandChunkConstPtr& msg) {
+  // points beyond the limits are clamped in a copy if clamping is configured
+  franka_core_msgs::JointCommandChunk chunk = *msg;
+  for (size_t i = 0; i < chunk.points.size(); ++i) {
+    auto& point = chunk.points[i];
+    std::array<double, 7> positions{};
+    std::copy_n(point.positions.begin(), std::min<size_t>(point.positions.size(), 7), positions.begin());
+    if (point.positions.size() == 7 && !limit_checker_.checkPositions(positions)) {
+      ROS_ERROR_STREAM("EffortJointPositionController: Rejected joint command chunk: positions of point " << i
+                       << " are beyond allowed position limits.");
+      return;
+    }
+    std::copy_n(positions.begin(), point.positions.size() == 7 ? 7 : 0, point.positions.begin());
+  }
+  std::string error;
+  if (!trajectory_interpolator_.addChunk(chunk, ros::Time::now(), error)) {
+    ROS_ERROR_STREAM("EffortJointPositionController: Rejected joint command chunk: " << error);
+  }
+}
+
 void EffortJointPositionController::controllerConfigCallback(
     franka_ros_controllers::joint_controller_paramsConfig& config,
     uint32_t /*level*/) {
 
-    k_gains_target_[0] = config.j1_k;
-    k_gains_target_[1] = config.j2_k;
-    k_gains_target_[2] = config.j3_k;
-    k_gains_target_[3] = config.j4_k;
-    k_gains_target_[4] = config.j5_k;
-    k_gains_target_[5] = config.j6_k;
-    k_gains_target_[6] = config.j7_k;
-
-    d_gains_target_[0] = config.j1_d;
-    d_gains_target_[1] = config.j2_d;
-    d_gains_target_[2] = config.j3_d;
-    d_gains_target_[3] = config.j4_d;
-    d_gains_target_[4] = config.j5_d;
-    d_gains_target_[5] = config.j6_d;
-    d_gains_target_[6] = config.j7_d;
+    kernel_.stiffnessTarget()[0] = config.j1_k;
+    kernel_.stiffnessTarget()[1] = config.j2_k;
+    kernel_.stiffnessTarget()[2] = config.j3_k;
+    kernel_.stiffnessTarget()[3] = config.j4_k;
+    kernel_.stiffnessTarget()[4] = config.j5_k;
+    kernel_.stiffnessTarget()[5] = config.j6_k;
+    kernel_.stiffnessTarget()[6] = config.j7_k;
+
+    kernel_.dampingTarget()[0] = config.j1_d;
+    kernel_.dampingTarget()[1] = config.j2_d;
+    kernel_.dampingTarget()[2] = config.j3_d;
+    kernel_.dampingTarget()[3] = config.j4_d;
+    kernel_.dampingTarget()[4] = config.j5_d;
+    kernel_.dampingTarget()[5] = config.j6_d;
+    kernel_.dampingTarget()[6] = config.j7_d;
 
 }
 
@@ -29,6 +29,8 @@
 #include <memory>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 
@@ -36,12 +38,15 @@ namespace franka_ros_controllers {
 
 bool EffortJointTorqueController::init(hardware_interface::RobotHW* robot_hw,
                                            ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
   std::string arm_id;
-  if (!node_handle.getParam("/robot_config/arm_id", arm_id)) {
+  if (!arm_node_handle.getParam("robot_config/arm_id", arm_id)) {
     ROS_ERROR("EffortJointTorqueController: Could not read parameter arm_id");
     return false;
   }
-  if (!node_handle.getParam("/robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
+  if (!arm_node_handle.getParam("robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
     ROS_ERROR(
         "EffortJointTorqueController: Invalid or no joint_names parameters provided, aborting "
         "controller init!");
@@ -49,7 +54,7 @@ bool EffortJointTorqueController::init(hardware_interface::RobotHW* robot_hw,
   }
 
   bool enable_coriolis;
-  if (!node_handle.getParam("/franka_ros_interface/effort_joint_torque_controller/compensate_coriolis", enable_coriolis)) {
+  if (!arm_node_handle.getParam("franka_ros_interface/effort_joint_torque_controller/compensate_coriolis", enable_coriolis)) {
     ROS_ERROR("EffortJointTorqueController: Could not read parameter compensate_coriolis");
     return false;
   }
@@ -62,25 +67,11 @@ bool EffortJointTorqueController::init(hardware_interface::RobotHW* robot_hw,
     ROS_INFO_STREAM("EffortJointTorqueController: Coriolis compensation enabled!");
   }
 
-  std::map<std::string, double> torque_limit_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_effort_limit", torque_limit_map))
-  {
-    ROS_ERROR("EffortJointTorqueController: Failed to find joint effort limits on the param server. Aborting controller init");
+  if (!limit_checker_.init(node_handle, "EffortJointTorqueController",
+                           JointLimitChecker::kEffort)) {
     return false;
   }
 
-  for (size_t i = 0; i < joint_limits_.joint_names.size(); ++i){
-    if (torque_limit_map.find(joint_limits_.joint_names[i]) != torque_limit_map.end())
-      {
-        joint_limits_.effort.push_back(torque_limit_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("EffortJointTorqueController: Unable to find torque limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-  }  
-
   double controller_state_publish_rate(30.0);
   if (!node_handle.getParam("controller_state_publish_rate", controller_state_publish_rate)) {
     ROS_INFO_STREAM("EffortJointTorqueController: Did not find controller_state_publish_rate. Using default "
@@ -88,21 +79,19 @@ bool EffortJointTorqueController::init(hardware_interface::RobotHW* robot_hw,
   }
   trigger_publish_ = franka_hw::TriggerRate(controller_state_publish_rate);
 
-  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
-  if (model_interface == nullptr) {
-    ROS_ERROR_STREAM(
-        "EffortJointTorqueController: Error getting model interface from hardware");
-    return false;
-  }
   try {
-    model_handle_ = std::make_unique<franka_hw::FrankaModelHandle>(
-        model_interface->getHandle(arm_id + "_model"));
+    model_handle_ = franka_interface::getModelCacheHandle(robot_hw, arm_id);
   } catch (hardware_interface::HardwareInterfaceException& ex) {
     ROS_ERROR_STREAM(
         "EffortJointTorqueController: Exception getting model handle from interface: "
         << ex.what());
     return false;
   }
+  if (model_handle_ == nullptr) {
+    ROS_ERROR_STREAM(
+        "EffortJointTorqueController: Error getting model interface from hardware");
+    return false;
+  }
 
   auto* effort_joint_interface = robot_hw->get<hardware_interface::EffortJointInterface>();
   if (effort_joint_interface == nullptr) {
@@ -119,10 +108,16 @@ bool EffortJointTorqueController::init(hardware_interface::RobotHW* robot_hw,
       return false;
     }
   }
-  desired_joints_subscriber_ = node_handle.subscribe(
-      "/franka_ros_interface/motion_controller/arm/joint_commands", 20, &EffortJointTorqueController::jointCmdCallback, this,
+  desired_joints_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/joint_commands", 20, &EffortJointTorqueController::jointCmdCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
-  publisher_controller_states_.init(node_handle, "/franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
+  if (!shared_command_reader_.init(node_handle, "EffortJointTorqueController")) {
+    return false;
+  }
+  latency_tracer_.init(node_handle, "EffortJointTorqueController");
+  command_watchdog_.init(node_handle, "EffortJointTorqueController");
+
+  publisher_controller_states_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
 
   {
     std::lock_guard<realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> > lock(
@@ -133,20 +128,50 @@ bool EffortJointTorqueController::init(hardware_interface::RobotHW* robot_hw,
 
   }
 
+  franka_core_msgs::JointControllerSamples samples_prototype;
+  samples_prototype.controller_name = "effort_joint_torque_controller";
+  samples_prototype.names = joint_limits_.joint_names;
+  sample_publisher_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_samples",
+                         samples_prototype, "EffortJointTorqueController");
+
   return true;
 }
 
-void EffortJointTorqueController::starting(const ros::Time& /*time*/) {
+void EffortJointTorqueController::starting(const ros::Time& time) {
 
   std::fill(jnt_cmd_.begin(), jnt_cmd_.end(), 0);
   prev_jnt_cmd_ = jnt_cmd_;
+  joint_command_mailbox_.clear();
+  shared_command_reader_.starting();
+  command_watchdog_.starting(time);
   ROS_WARN_STREAM("EffortJointTorqueController: Using raw torque controller! Be extremely careful and send smooth commands.");
 }
 
 void EffortJointTorqueController::update(const ros::Time& time,
                                              const ros::Duration& period) {
   
-  std::array<double, 7> coriolis = model_handle_->getCoriolis();
+  JointTargetCommand command;
+  bool new_command = joint_command_mailbox_.readFromRT(command);
+  if (new_command) {
+    latency_tracer_.applied(command.trace, time);
+    command_watchdog_.commandReceived(time);
+  }
+  franka_interface::SharedJointCommand shared_command;
+  if (shared_command_reader_.read(franka_core_msgs::JointCommand::TORQUE_MODE, shared_command)) {
+    command.effort = shared_command.effort;
+    command.hold = !limit_checker_.checkEfforts(command.effort);
+    new_command = true;
+    command_watchdog_.commandReceived(time);
+  }
+  if (new_command) {
+    jnt_cmd_ = command.hold ? prev_jnt_cmd_ : command.effort;
+  }
+  if (command_watchdog_.expired(time)) {
+    // only gravity (and coriolis) compensation; the torque rate limit below ramps down to it
+    jnt_cmd_.fill(0.0);
+  }
+
+  const std::array<double, 7>& coriolis = model_handle_->getCoriolis();
 
   std::array<double, 7> compensated_cmd{};
   for (size_t i = 0; i < 7; ++i) {
@@ -167,11 +192,21 @@ void EffortJointTorqueController::update(const ros::Time& time,
         publisher_controller_states_.msg_.joint_controller_states[i].header.stamp = time;
 
       }
+      publisher_controller_states_.msg_.overwritten_commands = joint_command_mailbox_.overwrittenCount();
 
       publisher_controller_states_.unlockAndPublish();
 
     }
 
+  if (sample_publisher_.enabled()) {
+    JointControllerSample sample;
+    sample.time = time.toSec();
+    sample.set_point = jnt_cmd_;
+    sample.process_value = compensated_cmd;
+    sample.command = tau_d_saturated;
+    sample_publisher_.push(sample);
+  }
+
   for (size_t i = 0; i < 7; ++i) {
     joint_handles_[i].setCommand(tau_d_saturated[i]);
 
@@ -181,15 +216,13 @@ void EffortJointTorqueController::update(const ros::Time& time,
 
 }
 
-bool EffortJointTorqueController::checkTorqueLimits(std::vector<double> torques)
-{
-  for (size_t i = 0;  i < 7; ++i){
-    if (!(abs(torques[i]) < joint_limits_.effort[i])){
-      return true;
-    }
-  }
-
-  return false;
+void EffortJointTorqueController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("EffortJointTorqueController: " << joint_command_mailbox_.overwrittenCount()
+                  << " of " << joint_command_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied; the command timeout was exceeded "
+                  << command_watchdog_.timeouts() << " times; "
+                  << limit_checker_.clampedCommands() << " commands were clamped to and "
+                  << limit_checker_.rejectedCommands() << " rejected for the joint limits.");
 }
 
 std::array<double, 7> EffortJointTorqueController::saturateTorqueRate(
@@ -202,25 +235,27 @@ std::array<double, 7> EffortJointTorqueController::saturateTorqueRate(
   return tau_d_saturated;
 }
 
-void EffortJointTorqueController::jointCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg) {
+void EffortJointTorqueController::jointCmdCallback(
+    const ros::MessageEvent<franka_core_msgs::JointCommand const>& event) {
+  const franka_core_msgs::JointCommandConstPtr& msg = event.getConstMessage();
 
   if (msg->mode == franka_core_msgs::JointCommand::TORQUE_MODE){
+    JointTargetCommand command;
     if (msg->effort.size() != 7) {
       ROS_ERROR_STREAM(
           "EffortJointTorqueController: Published Commands are not of size 7");
-      std::fill(jnt_cmd_.begin(), jnt_cmd_.end(), 0);
-      jnt_cmd_= prev_jnt_cmd_;
-    }
-    else if (checkTorqueLimits(msg->effort)) {
-         ROS_ERROR_STREAM(
-            "EffortJointTorqueController: Commanded torques are beyond allowed torque limits.");
-        std::fill(jnt_cmd_.begin(), jnt_cmd_.end(), 0);
-        jnt_cmd_= prev_jnt_cmd_;
+      command.hold = true;
     }
     else {
-      std::copy_n(msg->effort.begin(), 7, jnt_cmd_.begin());
-
+      std::copy_n(msg->effort.begin(), 7, command.effort.begin());
+      if (!limit_checker_.checkEfforts(command.effort)) {
+        ROS_ERROR_STREAM(
+            "EffortJointTorqueController: Commanded torques are beyond allowed torque limits.");
+        command.hold = true;
+      }
     }
+    command.trace = latency_tracer_.received(event);
+    joint_command_mailbox_.writeFromNonRT(command);
   }
   // else ROS_ERROR_STREAM("EffortJointTorqueController: Published Command msg are not of JointCommand::TORQUE_MODE! Dropping message");
 }
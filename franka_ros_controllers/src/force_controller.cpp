@@ -6,6 +6,8 @@
 #include <memory>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 
@@ -15,11 +17,14 @@ namespace franka_ros_controllers {
 
 bool ForceController::init(hardware_interface::RobotHW* robot_hw,
                                   ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
   std::vector<std::string> joint_names;
   std::string arm_id;
 
-  force_params_ = node_handle.subscribe(
-    "/wrench_target", 20, &ForceController::forceParamCallback, this,
+  force_params_ = command_node_handle.subscribe(
+    "wrench_target", 20, &ForceController::forceParamCallback, this,
     ros::TransportHints().reliable().tcpNoDelay());
 
   ROS_WARN(
@@ -36,19 +41,17 @@ bool ForceController::init(hardware_interface::RobotHW* robot_hw,
     return false;
   }
 
-  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
-  if (model_interface == nullptr) {
-    ROS_ERROR_STREAM("ForceController: Error getting model interface from hardware");
-    return false;
-  }
   try {
-    model_handle_ = std::make_unique<franka_hw::FrankaModelHandle>(
-        model_interface->getHandle(arm_id + "_model"));
+    model_handle_ = franka_interface::getModelCacheHandle(robot_hw, arm_id);
   } catch (hardware_interface::HardwareInterfaceException& ex) {
     ROS_ERROR_STREAM(
         "ForceController: Exception getting model handle from interface: " << ex.what());
     return false;
   }
+  if (model_handle_ == nullptr) {
+    ROS_ERROR_STREAM("ForceController: Error getting model interface from hardware");
+    return false;
+  }
 
   auto* state_interface = robot_hw->get<franka_hw::FrankaStateInterface>();
   if (state_interface == nullptr) {
@@ -87,24 +90,30 @@ bool ForceController::init(hardware_interface::RobotHW* robot_hw,
 
 void ForceController::starting(const ros::Time& /*time*/) {
   franka::RobotState robot_state = state_handle_->getRobotState();
-  std::array<double, 7> gravity_array = model_handle_->getGravity();
+  const std::array<double, 7>& gravity_array = model_handle_->getGravity();
   Eigen::Map<Eigen::Matrix<double, 7, 1>> tau_measured(robot_state.tau_J.data());
-  Eigen::Map<Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
+  Eigen::Map<const Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
   // Bias correction for the current external torque
   tau_ext_initial_ = tau_measured - gravity;
   tau_error_.setZero();
+  wrench_mailbox_.clear();
 }
 
 void ForceController::update(const ros::Time& /*time*/, const ros::Duration& period) {
   franka::RobotState robot_state = state_handle_->getRobotState();
-  std::array<double, 42> jacobian_array =
+  const std::array<double, 42>& jacobian_array =
       model_handle_->getZeroJacobian(franka::Frame::kEndEffector);
-  std::array<double, 7> gravity_array = model_handle_->getGravity();
-  Eigen::Map<Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
+  const std::array<double, 7>& gravity_array = model_handle_->getGravity();
+  Eigen::Map<const Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> tau_measured(robot_state.tau_J.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> tau_J_d(  // NOLINT (readability-identifier-naming)
       robot_state.tau_J_d.data());
-  Eigen::Map<Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
+  Eigen::Map<const Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
+
+  std::array<double, 6> wrench;
+  if (wrench_mailbox_.readFromRT(wrench)) {
+    target_mass_ = Eigen::Map<const Eigen::Matrix<double, 6, 1>>(wrench.data());
+  }
 
   Eigen::VectorXd tau_d(7), desired_force_torque(6), tau_cmd(7), tau_ext(7);
   desired_force_torque.setZero();
@@ -129,15 +138,17 @@ void ForceController::update(const ros::Time& /*time*/, const ros::Duration& per
   k_i_ = filter_gain_ * target_k_i_ + (1 - filter_gain_) * k_i_;
 }
 
+void ForceController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("ForceController: " << wrench_mailbox_.overwrittenCount()
+                  << " of " << wrench_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied.");
+}
+
 void ForceController::forceParamCallback(
      const geometry_msgs::Wrench& msg) {
 
-  target_mass_(0) = msg.force.x;
-  target_mass_(1) = msg.force.y;
-  target_mass_(2) = msg.force.z;
-  target_mass_(3) = msg.torque.x;
-  target_mass_(4) = msg.torque.y;
-  target_mass_(5) = msg.torque.z;
+  wrench_mailbox_.writeFromNonRT(
+      {{msg.force.x, msg.force.y, msg.force.z, msg.torque.x, msg.torque.y, msg.torque.z}});
 }
 
 
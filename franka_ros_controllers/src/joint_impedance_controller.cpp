@@ -6,6 +6,8 @@
 #include <memory>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 
@@ -15,6 +17,9 @@ namespace franka_ros_controllers {
 
 bool JointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
                                            ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
   std::string arm_id;
   if (!node_handle.getParam("arm_id", arm_id)) {
     ROS_ERROR("JointImpedanceController: Could not read parameter arm_id");
@@ -46,52 +51,28 @@ bool JointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
     return false;
   }
 
-  std::map<std::string, double> pos_limit_lower_map;
-  std::map<std::string, double> pos_limit_upper_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/lower", pos_limit_lower_map) ) {
-  ROS_ERROR("PositionJointPositionController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/upper", pos_limit_upper_map) ) {
-  ROS_ERROR("PositionJointPositionController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-  for (size_t i = 0; i < joint_limits_.joint_names.size(); ++i){
-    if (pos_limit_lower_map.find(joint_limits_.joint_names[i]) != pos_limit_lower_map.end())
-      {
-        joint_limits_.position_lower.push_back(pos_limit_lower_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("PositionJointPositionController: Unable to find lower position limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-    if (pos_limit_upper_map.find(joint_limits_.joint_names[i]) != pos_limit_upper_map.end())
-      {
-        joint_limits_.position_upper.push_back(pos_limit_upper_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("PositionJointPositionController: Unable to find upper position limit  values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-  } 
-
-  if (!node_handle.getParam("k_gains", k_gains_) || k_gains_.size() != 7) {
+  if (!limit_checker_.init(node_handle, "JointImpedanceController",
+                           JointLimitChecker::kPosition | JointLimitChecker::kVelocity)) {
+    return false;
+  }
+
+  std::vector<double> k_gains;
+  if (!node_handle.getParam("k_gains", k_gains) || k_gains.size() != 7) {
     ROS_ERROR(
         "JointImpedanceController:  Invalid or no k_gain parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-  if (!node_handle.getParam("d_gains", d_gains_) || d_gains_.size() != 7) {
+  std::vector<double> d_gains;
+  if (!node_handle.getParam("d_gains", d_gains) || d_gains.size() != 7) {
     ROS_ERROR(
         "JointImpedanceController:  Invalid or no d_gain parameters provided, aborting "
         "controller init!");
     return false;
   }
+  kernel_.setGains(k_gains, d_gains);
+  kernel_.setMaxTorqueRate(kDeltaTauMax);
 
   double publish_rate(30.0);
   if (!node_handle.getParam("publish_rate", publish_rate)) {
@@ -104,22 +85,21 @@ bool JointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
     ROS_INFO_STREAM("JointImpedanceController: coriolis_factor not found. Defaulting to "
                     << coriolis_factor_);
   }
+  kernel_.law().coriolis_factor = coriolis_factor_;
 
-  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
-  if (model_interface == nullptr) {
-    ROS_ERROR_STREAM(
-        "JointImpedanceController: Error getting model interface from hardware");
-    return false;
-  }
   try {
-    model_handle_ = std::make_unique<franka_hw::FrankaModelHandle>(
-        model_interface->getHandle(arm_id + "_model"));
+    model_handle_ = franka_interface::getModelCacheHandle(robot_hw, arm_id);
   } catch (hardware_interface::HardwareInterfaceException& ex) {
     ROS_ERROR_STREAM(
         "JointImpedanceController: Exception getting model handle from interface: "
         << ex.what());
     return false;
   }
+  if (model_handle_ == nullptr) {
+    ROS_ERROR_STREAM(
+        "JointImpedanceController: Error getting model interface from hardware");
+    return false;
+  }
 
   auto* cartesian_pose_interface = robot_hw->get<franka_hw::FrankaPoseCartesianInterface>();
   if (cartesian_pose_interface == nullptr) {
@@ -153,16 +133,16 @@ bool JointImpedanceController::init(hardware_interface::RobotHW* robot_hw,
     }
   }
   torques_publisher_.init(node_handle, "torque_comparison", 1);
+  torque_sample_publisher_.init(node_handle, "torque_comparison_samples", JointTorqueComparisonSamples(),
+                                "JointImpedanceController");
 
-  desired_joints_subscriber_ = node_handle.subscribe(
-      "/joint_impedance_position_velocity", 20, &JointImpedanceController::jointCmdCallback, this,
+  desired_joints_subscriber_ = command_node_handle.subscribe(
+      "joint_impedance_position_velocity", 20, &JointImpedanceController::jointCmdCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
-  stiffness_params_ = node_handle.subscribe(
-      "/joint_impedance_stiffness", 20, &JointImpedanceController::stiffnessParamCallback, this,
+  stiffness_params_ = arm_node_handle.subscribe(
+      "joint_impedance_stiffness", 20, &JointImpedanceController::stiffnessParamCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
 
-  std::fill(dq_filtered_.begin(), dq_filtered_.end(), 0);
-
   return true;
 }
 
@@ -177,11 +157,12 @@ void JointImpedanceController::starting(const ros::Time& /*time*/) {
   prev_pos_ = initial_pos_;
   pos_d_target_ = initial_pos_;
 
-  std::fill(dq_filtered_.begin(), dq_filtered_.end(), 0);
-  dq_d_ = dq_filtered_;
+  kernel_.reset();
+  dq_d_.fill(0.0);
+  joint_command_mailbox_.clear();
 }
 
-void JointImpedanceController::update(const ros::Time& /*time*/,
+void JointImpedanceController::update(const ros::Time& time,
                                              const ros::Duration& period) {
   /*if (vel_current_ < vel_max_) {
     vel_current_ += period.toSec() * std::fabs(vel_max_ / acceleration_time_);
@@ -202,28 +183,32 @@ void JointImpedanceController::update(const ros::Time& /*time*/,
   cartesian_pose_handle_->setCommand(pose_desired);
 
   franka::RobotState robot_state = cartesian_pose_handle_->getRobotState();
-  std::array<double, 7> coriolis = model_handle_->getCoriolis();
-  std::array<double, 7> gravity = model_handle_->getGravity();
+  const std::array<double, 7>& coriolis = model_handle_->getCoriolis();
+  const std::array<double, 7>& gravity = model_handle_->getGravity();
 
-  double alpha = 0.99;
-  for (size_t i = 0; i < 7; i++) {
-    dq_filtered_[i] = (1 - alpha) * dq_filtered_[i] + alpha * robot_state.dq[i];
+  JointTargetCommand command;
+  if (joint_command_mailbox_.readFromRT(command)) {
+    if (command.hold) {
+      pos_d_target_ = prev_pos_;
+    } else {
+      pos_d_target_ = command.position;
+      dq_d_ = command.velocity;
+    }
   }
-
-  std::array<double, 7> tau_d_calculated;
-  for (size_t i = 0; i < 7; ++i) {
-    //tau_d_calculated[i] = coriolis_factor_ * coriolis[i] +
-    //                      k_gains_[i] * (robot_state.q_d[i] - robot_state.q[i]) +
-    //                      d_gains_[i] * (robot_state.dq_d[i] - dq_filtered_[i]);
-    tau_d_calculated[i] = coriolis_factor_ * coriolis[i] +
-                          k_gains_[i] * (pos_d_target_[i] - robot_state.q[i]) +
-                          d_gains_[i] * (dq_d_[i] - dq_filtered_[i]);
-    
+  std::array<double, 7> stiffness;
+  if (stiffness_mailbox_.readFromRT(stiffness)) {
+    std::array<double, 7> damping;
+    for (size_t i = 0; i < 7; ++i) {
+      damping[i] = 2.0 * sqrt(stiffness[i]);
+    }
+    kernel_.setGains(stiffness, damping);
   }
 
   // Maximum torque difference with a sampling rate of 1 kHz. The maximum torque rate is
   // 1000 * (1 / sampling_time).
-  std::array<double, 7> tau_d_saturated = saturateTorqueRate(tau_d_calculated, robot_state.tau_J_d);
+  const std::array<double, 7>& tau_d_saturated =
+      kernel_.update(robot_state.q, robot_state.dq, pos_d_target_, dq_d_, robot_state.tau_J_d,
+                     period.toSec(), coriolis);
 
   for (size_t i = 0; i < 7; ++i) {
     joint_handles_[i].setCommand(tau_d_saturated[i]);
@@ -246,44 +231,25 @@ void JointImpedanceController::update(const ros::Time& /*time*/,
     }
     torques_publisher_.unlockAndPublish();
   }
+  if (torque_sample_publisher_.enabled()) {
+    JointTorqueComparisonSample sample;
+    sample.time = time.toSec();
+    sample.tau_commanded = last_tau_d_;
+    sample.tau_measured = robot_state.tau_J;
+    torque_sample_publisher_.push(sample);
+  }
 
   for (size_t i = 0; i < 7; ++i) {
     last_tau_d_[i] = tau_d_saturated[i] + gravity[i];
   }
 }
 
-std::array<double, 7> JointImpedanceController::saturateTorqueRate(
-    const std::array<double, 7>& tau_d_calculated,
-    const std::array<double, 7>& tau_J_d) {  // NOLINT (readability-identifier-naming)
-  std::array<double, 7> tau_d_saturated{};
-  for (size_t i = 0; i < 7; i++) {
-    double difference = tau_d_calculated[i] - tau_J_d[i];
-    tau_d_saturated[i] = tau_J_d[i] + std::max(std::min(difference, kDeltaTauMax), -kDeltaTauMax);
-  }
-  return tau_d_saturated;
-}
-
-bool JointImpedanceController::checkPositionLimits(std::vector<double> positions) {
-  return false;
-  for (size_t i = 0;  i < 7; ++i){ 
-    if (!((positions[i] <= joint_limits_.position_upper[i]) && (positions[i] >= joint_limits_.position_lower[i]))){
-      return true; //. if i set this to false, then it works. so something outside limits? doesnt seem so..;
-      // if i print the joint limits, similarly errors so it seems to be relating to reading the limit?
-    }
-  }
-
-  return false;
-}
-
-bool JointImpedanceController::checkVelocityLimits(std::vector<double> velocities) {
-  // bool retval = true;
-  for (size_t i = 0;  i < 7; ++i){
-    if (!(abs(velocities[i]) <= joint_limits_.velocity[i])){
-      return true;
-    }
-  }
-
-  return false;
+void JointImpedanceController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("JointImpedanceController: " << joint_command_mailbox_.overwrittenCount()
+                  << " of " << joint_command_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied; "
+                  << limit_checker_.clampedCommands() << " commands were clamped to and "
+                  << limit_checker_.rejectedCommands() << " rejected for the joint limits.");
 }
 
 void JointImpedanceController::jointCmdCallback(const franka_core_msgs::JICmd& msg) {
@@ -298,23 +264,34 @@ void JointImpedanceController::jointCmdCallback(const franka_core_msgs::JICmd& m
       std::copy_n(msg->position.begin(), 7, pos_d_target_.begin());
       std::copy_n(msg->velocity.begin(), 7, dq_d_.begin()); // if velocity is not there, the controller fails!!
     }*/
-  //TODO want to add back in position and velocity limit checks
-  checkPositionLimits(msg.position);
-  for (size_t i = 0;  i < 7; ++i){
-      pos_d_target_[i] = msg.position[i];
-  }
-  for (size_t i = 0;  i < 7; ++i){
-      dq_d_[i] = msg.velocity[i];
+  JointTargetCommand command;
+  if (msg.position.size() != 7 || msg.velocity.size() != 7) {
+    ROS_ERROR_STREAM("JointImpedanceController: Published Commands are not of size 7");
+    command.hold = true;
+  } else {
+    std::copy_n(msg.position.begin(), 7, command.position.begin());
+    std::copy_n(msg.velocity.begin(), 7, command.velocity.begin());
+    if (!limit_checker_.checkPositions(command.position) ||
+        !limit_checker_.checkVelocities(command.velocity)) {
+      ROS_ERROR_STREAM(
+          "JointImpedanceController: Commanded positions or velocities are beyond allowed limits.");
+      command.hold = true;
+    }
   }
+  joint_command_mailbox_.writeFromNonRT(command);
 }
 
 void JointImpedanceController::stiffnessParamCallback(
      const franka_core_msgs::JointImpedanceStiffness& msg) {
 
-  for (size_t i = 0;  i < 7; ++i){
-      k_gains_[i] = msg.stiffness[i];
-      d_gains_[i] = 2.0 * sqrt(msg.stiffness[i]);
-  }  
+  if (msg.stiffness.size() != 7) {
+    ROS_ERROR_STREAM("JointImpedanceController: Published stiffness is not of size 7");
+    return;
+  }
+  std::array<double, 7> stiffness;
+  std::copy_n(msg.stiffness.begin(), 7, stiffness.begin());
+  // gains are applied by update() so that all joints change in the same cycle
+  stiffness_mailbox_.writeFromNonRT(stiffness);
 
 }
 
@@ -6,6 +6,8 @@
 #include <memory>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 
@@ -15,11 +17,14 @@ namespace franka_ros_controllers {
 
 bool NTorqueController::init(hardware_interface::RobotHW* robot_hw,
                                   ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
   std::vector<std::string> joint_names;
   std::string arm_id;
 
-  torque_params_ = node_handle.subscribe(
-    "/torque_target", 20, &NTorqueController::torqueParamCallback, this,
+  torque_params_ = command_node_handle.subscribe(
+    "torque_target", 20, &NTorqueController::torqueParamCallback, this,
     ros::TransportHints().reliable().tcpNoDelay());
 
   ROS_WARN(
@@ -38,44 +43,29 @@ bool NTorqueController::init(hardware_interface::RobotHW* robot_hw,
 
 
 
-  if (!node_handle.getParam("/robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
+  if (!arm_node_handle.getParam("robot_config/joint_names", joint_limits_.joint_names) || joint_limits_.joint_names.size() != 7) {
     ROS_ERROR(
         "TorqueController: Invalid or no joint_names parameters provided, aborting "
         "controller init!");
     return false;
   }
 
-
-  std::map<std::string, double> torque_limit_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_effort_limit", torque_limit_map))
-  {
-    ROS_ERROR("TorqueController: Failed to find joint effort limits on the param server. Aborting controller init");
+  if (!limit_checker_.init(node_handle, "NTorqueController",
+                           JointLimitChecker::kEffort)) {
     return false;
   }
 
-
-  for (size_t i = 0; i < joint_limits_.joint_names.size(); ++i){
-    if (torque_limit_map.find(joint_limits_.joint_names[i]) != torque_limit_map.end()) {
-        joint_limits_.effort.push_back(torque_limit_map[joint_limits_.joint_names[i]]);
-    } else {
-        ROS_ERROR("TorqueController: Unable to find torque limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-  }
-
-  auto* model_interface = robot_hw->get<franka_hw::FrankaModelInterface>();
-  if (model_interface == nullptr) {
-    ROS_ERROR_STREAM("TorqueController: Error getting model interface from hardware");
-    return false;
-  }
   try {
-    model_handle_ = std::make_unique<franka_hw::FrankaModelHandle>(
-        model_interface->getHandle(arm_id + "_model"));
+    model_handle_ = franka_interface::getModelCacheHandle(robot_hw, arm_id);
   } catch (hardware_interface::HardwareInterfaceException& ex) {
     ROS_ERROR_STREAM(
         "TorqueController: Exception getting model handle from interface: " << ex.what());
     return false;
   }
+  if (model_handle_ == nullptr) {
+    ROS_ERROR_STREAM("TorqueController: Error getting model interface from hardware");
+    return false;
+  }
 
   auto* state_interface = robot_hw->get<franka_hw::FrankaStateInterface>();
   if (state_interface == nullptr) {
@@ -115,24 +105,30 @@ bool NTorqueController::init(hardware_interface::RobotHW* robot_hw,
 
 void NTorqueController::starting(const ros::Time& /*time*/) {
   franka::RobotState robot_state = state_handle_->getRobotState();
-  std::array<double, 7> gravity_array = model_handle_->getGravity();
+  const std::array<double, 7>& gravity_array = model_handle_->getGravity();
   Eigen::Map<Eigen::Matrix<double, 7, 1>> tau_measured(robot_state.tau_J.data());
-  Eigen::Map<Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
+  Eigen::Map<const Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
   // Bias correction for the current external torque
   tau_ext_initial_ = tau_measured - gravity;
   tau_error_.setZero();
+  torque_mailbox_.clear();
 }
 
 void NTorqueController::update(const ros::Time& /*time*/, const ros::Duration& period) {
   franka::RobotState robot_state = state_handle_->getRobotState();
-  std::array<double, 42> jacobian_array =
+  const std::array<double, 42>& jacobian_array =
       model_handle_->getZeroJacobian(franka::Frame::kEndEffector);
-  std::array<double, 7> gravity_array = model_handle_->getGravity();
-  Eigen::Map<Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
+  const std::array<double, 7>& gravity_array = model_handle_->getGravity();
+  Eigen::Map<const Eigen::Matrix<double, 6, 7>> jacobian(jacobian_array.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> tau_measured(robot_state.tau_J.data());
   Eigen::Map<Eigen::Matrix<double, 7, 1>> tau_J_d(  // NOLINT (readability-identifier-naming)
       robot_state.tau_J_d.data());
-  Eigen::Map<Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
+  Eigen::Map<const Eigen::Matrix<double, 7, 1>> gravity(gravity_array.data());
+
+  JointTargetCommand command;
+  if (torque_mailbox_.readFromRT(command)) {
+    target_torque_ = Eigen::Map<const Eigen::Matrix<double, 7, 1>>(command.effort.data());
+  }
 
   Eigen::VectorXd tau_cmd(7);
 
@@ -146,35 +142,33 @@ void NTorqueController::update(const ros::Time& /*time*/, const ros::Duration& p
   desired_torque_ = filter_gain_ * target_torque_ + (1 - filter_gain_) * desired_torque_;
 }
 
+void NTorqueController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("TorqueController: " << torque_mailbox_.overwrittenCount()
+                  << " of " << torque_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied; "
+                  << limit_checker_.clampedCommands() << " commands were clamped to and "
+                  << limit_checker_.rejectedCommands() << " rejected for the joint limits.");
+}
+
 void NTorqueController::torqueParamCallback(
      const franka_core_msgs::TorqueCmdConstPtr& msg) {
 
   if (msg->torque.size() != 7) {
       ROS_ERROR_STREAM("TorqueController: Published Commands are not of size 7");
+      return;
   }
-  else if (checkTorqueLimits(msg->torque)) {
-      ROS_ERROR_STREAM("TorqueController: Commanded positions or velicities are beyond allowed position limits.");
+  JointTargetCommand command;
+  std::copy_n(msg->torque.begin(), 7, command.effort.begin());
+  if (!limit_checker_.checkEfforts(command.effort)) {
+      ROS_ERROR_STREAM("TorqueController: Commanded torques are beyond allowed torque limits.");
   }
   else {
-      for (size_t i = 0; i < 7; ++i) {
-          target_torque_(i) = msg->torque[i];
-      }
+      torque_mailbox_.writeFromNonRT(command);
       //target_torque_ = msg->torque;
       //std::copy_n(msg->torque.begin(), 7, target_torque_);
   }
 }
 
-bool NTorqueController::checkTorqueLimits(std::vector<double> torques)
-{
-  for (size_t i = 0;  i < 7; ++i){
-    if (!(abs(torques[i]) < joint_limits_.effort[i])){
-      return true;
-    }
-  }
-
-  return false;
-}
-
 Eigen::Matrix<double, 7, 1> NTorqueController::saturateTorqueRate(
     const Eigen::Matrix<double, 7, 1>& tau_d_calculated,
     const Eigen::Matrix<double, 7, 1>& tau_J_d) {  // NOLINT (readability-identifier-naming)
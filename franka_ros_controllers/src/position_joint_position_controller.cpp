@@ -28,6 +28,8 @@
 #include <cmath>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <hardware_interface/hardware_interface.h>
 #include <hardware_interface/joint_command_interface.h>
 #include <pluginlib/class_list_macros.h>
@@ -38,9 +40,12 @@ namespace franka_ros_controllers {
 
 bool PositionJointPositionController::init(hardware_interface::RobotHW* robot_hardware,
                                           ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
 
-  desired_joints_subscriber_ = node_handle.subscribe(
-      "/franka_ros_interface/motion_controller/arm/joint_commands", 20, &PositionJointPositionController::jointPosCmdCallback, this,
+  desired_joints_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/joint_commands", 20, &PositionJointPositionController::jointPosCmdCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
 
   position_joint_interface_ = robot_hardware->get<hardware_interface::PositionJointInterface>();
@@ -49,7 +54,7 @@ bool PositionJointPositionController::init(hardware_interface::RobotHW* robot_ha
         "PositionJointPositionController: Error getting position joint interface from hardware!");
     return false;
   }
-  if (!node_handle.getParam("/robot_config/joint_names", joint_limits_.joint_names)) {
+  if (!arm_node_handle.getParam("robot_config/joint_names", joint_limits_.joint_names)) {
     ROS_ERROR("PositionJointPositionController: Could not parse joint names");
   }
   if (joint_limits_.joint_names.size() != 7) {
@@ -57,41 +62,11 @@ bool PositionJointPositionController::init(hardware_interface::RobotHW* robot_ha
                      << joint_limits_.joint_names.size() << " instead of 7 names!");
     return false;
   }
-  std::map<std::string, double> pos_limit_lower_map;
-  std::map<std::string, double> pos_limit_upper_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/lower", pos_limit_lower_map) ) {
-  ROS_ERROR(
-      "PositionJointPositionController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-  if (!node_handle.getParam("/robot_config/joint_config/joint_position_limit/upper", pos_limit_upper_map) ) {
-  ROS_ERROR(
-      "PositionJointPositionController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
 
-  for (size_t i = 0; i < joint_limits_.joint_names.size(); ++i){
-    if (pos_limit_lower_map.find(joint_limits_.joint_names[i]) != pos_limit_lower_map.end())
-      {
-        joint_limits_.position_lower.push_back(pos_limit_lower_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("PositionJointPositionController: Unable to find lower position limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-    if (pos_limit_upper_map.find(joint_limits_.joint_names[i]) != pos_limit_upper_map.end())
-      {
-        joint_limits_.position_upper.push_back(pos_limit_upper_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("PositionJointPositionController: Unable to find upper position limit  values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-  }  
+  if (!limit_checker_.init(node_handle, "PositionJointPositionController",
+                           JointLimitChecker::kPosition)) {
+    return false;
+  }
 
   position_joint_handles_.resize(7);
   for (size_t i = 0; i < 7; ++i) {
@@ -112,7 +87,7 @@ bool PositionJointPositionController::init(hardware_interface::RobotHW* robot_ha
   trigger_publish_ = franka_hw::TriggerRate(controller_state_publish_rate);
 
   dynamic_reconfigure_joint_controller_params_node_ =
-      ros::NodeHandle("/franka_ros_interface/position_joint_position_controller/arm/controller_parameters_config");
+      ros::NodeHandle(arm_node_handle, "franka_ros_interface/position_joint_position_controller/arm/controller_parameters_config");
 
   dynamic_server_joint_controller_params_ = std::make_unique<
       dynamic_reconfigure::Server<franka_ros_controllers::joint_controller_paramsConfig>>(
@@ -121,7 +96,12 @@ bool PositionJointPositionController::init(hardware_interface::RobotHW* robot_ha
   dynamic_server_joint_controller_params_->setCallback(
       boost::bind(&PositionJointPositionController::jointControllerParamCallback, this, _1, _2));
 
-  publisher_controller_states_.init(node_handle, "/franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
+  if (!shared_command_reader_.init(node_handle, "PositionJointPositionController")) {
+    return false;
+  }
+  latency_tracer_.init(node_handle, "PositionJointPositionController");
+
+  publisher_controller_states_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
 
   {
     std::lock_guard<realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> > lock(
@@ -132,6 +112,12 @@ bool PositionJointPositionController::init(hardware_interface::RobotHW* robot_ha
 
   }
 
+  franka_core_msgs::JointControllerSamples samples_prototype;
+  samples_prototype.controller_name = "position_joint_position_controller";
+  samples_prototype.names = joint_limits_.joint_names;
+  sample_publisher_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_samples",
+                         samples_prototype, "PositionJointPositionController");
+
   return true;
 }
 
@@ -142,10 +128,35 @@ void PositionJointPositionController::starting(const ros::Time& /* time */) {
   pos_d_ = initial_pos_;
   prev_pos_ = initial_pos_;
   pos_d_target_ = initial_pos_;
+  limit_checker_.resetSetpoints(initial_pos_, std::array<double, 7>{});
+  joint_command_mailbox_.clear();
+  shared_command_reader_.starting();
 }
 
 void PositionJointPositionController::update(const ros::Time& time,
                                             const ros::Duration& period) {
+  JointTargetCommand command;
+  bool new_command = joint_command_mailbox_.readFromRT(command);
+  if (new_command) {
+    latency_tracer_.applied(command.trace, time);
+  }
+  franka_interface::SharedJointCommand shared_command;
+  if (shared_command_reader_.read(franka_core_msgs::JointCommand::POSITION_MODE, shared_command)) {
+    command.position = shared_command.position;
+    command.hold = !limit_checker_.checkPositions(command.position);
+    new_command = true;
+  }
+  if (new_command) {
+    if (command.hold) {
+      pos_d_ = prev_pos_;
+      pos_d_target_ = prev_pos_;
+    } else {
+      pos_d_target_ = command.position;
+    }
+  }
+
+  // a rejected command or a jump of the target must not make the setpoint jump
+  limit_checker_.limitPositionSetpoint(pos_d_, period.toSec());
   for (size_t i = 0; i < 7; ++i) {
     position_joint_handles_[i].setCommand(pos_d_[i]);
   }
@@ -165,48 +176,55 @@ void PositionJointPositionController::update(const ros::Time& time,
       publisher_controller_states_.msg_.joint_controller_states[i].header.stamp = time;
 
     }
+    publisher_controller_states_.msg_.overwritten_commands = joint_command_mailbox_.overwrittenCount();
 
     publisher_controller_states_.unlockAndPublish();        
   }
 
+  if (sample_publisher_.enabled()) {
+    JointControllerSample sample;
+    sample.time = time.toSec();
+    sample.set_point = pos_d_target_;
+    sample.process_value = pos_d_;
+    sample_publisher_.push(sample);
+  }
+
   // update parameters changed online either through dynamic reconfigure or through the interactive
   // target by filtering
   filter_joint_pos_ = param_change_filter_ * target_filter_joint_pos_ + (1.0 - param_change_filter_) * filter_joint_pos_;
 
 }
 
-bool PositionJointPositionController::checkPositionLimits(std::vector<double> positions)
-{
-  // bool retval = true;
-  for (size_t i = 0;  i < 7; ++i){
-    if (!((positions[i] <= joint_limits_.position_upper[i]) && (positions[i] >= joint_limits_.position_lower[i]))){
-      return true;
-    }
-  }
-
-  return false;
+void PositionJointPositionController::stopping(const ros::Time& /*time*/) {
+  ROS_INFO_STREAM("PositionJointPositionController: " << joint_command_mailbox_.overwrittenCount()
+                  << " of " << joint_command_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied; "
+                  << limit_checker_.clampedCommands() << " commands were clamped to and "
+                  << limit_checker_.rejectedCommands() << " rejected for the joint limits; the "
+                  << "setpoint was limited in " << limit_checker_.limitedSetpoints() << " cycles.");
 }
 
-void PositionJointPositionController::jointPosCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg) {
+void PositionJointPositionController::jointPosCmdCallback(
+    const ros::MessageEvent<franka_core_msgs::JointCommand const>& event) {
+    const franka_core_msgs::JointCommandConstPtr& msg = event.getConstMessage();
 
     if (msg->mode == franka_core_msgs::JointCommand::POSITION_MODE){
+      JointTargetCommand command;
       if (msg->position.size() != 7) {
         ROS_ERROR_STREAM(
             "PositionJointPositionController: Published Commands are not of size 7");
-        pos_d_ = prev_pos_;
-        pos_d_target_ = prev_pos_;
-      }
-      else if (checkPositionLimits(msg->position)) {
-         ROS_ERROR_STREAM(
-            "PositionJointPositionController: Commanded positions are beyond allowed position limits.");
-        pos_d_ = prev_pos_;
-        pos_d_target_ = prev_pos_;
-
+        command.hold = true;
       }
-      else
-      {
-        std::copy_n(msg->position.begin(), 7, pos_d_target_.begin());
+      else {
+        std::copy_n(msg->position.begin(), 7, command.position.begin());
+        if (!limit_checker_.checkPositions(command.position)) {
+          ROS_ERROR_STREAM(
+              "PositionJointPositionController: Commanded positions are beyond allowed position limits.");
+          command.hold = true;
+        }
       }
+      command.trace = latency_tracer_.received(event);
+      joint_command_mailbox_.writeFromNonRT(command);
       
     }
     // else ROS_ERROR_STREAM("PositionJointPositionController: Published Command msg are not of JointCommand::POSITION_MODE! Dropping message");
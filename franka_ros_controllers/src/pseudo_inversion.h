@@ -4,6 +4,8 @@
 // pseudo_inverse() computes the pseudo inverse of matrix M_ using SVD decomposition (can choose
 // between damped and not)
 // returns the pseudo inverted matrix M_pinv_
+// The templated overload does the same for fixed-size matrices without any heap allocation so
+// that it can be used in the control loop.
 
 #pragma once
 
@@ -24,3 +26,25 @@ inline void pseudoInverse(const Eigen::MatrixXd& M_, Eigen::MatrixXd& M_pinv_, b
 
   M_pinv_ = Eigen::MatrixXd(svd.matrixV() * S_.transpose() * svd.matrixU().transpose());
 }
+
+template <typename Derived>
+inline void pseudoInverse(
+    const Eigen::MatrixBase<Derived>& M_,
+    Eigen::Matrix<double, Derived::ColsAtCompileTime, Derived::RowsAtCompileTime>& M_pinv_,
+    bool damped = true) {
+  EIGEN_STATIC_ASSERT_FIXED_SIZE(Derived);
+  constexpr int kRows = Derived::RowsAtCompileTime;
+  constexpr int kCols = Derived::ColsAtCompileTime;
+  constexpr int kDiag = kRows < kCols ? kRows : kCols;
+  double lambda_ = damped ? 0.2 : 0.0;
+
+  Eigen::JacobiSVD<Eigen::Matrix<double, kRows, kCols>> svd(M_, Eigen::ComputeFullU |
+                                                                    Eigen::ComputeFullV);
+  // only the first kDiag columns of U and V contribute, so S_ is applied as a diagonal
+  Eigen::Matrix<double, kDiag, 1> sing_vals_inv_ =
+      svd.singularValues().array() /
+      (svd.singularValues().array().square() + lambda_ * lambda_);
+
+  M_pinv_.noalias() = svd.matrixV().template leftCols<kDiag>() * sing_vals_inv_.asDiagonal() *
+                      svd.matrixU().template leftCols<kDiag>().transpose();
+}
@@ -28,6 +28,8 @@
 #include <cmath>
 
 #include <controller_interface/controller_base.h>
+#include <franka_interface/arm_namespace.h>
+#include <franka_interface/callback_queues.h>
 #include <hardware_interface/hardware_interface.h>
 #include <hardware_interface/joint_command_interface.h>
 #include <pluginlib/class_list_macros.h>
@@ -38,9 +40,12 @@ namespace franka_ros_controllers {
 
 bool VelocityJointVelocityController::init(hardware_interface::RobotHW* robot_hardware,
                                           ros::NodeHandle& node_handle) {
+  ros::NodeHandle arm_node_handle = franka_interface::armNodeHandle(node_handle);
+  // command topics are delivered by a thread of their own, see commandNodeHandle()
+  ros::NodeHandle command_node_handle = franka_interface::commandNodeHandle(node_handle);
 
-  desired_joints_subscriber_ = node_handle.subscribe(
-      "/franka_ros_interface/motion_controller/arm/joint_commands", 20, &VelocityJointVelocityController::jointVelCmdCallback, this,
+  desired_joints_subscriber_ = command_node_handle.subscribe(
+      "franka_ros_interface/motion_controller/arm/joint_commands", 20, &VelocityJointVelocityController::jointVelCmdCallback, this,
       ros::TransportHints().reliable().tcpNoDelay());
 
   velocity_joint_interface_ = robot_hardware->get<hardware_interface::VelocityJointInterface>();
@@ -49,7 +54,7 @@ bool VelocityJointVelocityController::init(hardware_interface::RobotHW* robot_ha
         "VelocityJointVelocityController: Error getting velocity joint interface from hardware!");
     return false;
   }
-  if (!node_handle.getParam("/robot_config/joint_names", joint_limits_.joint_names)) {
+  if (!arm_node_handle.getParam("robot_config/joint_names", joint_limits_.joint_names)) {
     ROS_ERROR("VelocityJointVelocityController: Could not parse joint names");
   }
   if (joint_limits_.joint_names.size() != 7) {
@@ -57,26 +62,11 @@ bool VelocityJointVelocityController::init(hardware_interface::RobotHW* robot_ha
                      << joint_limits_.joint_names.size() << " instead of 7 names!");
     return false;
   }
-  std::map<std::string, double> vel_limit_map;
-  if (!node_handle.getParam("/robot_config/joint_config/joint_velocity_limit", vel_limit_map) ) {
-  ROS_ERROR(
-      "VelocityJointVelocityController: Joint limits parameters not provided, aborting "
-      "controller init!");
-  return false;
-      }
-  
 
-  for (size_t i = 0; i < joint_limits_.joint_names.size(); ++i){
-    if (vel_limit_map.find(joint_limits_.joint_names[i]) != vel_limit_map.end())
-      {
-        joint_limits_.velocity.push_back(vel_limit_map[joint_limits_.joint_names[i]]);
-      }
-      else
-      {
-        ROS_ERROR("VelocityJointVelocityController: Unable to find lower velocity limit values for joint %s...",
-                       joint_limits_.joint_names[i].c_str());
-      }
-  }  
+  if (!limit_checker_.init(node_handle, "VelocityJointVelocityController",
+                           JointLimitChecker::kVelocity)) {
+    return false;
+  }
 
   velocity_joint_handles_.resize(7);
   for (size_t i = 0; i < 7; ++i) {
@@ -97,7 +87,7 @@ bool VelocityJointVelocityController::init(hardware_interface::RobotHW* robot_ha
   trigger_publish_ = franka_hw::TriggerRate(controller_state_publish_rate);
 
   dynamic_reconfigure_joint_controller_params_node_ =
-      ros::NodeHandle("/franka_ros_interface/velocity_joint_velocity_controller/arm/controller_parameters_config");
+      ros::NodeHandle(arm_node_handle, "franka_ros_interface/velocity_joint_velocity_controller/arm/controller_parameters_config");
 
   dynamic_server_joint_controller_params_ = std::make_unique<
       dynamic_reconfigure::Server<franka_ros_controllers::joint_controller_paramsConfig>>(
@@ -106,7 +96,13 @@ bool VelocityJointVelocityController::init(hardware_interface::RobotHW* robot_ha
   dynamic_server_joint_controller_params_->setCallback(
       boost::bind(&VelocityJointVelocityController::jointControllerParamCallback, this, _1, _2));
 
-  publisher_controller_states_.init(node_handle, "/franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
+  if (!shared_command_reader_.init(node_handle, "VelocityJointVelocityController")) {
+    return false;
+  }
+  latency_tracer_.init(node_handle, "VelocityJointVelocityController");
+  command_watchdog_.init(node_handle, "VelocityJointVelocityController");
+
+  publisher_controller_states_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_states", 1);
 
   {
     std::lock_guard<realtime_tools::RealtimePublisher<franka_core_msgs::JointControllerStates> > lock(
@@ -117,19 +113,57 @@ bool VelocityJointVelocityController::init(hardware_interface::RobotHW* robot_ha
 
   }
 
+  franka_core_msgs::JointControllerSamples samples_prototype;
+  samples_prototype.controller_name = "velocity_joint_velocity_controller";
+  samples_prototype.names = joint_limits_.joint_names;
+  sample_publisher_.init(arm_node_handle, "franka_ros_interface/motion_controller/arm/joint_controller_samples",
+                         samples_prototype, "VelocityJointVelocityController");
+
   return true;
 }
 
-void VelocityJointVelocityController::starting(const ros::Time& /* time */) {
+void VelocityJointVelocityController::starting(const ros::Time& time) {
   for (size_t i = 0; i < 7; ++i) {
     initial_vel_[i] = velocity_joint_handles_[i].getVelocity();
   }
   vel_d_ = initial_vel_;
   prev_d_ = vel_d_;
+  limit_checker_.resetSetpoints(std::array<double, 7>{}, initial_vel_);
+  joint_command_mailbox_.clear();
+  shared_command_reader_.starting();
+  command_watchdog_.starting(time);
 }
 
 void VelocityJointVelocityController::update(const ros::Time& time,
                                             const ros::Duration& period) {
+  JointTargetCommand command;
+  bool new_command = joint_command_mailbox_.readFromRT(command);
+  if (new_command) {
+    latency_tracer_.applied(command.trace, time);
+    command_watchdog_.commandReceived(time);
+  }
+  franka_interface::SharedJointCommand shared_command;
+  if (shared_command_reader_.read(franka_core_msgs::JointCommand::VELOCITY_MODE, shared_command)) {
+    command.velocity = shared_command.velocity;
+    command.hold = !limit_checker_.checkVelocities(command.velocity);
+    new_command = true;
+    command_watchdog_.commandReceived(time);
+  }
+  if (new_command) {
+    if (command.hold) {
+      vel_d_ = prev_d_;
+      vel_d_target_ = prev_d_;
+    } else {
+      vel_d_target_ = command.velocity;
+    }
+  }
+  if (command_watchdog_.expired(time)) {
+    // ramp down to standstill through the filter below
+    vel_d_target_.fill(0.0);
+  }
+
+  // a rejected command or a jump of the target must not make the setpoint jump
+  limit_checker_.limitVelocitySetpoint(vel_d_, period.toSec());
   for (size_t i = 0; i < 7; ++i) {
     velocity_joint_handles_[i].setCommand(vel_d_[i]);
   }
@@ -149,49 +183,46 @@ void VelocityJointVelocityController::update(const ros::Time& time,
       publisher_controller_states_.msg_.joint_controller_states[i].header.stamp = time;
 
     }
+    publisher_controller_states_.msg_.overwritten_commands = joint_command_mailbox_.overwrittenCount();
 
     publisher_controller_states_.unlockAndPublish();        
   }
 
+  if (sample_publisher_.enabled()) {
+    JointControllerSample sample;
+    sample.time = time.toSec();
+    sample.set_point = vel_d_target_;
+    sample.process_value = vel_d_;
+    sample_publisher_.push(sample);
+  }
+
   // update parameters changed online either through dynamic reconfigure or through the interactive
   // target by filtering
   filter_joint_vel_ = param_change_filter_ * target_filter_joint_vel_ + (1.0 - param_change_filter_) * filter_joint_vel_;
 
 }
 
-bool VelocityJointVelocityController::checkVelocityLimits(std::vector<double> velocities)
-{
-  // bool retval = true;
-  for (size_t i = 0;  i < 7; ++i){
-    if (!(abs(velocities[i]) <= joint_limits_.velocity[i])){
-      return true;
-    }
-  }
-
-  return false;
-}
-
-void VelocityJointVelocityController::jointVelCmdCallback(const franka_core_msgs::JointCommandConstPtr& msg) {
+void VelocityJointVelocityController::jointVelCmdCallback(
+    const ros::MessageEvent<franka_core_msgs::JointCommand const>& event) {
+    const franka_core_msgs::JointCommandConstPtr& msg = event.getConstMessage();
 
     if (msg->mode == franka_core_msgs::JointCommand::VELOCITY_MODE){
+      JointTargetCommand command;
       if (msg->velocity.size() != 7) {
         ROS_ERROR_STREAM(
             "VelocityJointVelocityController: Published Commands are not of size 7");
-        vel_d_ = prev_d_;
-        vel_d_target_ = prev_d_;
-      }
-      else if (checkVelocityLimits(msg->velocity)) {
-         ROS_ERROR_STREAM(
-            "VelocityJointVelocityController: Commanded velocities are beyond allowed velocity limits.");
-        vel_d_ = prev_d_;
-        vel_d_target_ = prev_d_;
-
+        command.hold = true;
       }
-      else
-      {
-        std::copy_n(msg->velocity.begin(), 7, vel_d_target_.begin());
+      else {
+        std::copy_n(msg->velocity.begin(), 7, command.velocity.begin());
+        if (!limit_checker_.checkVelocities(command.velocity)) {
+          ROS_ERROR_STREAM(
+              "VelocityJointVelocityController: Commanded velocities are beyond allowed velocity limits.");
+          command.hold = true;
+        }
       }
-      
+      command.trace = latency_tracer_.received(event);
+      joint_command_mailbox_.writeFromNonRT(command);
     }
     // else ROS_ERROR_STREAM("VelocityJointVelocityController: Published Command msg are not of JointCommand::Velocity! Dropping message");
 }
@@ -205,6 +236,13 @@ void VelocityJointVelocityController::stopping(const ros::Time& /*time*/) {
   // WARNING: DO NOT SEND ZERO VELOCITIES HERE AS IN CASE OF ABORTING DURING MOTION
   // A JUMP TO ZERO WILL BE COMMANDED PUTTING HIGH LOADS ON THE ROBOT. LET THE DEFAULT
   // BUILT-IN STOPPING BEHAVIOR SLOW DOWN THE ROBOT.
+  ROS_INFO_STREAM("VelocityJointVelocityController: " << joint_command_mailbox_.overwrittenCount()
+                  << " of " << joint_command_mailbox_.writtenCount()
+                  << " commands were overwritten before being applied; the command timeout was exceeded "
+                  << command_watchdog_.timeouts() << " times; "
+                  << limit_checker_.clampedCommands() << " commands were clamped to and "
+                  << limit_checker_.rejectedCommands() << " rejected for the joint limits; the "
+                  << "setpoint was limited in " << limit_checker_.limitedSetpoints() << " cycles.");
 }
 
 }  // namespace franka_ros_controllers
@@ -0,0 +1,126 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+// Runs update() of CartesianImpedanceController on a MockFrankaHW and counts the heap
+// allocations of the control thread with the AllocationCounter of the benchmarks, which
+// replaces malloc and its relatives (and so every operator new, Eigen, the standard containers,
+// ...) in this executable. Any allocation fails the test. Started by
+// cartesian_impedance_allocation.test, as the controller needs a ROS master in init().
+
+#include <string>
+#include <vector>
+
+#include <franka_core_msgs/CartImpedanceStiffness.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+
+#include <franka_ros_controllers/cartesian_impedance_controller.h>
+
+#include "../benchmark/allocation_counter.h"
+#include "../benchmark/mock_franka_hw.h"
+
+namespace franka_ros_controllers {
+namespace {
+
+const ros::Duration kPeriod(0.001);
+
+// waits until the controller has taken the message published last, i.e. until the topic has
+// a subscriber and the spinner has delivered it
+template <typename Message>
+void publishAndWait(ros::Publisher& publisher, const Message& message) {
+  for (int i = 0; i < 100 && publisher.getNumSubscribers() == 0; ++i) {
+    ros::Duration(0.01).sleep();
+  }
+  ASSERT_GT(publisher.getNumSubscribers(), 0u);
+  publisher.publish(message);
+  ros::Duration(0.1).sleep();
+}
+
+using benchmarks::AllocationCounter;
+
+TEST(CartesianImpedanceController, UpdateDoesNotAllocate) {
+  ros::NodeHandle root_node_handle;
+  std::string arm_id;
+  std::vector<std::string> joint_names;
+  ASSERT_TRUE(root_node_handle.getParam("/robot_config/arm_id", arm_id));
+  ASSERT_TRUE(root_node_handle.getParam("/robot_config/joint_names", joint_names));
+
+  benchmarks::MockFrankaHW hardware(arm_id, joint_names, benchmarks::syntheticTrajectory(2000));
+  ros::NodeHandle controller_node_handle("/franka_ros_interface/cartesian_impedance_controller");
+  CartesianImpedanceController controller;
+  controller_interface::ControllerBase::ClaimedResources claimed_resources;
+  ASSERT_TRUE(controller.initRequest(&hardware, root_node_handle, controller_node_handle,
+                                     claimed_resources));
+  ros::Time time = ros::Time::now();
+  controller.startRequest(time);
+
+  // only update() is counted, on this thread; the callbacks run on the spinner thread
+  auto run = [&](size_t cycles) {
+    for (size_t i = 0; i < cycles; ++i) {
+      hardware.read();
+      time += kPeriod;
+      const uint64_t allocations = AllocationCounter::count();
+      AllocationCounter::enable(true);
+      controller.updateRequest(time, kPeriod);
+      AllocationCounter::enable(false);
+      ASSERT_EQ(AllocationCounter::count() - allocations, 0u) << "in update() " << i;
+    }
+  };
+  run(1000);
+
+  // new targets go through the mailboxes and the target filter
+  ros::Publisher pose_publisher =
+      root_node_handle.advertise<geometry_msgs::PoseStamped>("equilibrium_pose", 1);
+  geometry_msgs::PoseStamped pose;
+  pose.pose.position.x = 0.35;
+  pose.pose.position.z = 0.45;
+  pose.pose.orientation.x = 1.0;
+  publishAndWait(pose_publisher, pose);
+  ros::Publisher stiffness_publisher =
+      root_node_handle.advertise<franka_core_msgs::CartImpedanceStiffness>("impedance_stiffness", 1);
+  franka_core_msgs::CartImpedanceStiffness stiffness;
+  stiffness.x = stiffness.y = stiffness.z = 300.0;
+  stiffness.xrot = stiffness.yrot = stiffness.zrot = 15.0;
+  publishAndWait(stiffness_publisher, stiffness);
+  run(1000);
+
+  controller.stopRequest(time);
+}
+
+}  // anonymous namespace
+}  // namespace franka_ros_controllers
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "cartesian_impedance_allocation_test");
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+  int result = RUN_ALL_TESTS();
+  ros::shutdown();
+  return result;
+}
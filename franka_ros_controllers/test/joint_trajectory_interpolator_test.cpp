@@ -0,0 +1,183 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+// Timing of JointTrajectoryInterpolator: where appended and restarting chunks are placed in time,
+// that the points are passed through, and what stop() leaves behind. Runs both sides from the
+// test thread with explicit times; no ROS master needed.
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <franka_core_msgs/JointCommandChunk.h>
+#include <gtest/gtest.h>
+#include <ros/time.h>
+
+#include <franka_ros_controllers/joint_trajectory_interpolator.h>
+
+namespace franka_ros_controllers {
+namespace {
+
+const double kTolerance(1e-6);
+const ros::Duration kPeriod(0.001);
+
+// chunk of points that move all joints to position[k] at time_from_start[k], without velocities
+franka_core_msgs::JointCommandChunk makeChunk(const std::vector<double>& time_from_start,
+                                              const std::vector<double>& position,
+                                              const ros::Time& stamp = ros::Time()) {
+  franka_core_msgs::JointCommandChunk chunk;
+  chunk.header.stamp = stamp;
+  chunk.interpolation = franka_core_msgs::JointCommandChunk::CUBIC;
+  chunk.points.resize(time_from_start.size());
+  for (size_t k = 0; k < time_from_start.size(); ++k) {
+    chunk.points[k].time_from_start = ros::Duration(time_from_start[k]);
+    chunk.points[k].positions.assign(7, position[k]);
+  }
+  return chunk;
+}
+
+class JointTrajectoryInterpolatorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    position_.fill(0.0);
+    velocity_.fill(0.0);
+  }
+
+  void add(const franka_core_msgs::JointCommandChunk& chunk) {
+    std::string error;
+    ASSERT_TRUE(interpolator_.addChunk(chunk, time_, error)) << error;
+  }
+
+  // runs the control loop up to (and including) the cycle at time
+  void runUntil(const ros::Time& time) {
+    while (time_ < time - ros::Duration(kPeriod.toSec() / 2)) {
+      time_ += kPeriod;
+      interpolator_.sample(time_, position_, velocity_);
+    }
+  }
+
+  JointTrajectoryInterpolator interpolator_;
+  ros::Time time_{10.0};
+  std::array<double, 7> position_;
+  std::array<double, 7> velocity_;
+};
+
+TEST_F(JointTrajectoryInterpolatorTest, PassesThroughPoints) {
+  add(makeChunk({0.1, 0.2, 0.3}, {0.1, 0.2, 0.4}));
+  runUntil(ros::Time(10.1));
+  EXPECT_NEAR(position_[0], 0.1, kTolerance);
+  runUntil(ros::Time(10.2));
+  EXPECT_NEAR(position_[3], 0.2, kTolerance);
+  EXPECT_GT(velocity_[3], 0.0);
+  runUntil(ros::Time(10.3));
+  EXPECT_NEAR(position_[6], 0.4, kTolerance);
+  EXPECT_NEAR(velocity_[6], 0.0, kTolerance);
+  runUntil(ros::Time(10.301));
+  EXPECT_FALSE(interpolator_.active());
+  EXPECT_NEAR(position_[6], 0.4, kTolerance);
+}
+
+TEST_F(JointTrajectoryInterpolatorTest, AppendContinuesAfterLastQueuedPoint) {
+  add(makeChunk({0.1, 0.2, 0.3}, {0.1, 0.2, 0.3}));
+  runUntil(ros::Time(10.15));
+  // relative to the last queued point (10.3), not to now
+  add(makeChunk({0.1, 0.2}, {0.4, 0.5}));
+  runUntil(ros::Time(10.3));
+  EXPECT_NEAR(position_[0], 0.3, kTolerance);
+  // appended before the segment towards 10.3 started: passes through instead of stopping
+  EXPECT_NEAR(velocity_[0], 1.0, kTolerance);
+  runUntil(ros::Time(10.4));
+  EXPECT_NEAR(position_[0], 0.4, kTolerance);
+  EXPECT_NEAR(velocity_[0], 1.0, kTolerance);
+  runUntil(ros::Time(10.5));
+  EXPECT_NEAR(position_[0], 0.5, kTolerance);
+  EXPECT_NEAR(velocity_[0], 0.0, kTolerance);
+}
+
+TEST_F(JointTrajectoryInterpolatorTest, LateAppendStopsAtBoundary) {
+  add(makeChunk({0.1, 0.2}, {0.1, 0.2}));
+  runUntil(ros::Time(10.15));
+  add(makeChunk({0.1}, {0.3}));
+  runUntil(ros::Time(10.2));
+  EXPECT_NEAR(position_[0], 0.2, kTolerance);
+  EXPECT_NEAR(velocity_[0], 0.0, kTolerance);
+  runUntil(ros::Time(10.3));
+  EXPECT_NEAR(position_[0], 0.3, kTolerance);
+}
+
+TEST_F(JointTrajectoryInterpolatorTest, AppendAfterQueueRanEmptyStartsFromNow) {
+  add(makeChunk({0.1}, {0.1}));
+  runUntil(ros::Time(10.5));
+  EXPECT_FALSE(interpolator_.active());
+  add(makeChunk({0.1}, {0.2}));
+  runUntil(ros::Time(10.55));
+  EXPECT_TRUE(interpolator_.active());
+  runUntil(ros::Time(10.6));
+  EXPECT_NEAR(position_[0], 0.2, kTolerance);
+}
+
+TEST_F(JointTrajectoryInterpolatorTest, RestartIsRelativeToStamp) {
+  add(makeChunk({0.1, 0.2, 0.3}, {0.1, 0.2, 0.3}));
+  runUntil(ros::Time(10.15));
+  // drops the queued points and blends from the current target
+  add(makeChunk({0.2, 0.4}, {-0.1, -0.2}, ros::Time(10.1)));
+  runUntil(ros::Time(10.3));
+  EXPECT_NEAR(position_[0], -0.1, kTolerance);
+  runUntil(ros::Time(10.5));
+  EXPECT_NEAR(position_[0], -0.2, kTolerance);
+  runUntil(ros::Time(10.501));
+  EXPECT_FALSE(interpolator_.active());
+}
+
+TEST_F(JointTrajectoryInterpolatorTest, AppendAfterStopStartsFromNow) {
+  add(makeChunk({0.1, 0.2, 0.3}, {0.1, 0.2, 0.3}));
+  runUntil(ros::Time(10.05));
+  interpolator_.stop();
+  EXPECT_FALSE(interpolator_.active());
+  // the dropped points (up to 10.3) must not delay the next chunk
+  add(makeChunk({0.1}, {0.5}));
+  runUntil(ros::Time(10.15));
+  EXPECT_NEAR(position_[0], 0.5, kTolerance);
+  runUntil(ros::Time(10.151));
+  EXPECT_FALSE(interpolator_.active());
+}
+
+TEST_F(JointTrajectoryInterpolatorTest, RejectsPointsInThePast) {
+  std::string error;
+  EXPECT_FALSE(interpolator_.addChunk(makeChunk({0.2, 0.1}, {0.1, 0.2}), time_, error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_FALSE(interpolator_.addChunk(makeChunk({0.1}, {0.1}, ros::Time(9.5)), time_, error));
+  EXPECT_FALSE(interpolator_.sample(time_ + kPeriod, position_, velocity_));
+}
+
+}  // anonymous namespace
+}  // namespace franka_ros_controllers
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,208 @@
+/***************************************************************************
+
+*
+* @package: franka_ros_controllers
+* @metapackage: franka_ros_interface
+* @author: Saif Sidhik <sxs1412@bham.ac.uk>
+*
+
+**************************************************************************/
+
+/***************************************************************************
+* Copyright (c) 2019-2020, Saif Sidhik.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**************************************************************************/
+
+
+// Round trip of SampleBatchPublisher: samples pushed as by the control loop are received from
+// the batch topic, unpacked and compared with what was pushed. Started by
+// sample_batch_publisher.test, as publishing needs a ROS master.
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <franka_core_msgs/JointControllerSamples.h>
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+
+#include <franka_ros_controllers/sample_batch_publisher.h>
+
+namespace franka_ros_controllers {
+namespace {
+
+const size_t kJoints(7);
+
+// distinct and exactly representable for every field of every sample
+JointControllerSample makeSample(size_t index) {
+  JointControllerSample sample;
+  sample.time = 100.0 + index * 0.001;
+  for (size_t j = 0; j < kJoints; ++j) {
+    sample.set_point[j] = index * 100.0 + j;
+    sample.process_value[j] = index * 100.0 + j + 10.0;
+    sample.process_value_dot[j] = index * 100.0 + j + 20.0;
+    sample.error[j] = index * 100.0 + j + 30.0;
+    sample.command[j] = index * 100.0 + j + 40.0;
+  }
+  return sample;
+}
+
+class BatchCollector {
+ public:
+  BatchCollector(ros::NodeHandle& node_handle, const std::string& topic)
+      : subscriber_(node_handle.subscribe(topic, 1000, &BatchCollector::callback, this)) {}
+
+  // waits for the publisher to connect
+  bool connected() {
+    for (int i = 0; i < 100 && subscriber_.getNumPublishers() == 0; ++i) {
+      ros::Duration(0.01).sleep();
+    }
+    return subscriber_.getNumPublishers() > 0;
+  }
+
+  // waits until count samples arrived
+  std::vector<franka_core_msgs::JointControllerSamples> waitFor(size_t count) {
+    for (int i = 0; i < 500; ++i) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (samples_ >= count) {
+          break;
+        }
+      }
+      ros::Duration(0.01).sleep();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return batches_;
+  }
+
+ private:
+  void callback(const franka_core_msgs::JointControllerSamples& batch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batches_.push_back(batch);
+    samples_ += batch.stamps.size();
+  }
+
+  ros::Subscriber subscriber_;
+  std::mutex mutex_;
+  std::vector<franka_core_msgs::JointControllerSamples> batches_;
+  size_t samples_{0};
+};
+
+// unpacks the batches and compares them with the samples first, first + 1, ...
+void expectSamples(const std::vector<franka_core_msgs::JointControllerSamples>& batches,
+                   size_t first, size_t count) {
+  size_t index = first;
+  for (const auto& batch : batches) {
+    const size_t n = batch.stamps.size();
+    ASSERT_GT(n, 0u) << "empty batches are not published";
+    EXPECT_EQ(batch.controller_name, "test_controller");
+    ASSERT_EQ(batch.names.size(), kJoints);
+    ASSERT_EQ(batch.set_point.size(), n * kJoints);
+    ASSERT_EQ(batch.process_value.size(), n * kJoints);
+    ASSERT_EQ(batch.process_value_dot.size(), n * kJoints);
+    ASSERT_EQ(batch.error.size(), n * kJoints);
+    ASSERT_EQ(batch.command.size(), n * kJoints);
+    EXPECT_EQ(batch.header.stamp, batch.stamps.back());
+    for (size_t i = 0; i < n; ++i, ++index) {
+      const JointControllerSample expected = makeSample(index);
+      EXPECT_EQ(batch.stamps[i], ros::Time(expected.time)) << "sample " << index;
+      for (size_t j = 0; j < kJoints; ++j) {
+        ASSERT_EQ(batch.set_point[i * kJoints + j], expected.set_point[j]) << "sample " << index;
+        ASSERT_EQ(batch.process_value[i * kJoints + j], expected.process_value[j]);
+        ASSERT_EQ(batch.process_value_dot[i * kJoints + j], expected.process_value_dot[j]);
+        ASSERT_EQ(batch.error[i * kJoints + j], expected.error[j]);
+        ASSERT_EQ(batch.command[i * kJoints + j], expected.command[j]);
+      }
+    }
+  }
+  EXPECT_EQ(index, first + count);
+}
+
+franka_core_msgs::JointControllerSamples prototype() {
+  franka_core_msgs::JointControllerSamples batch;
+  batch.controller_name = "test_controller";
+  for (size_t j = 0; j < kJoints; ++j) {
+    batch.names.push_back("panda_joint" + std::to_string(j + 1));
+  }
+  return batch;
+}
+
+TEST(SampleBatchPublisher, DisabledByDefault) {
+  ros::NodeHandle node_handle("~disabled");
+  SampleBatchPublisher<JointControllerSample> publisher;
+  publisher.init(node_handle, "samples", prototype(), "SampleBatchPublisherTest");
+  EXPECT_FALSE(publisher.enabled());
+  publisher.push(makeSample(0));  // no-op
+}
+
+TEST(SampleBatchPublisher, RoundTrip) {
+  ros::NodeHandle node_handle("~round_trip");
+  node_handle.setParam("publish_samples", true);
+  node_handle.setParam("sample_publish_rate", 50.0);
+  SampleBatchPublisher<JointControllerSample> publisher;
+  publisher.init(node_handle, "samples", prototype(), "SampleBatchPublisherTest");
+  ASSERT_TRUE(publisher.enabled());
+  BatchCollector collector(node_handle, "samples");
+  ASSERT_TRUE(collector.connected());
+
+  // about 1 kHz, so that the samples are spread over several batches
+  const size_t count = 500;
+  for (size_t index = 0; index < count; ++index) {
+    publisher.push(makeSample(index));
+    ros::WallDuration(0.001).sleep();
+  }
+  // publishes what is still buffered
+  publisher.stop();
+  std::vector<franka_core_msgs::JointControllerSamples> batches = collector.waitFor(count);
+  EXPECT_GT(batches.size(), 1u);
+  expectSamples(batches, 0, count);
+  for (const auto& batch : batches) {
+    EXPECT_EQ(batch.dropped_samples, 0u);
+  }
+}
+
+TEST(SampleBatchPublisher, CountsDroppedSamples) {
+  ros::NodeHandle node_handle("~overflow");
+  node_handle.setParam("publish_samples", true);
+  node_handle.setParam("sample_publish_rate", 1.0);
+  // smaller than the samples pushed before the thread first wakes up
+  SampleBatchPublisher<JointControllerSample, 16> publisher;
+  publisher.init(node_handle, "samples", prototype(), "SampleBatchPublisherTest");
+  ASSERT_TRUE(publisher.enabled());
+  BatchCollector collector(node_handle, "samples");
+  ASSERT_TRUE(collector.connected());
+
+  for (size_t index = 0; index < 20; ++index) {
+    publisher.push(makeSample(index));
+  }
+  publisher.stop();
+  std::vector<franka_core_msgs::JointControllerSamples> batches = collector.waitFor(16);
+  ASSERT_EQ(batches.size(), 1u);
+  // the oldest samples are kept
+  expectSamples(batches, 0, 16);
+  EXPECT_EQ(batches.front().dropped_samples, 4u);
+}
+
+}  // anonymous namespace
+}  // namespace franka_ros_controllers
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "sample_batch_publisher_test");
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+  int result = RUN_ALL_TESTS();
+  ros::shutdown();
+  return result;
+}